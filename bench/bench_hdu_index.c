@@ -0,0 +1,159 @@
+/**
+ * @file bench_hdu_index.c
+ * @author Greg Sleap
+ * @date 18 Oct 2026
+ * @brief Benchmark of reading random integrations of a fits file through its .idx sidecar versus with cfitsio
+ *
+ * Usage: bench_hdu_index FITS_FILE [ITERATIONS]
+ *
+ * FITS_FILE must have been written with --hdu-index. The visibilities of ITERATIONS randomly chosen integrations are
+ * read into native floats, first through the index (looking each one up by its marker, then straight from the memory
+ * mapped file), then with cfitsio (moving to the HDU and reading the image), after checking both read the same values
+ * for every integration. The mean time per integration each way is reported, along with the time to open the file.
+ */
+#include <fitsio.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../src/hdu_index.h"
+
+#define BENCH_DEFAULT_ITERATIONS 1000
+
+static double elapsed_sec(struct timespec *start, struct timespec *end)
+{
+  return (end->tv_sec - start->tv_sec) + ((end->tv_nsec - start->tv_nsec) / 1.0e9);
+}
+
+// Reads integration n (of nintegrations, in a file of nhdus) with cfitsio. HDU 1 is the primary, then each integration
+// has the same number of HDUs (visibilities first)
+static int read_with_cfitsio(fitsfile *fptr, int nhdus, uint64_t nintegrations, uint64_t n, float *dest, uint64_t nfloats)
+{
+  int hdus_per_integration = (int)((nhdus - 1) / nintegrations);
+  int status = 0;
+  int anynul = 0;
+  float nulval = 0;
+
+  fits_movabs_hdu(fptr, 2 + (int)n * hdus_per_integration, NULL, &status);
+  fits_read_img(fptr, TFLOAT, 1, (LONGLONG)nfloats, &nulval, dest, &anynul, &status);
+
+  return status;
+}
+
+int main(int argc, char *argv[])
+{
+  if (argc < 2)
+  {
+    printf("Usage: bench_hdu_index FITS_FILE [ITERATIONS]\n");
+    exit(1);
+  }
+
+  const char *fits_filename = argv[1];
+  int iterations = (argc > 2) ? atoi(argv[2]) : BENCH_DEFAULT_ITERATIONS;
+
+  if (iterations < 1)
+  {
+    fprintf(stderr, "Error: ITERATIONS must be 1 or greater.\n");
+    exit(1);
+  }
+
+  struct timespec start, end;
+  hdu_index_reader_s reader;
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+
+  if (hdu_index_reader_open(&reader, fits_filename) != EXIT_SUCCESS || reader.record_count == 0)
+  {
+    fprintf(stderr, "Error: could not open %s with its index (was it written with --hdu-index?).\n", fits_filename);
+    exit(1);
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  double index_open_sec = elapsed_sec(&start, &end);
+
+  fitsfile *fptr = NULL;
+  int status = 0;
+  int nhdus = 0;
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+
+  if (fits_open_file(&fptr, fits_filename, READONLY, &status) || fits_get_num_hdus(fptr, &nhdus, &status))
+  {
+    fprintf(stderr, "Error: cfitsio could not open %s (%d).\n", fits_filename, status);
+    exit(1);
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  double cfitsio_open_sec = elapsed_sec(&start, &end);
+
+  uint64_t nintegrations = reader.record_count;
+  uint64_t vis_bytes = reader.records[0].vis_data_bytes;
+  uint64_t nfloats = vis_bytes / sizeof(float);
+  float *from_index = malloc(vis_bytes);
+  float *from_cfitsio = malloc(vis_bytes);
+  uint64_t *order = malloc(iterations * sizeof(uint64_t));
+
+  if (from_index == NULL || from_cfitsio == NULL || order == NULL)
+  {
+    fprintf(stderr, "Error: could not allocate memory.\n");
+    exit(1);
+  }
+
+  // Both ways must read the same visibilities
+  for (uint64_t n = 0; n < nintegrations; n++)
+  {
+    uint64_t bytes = 0;
+    const void *vis = hdu_index_reader_visibilities(&reader, n, &bytes);
+    hdu_index_copy_floats(from_index, vis, nfloats);
+
+    if (bytes != vis_bytes || read_with_cfitsio(fptr, nhdus, nintegrations, n, from_cfitsio, nfloats) != 0 ||
+        memcmp(from_index, from_cfitsio, vis_bytes) != 0)
+    {
+      fprintf(stderr, "Error: integration %lu read through the index does not match cfitsio.\n", n);
+      exit(1);
+    }
+  }
+
+  srand(1);
+
+  for (int i = 0; i < iterations; i++)
+  {
+    order[i] = (uint64_t)rand() % nintegrations;
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+
+  for (int i = 0; i < iterations; i++)
+  {
+    uint64_t bytes = 0;
+    const hdu_index_record_s *record = hdu_index_reader_find_marker(&reader, reader.records[order[i]].marker);
+    const void *vis = hdu_index_reader_visibilities(&reader, (uint64_t)(record - reader.records), &bytes);
+    hdu_index_copy_floats(from_index, vis, nfloats);
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  double index_sec = elapsed_sec(&start, &end);
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+
+  for (int i = 0; i < iterations; i++)
+  {
+    read_with_cfitsio(fptr, nhdus, nintegrations, order[i], from_cfitsio, nfloats);
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  double cfitsio_sec = elapsed_sec(&start, &end);
+
+  printf("method,integrations,hdus,vis_bytes,open_ms,us_per_integration\n");
+  printf("hdu_index,%lu,%d,%lu,%.3f,%.3f\n", nintegrations, nhdus, vis_bytes, index_open_sec * 1.0e3, index_sec / iterations * 1.0e6);
+  printf("cfitsio,%lu,%d,%lu,%.3f,%.3f\n", nintegrations, nhdus, vis_bytes, cfitsio_open_sec * 1.0e3, cfitsio_sec / iterations * 1.0e6);
+
+  fits_close_file(fptr, &status);
+  hdu_index_reader_close(&reader);
+  free(from_index);
+  free(from_cfitsio);
+  free(order);
+
+  return EXIT_SUCCESS;
+}
\ No newline at end of file
@@ -0,0 +1,114 @@
+/**
+ * @file bench_header.c
+ * @author Greg Sleap
+ * @date 18 Oct 2026
+ * @brief Benchmark of reading every keyword of a PSRDADA header with ascii_header_get() versus dada_header_parse()
+ *
+ * Usage: bench_header [ITERATIONS]
+ *
+ * A typical MWAX correlator header (padded to 4096 bytes like the ringbuffer's header blocks) has every keyword in it
+ * read as a string, first by calling ascii_header_get() for each keyword (which searches the header from the start
+ * every time), then by splitting it into keywords once with dada_header_parse() and finding each one in the index.
+ * The values read both ways are compared, then the mean time to read the whole header each way is reported.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "ascii_header.h"
+#include "../src/dada_header.h"
+
+#define BENCH_DEFAULT_ITERATIONS 100000
+#define BENCH_HEADER_SIZE 4096
+#define BENCH_VALUE_LEN 256
+
+// The header of tests/test01, as the correlator sends it
+static const char *bench_header_text =
+    "HDR_SIZE 4096\nPOPULATED 1\nOBS_ID 1324440018\nSUBOBS_ID 1324440018\nMODE MWAX_CORRELATOR\n"
+    "UTC_START 2021-12-25-04:00:00\nFILE_SIZE 4576\nOBS_OFFSET 0\nNBIT 32\nNPOL 2\nNTIMESAMPLES 2\nNINPUTS 4\n"
+    "NINPUTS_XGPU 16\nAPPLY_PATH_WEIGHTS 0\nAPPLY_PATH_DELAYS 0\nINT_TIME_MSEC 4000\nFSCRUNCH_FACTOR 50\n"
+    "APPLY_VIS_WEIGHTS 0\nTRANSFER_SIZE 480\nPROJ_ID C001\nEXPOSURE_SECS 16\nCOARSE_CHANNEL 148\n"
+    "CORR_COARSE_CHANNEL 9\nSECS_PER_SUBOBS 8\nUNIXTIME 1640404800\nUNIXTIME_MSEC 0\nFINE_CHAN_WIDTH_HZ 640000\n"
+    "NFINE_CHAN 2\nBANDWIDTH_HZ 1280000\nSAMPLE_RATE 1280000\nMC_IP 0.0.0.0\nMC_PORT 0\nMC_SRC_IP 0.0.0.0\n"
+    "MWAX_U2S_VER 2.05a-83\nMWAX_DB2CORR2DB_VER 0.0.0\n";
+
+static double elapsed_sec(struct timespec *start, struct timespec *end)
+{
+  return (end->tv_sec - start->tv_sec) + ((end->tv_nsec - start->tv_nsec) / 1.0e9);
+}
+
+int main(int argc, char *argv[])
+{
+  int iterations = (argc > 1) ? atoi(argv[1]) : BENCH_DEFAULT_ITERATIONS;
+
+  if (iterations < 1)
+  {
+    fprintf(stderr, "Error: ITERATIONS must be 1 or greater.\n");
+    exit(1);
+  }
+
+  char header_text[BENCH_HEADER_SIZE];
+  memset(header_text, 0, BENCH_HEADER_SIZE);
+  strncpy(header_text, bench_header_text, BENCH_HEADER_SIZE - 1);
+
+  // The keywords to read are the ones in the header
+  static dada_header_s header;
+  dada_header_parse(&header, header_text, BENCH_HEADER_SIZE, NULL);
+
+  int nkeys = header.count;
+  char keys[DADA_HEADER_MAX_KEYS][BENCH_VALUE_LEN];
+  char expected[DADA_HEADER_MAX_KEYS][BENCH_VALUE_LEN];
+  char value[BENCH_VALUE_LEN];
+
+  for (int k = 0; k < nkeys; k++)
+  {
+    snprintf(keys[k], BENCH_VALUE_LEN, "%.*s", header.entries[k].key_len, header.entries[k].key);
+
+    if (ascii_header_get(header_text, keys[k], "%s", expected[k]) != 1 ||
+        dada_header_get_string(&header, keys[k], value, BENCH_VALUE_LEN) != DADA_HEADER_OK || strcmp(value, expected[k]) != 0)
+    {
+      fprintf(stderr, "Error: %s was read differently by ascii_header_get() and dada_header_parse().\n", keys[k]);
+      exit(1);
+    }
+  }
+
+  struct timespec start, end;
+  volatile int checksum = 0; // So the reads are not optimised away
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+
+  for (int i = 0; i < iterations; i++)
+  {
+    for (int k = 0; k < nkeys; k++)
+    {
+      ascii_header_get(header_text, keys[k], "%s", value);
+      checksum += value[0];
+    }
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  double ascii_header_get_sec = elapsed_sec(&start, &end);
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+
+  for (int i = 0; i < iterations; i++)
+  {
+    dada_header_parse(&header, header_text, BENCH_HEADER_SIZE, NULL);
+
+    for (int k = 0; k < nkeys; k++)
+    {
+      dada_header_get_string(&header, keys[k], value, BENCH_VALUE_LEN);
+      checksum += value[0];
+    }
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  double dada_header_parse_sec = elapsed_sec(&start, &end);
+
+  printf("method,keywords,header_bytes,us_per_header\n");
+  printf("ascii_header_get,%d,%d,%.3f\n", nkeys, BENCH_HEADER_SIZE, ascii_header_get_sec / iterations * 1.0e6);
+  printf("dada_header_parse,%d,%d,%.3f\n", nkeys, BENCH_HEADER_SIZE, dada_header_parse_sec / iterations * 1.0e6);
+
+  return EXIT_SUCCESS;
+}
\ No newline at end of file
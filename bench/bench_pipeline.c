@@ -0,0 +1,350 @@
+/**
+ * @file bench_pipeline.c
+ * @author Greg Sleap
+ * @date 18 Oct 2026
+ * @brief In-process benchmark of the whole db2fits pipeline, without psrdada ringbuffers
+ *
+ * Usage: bench_pipeline -d PATH [-t TILES] [-c FINE_CHANS] [-i INT_TIME_MSEC] [-e EXPOSURE_SECS] [-l BYTES] [-T] [-s] [-r SIGMA] [-C] [-v]
+ *
+ * A fake dada_client_t with an in-memory ascii header is driven through dada_dbfits_open(), dada_dbfits_io() and
+ * dada_dbfits_close() for each 8 second sub-observation of a synthetic observation, exactly as dada_client_read()
+ * would, using generated visibilities (rotating through a few buffers, like a ringbuffer). Fits files are written to
+ * PATH for real, so point it at the filesystem you want to measure (and clean it up afterwards).
+ *
+ * One CSV line is reported: the rate fits files were written, the latency percentiles of each integration's
+ * dada_dbfits_io() call and of each HDU write, and the real-time margin, i.e. how many times faster than the
+ * integration cadence the pipeline ran (at the p99 of dada_dbfits_io(), and over the whole run).
+ */
+#include <getopt.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../src/autos.h"
+#include "../src/dada_dbfits.h"
+#include "../mwax_common/mwax_global_defs.h" // From mwax-common
+#include "../src/global.h"
+#include "../src/metrics.h"
+#include "../src/rfi.h"
+#include "../src/stats.h"
+#include "../src/utils.h"
+
+#define BENCH_POLS 4             // xx,xy,yx,yy
+#define BENCH_BUFFERS 4          // Number of integration buffers to rotate through
+#define BENCH_SECS_PER_SUBOBS 8  // As the correlator sends them
+#define BENCH_BANDWIDTH_HZ 1280000
+#define BENCH_OBS_ID 1324440018
+#define BENCH_HEADER_SIZE 4096
+
+static void print_bench_usage()
+{
+  printf("Usage: bench_pipeline -d PATH [OPTION]...\n\n");
+  printf("  -d PATH           Directory to write the fits files to (mandatory)\n");
+  printf("  -t TILES          Number of tiles. Default=128\n");
+  printf("  -c FINE_CHANS     Number of fine channels per coarse channel. Default=128\n");
+  printf("  -i INT_TIME_MSEC  Integration time (milliseconds). Default=1000\n");
+  printf("  -e EXPOSURE_SECS  Length of the observation (a multiple of %d seconds). Default=16\n", BENCH_SECS_PER_SUBOBS);
+  printf("  -l BYTES          FITS file size limit. Default=%ld bytes. 0=no splitting\n", DEFAULT_FILE_SIZE_LIMIT);
+  printf("  -T                Write visibilities frequency-major (--transpose)\n");
+  printf("  -s                Write channel statistics (--channel-stats)\n");
+  printf("  -r SIGMA          RFI flagging threshold (--rfi-threshold). Default=0 (disabled)\n");
+  printf("  -C                Write one visibility and one weights cube HDU per sub-observation (--cube)\n");
+  printf("  -v                Log everything db2fits logs to stderr (default is to discard it)\n");
+}
+
+static int compare_uint64(const void *a, const void *b)
+{
+  uint64_t x = *(const uint64_t *)a;
+  uint64_t y = *(const uint64_t *)b;
+
+  return (x > y) - (x < y);
+}
+
+// Builds the ascii header the correlator would send for one sub-observation
+static void make_header(char *header, int tiles, int fine_chans, int int_time_msec, int exposure_secs, int obs_offset, time_t unix_time, uint64_t transfer_size)
+{
+  char utc_start[UTC_START_LEN];
+  time_t obs_start = unix_time - obs_offset;
+  strftime(utc_start, sizeof(utc_start), "%Y-%m-%d-%H:%M:%S", gmtime(&obs_start));
+
+  memset(header, 0, BENCH_HEADER_SIZE);
+  snprintf(header, BENCH_HEADER_SIZE,
+           "HDR_SIZE %d\n%s 1\n%s %d\n%s %d\n%s MWAX_CORRELATOR\n%s %s\n%s %d\n%s 32\n%s 2\n%s %d\n%s %d\n%s 1\n%s %lu\n"
+           "%s C001\n%s %d\n%s 148\n%s 9\n%s %d\n%s %ld\n%s 0\n%s %d\n%s %d\n%s %d\n%s 0.0.0.0\n%s 0\n%s bench\n%s bench\n",
+           BENCH_HEADER_SIZE,
+           HEADER_POPULATED,
+           HEADER_OBS_ID, BENCH_OBS_ID,
+           HEADER_SUBOBS_ID, BENCH_OBS_ID + obs_offset,
+           HEADER_MODE,
+           HEADER_UTC_START, utc_start,
+           HEADER_OBS_OFFSET, obs_offset,
+           HEADER_NBIT,
+           HEADER_NPOL,
+           HEADER_NINPUTS, tiles * 2,
+           HEADER_INT_TIME_MSEC, int_time_msec,
+           HEADER_FSCRUNCH_FACTOR,
+           HEADER_TRANSFER_SIZE, transfer_size,
+           HEADER_PROJ_ID,
+           HEADER_EXPOSURE_SECS, exposure_secs,
+           HEADER_COARSE_CHANNEL,
+           HEADER_CORR_COARSE_CHANNEL,
+           HEADER_SECS_PER_SUBOBS, BENCH_SECS_PER_SUBOBS,
+           HEADER_UNIXTIME, (long)unix_time,
+           HEADER_UNIXTIME_MSEC,
+           HEADER_FINE_CHAN_WIDTH_HZ, BENCH_BANDWIDTH_HZ / fine_chans,
+           HEADER_NFINE_CHAN, fine_chans,
+           HEADER_BANDWIDTH_HZ, BENCH_BANDWIDTH_HZ,
+           HEADER_MC_IP,
+           HEADER_MC_PORT,
+           HEADER_MWAX_U2S_VERSION,
+           HEADER_MWAX_DB2CORRELATE2DB_VERSION);
+}
+
+int main(int argc, char *argv[])
+{
+  char *destination_path = NULL;
+  int tiles = 128;
+  int fine_chans = 128;
+  int int_time_msec = 1000;
+  int exposure_secs = 16;
+  long file_size_limit = DEFAULT_FILE_SIZE_LIMIT;
+  int verbose = 0;
+
+  g_ctx.vis_layout = VIS_LAYOUT_BASELINE_MAJOR;
+  g_ctx.rfi_threads = RFI_DEFAULT_THREADS;
+
+  int opt;
+
+  while ((opt = getopt(argc, argv, "d:t:c:i:e:l:Tsr:Cv?")) != -1)
+  {
+    switch (opt)
+    {
+    case 'd':
+      destination_path = optarg;
+      break;
+    case 't':
+      tiles = atoi(optarg);
+      break;
+    case 'c':
+      fine_chans = atoi(optarg);
+      break;
+    case 'i':
+      int_time_msec = atoi(optarg);
+      break;
+    case 'e':
+      exposure_secs = atoi(optarg);
+      break;
+    case 'l':
+      file_size_limit = atol(optarg);
+      break;
+    case 'T':
+      g_ctx.vis_layout = VIS_LAYOUT_FINECHAN_MAJOR;
+      break;
+    case 's':
+      g_ctx.channel_stats = 1;
+      break;
+    case 'r':
+      g_ctx.rfi_threshold = atof(optarg);
+      break;
+    case 'C':
+      g_ctx.cube = 1;
+      break;
+    case 'v':
+      verbose = 1;
+      break;
+    default:
+      print_bench_usage();
+      exit(1);
+    }
+  }
+
+  if (destination_path == NULL || tiles < 1 || fine_chans < 1 || BENCH_BANDWIDTH_HZ % fine_chans != 0 || int_time_msec < INT_TIME_MSEC_MIN ||
+      (BENCH_SECS_PER_SUBOBS * 1000) % int_time_msec != 0 || exposure_secs < BENCH_SECS_PER_SUBOBS || exposure_secs % BENCH_SECS_PER_SUBOBS != 0)
+  {
+    fprintf(stderr, "Error: a destination path is mandatory, fine channels must divide %d Hz, the integration time must divide %d seconds and the exposure must be a multiple of %d seconds.\n",
+            BENCH_BANDWIDTH_HZ, BENCH_SECS_PER_SUBOBS, BENCH_SECS_PER_SUBOBS);
+    print_bench_usage();
+    exit(1);
+  }
+
+  if (g_ctx.cube && (g_ctx.channel_stats || g_ctx.rfi_threshold > 0))
+  {
+    fprintf(stderr, "Error: -C can not be used with -s or -r.\n");
+    print_bench_usage();
+    exit(1);
+  }
+
+  // db2fits logs a few lines for each integration. Formatting them is part of the cost, so they are written somewhere
+  multilog_t *log = multilog_open("bench_pipeline", 0);
+  FILE *log_file = verbose ? stderr : fopen("/dev/null", "w");
+  multilog_add(log, log_file);
+
+  // Set up the context as main() would
+  g_ctx.log = log;
+  gethostname(g_ctx.hostname, HOST_NAME_LEN);
+  g_ctx.destination_dir = destination_path;
+  g_ctx.fits_file_size_limit = (file_size_limit == 0 ? LONG_MAX : file_size_limit);
+  g_ctx.bad_data_policy = BAD_DATA_POLICY_KEEP;
+  memset(&g_ctx.perf, 0, sizeof(perf_counters_s));
+
+  if (health_manager_init(0) != EXIT_SUCCESS)
+  {
+    fprintf(stderr, "Error: could not initialise the health manager.\n");
+    exit(1);
+  }
+
+  // Sizes of everything, as process_new_observation() will work them out from the header
+  uint64_t baselines = (uint64_t)tiles * (tiles + 1) / 2;
+  uint64_t values_per_baseline = (uint64_t)fine_chans * BENCH_POLS * 2;
+  uint64_t integration_bytes = baselines * values_per_baseline * sizeof(float);
+  uint64_t weights_bytes = baselines * BENCH_POLS * sizeof(float);
+  int integrations_per_subobs = (BENCH_SECS_PER_SUBOBS * 1000) / int_time_msec;
+  int subobs_count = exposure_secs / BENCH_SECS_PER_SUBOBS;
+  int integrations = integrations_per_subobs * subobs_count;
+
+  g_ctx.block_size = integration_bytes + weights_bytes;
+
+  // Synthetic visibilities: noise around a constant, with real autos, and weights of 1
+  float *buffers[BENCH_BUFFERS];
+  uint32_t seed = 12345;
+
+  for (int b = 0; b < BENCH_BUFFERS; b++)
+  {
+    buffers[b] = malloc(g_ctx.block_size);
+
+    if (buffers[b] == NULL)
+    {
+      fprintf(stderr, "Error: could not allocate %lu bytes for an integration.\n", g_ctx.block_size);
+      exit(1);
+    }
+
+    for (uint64_t v = 0; v < integration_bytes / sizeof(float); v++)
+    {
+      seed = seed * 1664525 + 1013904223;
+      buffers[b][v] = 10.0f + (seed >> 8) / (float)(1 << 24);
+    }
+
+    for (uint64_t w = 0; w < weights_bytes / sizeof(float); w++)
+    {
+      buffers[b][(integration_bytes / sizeof(float)) + w] = 1.0f;
+    }
+  }
+
+  char header[BENCH_HEADER_SIZE];
+  dada_client_t client;
+  memset(&client, 0, sizeof(client));
+  client.log = log;
+  client.context = &g_ctx;
+  client.header = header;
+  client.header_size = BENCH_HEADER_SIZE;
+
+  uint64_t *io_ns = malloc(integrations * sizeof(uint64_t));
+  metrics_snapshot_s *metrics_before = malloc(sizeof(metrics_snapshot_s));
+  metrics_snapshot_s *metrics_after = malloc(sizeof(metrics_snapshot_s));
+
+  if (io_ns == NULL || metrics_before == NULL || metrics_after == NULL)
+  {
+    fprintf(stderr, "Error: could not allocate memory for the results.\n");
+    exit(1);
+  }
+
+  // The data is "arriving" now, so the end to end latencies are meaningful too
+  time_t obs_start_time = time(NULL);
+  uint64_t transfer_size = (integration_bytes + weights_bytes) * integrations_per_subobs;
+  int integration = 0;
+
+  metrics_snapshot(metrics_before);
+  uint64_t run_start_ns = metrics_now_ns();
+
+  for (int subobs = 0; subobs < subobs_count; subobs++)
+  {
+    int obs_offset = subobs * BENCH_SECS_PER_SUBOBS;
+    make_header(header, tiles, fine_chans, int_time_msec, exposure_secs, obs_offset, obs_start_time + obs_offset, transfer_size);
+
+    if (dada_dbfits_open(&client) != EXIT_SUCCESS)
+    {
+      fprintf(stderr, "Error: dada_dbfits_open() failed for sub-observation %d (run with -v to see why).\n", subobs);
+      exit(1);
+    }
+
+    for (int i = 0; i < integrations_per_subobs; i++, integration++)
+    {
+      uint64_t start_ns = metrics_now_ns();
+
+      if (dada_dbfits_io(&client, buffers[integration % BENCH_BUFFERS], g_ctx.block_size) < 0)
+      {
+        fprintf(stderr, "Error: dada_dbfits_io() failed for integration %d (run with -v to see why).\n", integration);
+        exit(1);
+      }
+
+      io_ns[integration] = metrics_now_ns() - start_ns;
+    }
+
+    if (dada_dbfits_close(&client, g_ctx.block_size * integrations_per_subobs) != EXIT_SUCCESS)
+    {
+      fprintf(stderr, "Error: dada_dbfits_close() failed for sub-observation %d (run with -v to see why).\n", subobs);
+      exit(1);
+    }
+  }
+
+  double wall_sec = (metrics_now_ns() - run_start_ns) / 1.0e9;
+  metrics_snapshot(metrics_after);
+
+  // Results
+  qsort(io_ns, integrations, sizeof(uint64_t), compare_uint64);
+  uint64_t io_p50_ns = io_ns[integrations / 2];
+  uint64_t io_p99_ns = io_ns[(integrations * 99) / 100];
+  uint64_t io_max_ns = io_ns[integrations - 1];
+  uint64_t fits_bytes = metrics_after->bytes_written - metrics_before->bytes_written;
+
+  metrics_latency_summary_s vis_hdu, weights_hdu, create_fits, close_fits;
+  metrics_summarise_latency(metrics_after, metrics_before, METRICS_LATENCY_VIS_HDU, &vis_hdu);
+  metrics_summarise_latency(metrics_after, metrics_before, METRICS_LATENCY_WEIGHTS_HDU, &weights_hdu);
+  metrics_summarise_latency(metrics_after, metrics_before, METRICS_LATENCY_CREATE_FITS, &create_fits);
+  metrics_summarise_latency(metrics_after, metrics_before, METRICS_LATENCY_CLOSE_FITS, &close_fits);
+
+  printf("tiles,fine_chans,int_time_msec,exposure_secs,integrations,bytes_per_integration,fits_bytes,wall_sec,gbytes_per_sec,"
+         "io_p50_ms,io_p99_ms,io_max_ms,vis_hdu_p50_us,vis_hdu_p99_us,vis_hdu_max_us,weights_hdu_p50_us,weights_hdu_p99_us,weights_hdu_max_us,"
+         "create_fits_max_us,close_fits_max_us,realtime_margin_p99,realtime_margin_wall\n");
+  printf("%d,%d,%d,%d,%d,%lu,%lu,%.6f,%.3f,%.3f,%.3f,%.3f,%lu,%lu,%lu,%lu,%lu,%lu,%lu,%lu,%.2f,%.2f\n",
+         tiles, fine_chans, int_time_msec, exposure_secs, integrations, g_ctx.block_size, fits_bytes, wall_sec, fits_bytes / wall_sec / 1.0e9,
+         io_p50_ns / 1.0e6, io_p99_ns / 1.0e6, io_max_ns / 1.0e6,
+         vis_hdu.p50_usec, vis_hdu.p99_usec, vis_hdu.max_usec, weights_hdu.p50_usec, weights_hdu.p99_usec, weights_hdu.max_usec,
+         create_fits.max_usec, close_fits.max_usec,
+         (int_time_msec * 1.0e6) / io_p99_ns, exposure_secs / wall_sec);
+
+  // Tidy up as main() would
+  autos_destroy(&client);
+  rfi_destroy(&client);
+  channel_stats_free(&g_ctx.chan_stats);
+  free(g_ctx.bad_baselines);
+  free(g_ctx.bad_data_weights);
+  free(g_ctx.transpose_buffer);
+  free(g_ctx.cube_weights);
+  free(g_ctx.file_integration_usec);
+  free(g_ctx.obs_start_metrics);
+  free(g_ctx.obs_end_metrics);
+  health_manager_free_tile_weights();
+  health_manager_destroy();
+
+  for (int b = 0; b < BENCH_BUFFERS; b++)
+  {
+    free(buffers[b]);
+  }
+
+  free(io_ns);
+  free(metrics_before);
+  free(metrics_after);
+
+  multilog_close(log);
+
+  if (!verbose)
+  {
+    fclose(log_file);
+  }
+
+  return EXIT_SUCCESS;
+}
\ No newline at end of file
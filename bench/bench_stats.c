@@ -0,0 +1,118 @@
+/**
+ * @file bench_stats.c
+ * @author Greg Sleap
+ * @date 18 Oct 2026
+ * @brief Benchmark of the per integration data quality passes (compute_channel_stats and scan_bad_data) for 128T and 256T integrations
+ *
+ * Usage: bench_stats [ITERATIONS]
+ *
+ * For each pass and shape this reports the mean time to process one integration, the rate at which
+ * the visibilities were read and the fraction of a 500 ms integration that this takes.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "../src/stats.h"
+
+#define BENCH_DEFAULT_ITERATIONS 20
+#define BENCH_POLS 4           // xx,xy,yx,yy
+#define BENCH_INT_TIME_MSEC 500 // Integration time to compare against
+
+typedef struct
+{
+  int tiles;
+  int fine_channels;
+} bench_shape_s;
+
+typedef enum
+{
+  BENCH_CHANNEL_STATS,
+  BENCH_BAD_DATA_SCAN,
+  BENCH_KERNELS
+} bench_kernel_e;
+
+static const char *bench_kernel_names[BENCH_KERNELS] = {"channel_stats", "bad_data_scan"};
+
+static double elapsed_sec(struct timespec *start, struct timespec *end)
+{
+  return (end->tv_sec - start->tv_sec) + ((end->tv_nsec - start->tv_nsec) / 1.0e9);
+}
+
+int main(int argc, char *argv[])
+{
+  int iterations = (argc > 1) ? atoi(argv[1]) : BENCH_DEFAULT_ITERATIONS;
+
+  // 128T and 256T at 40 kHz and 10 kHz fine channels (over a 1.28 MHz coarse channel)
+  bench_shape_s shapes[] = {{128, 32}, {128, 128}, {256, 32}, {256, 128}};
+  int nshapes = sizeof(shapes) / sizeof(shapes[0]);
+
+  if (iterations < 1)
+  {
+    fprintf(stderr, "Error: ITERATIONS must be 1 or greater.\n");
+    exit(1);
+  }
+
+  printf("kernel,tiles,fine_chans,baselines,bytes,ms_per_integration,gbytes_per_sec,pct_of_%dms\n", BENCH_INT_TIME_MSEC);
+
+  for (int s = 0; s < nshapes; s++)
+  {
+    uint64_t baselines = (uint64_t)shapes[s].tiles * (shapes[s].tiles + 1) / 2;
+    uint64_t nfloats = baselines * shapes[s].fine_channels * BENCH_POLS * 2;
+    uint64_t bytes = nfloats * sizeof(float);
+
+    float *buffer = malloc(bytes);
+    unsigned char *bad_baselines = malloc(baselines);
+    channel_stats_s stats = {0};
+
+    if (buffer == NULL || bad_baselines == NULL || channel_stats_alloc(&stats, shapes[s].fine_channels, BENCH_POLS) != EXIT_SUCCESS)
+    {
+      fprintf(stderr, "Error: could not allocate %lu bytes for a %d tile integration.\n", bytes, shapes[s].tiles);
+      exit(1);
+    }
+
+    // Something which is not all zeros, with the odd NaN thrown in
+    for (uint64_t i = 0; i < nfloats; i++)
+    {
+      buffer[i] = (float)(i % 1000) - 500.0f;
+    }
+    buffer[nfloats / 2] = 0.0f / 0.0f;
+
+    for (int k = 0; k < BENCH_KERNELS; k++)
+    {
+      uint64_t zero_baselines = 0;
+      struct timespec start, end;
+
+      // The first iteration is a warm up (pages in the buffer) and is not timed
+      for (int i = -1; i < iterations; i++)
+      {
+        if (i == 0)
+        {
+          clock_gettime(CLOCK_MONOTONIC, &start);
+        }
+
+        if (k == BENCH_CHANNEL_STATS)
+        {
+          compute_channel_stats(buffer, baselines, &stats);
+        }
+        else
+        {
+          scan_bad_data(buffer, baselines, shapes[s].fine_channels * BENCH_POLS * 2, bad_baselines, &zero_baselines);
+        }
+      }
+
+      clock_gettime(CLOCK_MONOTONIC, &end);
+
+      double sec_per_integration = elapsed_sec(&start, &end) / iterations;
+
+      printf("%s,%d,%d,%lu,%lu,%.3f,%.2f,%.2f\n", bench_kernel_names[k], shapes[s].tiles, shapes[s].fine_channels, baselines, bytes,
+             sec_per_integration * 1000.0, (bytes / sec_per_integration) / 1.0e9, (sec_per_integration * 1000.0 * 100.0) / BENCH_INT_TIME_MSEC);
+    }
+
+    channel_stats_free(&stats);
+    free(bad_baselines);
+    free(buffer);
+  }
+
+  return EXIT_SUCCESS;
+}
\ No newline at end of file
@@ -0,0 +1,323 @@
+/**
+ * @file bench_turnover.c
+ * @author Greg Sleap
+ * @date 18 Oct 2026
+ * @brief In-process benchmark of how quickly db2fits turns over from one short observation to the next
+ *
+ * Usage: bench_turnover -d PATH [-n OBSERVATIONS] [-t TILES] [-c FINE_CHANS] [-i INT_TIME_MSEC] [-A] [-v]
+ *
+ * Each observation is a single 8 second sub-observation with its own obs id, driven through dada_dbfits_open(),
+ * dada_dbfits_io() and dada_dbfits_close() as dada_client_read() would (see bench_pipeline.c). The time spent in
+ * dada_dbfits_open() (parsing the header, setting up the observation and creating the fits file) and in
+ * dada_dbfits_close() (closing and renaming it) is what the correlator has to wait for between observations, so those
+ * are measured, not the integrations. Fits files are written to PATH for real (clean it up afterwards).
+ *
+ * One CSV line is reported: p50/p99/max of open, close and turnover (close of one observation plus open of the
+ * next), how long the finaliser took to drain at the end (-A), the observations per hour that turnover alone would
+ * allow, and whether the p99 turnover is under the 1 ms budget (which leaves the per-channel target of 1000
+ * observations per hour dominated by the data, not the bookkeeping).
+ */
+#include <getopt.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../src/autos.h"
+#include "../src/dada_dbfits.h"
+#include "../src/finaliser.h"
+#include "../mwax_common/mwax_global_defs.h" // From mwax-common
+#include "../src/global.h"
+#include "../src/metrics.h"
+#include "../src/rfi.h"
+#include "../src/stats.h"
+#include "../src/utils.h"
+
+#define BENCH_POLS 4             // xx,xy,yx,yy
+#define BENCH_SECS_PER_SUBOBS 8  // As the correlator sends them
+#define BENCH_BANDWIDTH_HZ 1280000
+#define BENCH_OBS_ID 1324440018
+#define BENCH_HEADER_SIZE 4096
+#define BENCH_TURNOVER_BUDGET_NS 1000000 // 1 ms
+
+static void print_bench_usage()
+{
+  printf("Usage: bench_turnover -d PATH [OPTION]...\n\n");
+  printf("  -d PATH           Directory to write the fits files to (mandatory)\n");
+  printf("  -n OBSERVATIONS   Number of observations. Default=100\n");
+  printf("  -t TILES          Number of tiles. Default=16\n");
+  printf("  -c FINE_CHANS     Number of fine channels per coarse channel. Default=128\n");
+  printf("  -i INT_TIME_MSEC  Integration time (milliseconds). Default=8000\n");
+  printf("  -A                Close and rename fits files on the finaliser thread (--async-close)\n");
+  printf("  -v                Log everything db2fits logs to stderr (default is to discard it)\n");
+}
+
+static int compare_uint64(const void *a, const void *b)
+{
+  uint64_t x = *(const uint64_t *)a;
+  uint64_t y = *(const uint64_t *)b;
+
+  return (x > y) - (x < y);
+}
+
+// Builds the ascii header the correlator would send for a one sub-observation observation
+static void make_header(char *header, int obs_id, int tiles, int fine_chans, int int_time_msec, time_t unix_time, uint64_t transfer_size)
+{
+  char utc_start[UTC_START_LEN];
+  strftime(utc_start, sizeof(utc_start), "%Y-%m-%d-%H:%M:%S", gmtime(&unix_time));
+
+  memset(header, 0, BENCH_HEADER_SIZE);
+  snprintf(header, BENCH_HEADER_SIZE,
+           "HDR_SIZE %d\n%s 1\n%s %d\n%s %d\n%s MWAX_CORRELATOR\n%s %s\n%s 0\n%s 32\n%s 2\n%s %d\n%s %d\n%s 1\n%s %lu\n"
+           "%s C001\n%s %d\n%s 148\n%s 9\n%s %d\n%s %ld\n%s 0\n%s %d\n%s %d\n%s %d\n%s 0.0.0.0\n%s 0\n%s bench\n%s bench\n",
+           BENCH_HEADER_SIZE,
+           HEADER_POPULATED,
+           HEADER_OBS_ID, obs_id,
+           HEADER_SUBOBS_ID, obs_id,
+           HEADER_MODE,
+           HEADER_UTC_START, utc_start,
+           HEADER_OBS_OFFSET,
+           HEADER_NBIT,
+           HEADER_NPOL,
+           HEADER_NINPUTS, tiles * 2,
+           HEADER_INT_TIME_MSEC, int_time_msec,
+           HEADER_FSCRUNCH_FACTOR,
+           HEADER_TRANSFER_SIZE, transfer_size,
+           HEADER_PROJ_ID,
+           HEADER_EXPOSURE_SECS, BENCH_SECS_PER_SUBOBS,
+           HEADER_COARSE_CHANNEL,
+           HEADER_CORR_COARSE_CHANNEL,
+           HEADER_SECS_PER_SUBOBS, BENCH_SECS_PER_SUBOBS,
+           HEADER_UNIXTIME, (long)unix_time,
+           HEADER_UNIXTIME_MSEC,
+           HEADER_FINE_CHAN_WIDTH_HZ, BENCH_BANDWIDTH_HZ / fine_chans,
+           HEADER_NFINE_CHAN, fine_chans,
+           HEADER_BANDWIDTH_HZ, BENCH_BANDWIDTH_HZ,
+           HEADER_MC_IP,
+           HEADER_MC_PORT,
+           HEADER_MWAX_U2S_VERSION,
+           HEADER_MWAX_DB2CORRELATE2DB_VERSION);
+}
+
+int main(int argc, char *argv[])
+{
+  char *destination_path = NULL;
+  int observations = 100;
+  int tiles = 16;
+  int fine_chans = 128;
+  int int_time_msec = 8000;
+  int verbose = 0;
+
+  g_ctx.vis_layout = VIS_LAYOUT_BASELINE_MAJOR;
+  g_ctx.rfi_threads = RFI_DEFAULT_THREADS;
+
+  int opt;
+
+  while ((opt = getopt(argc, argv, "d:n:t:c:i:Av?")) != -1)
+  {
+    switch (opt)
+    {
+    case 'd':
+      destination_path = optarg;
+      break;
+    case 'n':
+      observations = atoi(optarg);
+      break;
+    case 't':
+      tiles = atoi(optarg);
+      break;
+    case 'c':
+      fine_chans = atoi(optarg);
+      break;
+    case 'i':
+      int_time_msec = atoi(optarg);
+      break;
+    case 'A':
+      g_ctx.async_close = 1;
+      break;
+    case 'v':
+      verbose = 1;
+      break;
+    default:
+      print_bench_usage();
+      exit(1);
+    }
+  }
+
+  if (destination_path == NULL || observations < 2 || tiles < 1 || fine_chans < 1 || BENCH_BANDWIDTH_HZ % fine_chans != 0 ||
+      int_time_msec < INT_TIME_MSEC_MIN || (BENCH_SECS_PER_SUBOBS * 1000) % int_time_msec != 0)
+  {
+    fprintf(stderr, "Error: a destination path and at least 2 observations are mandatory, fine channels must divide %d Hz and the integration time must divide %d seconds.\n",
+            BENCH_BANDWIDTH_HZ, BENCH_SECS_PER_SUBOBS);
+    print_bench_usage();
+    exit(1);
+  }
+
+  multilog_t *log = multilog_open("bench_turnover", 0);
+  FILE *log_file = verbose ? stderr : fopen("/dev/null", "w");
+  multilog_add(log, log_file);
+
+  // Set up the context as main() would
+  g_ctx.log = log;
+  gethostname(g_ctx.hostname, HOST_NAME_LEN);
+  g_ctx.destination_dir = destination_path;
+  g_ctx.fits_file_size_limit = LONG_MAX;
+  g_ctx.bad_data_policy = BAD_DATA_POLICY_KEEP;
+  memset(&g_ctx.perf, 0, sizeof(perf_counters_s));
+
+  if (health_manager_init(0) != EXIT_SUCCESS)
+  {
+    fprintf(stderr, "Error: could not initialise the health manager.\n");
+    exit(1);
+  }
+
+  if (g_ctx.async_close && finaliser_init(log) != EXIT_SUCCESS)
+  {
+    fprintf(stderr, "Error: could not start the fits finaliser thread (run with -v to see why).\n");
+    exit(1);
+  }
+
+  // Sizes of everything, as process_new_observation() will work them out from the header
+  uint64_t baselines = (uint64_t)tiles * (tiles + 1) / 2;
+  uint64_t integration_bytes = baselines * fine_chans * BENCH_POLS * 2 * sizeof(float);
+  uint64_t weights_bytes = baselines * BENCH_POLS * sizeof(float);
+  int integrations_per_subobs = (BENCH_SECS_PER_SUBOBS * 1000) / int_time_msec;
+
+  g_ctx.block_size = integration_bytes + weights_bytes;
+
+  // The content of the integrations does not matter here, only that they are valid
+  float *buffer = malloc(g_ctx.block_size);
+
+  if (buffer == NULL)
+  {
+    fprintf(stderr, "Error: could not allocate %lu bytes for an integration.\n", g_ctx.block_size);
+    exit(1);
+  }
+
+  for (uint64_t v = 0; v < g_ctx.block_size / sizeof(float); v++)
+  {
+    buffer[v] = 1.0f;
+  }
+
+  char header[BENCH_HEADER_SIZE];
+  dada_client_t client;
+  memset(&client, 0, sizeof(client));
+  client.log = log;
+  client.context = &g_ctx;
+  client.header = header;
+  client.header_size = BENCH_HEADER_SIZE;
+
+  uint64_t *open_ns = malloc(observations * sizeof(uint64_t));
+  uint64_t *close_ns = malloc(observations * sizeof(uint64_t));
+  uint64_t *turnover_ns = malloc(observations * sizeof(uint64_t));
+
+  if (open_ns == NULL || close_ns == NULL || turnover_ns == NULL)
+  {
+    fprintf(stderr, "Error: could not allocate memory for the results.\n");
+    exit(1);
+  }
+
+  time_t start_time = time(NULL);
+  uint64_t transfer_size = g_ctx.block_size * integrations_per_subobs;
+  uint64_t run_start_ns = metrics_now_ns();
+
+  for (int obs = 0; obs < observations; obs++)
+  {
+    // Back to back observations, each 8 seconds after the last
+    int obs_id = BENCH_OBS_ID + (obs * BENCH_SECS_PER_SUBOBS);
+    make_header(header, obs_id, tiles, fine_chans, int_time_msec, start_time + (obs * BENCH_SECS_PER_SUBOBS), transfer_size);
+
+    uint64_t start_ns = metrics_now_ns();
+
+    if (dada_dbfits_open(&client) != EXIT_SUCCESS)
+    {
+      fprintf(stderr, "Error: dada_dbfits_open() failed for observation %d (run with -v to see why).\n", obs);
+      exit(1);
+    }
+
+    open_ns[obs] = metrics_now_ns() - start_ns;
+
+    for (int i = 0; i < integrations_per_subobs; i++)
+    {
+      if (dada_dbfits_io(&client, buffer, g_ctx.block_size) < 0)
+      {
+        fprintf(stderr, "Error: dada_dbfits_io() failed for observation %d (run with -v to see why).\n", obs);
+        exit(1);
+      }
+    }
+
+    start_ns = metrics_now_ns();
+
+    if (dada_dbfits_close(&client, transfer_size) != EXIT_SUCCESS)
+    {
+      fprintf(stderr, "Error: dada_dbfits_close() failed for observation %d (run with -v to see why).\n", obs);
+      exit(1);
+    }
+
+    close_ns[obs] = metrics_now_ns() - start_ns;
+  }
+
+  // With -A the last files are still being closed: waiting for them is part of the run, but not of any turnover
+  uint64_t drain_start_ns = metrics_now_ns();
+
+  if (g_ctx.async_close)
+  {
+    finaliser_destroy();
+  }
+
+  uint64_t drain_ns = metrics_now_ns() - drain_start_ns;
+  double wall_sec = (metrics_now_ns() - run_start_ns) / 1.0e9;
+
+  // Turnover is the close of one observation plus the open of the next
+  int turnovers = observations - 1;
+
+  for (int obs = 0; obs < turnovers; obs++)
+  {
+    turnover_ns[obs] = close_ns[obs] + open_ns[obs + 1];
+  }
+
+  qsort(open_ns, observations, sizeof(uint64_t), compare_uint64);
+  qsort(close_ns, observations, sizeof(uint64_t), compare_uint64);
+  qsort(turnover_ns, turnovers, sizeof(uint64_t), compare_uint64);
+
+  uint64_t turnover_p99_ns = turnover_ns[(turnovers * 99) / 100];
+
+  printf("tiles,fine_chans,int_time_msec,observations,async_close,wall_sec,open_p50_us,open_p99_us,open_max_us,close_p50_us,close_p99_us,close_max_us,"
+         "turnover_p50_us,turnover_p99_us,turnover_max_us,drain_ms,turnover_obs_per_hour,result\n");
+  printf("%d,%d,%d,%d,%d,%.6f,%.1f,%.1f,%.1f,%.1f,%.1f,%.1f,%.1f,%.1f,%.1f,%.3f,%.0f,%s\n",
+         tiles, fine_chans, int_time_msec, observations, g_ctx.async_close, wall_sec,
+         open_ns[observations / 2] / 1.0e3, open_ns[(observations * 99) / 100] / 1.0e3, open_ns[observations - 1] / 1.0e3,
+         close_ns[observations / 2] / 1.0e3, close_ns[(observations * 99) / 100] / 1.0e3, close_ns[observations - 1] / 1.0e3,
+         turnover_ns[turnovers / 2] / 1.0e3, turnover_p99_ns / 1.0e3, turnover_ns[turnovers - 1] / 1.0e3,
+         drain_ns / 1.0e6, 3600.0e9 / turnover_p99_ns,
+         (turnover_p99_ns < BENCH_TURNOVER_BUDGET_NS ? "PASS" : "FAIL"));
+
+  // Tidy up as main() would
+  autos_destroy(&client);
+  rfi_destroy(&client);
+  channel_stats_free(&g_ctx.chan_stats);
+  free(g_ctx.bad_baselines);
+  free(g_ctx.bad_data_weights);
+  free(g_ctx.transpose_buffer);
+  free(g_ctx.file_integration_usec);
+  free(g_ctx.obs_start_metrics);
+  free(g_ctx.obs_end_metrics);
+  health_manager_free_tile_weights();
+  health_manager_destroy();
+
+  free(buffer);
+  free(open_ns);
+  free(close_ns);
+  free(turnover_ns);
+
+  multilog_close(log);
+
+  if (!verbose)
+  {
+    fclose(log_file);
+  }
+
+  return EXIT_SUCCESS;
+}
\ No newline at end of file
@@ -0,0 +1,197 @@
+/**
+ * @file bench_weights.c
+ * @author Greg Sleap
+ * @date 18 Oct 2026
+ * @brief Benchmark of the reader (ringbuffer) side cost of adding the weights (and auto power) of an integration to the health totals
+ *
+ * Usage: bench_weights [ITERATIONS]
+ *
+ * For 128, 256 and 512 tiles this reports the mean time per integration of:
+ *   baseline_walk       - the previous approach: walk every baseline under the health mutex to pick out the autos
+ *   auto_gather         - accumulate_auto_weights(), which computes the index of each auto directly
+ *   auto_power          - accumulate_auto_power() over BENCH_FINE_CHANS fine channels, with no bandpass bins
+ *   auto_power_bandpass - as above, with BENCH_BANDPASS_BINS bandpass bins
+ *   set_weights_info    - health_manager_set_weights_info() (auto_gather and auto_power_bandpass inside the sequence lock)
+ *   set_weights_info_contended - as above, while another thread copies the totals in a tight loop
+ * More than NTILES_MAX tiles exercises health_manager_set_weights_info() growing the tile weights (once, up front).
+ */
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "../src/global.h"
+#include "../src/utils.h"
+
+#define BENCH_DEFAULT_ITERATIONS 100000
+#define BENCH_POLS 4 // xx,xy,yx,yy
+#define BENCH_FINE_CHANS 128
+#define BENCH_BANDPASS_BINS 16
+
+static pthread_mutex_t bench_mutex = PTHREAD_MUTEX_INITIALIZER;
+static atomic_int bench_reader_quit;
+
+static double elapsed_sec(struct timespec *start, struct timespec *end)
+{
+  return (end->tv_sec - start->tv_sec) + ((end->tv_nsec - start->tv_nsec) / 1.0e9);
+}
+
+// The previous approach, for comparison
+static void baseline_walk(const float *buffer, int ntiles, double *weights_per_tile_x, double *weights_per_tile_y)
+{
+  pthread_mutex_lock(&bench_mutex);
+
+  int baseline = 0;
+
+  for (int i = 0; i < ntiles; i++)
+  {
+    for (int j = 0; j <= i; j++)
+    {
+      if (i == j)
+      {
+        weights_per_tile_x[i] += buffer[baseline * BENCH_POLS];
+        weights_per_tile_y[i] += buffer[(baseline * BENCH_POLS) + 3];
+      }
+
+      baseline++;
+    }
+  }
+
+  pthread_mutex_unlock(&bench_mutex);
+}
+
+// Plays the part of the health thread, but as often as it can
+static void *totals_reader_fn(void *args)
+{
+  (void)args;
+  health_totals_s totals;
+  health_tile_weights_s *tile_weights = health_tile_weights_alloc(NTILES_MAX, BENCH_BANDPASS_BINS);
+
+  while (!atomic_load(&bench_reader_quit))
+  {
+    health_manager_get_totals(&totals, &tile_weights);
+  }
+
+  health_tile_weights_free(tile_weights);
+
+  return NULL;
+}
+
+int main(int argc, char *argv[])
+{
+  int iterations = (argc > 1) ? atoi(argv[1]) : BENCH_DEFAULT_ITERATIONS;
+  int tile_counts[] = {128, 256, 512};
+  int ntile_counts = sizeof(tile_counts) / sizeof(tile_counts[0]);
+
+  if (iterations < 1)
+  {
+    fprintf(stderr, "Error: ITERATIONS must be 1 or greater.\n");
+    exit(1);
+  }
+
+  health_manager_init(BENCH_BANDPASS_BINS);
+
+  printf("method,tiles,ns_per_integration\n");
+
+  for (int t = 0; t < ntile_counts; t++)
+  {
+    int ntiles = tile_counts[t];
+    uint64_t baselines = (uint64_t)ntiles * (ntiles + 1) / 2;
+    float *buffer = malloc(baselines * BENCH_POLS * sizeof(float));
+    double *weights_per_tile_x = calloc(ntiles, sizeof(double));
+    double *weights_per_tile_y = calloc(ntiles, sizeof(double));
+    double *bandpass_per_tile = calloc((uint64_t)ntiles * 2 * BENCH_BANDPASS_BINS, sizeof(double));
+
+    // Only the autocorrelations are read, so the rest of the visibilities are left as untouched (zero) pages
+    uint64_t values_per_baseline = (uint64_t)BENCH_FINE_CHANS * BENCH_POLS * 2;
+    float *visibilities = calloc(baselines * values_per_baseline, sizeof(float));
+
+    if (buffer == NULL || weights_per_tile_x == NULL || weights_per_tile_y == NULL || bandpass_per_tile == NULL || visibilities == NULL)
+    {
+      fprintf(stderr, "Error: could not allocate weights for %d tiles.\n", ntiles);
+      exit(1);
+    }
+
+    for (uint64_t i = 0; i < baselines * BENCH_POLS; i++)
+    {
+      buffer[i] = 1.0f;
+    }
+
+    for (int tile = 0; tile < ntiles; tile++)
+    {
+      for (uint64_t v = 0; v < values_per_baseline; v++)
+      {
+        visibilities[(get_auto_baseline_index(tile) * values_per_baseline) + v] = 1.0f;
+      }
+    }
+
+    struct timespec start, end;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int i = 0; i < iterations; i++)
+    {
+      baseline_walk(buffer, ntiles, weights_per_tile_x, weights_per_tile_y);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    printf("baseline_walk,%d,%.1f\n", ntiles, elapsed_sec(&start, &end) * 1.0e9 / iterations);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int i = 0; i < iterations; i++)
+    {
+      accumulate_auto_weights(buffer, ntiles, weights_per_tile_x, weights_per_tile_y);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    printf("auto_gather,%d,%.1f\n", ntiles, elapsed_sec(&start, &end) * 1.0e9 / iterations);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int i = 0; i < iterations; i++)
+    {
+      accumulate_auto_power(visibilities, ntiles, BENCH_FINE_CHANS, 0, weights_per_tile_x, weights_per_tile_y, NULL);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    printf("auto_power,%d,%.1f\n", ntiles, elapsed_sec(&start, &end) * 1.0e9 / iterations);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int i = 0; i < iterations; i++)
+    {
+      accumulate_auto_power(visibilities, ntiles, BENCH_FINE_CHANS, BENCH_BANDPASS_BINS, weights_per_tile_x, weights_per_tile_y, bandpass_per_tile);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    printf("auto_power_bandpass,%d,%.1f\n", ntiles, elapsed_sec(&start, &end) * 1.0e9 / iterations);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int i = 0; i < iterations; i++)
+    {
+      health_manager_set_weights_info(buffer, visibilities, ntiles, BENCH_FINE_CHANS);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    printf("set_weights_info,%d,%.1f\n", ntiles, elapsed_sec(&start, &end) * 1.0e9 / iterations);
+
+    pthread_t reader;
+    atomic_store(&bench_reader_quit, 0);
+    pthread_create(&reader, NULL, totals_reader_fn, NULL);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int i = 0; i < iterations; i++)
+    {
+      health_manager_set_weights_info(buffer, visibilities, ntiles, BENCH_FINE_CHANS);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    atomic_store(&bench_reader_quit, 1);
+    pthread_join(reader, NULL);
+    printf("set_weights_info_contended,%d,%.1f\n", ntiles, elapsed_sec(&start, &end) * 1.0e9 / iterations);
+
+    free(weights_per_tile_x);
+    free(weights_per_tile_y);
+    free(bandpass_per_tile);
+    free(visibilities);
+    free(buffer);
+  }
+
+  health_manager_free_tile_weights();
+  health_manager_destroy();
+
+  return EXIT_SUCCESS;
+}
\ No newline at end of file
@@ -0,0 +1,153 @@
+/**
+ * @file fuzz_dada_header.c
+ * @author Greg Sleap
+ * @date 18 Oct 2026
+ * @brief Fuzz target for dada_header_parse() and its typed accessors
+ *
+ * Built with clang this is a libFuzzer target (run e.g. bin/fuzz_dada_header -max_total_time=60). Built with any
+ * other compiler (FUZZ_STANDALONE) it has its own main, which fuzzes a typical MWAX header with random mutations:
+ *
+ * Usage: fuzz_dada_header [ITERATIONS] [SEED]
+ *
+ * The input is copied to a buffer of exactly its size with no NUL terminator, so with -fsanitize=address any read
+ * past the end of the header is caught. Every keyword found must lie within the input, and be found again by name
+ * (its first occurrence); every typed accessor must return one of the documented results.
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../src/dada_header.h"
+
+#define FUZZ_VALUE_LEN 33 // As short as MWAX_MODE_LEN, so values which are too long are exercised
+#define FUZZ_KEY_LEN 256
+
+static void fuzz_check(int condition, const char *what)
+{
+  if (!condition)
+  {
+    fprintf(stderr, "fuzz_dada_header: %s\n", what);
+    abort();
+  }
+}
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+  char *text = malloc(size == 0 ? 1 : size);
+  fuzz_check(text != NULL, "could not allocate memory");
+  memcpy(text, data, size);
+
+  static dada_header_s header;
+  fuzz_check(dada_header_parse(&header, text, size, NULL) == EXIT_SUCCESS, "dada_header_parse() failed");
+  fuzz_check(header.count >= 0 && header.count <= DADA_HEADER_MAX_KEYS, "count out of range");
+
+  for (int e = 0; e < header.count; e++)
+  {
+    const dada_header_entry_s *entry = &header.entries[e];
+    fuzz_check(entry->key_len > 0 && entry->key >= text && entry->key + entry->key_len <= text + size, "key outside the header");
+    fuzz_check(entry->value_len >= 0 && entry->value >= text && entry->value + entry->value_len <= text + size, "value outside the header");
+
+    char key[FUZZ_KEY_LEN];
+
+    if ((size_t)entry->key_len >= sizeof(key))
+    {
+      continue;
+    }
+
+    memcpy(key, entry->key, entry->key_len);
+    key[entry->key_len] = '\0';
+
+    const dada_header_entry_s *found = dada_header_find(&header, key);
+    fuzz_check(found != NULL && found <= entry, "keyword not found by name");
+
+    int int_value;
+    long long_value;
+    uint64_t uint64_value;
+    char string_value[FUZZ_VALUE_LEN];
+
+    int result = dada_header_get_int(&header, key, &int_value);
+    fuzz_check(result == DADA_HEADER_OK || result == DADA_HEADER_INVALID, "unexpected result from dada_header_get_int()");
+    result = dada_header_get_long(&header, key, &long_value);
+    fuzz_check(result == DADA_HEADER_OK || result == DADA_HEADER_INVALID, "unexpected result from dada_header_get_long()");
+    result = dada_header_get_uint64(&header, key, &uint64_value);
+    fuzz_check(result == DADA_HEADER_OK || result == DADA_HEADER_INVALID, "unexpected result from dada_header_get_uint64()");
+    result = dada_header_get_string(&header, key, string_value, FUZZ_VALUE_LEN);
+    fuzz_check(result == DADA_HEADER_OK || result == DADA_HEADER_INVALID, "unexpected result from dada_header_get_string()");
+    fuzz_check(result != DADA_HEADER_OK || strlen(string_value) == (size_t)found->value_len, "string value has the wrong length");
+  }
+
+  free(text);
+
+  return 0;
+}
+
+#ifdef FUZZ_STANDALONE
+#define FUZZ_DEFAULT_ITERATIONS 100000
+#define FUZZ_MAX_SIZE 4096
+
+static const char *fuzz_seed_header =
+    "HDR_SIZE 4096\nPOPULATED 1\nOBS_ID 1324440018\nSUBOBS_ID 1324440018\nMODE MWAX_CORRELATOR\n"
+    "UTC_START 2021-12-25-04:00:00\nOBS_OFFSET 0\nNBIT 32\nNPOL 2\nNINPUTS 4\nINT_TIME_MSEC 4000\n"
+    "FSCRUNCH_FACTOR 50\nTRANSFER_SIZE 480\nPROJ_ID C001\nEXPOSURE_SECS 16\nCOARSE_CHANNEL 148\n"
+    "CORR_COARSE_CHANNEL 9\nSECS_PER_SUBOBS 8\nUNIXTIME 1640404800\nUNIXTIME_MSEC 0\nFINE_CHAN_WIDTH_HZ 640000\n"
+    "NFINE_CHAN 2\nBANDWIDTH_HZ 1280000\nMC_IP 0.0.0.0\nMC_PORT 0\nMWAX_U2S_VER 2.05a-83\nMWAX_DB2CORR2DB_VER 0.0.0\n";
+
+// Characters that matter to the parser, and some that do not
+static const char fuzz_alphabet[] = " \t\n\r#-+0123456789abcXYZ_.\0\xff";
+
+int main(int argc, char *argv[])
+{
+  long iterations = (argc > 1) ? atol(argv[1]) : FUZZ_DEFAULT_ITERATIONS;
+  srand((argc > 2) ? (unsigned)atoi(argv[2]) : 1);
+
+  uint8_t input[FUZZ_MAX_SIZE];
+  size_t seed_size = strlen(fuzz_seed_header);
+
+  for (long i = 0; i < iterations; i++)
+  {
+    memcpy(input, fuzz_seed_header, seed_size);
+    size_t size = seed_size;
+    int mutations = 1 + rand() % 16;
+
+    for (int m = 0; m < mutations; m++)
+    {
+      size_t at = (size == 0 ? 0 : (size_t)rand() % size);
+
+      switch (rand() % 4)
+      {
+      case 0: // Replace a byte
+        if (size > 0)
+        {
+          input[at] = fuzz_alphabet[rand() % (sizeof(fuzz_alphabet) - 1)];
+        }
+        break;
+      case 1: // Insert a byte
+        if (size < FUZZ_MAX_SIZE)
+        {
+          memmove(input + at + 1, input + at, size - at);
+          input[at] = fuzz_alphabet[rand() % (sizeof(fuzz_alphabet) - 1)];
+          size++;
+        }
+        break;
+      case 2: // Delete a byte
+        if (size > 0)
+        {
+          memmove(input + at, input + at + 1, size - at - 1);
+          size--;
+        }
+        break;
+      case 3: // Truncate
+        size = at;
+        break;
+      }
+    }
+
+    LLVMFuzzerTestOneInput(input, size);
+  }
+
+  printf("fuzz_dada_header: %ld inputs OK\n", iterations);
+
+  return EXIT_SUCCESS;
+}
+#endif
\ No newline at end of file
@@ -12,10 +12,10 @@ echo About to try and installl packages, press Ctrl-C to cancel
 pip3 install --upgrade pip
 pip3 install -r requirements.txt
 
-for i in {01..04}
+for i in {01..15}
 do
     echo Building test${i}...
-    gcc test${i}/make_test${i}_data.c common.c -o test${i}/make_test${i}_data
+    gcc test${i}/make_test${i}_data.c common.c -lm -o test${i}/make_test${i}_data
 
     echo Executing test${i}...
     pushd test${i}
@@ -24,7 +24,7 @@ do
 done
 
 echo Analysing Test Results
-for i in {01..04}
+for i in {01..15}
 do
     pytest test${i}.py
 done
@@ -0,0 +1,256 @@
+#
+# Runs bin/bench_pipeline over a sweep of correlator configurations and reports, for each, the data rate the correlator
+# produces, the rate mwax_db2fits achieved and whether it kept up (see "Benchmarks" in README.md)
+#
+import argparse
+import csv
+import datetime
+import json
+import os
+import shutil
+import socket
+import subprocess
+import sys
+
+BANDWIDTH_HZ = 1280000
+SECS_PER_SUBOBS = 8
+NPOL = 2
+BYTES_PER_COMPLEX = 8
+BYTES_PER_FLOAT = 4
+
+# bench_pipeline flags for each output option. Options can be combined with "+", e.g. "transpose+rfi"
+OPTION_FLAGS = {
+    "none": [],
+    "transpose": ["-T"],
+    "chanstats": ["-s"],
+    "rfi": ["-r", "3"],
+    "cube": ["-C"],
+}
+
+# Columns identifying a configuration, used to match rows against a baseline
+KEY_COLUMNS = ["tiles", "fine_chan_width_hz", "int_time_msec", "options"]
+
+COLUMNS = KEY_COLUMNS + [
+    "fine_chans",
+    "integration_bytes",
+    "required_mbytes_per_sec",
+    "achieved_mbytes_per_sec",
+    "headroom",
+    "io_p99_ms",
+    "realtime_margin_p99",
+    "fits_gbytes_per_sec",
+    "result",
+    "baseline_achieved_mbytes_per_sec",
+    "change_percent",
+    "commit",
+    "hostname",
+    "date",
+]
+
+
+def integration_bytes(tiles, fine_chans):
+    # The same sizes process_new_observation() works out from the header
+    ninputs = tiles * 2
+    nbaselines = (ninputs * (ninputs + 2)) // 8
+    one_fine_channel = NPOL * NPOL * BYTES_PER_COMPLEX * nbaselines
+    weights = NPOL * NPOL * BYTES_PER_FLOAT * nbaselines
+    return (one_fine_channel * fine_chans) + weights
+
+
+def git_commit():
+    repo = os.path.join(os.path.dirname(os.path.abspath(__file__)), "..")
+
+    try:
+        commit = subprocess.run(["git", "-C", repo, "rev-parse", "--short", "HEAD"], capture_output=True, text=True, check=True).stdout.strip()
+        dirty = subprocess.run(["git", "-C", repo, "status", "--porcelain", "--untracked-files=no"], capture_output=True, text=True, check=True).stdout.strip()
+        return commit + ("-dirty" if dirty else "")
+    except (OSError, subprocess.CalledProcessError):
+        return "unknown"
+
+
+def run_bench(args, tiles, fine_chans, int_time_msec, options):
+    scratch = os.path.join(args.dest, f"bench_sweep_{os.getpid()}")
+    os.makedirs(scratch, exist_ok=True)
+
+    command = [
+        args.bench,
+        "-d", scratch,
+        "-t", str(tiles),
+        "-c", str(fine_chans),
+        "-i", str(int_time_msec),
+        "-e", str(args.exposure_secs),
+    ]
+
+    for option in options.split("+"):
+        command += OPTION_FLAGS[option]
+
+    try:
+        output = subprocess.run(command, capture_output=True, text=True)
+    finally:
+        shutil.rmtree(scratch, ignore_errors=True)
+
+    if output.returncode != 0:
+        print(f"bench_sweep: {' '.join(command)} failed: {output.stderr.strip()}", file=sys.stderr)
+        return None
+
+    # bench_pipeline prints a CSV header line and one line of results
+    return next(csv.DictReader(output.stdout.strip().splitlines()))
+
+
+def read_baseline(filename):
+    with open(filename) as baseline_file:
+        if filename.endswith(".json"):
+            rows = json.load(baseline_file)["results"]
+        else:
+            rows = list(csv.DictReader(baseline_file))
+
+    return {tuple(str(row[column]) for column in KEY_COLUMNS): row for row in rows}
+
+
+def sweep(args):
+    baseline = read_baseline(args.baseline) if args.baseline else {}
+    commit = git_commit()
+    hostname = socket.gethostname()
+    date = datetime.datetime.now().isoformat(timespec="seconds")
+    results = []
+
+    for tiles in args.tiles:
+        for fine_chan_width_hz in args.fine_chan_width_hz:
+            for int_time_msec in args.int_time_msec:
+                for options in args.options:
+                    fine_chans = BANDWIDTH_HZ // fine_chan_width_hz
+                    size = integration_bytes(tiles, fine_chans)
+                    required = size / (int_time_msec / 1000.0) / 1.0e6
+
+                    row = {
+                        "tiles": tiles,
+                        "fine_chan_width_hz": fine_chan_width_hz,
+                        "int_time_msec": int_time_msec,
+                        "options": options,
+                        "fine_chans": fine_chans,
+                        "integration_bytes": size,
+                        "required_mbytes_per_sec": round(required, 1),
+                        "commit": commit,
+                        "hostname": hostname,
+                        "date": date,
+                    }
+
+                    # bench_pipeline rotates through 4 integration buffers
+                    if size * 4 > args.max_memory_gib * (1 << 30):
+                        row["result"] = "SKIPPED"
+                        results.append(row)
+                        continue
+
+                    print(f"bench_sweep: {tiles}T {fine_chan_width_hz}Hz {int_time_msec}ms {options}...", file=sys.stderr)
+
+                    # The fastest of the repeats is kept, as it is the least disturbed by anything else on the machine
+                    bench = None
+                    achieved = 0
+
+                    for _ in range(args.repeat):
+                        repeat = run_bench(args, tiles, fine_chans, int_time_msec, options)
+
+                        if repeat is None:
+                            bench = None
+                            break
+
+                        repeat_achieved = (int(repeat["bytes_per_integration"]) * int(repeat["integrations"])) / float(repeat["wall_sec"]) / 1.0e6
+
+                        if repeat_achieved > achieved:
+                            bench = repeat
+                            achieved = repeat_achieved
+
+                    if bench is None:
+                        row["result"] = "ERROR"
+                        results.append(row)
+                        continue
+
+                    if int(bench["bytes_per_integration"]) != size:
+                        print(f"bench_sweep: bench_pipeline integrations are {bench['bytes_per_integration']} bytes, expected {size}", file=sys.stderr)
+
+                    headroom = achieved / required
+                    margin_p99 = float(bench["realtime_margin_p99"])
+
+                    row["achieved_mbytes_per_sec"] = round(achieved, 1)
+                    row["headroom"] = round(headroom, 2)
+                    row["io_p99_ms"] = float(bench["io_p99_ms"])
+                    row["realtime_margin_p99"] = margin_p99
+                    row["fits_gbytes_per_sec"] = float(bench["gbytes_per_sec"])
+                    row["result"] = "PASS" if (headroom >= args.min_headroom and margin_p99 >= args.min_headroom) else "FAIL"
+
+                    previous = baseline.get(tuple(str(row[column]) for column in KEY_COLUMNS))
+
+                    if previous and previous.get("achieved_mbytes_per_sec") not in (None, ""):
+                        previous_achieved = float(previous["achieved_mbytes_per_sec"])
+                        change = (achieved - previous_achieved) / previous_achieved * 100.0
+                        row["baseline_achieved_mbytes_per_sec"] = previous_achieved
+                        row["change_percent"] = round(change, 1)
+
+                        if change < -args.tolerance_percent:
+                            row["result"] += " REGRESSION"
+
+                    results.append(row)
+
+    return results
+
+
+def write_results(args, results):
+    output = open(args.output, "w", newline="") if args.output else sys.stdout
+
+    if args.format == "json":
+        json.dump({"columns": COLUMNS, "results": results}, output, indent=2)
+        output.write("\n")
+    else:
+        writer = csv.DictWriter(output, fieldnames=COLUMNS)
+        writer.writeheader()
+        writer.writerows(results)
+
+    if args.output:
+        output.close()
+
+
+def int_list(text):
+    return [int(value) for value in text.split(",")]
+
+
+def options_list(text):
+    options = text.split(",")
+
+    for option in options:
+        for name in option.split("+"):
+            if name not in OPTION_FLAGS:
+                raise argparse.ArgumentTypeError(f"unknown option {name} (must be one of {', '.join(OPTION_FLAGS)})")
+
+    return options
+
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(description="Sweep bench_pipeline over correlator configurations and report whether mwax_db2fits keeps up")
+    parser.add_argument("--dest", required=True, help="scratch directory on the filesystem to test (fits files are deleted after each run)")
+    parser.add_argument("--bench", default=os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "bin", "bench_pipeline"), help="path to bench_pipeline")
+    parser.add_argument("--tiles", type=int_list, default=[128, 256, 512, 1024], help="comma separated tile counts")
+    parser.add_argument("--fine-chan-width-hz", type=int_list, default=[10000, 40000], help=f"comma separated fine channel widths (must divide {BANDWIDTH_HZ})")
+    parser.add_argument("--int-time-msec", type=int_list, default=[200, 500, 1000, 2000, 8000], help=f"comma separated integration times (must divide {SECS_PER_SUBOBS}000)")
+    parser.add_argument("--options", type=options_list, default=["none", "transpose", "chanstats", "rfi"], help=f"comma separated output options, each one of {', '.join(OPTION_FLAGS)} or a combination joined with +")
+    parser.add_argument("--exposure-secs", type=int, default=SECS_PER_SUBOBS, help=f"length of each run (a multiple of {SECS_PER_SUBOBS} seconds)")
+    parser.add_argument("--repeat", type=int, default=3, help="run each configuration this many times and keep the fastest")
+    parser.add_argument("--min-headroom", type=float, default=1.0, help="a configuration passes if the achieved rate, and the p99 of each integration, beat the integration cadence by at least this factor")
+    parser.add_argument("--max-memory-gib", type=float, default=16, help="skip configurations whose integration buffers would need more than this")
+    parser.add_argument("--baseline", help="results (.csv or .json) of a previous sweep, e.g. from another commit, to compare against")
+    parser.add_argument("--tolerance-percent", type=float, default=10, help="flag a REGRESSION if the achieved rate is this much lower than the baseline")
+    parser.add_argument("--format", choices=["csv", "json"], default="csv", help="output format")
+    parser.add_argument("--output", help="file to write the results to (default stdout)")
+    args = parser.parse_args()
+
+    for fine_chan_width_hz in args.fine_chan_width_hz:
+        if BANDWIDTH_HZ % fine_chan_width_hz != 0:
+            parser.error(f"fine channel width {fine_chan_width_hz} Hz does not divide {BANDWIDTH_HZ} Hz")
+
+    for int_time_msec in args.int_time_msec:
+        if (SECS_PER_SUBOBS * 1000) % int_time_msec != 0:
+            parser.error(f"integration time {int_time_msec} ms does not divide {SECS_PER_SUBOBS} seconds")
+
+    results = sweep(args)
+    write_results(args, results)
+
+    sys.exit(1 if any(row["result"] != "PASS" and row["result"] != "SKIPPED" for row in results) else 0)
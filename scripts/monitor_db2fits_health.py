@@ -0,0 +1,358 @@
+#
+# Receives and prints the health packets sent by mwax_db2fits (see "Health Packet format" in README.md)
+#
+import argparse
+import datetime
+import math
+import socket
+import struct
+import sys
+
+# The original packet: version, hostname, times, status, obs/subobs ids and tile weights
+NTILES_MAX = 256
+BASE_FORMAT = f"<iii64sqqdiqq{NTILES_MAX}f{NTILES_MAX}f"
+
+# The extension: ext_version and ext_size, then the fields added in each version
+EXT_HEADER_FORMAT = "<ii"
+EXT_V1_FORMAT = "<iiiiQQ"  # bad data
+EXT_V2_FORMAT = "<dQ" + ("IIII" * 4)  # throughput and latency
+EXT_V3_FORMAT = "<i" + ("Q" * 10) + "ddd"  # ringbuffer occupancy
+EXT_V4_FORMAT = "<i" + ("QQQQQ" * 9)  # perf counters
+EXT_V5_FORMAT = "<" + ("IIII" * 2)  # end to end latency
+EXT_V6_FORMAT = "<Iii"  # sequence and tile weights chunks
+EXT_V7_FORMAT = "<ii"  # bandpass bins and dead tiles
+EXT_V8_FORMAT = "<ddi"  # destination path bandwidth
+DISK_STATE_NAMES = ["unknown", "ok", "overloaded", "shed"]
+EXT_V9_FORMAT = "<QQi"  # destination path free space forecast
+SPACE_STATE_NAMES = ["unknown", "ok", "low", "redirected", "compressed", "refused"]
+
+# The tile weights messages sent after each health packet (ext_version >= 6). The header is followed by the XX weights
+# of chunk_ntiles tiles and then their YY weights, then (version >= 2) their XX and YY auto power and bandpass summaries
+TILE_WEIGHTS_MAGIC = 0x5754584D
+TILE_WEIGHTS_HEADER_FORMAT = "<IHHIHHIII64sqq"
+TILE_WEIGHTS_HEADER_V2_FORMAT = "<I"  # bandpass bins
+TILE_VALUE_NAMES = ["weights_x", "weights_y", "auto_power_x", "auto_power_y"]
+
+LATENCY_NAMES = ["create_fits", "close_fits", "vis_hdu", "weights_hdu"]
+PERF_STAGE_NAMES = [
+    "scan_bad_data",
+    "rfi_flag",
+    "transpose",
+    "vis_hdu",
+    "weights_hdu",
+    "flags_hdu",
+    "chanstats_hdu",
+    "health_weights",
+    "autos",
+]
+
+
+def decode(data):
+    packet = {}
+    offset = 0
+
+    (
+        packet["version_major"],
+        packet["version_minor"],
+        packet["version_build"],
+        hostname,
+        packet["start_time"],
+        packet["health_time"],
+        packet["up_time"],
+        packet["status"],
+        packet["obs_id"],
+        packet["subobs_id"],
+        *weights,
+    ) = struct.unpack_from(BASE_FORMAT, data, offset)
+    offset += struct.calcsize(BASE_FORMAT)
+
+    packet["hostname"] = hostname.split(b"\0", 1)[0].decode()
+    packet["weights_x"] = weights[:NTILES_MAX]
+    packet["weights_y"] = weights[NTILES_MAX:]
+    packet["ext_version"] = 0
+
+    # Older versions of mwax_db2fits do not send an extension
+    if len(data) < offset + struct.calcsize(EXT_HEADER_FORMAT):
+        return packet
+
+    ext_start = offset
+    packet["ext_version"], ext_size = struct.unpack_from(EXT_HEADER_FORMAT, data, offset)
+    offset += struct.calcsize(EXT_HEADER_FORMAT)
+
+    if packet["ext_version"] >= 1:
+        (
+            packet["bad_data_policy"],
+            packet["bad_data_scanned"],
+            packet["bad_data_integrations"],
+            packet["bad_data_dropped"],
+            packet["bad_data_nonfinite"],
+            packet["bad_data_zero_baselines"],
+        ) = struct.unpack_from(EXT_V1_FORMAT, data, offset)
+        offset += struct.calcsize(EXT_V1_FORMAT)
+
+    if packet["ext_version"] >= 2:
+        (packet["bytes_per_sec"], packet["hdus_written"], *latency) = struct.unpack_from(EXT_V2_FORMAT, data, offset)
+        offset += struct.calcsize(EXT_V2_FORMAT)
+
+        packet["latency"] = {}
+        for i, name in enumerate(LATENCY_NAMES):
+            count, p50, p99, max_usec = latency[i * 4 : (i + 1) * 4]
+            packet["latency"][name] = {"count": count, "p50_usec": p50, "p99_usec": p99, "max_usec": max_usec}
+
+    if packet["ext_version"] >= 3:
+        (
+            packet["ringbuffer_nreaders"],
+            packet["header_bufsz"],
+            packet["header_nbufs"],
+            packet["header_full_bufs"],
+            packet["header_clear_bufs"],
+            packet["data_bufsz"],
+            packet["data_nbufs"],
+            packet["data_full_bufs"],
+            packet["data_clear_bufs"],
+            packet["data_bufs_written"],
+            packet["data_bufs_read"],
+            packet["data_write_bufs_per_sec"],
+            packet["data_read_bufs_per_sec"],
+            packet["headroom_sec"],
+        ) = struct.unpack_from(EXT_V3_FORMAT, data, offset)
+        offset += struct.calcsize(EXT_V3_FORMAT)
+
+    if packet["ext_version"] >= 4:
+        (packet["perf_counters_available"], *perf) = struct.unpack_from(EXT_V4_FORMAT, data, offset)
+        offset += struct.calcsize(EXT_V4_FORMAT)
+
+        packet["perf_stages"] = {}
+        for i, name in enumerate(PERF_STAGE_NAMES):
+            samples, cycles, instructions, llc_misses, page_faults = perf[i * 5 : (i + 1) * 5]
+            packet["perf_stages"][name] = {
+                "samples": samples,
+                "cycles": cycles,
+                "instructions": instructions,
+                "llc_misses": llc_misses,
+                "page_faults": page_faults,
+            }
+
+    if packet["ext_version"] >= 5:
+        latency = struct.unpack_from(EXT_V5_FORMAT, data, offset)
+        offset += struct.calcsize(EXT_V5_FORMAT)
+
+        for i, name in enumerate(["data_to_hdu", "data_to_fits"]):
+            count, p50, p99, max_usec = latency[i * 4 : (i + 1) * 4]
+            packet["latency"][name] = {"count": count, "p50_usec": p50, "p99_usec": p99, "max_usec": max_usec}
+
+    if packet["ext_version"] >= 6:
+        (packet["sequence"], packet["ntiles"], packet["tile_weights_chunks"]) = struct.unpack_from(EXT_V6_FORMAT, data, offset)
+        offset += struct.calcsize(EXT_V6_FORMAT)
+
+    if packet["ext_version"] >= 7:
+        (packet["bandpass_bins"], packet["dead_tiles"]) = struct.unpack_from(EXT_V7_FORMAT, data, offset)
+        offset += struct.calcsize(EXT_V7_FORMAT)
+
+    if packet["ext_version"] >= 8:
+        (packet["disk_bytes_per_sec"], packet["required_bytes_per_sec"], packet["disk_state"]) = struct.unpack_from(
+            EXT_V8_FORMAT, data, offset
+        )
+        offset += struct.calcsize(EXT_V8_FORMAT)
+
+    if packet["ext_version"] >= 9:
+        (packet["space_free_bytes"], packet["space_forecast_bytes"], packet["space_state"]) = struct.unpack_from(
+            EXT_V9_FORMAT, data, offset
+        )
+        offset += struct.calcsize(EXT_V9_FORMAT)
+
+    # Anything newer than we know about is skipped using ext_size
+    packet["unknown_ext_bytes"] = (ext_start + ext_size) - offset
+
+    return packet
+
+
+def is_tile_weights(data):
+    return len(data) >= 4 and struct.unpack_from("<I", data)[0] == TILE_WEIGHTS_MAGIC
+
+
+def decode_tile_weights(data):
+    message = {}
+
+    (
+        message["magic"],
+        message["version"],
+        header_size,
+        message["sequence"],
+        message["chunk_index"],
+        message["chunk_count"],
+        message["ntiles"],
+        message["first_tile"],
+        message["chunk_ntiles"],
+        hostname,
+        message["health_time"],
+        message["obs_id"],
+    ) = struct.unpack_from(TILE_WEIGHTS_HEADER_FORMAT, data)
+    message["hostname"] = hostname.split(b"\0", 1)[0].decode()
+    message["bandpass_bins"] = 0
+
+    if message["version"] >= 2:
+        (message["bandpass_bins"],) = struct.unpack_from(
+            TILE_WEIGHTS_HEADER_V2_FORMAT, data, struct.calcsize(TILE_WEIGHTS_HEADER_FORMAT)
+        )
+
+    # header_size lets newer versions add to the header without breaking us
+    n = message["chunk_ntiles"]
+    bins = message["bandpass_bins"]
+    values_per_tile = 4 + (2 * bins) if message["version"] >= 2 else 2
+    values = struct.unpack_from(f"<{values_per_tile * n}f", data, header_size)
+    message["weights_x"] = values[:n]
+    message["weights_y"] = values[n : 2 * n]
+    message["auto_power_x"] = values[2 * n : 3 * n] if message["version"] >= 2 else [math.nan] * n
+    message["auto_power_y"] = values[3 * n : 4 * n] if message["version"] >= 2 else [math.nan] * n
+    message["bandpass"] = [values[4 * n + (i * 2 * bins) : 4 * n + ((i + 1) * 2 * bins)] for i in range(n)]
+
+    return message
+
+
+class TileWeightsAssembler:
+    """Puts the chunks of the tile weights messages back together. Chunks are kept per host until all of a
+    sequence's chunks have arrived, and a sequence is given up on when a newer one starts (UDP may drop chunks)."""
+
+    def __init__(self):
+        self.pending = {}
+
+    def add(self, message):
+        """Returns (hostname, sequence, tiles) once every chunk of a sequence has arrived, otherwise None. tiles has a
+        list of each tile's values: weights_x, weights_y, auto_power_x, auto_power_y and bandpass ([x bins..., y bins...])"""
+        pending = self.pending.get(message["hostname"])
+
+        if pending is None or pending["sequence"] != message["sequence"]:
+            pending = {
+                "sequence": message["sequence"],
+                "chunks": set(),
+                "tiles": {name: [math.nan] * message["ntiles"] for name in TILE_VALUE_NAMES},
+            }
+            pending["tiles"]["bandpass"] = [()] * message["ntiles"]
+            self.pending[message["hostname"]] = pending
+
+        first = message["first_tile"]
+        last = first + message["chunk_ntiles"]
+        for name in TILE_VALUE_NAMES + ["bandpass"]:
+            pending["tiles"][name][first:last] = message[name]
+        pending["chunks"].add(message["chunk_index"])
+
+        if len(pending["chunks"]) < message["chunk_count"]:
+            return None
+
+        del self.pending[message["hostname"]]
+        return (message["hostname"], message["sequence"], pending["tiles"])
+
+
+def format_tile_weights(hostname, sequence, tiles):
+    weights_x = tiles["weights_x"]
+    weights_y = tiles["weights_y"]
+    ntiles = len(weights_x)
+    mean_x = sum(weights_x) / ntiles
+    mean_y = sum(weights_y) / ntiles
+    low = sum(1 for x, y in zip(weights_x, weights_y) if x < 1.0 or y < 1.0)
+    dead = [tile for tile, (x, y) in enumerate(zip(tiles["auto_power_x"], tiles["auto_power_y"])) if x == 0 or y == 0]
+
+    return (
+        f"{datetime.datetime.now().strftime('%Y-%m-%d %H:%M:%S')}: {hostname} sequence={sequence}"
+        f" tile_weights(tiles={ntiles} mean_x={mean_x:.3f} mean_y={mean_y:.3f} tiles_below_1={low})"
+        f" dead_tiles={dead}"
+    )
+
+
+def format_packet(packet):
+    ntiles = sum(1 for w in packet["weights_x"] if not math.isnan(w))
+    line = (
+        f"{datetime.datetime.now().strftime('%Y-%m-%d %H:%M:%S')}: {packet['hostname']}"
+        f" v{packet['version_major']}.{packet['version_minor']}.{packet['version_build']}"
+        f" status={packet['status']} obs_id={packet['obs_id']} subobs_id={packet['subobs_id']} tiles_with_weights={ntiles}"
+    )
+
+    if packet["ext_version"] >= 6:
+        line += f" sequence={packet['sequence']} ntiles={packet['ntiles']} tile_weights_chunks={packet['tile_weights_chunks']}"
+
+    if packet["ext_version"] >= 7:
+        line += f" dead_tiles={packet['dead_tiles']} bandpass_bins={packet['bandpass_bins']}"
+
+    if packet["ext_version"] >= 8 and packet["disk_bytes_per_sec"] > 0:
+        state = packet["disk_state"]
+        line += (
+            f" disk({packet['disk_bytes_per_sec'] / 1e6:.1f}MB/s required={packet['required_bytes_per_sec'] / 1e6:.1f}MB/s"
+            f" state={DISK_STATE_NAMES[state] if 0 <= state < len(DISK_STATE_NAMES) else state})"
+        )
+
+    if packet["ext_version"] >= 9 and packet["space_state"] != 0:
+        state = packet["space_state"]
+        line += (
+            f" space(free={packet['space_free_bytes'] / 1e9:.1f}GB forecast={packet['space_forecast_bytes'] / 1e9:.1f}GB"
+            f" state={SPACE_STATE_NAMES[state] if 0 <= state < len(SPACE_STATE_NAMES) else state})"
+        )
+
+    if packet["ext_version"] >= 1:
+        line += (
+            f" bad_data(scanned={packet['bad_data_scanned']} bad={packet['bad_data_integrations']}"
+            f" dropped={packet['bad_data_dropped']} nonfinite={packet['bad_data_nonfinite']}"
+            f" zero_baselines={packet['bad_data_zero_baselines']})"
+        )
+
+    if packet["ext_version"] >= 2:
+        line += f" {packet['bytes_per_sec'] / 1e6:.1f}MB/s hdus={packet['hdus_written']}"
+
+        for name, latency in packet["latency"].items():
+            if latency["count"] > 0:
+                line += (
+                    f" {name}(n={latency['count']} p50={latency['p50_usec']}us"
+                    f" p99={latency['p99_usec']}us max={latency['max_usec']}us)"
+                )
+
+    if packet["ext_version"] >= 3:
+        line += (
+            f" data_rb(full={packet['data_full_bufs']}/{packet['data_nbufs']} clear={packet['data_clear_bufs']}"
+            f" write/s={packet['data_write_bufs_per_sec']:.2f} read/s={packet['data_read_bufs_per_sec']:.2f}"
+            f" headroom={packet['headroom_sec']:.1f}s)"
+        )
+
+    if packet["ext_version"] >= 4 and packet["perf_counters_available"]:
+        for name, perf in packet["perf_stages"].items():
+            if perf["samples"] > 0:
+                ipc = perf["instructions"] / perf["cycles"] if perf["cycles"] > 0 else 0
+                line += f" {name}(n={perf['samples']} ipc={ipc:.2f} llc_misses={perf['llc_misses']} page_faults={perf['page_faults']})"
+
+    return line
+
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(description="Receive and print mwax_db2fits health packets")
+    parser.add_argument("--ip", required=True, help="health multicast ip (mwax_db2fits --health-ip)")
+    parser.add_argument("--port", required=True, type=int, help="health port (mwax_db2fits --health-port)")
+    parser.add_argument("--interface-ip", default="0.0.0.0", help="ip of the local interface to receive on")
+    args = parser.parse_args()
+
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM, socket.IPPROTO_UDP)
+    sock.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+    sock.bind(("", args.port))
+    sock.setsockopt(
+        socket.IPPROTO_IP,
+        socket.IP_ADD_MEMBERSHIP,
+        socket.inet_aton(args.ip) + socket.inet_aton(args.interface_ip),
+    )
+
+    try:
+        print(f"listening on {args.ip}:{args.port}...")
+        assembler = TileWeightsAssembler()
+
+        while True:
+            data, server = sock.recvfrom(65536)
+
+            if is_tile_weights(data):
+                tile_weights = assembler.add(decode_tile_weights(data))
+
+                if tile_weights is not None:
+                    print(format_tile_weights(*tile_weights))
+            else:
+                print(format_packet(decode(data)))
+
+            sys.stdout.flush()
+    finally:
+        print("closing socket")
+        sock.close()
@@ -8,9 +8,12 @@
 #include <getopt.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include "args.h"
+#include "diskprobe.h"
 #include "global.h"
 #include "multilog.h"
+#include "rfi.h"
 #include "version.h"
 
 /**
@@ -29,8 +32,28 @@ int process_args(int argc, char *argv[], globalArgs_s *globalArgs)
     globalArgs->health_ip = NULL;
     globalArgs->health_port = 0;
     globalArgs->file_size_limit = -1;
+    globalArgs->autos_average = 0;
+    globalArgs->vis_layout = VIS_LAYOUT_BASELINE_MAJOR;
+    globalArgs->rfi_threshold = 0;
+    globalArgs->rfi_threads = RFI_DEFAULT_THREADS;
+    globalArgs->channel_stats = 0;
+    globalArgs->bad_data_policy = BAD_DATA_POLICY_KEEP;
+    globalArgs->trace_dir = NULL;
+    globalArgs->perf_counters = 0;
+    globalArgs->bandpass_bins = 0;
+    globalArgs->input_file = NULL;
+    globalArgs->async_close = 0;
+    globalArgs->hdu_index = 0;
+    globalArgs->cube = 0;
+    globalArgs->journal = 0;
+    globalArgs->join_in_progress = 0;
+    globalArgs->preallocate = 0;
+    globalArgs->disk_probe_mb = 0;
+    globalArgs->overload_policy = OVERLOAD_POLICY_WARN;
+    globalArgs->space_policy = SPACE_POLICY_WARN;
+    globalArgs->alternate_path = NULL;
 
-    static const char *optString = "k:m:d:n:i:p:l:v:?";
+    static const char *optString = "k:m:d:n:i:p:l:a:tr:T:sz:x:Pb:f:AICjJWD:O:S:Y:v:?";
 
     static const struct option longOpts[] =
         {
@@ -40,6 +63,26 @@ int process_args(int argc, char *argv[], globalArgs_s *globalArgs)
             {"health-ip", required_argument, NULL, 'i'},
             {"health-port", required_argument, NULL, 'p'},
             {"file-size-limit", optional_argument, NULL, 'l'},
+            {"autos-average", required_argument, NULL, 'a'},
+            {"transpose", no_argument, NULL, 't'},
+            {"rfi-threshold", required_argument, NULL, 'r'},
+            {"rfi-threads", required_argument, NULL, 'T'},
+            {"channel-stats", no_argument, NULL, 's'},
+            {"bad-data-policy", required_argument, NULL, 'z'},
+            {"trace-dir", required_argument, NULL, 'x'},
+            {"perf-counters", no_argument, NULL, 'P'},
+            {"bandpass-bins", required_argument, NULL, 'b'},
+            {"input-file", required_argument, NULL, 'f'},
+            {"async-close", no_argument, NULL, 'A'},
+            {"hdu-index", no_argument, NULL, 'I'},
+            {"cube", no_argument, NULL, 'C'},
+            {"journal", no_argument, NULL, 'j'},
+            {"join-in-progress", no_argument, NULL, 'J'},
+            {"preallocate", no_argument, NULL, 'W'},
+            {"disk-probe", required_argument, NULL, 'D'},
+            {"overload-policy", required_argument, NULL, 'O'},
+            {"space-policy", required_argument, NULL, 'S'},
+            {"alternate-path", required_argument, NULL, 'Y'},
             {"version", no_argument, NULL, 'v'},
             {"help", no_argument, NULL, '?'},
             {NULL, no_argument, NULL, 0}};
@@ -76,6 +119,137 @@ int process_args(int argc, char *argv[], globalArgs_s *globalArgs)
             globalArgs->file_size_limit = atol(optarg);
             break;
 
+        case 'a':
+            globalArgs->autos_average = atoi(optarg);
+            break;
+
+        case 't':
+            globalArgs->vis_layout = VIS_LAYOUT_FINECHAN_MAJOR;
+            break;
+
+        case 'r':
+            globalArgs->rfi_threshold = atof(optarg);
+            break;
+
+        case 'T':
+            globalArgs->rfi_threads = atoi(optarg);
+            break;
+
+        case 's':
+            globalArgs->channel_stats = 1;
+            break;
+
+        case 'z':
+            if (strcmp(optarg, "keep") == 0)
+            {
+                globalArgs->bad_data_policy = BAD_DATA_POLICY_KEEP;
+            }
+            else if (strcmp(optarg, "zero-weight") == 0)
+            {
+                globalArgs->bad_data_policy = BAD_DATA_POLICY_ZERO_WEIGHT;
+            }
+            else if (strcmp(optarg, "drop") == 0)
+            {
+                globalArgs->bad_data_policy = BAD_DATA_POLICY_DROP;
+            }
+            else
+            {
+                fprintf(stderr, "Error: bad data policy (-z | --bad-data-policy) must be one of keep, zero-weight or drop.\n");
+                print_usage();
+                exit(1);
+            }
+            break;
+
+        case 'x':
+            globalArgs->trace_dir = optarg;
+            break;
+
+        case 'P':
+            globalArgs->perf_counters = 1;
+            break;
+
+        case 'b':
+            globalArgs->bandpass_bins = atoi(optarg);
+            break;
+
+        case 'f':
+            globalArgs->input_file = optarg;
+            break;
+
+        case 'A':
+            globalArgs->async_close = 1;
+            break;
+
+        case 'I':
+            globalArgs->hdu_index = 1;
+            break;
+
+        case 'C':
+            globalArgs->cube = 1;
+            break;
+
+        case 'j':
+            globalArgs->journal = 1;
+            break;
+
+        case 'J':
+            globalArgs->join_in_progress = 1;
+            break;
+
+        case 'W':
+            globalArgs->preallocate = 1;
+            break;
+
+        case 'D':
+            globalArgs->disk_probe_mb = atoi(optarg);
+            break;
+
+        case 'O':
+            if (strcmp(optarg, "warn") == 0)
+            {
+                globalArgs->overload_policy = OVERLOAD_POLICY_WARN;
+            }
+            else if (strcmp(optarg, "shed") == 0)
+            {
+                globalArgs->overload_policy = OVERLOAD_POLICY_SHED;
+            }
+            else
+            {
+                fprintf(stderr, "Error: overload policy (-O | --overload-policy) must be one of warn or shed.\n");
+                print_usage();
+                exit(1);
+            }
+            break;
+
+        case 'S':
+            if (strcmp(optarg, "warn") == 0)
+            {
+                globalArgs->space_policy = SPACE_POLICY_WARN;
+            }
+            else if (strcmp(optarg, "redirect") == 0)
+            {
+                globalArgs->space_policy = SPACE_POLICY_REDIRECT;
+            }
+            else if (strcmp(optarg, "compress") == 0)
+            {
+                globalArgs->space_policy = SPACE_POLICY_COMPRESS;
+            }
+            else if (strcmp(optarg, "refuse") == 0)
+            {
+                globalArgs->space_policy = SPACE_POLICY_REFUSE;
+            }
+            else
+            {
+                fprintf(stderr, "Error: space policy (-S | --space-policy) must be one of warn, redirect, compress or refuse.\n");
+                print_usage();
+                exit(1);
+            }
+            break;
+
+        case 'Y':
+            globalArgs->alternate_path = optarg;
+            break;
+
         case 'v':
             print_version();
             return EXIT_FAILURE;
@@ -93,9 +267,9 @@ int process_args(int argc, char *argv[], globalArgs_s *globalArgs)
     }
 
     // Check that mandatory parameters are passed
-    if (!globalArgs->input_db_key)
+    if (!globalArgs->input_db_key && globalArgs->input_file == NULL)
     {
-        fprintf(stderr, "Error: input shared memory key (-k | --key) is mandatory.\n");
+        fprintf(stderr, "Error: input shared memory key (-k | --key) is mandatory (unless an input file (-f | --input-file) is given).\n");
         print_usage();
         exit(1);
     }
@@ -138,6 +312,65 @@ int process_args(int argc, char *argv[], globalArgs_s *globalArgs)
         globalArgs->file_size_limit = LONG_MAX;
     }
 
+    if (globalArgs->autos_average < 0)
+    {
+        fprintf(stderr, "Error: autos average (-a | --autos-average) must be 0 (disabled) or greater.\n");
+        print_usage();
+        exit(1);
+    }
+
+    if (globalArgs->rfi_threshold < 0)
+    {
+        fprintf(stderr, "Error: RFI threshold (-r | --rfi-threshold) must be 0 (disabled) or greater.\n");
+        print_usage();
+        exit(1);
+    }
+
+    if (globalArgs->rfi_threads < 1)
+    {
+        fprintf(stderr, "Error: RFI threads (-T | --rfi-threads) must be 1 or greater.\n");
+        print_usage();
+        exit(1);
+    }
+
+    if (globalArgs->bandpass_bins < 0 || globalArgs->bandpass_bins > BANDPASS_BINS_MAX)
+    {
+        fprintf(stderr, "Error: bandpass bins (-b | --bandpass-bins) must be 0 (disabled) to %d.\n", BANDPASS_BINS_MAX);
+        print_usage();
+        exit(1);
+    }
+
+    if (globalArgs->disk_probe_mb < 0)
+    {
+        fprintf(stderr, "Error: disk probe (-D | --disk-probe) must be 0 (disabled) or greater.\n");
+        print_usage();
+        exit(1);
+    }
+
+    if (globalArgs->space_policy == SPACE_POLICY_REDIRECT && globalArgs->alternate_path == NULL)
+    {
+        fprintf(stderr, "Error: space policy redirect (-S | --space-policy) needs an alternate path (-Y | --alternate-path).\n");
+        print_usage();
+        exit(1);
+    }
+
+    // Compressed HDUs are tables of compressed tiles, so the cube can't be written a plane at a time and the .idx
+    // offsets would not point at the raw pixels
+    if (globalArgs->space_policy == SPACE_POLICY_COMPRESS && (globalArgs->cube || globalArgs->hdu_index))
+    {
+        fprintf(stderr, "Error: space policy compress (-S | --space-policy) can not be used with cube output (-C | --cube) or the HDU index (-I | --hdu-index).\n");
+        print_usage();
+        exit(1);
+    }
+
+    // Flags and channel statistics are written as HDUs after each integration, which would split the cube
+    if (globalArgs->cube && (globalArgs->rfi_threshold > 0 || globalArgs->channel_stats))
+    {
+        fprintf(stderr, "Error: cube output (-C | --cube) can not be used with RFI flagging (-r | --rfi-threshold) or channel statistics (-s | --channel-stats).\n");
+        print_usage();
+        exit(1);
+    }
+
     return EXIT_SUCCESS;
 }
 
@@ -159,6 +392,26 @@ void print_usage()
     printf("  -i --health-ip=IP                 Health UDP Multicast destination ip address\n");
     printf("  -p --health-port=PORT             Health UDP Multicast destination port\n");
     printf("  -l --file-size-limit=BYTES        FITS file size limit before splitting into a new file. Default=%ld bytes. 0=no splitting\n", DEFAULT_FILE_SIZE_LIMIT);
+    printf("  -a --autos-average=N              Write autocorrelations to a sidecar _autos.fits file, averaging N integrations per HDU. Default=0 (disabled)\n");
+    printf("  -t --transpose                    Write visibilities frequency-major: [finechan][baseline][pol][r,i]. Default is [baseline][finechan][pol][r,i]\n");
+    printf("  -r --rfi-threshold=SIGMA          Flag fine channels more than SIGMA from the median and write a flags HDU after each weights HDU. Default=0 (disabled)\n");
+    printf("  -T --rfi-threads=N                Number of threads to use for RFI flagging. Default=%d\n", RFI_DEFAULT_THREADS);
+    printf("  -s --channel-stats                Write a table HDU of per fine channel/pol mean, rms, max power and NaN count after each integration\n");
+    printf("  -z --bad-data-policy=POLICY       What to do with integrations containing NaN/Inf values or zero-power baselines: keep, zero-weight (the bad baselines) or drop. Default=keep\n");
+    printf("  -x --trace-dir=PATH               Record a timeline of each integration and write it as Chrome trace JSON to PATH at the end of each observation and on SIGUSR1. Default is disabled\n");
+    printf("  -P --perf-counters                Read CPU cycles, instructions, LLC misses and page faults around each stage of processing. Logged per observation and sent in the health packets\n");
+    printf("  -b --bandpass-bins=K              Send a bandpass summary of K bins (each the mean auto power of a range of fine channels) for each tile in the health tile weights messages. Default=0 (disabled). Max=%d\n", BANDPASS_BINS_MAX);
+    printf("  -f --input-file=PATH              Replay a .dada file (header followed by data), or every .dada/.dat file in directory PATH in name order, instead of reading the ringbuffer. Exits when done\n");
+    printf("  -A --async-close                  Close and rename fits files on a separate thread, so the next observation can start straight away (needs a reentrant cfitsio)\n");
+    printf("  -I --hdu-index                    Write a .idx sidecar file of the byte offsets of each integration's visibility and weights HDUs with each fits file\n");
+    printf("  -C --cube                         Write one visibility cube and one weights cube HDU per sub-observation ([time][baseline][finechan][pol][r,i]), rather than 2 HDUs per integration\n");
+    printf("  -j --journal                      Journal each integration as it is completed, and at startup recover (truncate to the last complete integration and rename) any fits files a previous run did not finish\n");
+    printf("  -J --join-in-progress             Join an observation which is already in progress (e.g. after a restart), carrying on from its current marker, rather than skipping it\n");
+    printf("  -W --preallocate                  Reserve the disk space each fits file is expected to need (the rest of the observation, up to the file size limit) when it is created\n");
+    printf("  -D --disk-probe=MB                Measure the write bandwidth of the destination path by writing MB megabytes at startup (and every %d seconds between observations), and check each observation can be written at the rate it arrives. Default=0 (disabled)\n", DISKPROBE_REFRESH_SECONDS);
+    printf("  -O --overload-policy=POLICY       What to do with an observation which needs more than the measured bandwidth (-D): warn (log and send it in the health packets), or shed (also turn off its flags, channel statistics and autos outputs). Default=warn\n");
+    printf("  -S --space-policy=POLICY          What to do with an observation which won't fit in the free space of the destination path: warn, redirect (to -Y), compress (its HDUs, lossless) or refuse (don't write it). Default=warn\n");
+    printf("  -Y --alternate-path=PATH          Where space policy redirect writes observations which won't fit on the destination path\n");
     printf("  -v --version                      Display version number\n");
     printf("  -? --help                         This help text\n");
 }
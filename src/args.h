@@ -18,6 +18,26 @@ typedef struct
     char *health_ip;
     int health_port;
     long file_size_limit;
+    int autos_average;
+    int vis_layout;
+    float rfi_threshold;
+    int rfi_threads;
+    int channel_stats;
+    int bad_data_policy;
+    char *trace_dir;
+    int perf_counters;
+    int bandpass_bins;
+    char *input_file;
+    int async_close;
+    int hdu_index;
+    int cube;
+    int journal;
+    int join_in_progress;
+    int preallocate;
+    int disk_probe_mb;
+    int overload_policy;
+    int space_policy;
+    char *alternate_path;
 } globalArgs_s;
 
 void print_usage();
@@ -0,0 +1,239 @@
+/**
+ * @file autos.c
+ * @author Greg Sleap
+ * @date 18 Oct 2026
+ * @brief This is the code that extracts autocorrelations into a quick-look sidecar fits file
+ *
+ * Operators want per tile bandpasses without opening the (large) visibility files, so while
+ * we have each integration in hand we pull out the ntiles autocorrelations, average them over
+ * autos_average integrations and write them into a small fits file next to the visibilities.
+ */
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "autos.h"
+#include "fitswriter.h"
+#include "global.h"
+#include "multilog.h"
+#include "utils.h"
+
+/**
+ *
+ *  @brief Writes the accumulated autocorrelations (averaged) into a new HDU of the autos fits file and resets the accumulator.
+ *  @param[in] client A pointer to the dada_client_t object.
+ *  @returns EXIT_SUCCESS on success, or -1 if there was an error.
+ */
+static int autos_write_hdu(dada_client_t *client)
+{
+  dada_db_s *ctx = (dada_db_s *)client->context;
+  multilog_t *log = (multilog_t *)ctx->log;
+
+  uint64_t nvalues = ctx->autos_buffer_bytes / sizeof(float);
+  float scale = 1.0f / (float)ctx->autos_counter;
+
+  for (uint64_t v = 0; v < nvalues; v++)
+  {
+    ctx->autos_buffer[v] *= scale;
+  }
+
+  if (create_fits_autos_imghdu(client, ctx->autos_fits_ptr, ctx->autos_unix_time, ctx->autos_unix_time_msec, ctx->autos_marker, ctx->autos_counter,
+                               ctx->ninputs / 2, ctx->nfine_chan, ctx->npol, ctx->autos_buffer, ctx->autos_buffer_bytes))
+  {
+    multilog(log, LOG_ERR, "autos_write_hdu(): Error writing into new autos image HDU.\n");
+    return -1;
+  }
+
+  ctx->autos_counter = 0;
+
+  return EXIT_SUCCESS;
+}
+
+/**
+ *
+ *  @brief Sets up the autos accumulator for a new observation. Call after the header has been read and validated.
+ *  @param[in] client A pointer to the dada_client_t object.
+ *  @returns EXIT_SUCCESS on success, or -1 if there was an error.
+ */
+int autos_init_observation(dada_client_t *client)
+{
+  assert(client != 0);
+  dada_db_s *ctx = (dada_db_s *)client->context;
+  multilog_t *log = (multilog_t *)ctx->log;
+
+  ctx->autos_counter = 0;
+
+  if (ctx->autos_average <= 0)
+  {
+    return EXIT_SUCCESS;
+  }
+
+  // One auto per tile, each the same size as a baseline in the visibilities
+  ctx->autos_buffer_bytes = (ctx->expected_transfer_size_of_integration / ctx->nbaselines) * (ctx->ninputs / 2);
+
+  // Only grow the buffer- it is reused for the life of the process
+  if (ctx->autos_buffer_bytes > ctx->autos_buffer_capacity)
+  {
+    float *new_buffer = realloc(ctx->autos_buffer, ctx->autos_buffer_bytes);
+
+    if (new_buffer == NULL)
+    {
+      multilog(log, LOG_ERR, "autos_init_observation(): Error allocating %lu bytes for the autos buffer.\n", ctx->autos_buffer_bytes);
+      return -1;
+    }
+
+    ctx->autos_buffer = new_buffer;
+    ctx->autos_buffer_capacity = ctx->autos_buffer_bytes;
+  }
+
+  return EXIT_SUCCESS;
+}
+
+/**
+ *
+ *  @brief Creates a new autos sidecar fits file to go with the visibility fits file which has just been created.
+ *         The filename is the visibility filename with "_autos" before the extension.
+ *  @param[in] client A pointer to the dada_client_t object.
+ *  @returns EXIT_SUCCESS on success, or -1 if there was an error.
+ */
+int autos_open_fits(dada_client_t *client)
+{
+  assert(client != 0);
+  dada_db_s *ctx = (dada_db_s *)client->context;
+  multilog_t *log = (multilog_t *)ctx->log;
+
+  if (ctx->autos_average <= 0)
+  {
+    return EXIT_SUCCESS;
+  }
+
+  /* Make a new filename- oooooooooo_YYYYMMDDhhmmss_chCCC_FFF_autos.fits */
+  int base_len = strlen(ctx->fits_filename) - strlen(".fits");
+  snprintf(ctx->autos_fits_filename, FITS_FILENAME_LEN, "%.*s_autos.fits", base_len, ctx->fits_filename);
+  snprintf(ctx->temp_autos_fits_filename, TEMP_FITS_FILENAME_LEN, "%s.tmp", ctx->autos_fits_filename);
+
+  // Any partial average belongs to the previous file
+  ctx->autos_counter = 0;
+
+  if (create_autos_fits(client, &ctx->autos_fits_ptr, ctx->temp_autos_fits_filename))
+  {
+    multilog(log, LOG_ERR, "autos_open_fits(): Error creating new autos fits file.\n");
+    return -1;
+  }
+
+  return EXIT_SUCCESS;
+}
+
+/**
+ *
+ *  @brief Adds the autocorrelations from one integration to the running average, writing an autos HDU once
+ *         autos_average integrations have been accumulated.
+ *  @param[in] client A pointer to the dada_client_t object.
+ *  @param[in] buffer The visibilities for this integration: [baseline][finechan][pol][r,i].
+ *  @returns EXIT_SUCCESS on success, or -1 if there was an error.
+ */
+int autos_accumulate(dada_client_t *client, float *buffer)
+{
+  assert(client != 0);
+  dada_db_s *ctx = (dada_db_s *)client->context;
+
+  if (ctx->autos_average <= 0 || ctx->autos_fits_ptr == NULL)
+  {
+    return EXIT_SUCCESS;
+  }
+
+  int ntiles = ctx->ninputs / 2;
+  uint64_t values_per_baseline = ctx->expected_transfer_size_of_integration / ctx->nbaselines / sizeof(float);
+
+  if (ctx->autos_counter == 0)
+  {
+    // First integration of this average- remember when it was and just copy the autos in
+    ctx->autos_unix_time = ctx->unix_time;
+    ctx->autos_unix_time_msec = ctx->unix_time_msec;
+    ctx->autos_marker = ctx->obs_marker_number;
+
+    for (int tile = 0; tile < ntiles; tile++)
+    {
+      memcpy(ctx->autos_buffer + (tile * values_per_baseline),
+             buffer + (get_auto_baseline_index(tile) * values_per_baseline),
+             values_per_baseline * sizeof(float));
+    }
+  }
+  else
+  {
+    for (int tile = 0; tile < ntiles; tile++)
+    {
+      float *dest = ctx->autos_buffer + (tile * values_per_baseline);
+      const float *src = buffer + (get_auto_baseline_index(tile) * values_per_baseline);
+
+      for (uint64_t v = 0; v < values_per_baseline; v++)
+      {
+        dest[v] += src[v];
+      }
+    }
+  }
+
+  ctx->autos_counter++;
+
+  if (ctx->autos_counter == ctx->autos_average)
+  {
+    return autos_write_hdu(client);
+  }
+
+  return EXIT_SUCCESS;
+}
+
+/**
+ *
+ *  @brief Closes the autos fits file (if open). If the file is good, any partial average is written first so
+ *         the sidecar covers the same integrations as the visibility file.
+ *  @param[in] client A pointer to the dada_client_t object.
+ *  @param[in] fits_is_good 0 == delete the file, 1 == close and rename it (same as close_fits()).
+ *  @returns EXIT_SUCCESS on success, or -1 if there was an error.
+ */
+int autos_close_fits(dada_client_t *client, int fits_is_good)
+{
+  assert(client != 0);
+  dada_db_s *ctx = (dada_db_s *)client->context;
+  multilog_t *log = (multilog_t *)ctx->log;
+
+  if (ctx->autos_fits_ptr == NULL)
+  {
+    return EXIT_SUCCESS;
+  }
+
+  if (fits_is_good == 1 && ctx->autos_counter > 0)
+  {
+    if (autos_write_hdu(client) != EXIT_SUCCESS)
+    {
+      return -1;
+    }
+  }
+
+  ctx->autos_counter = 0;
+
+  if (close_autos_fits(client, &ctx->autos_fits_ptr, fits_is_good))
+  {
+    multilog(log, LOG_ERR, "autos_close_fits(): Error closing autos fits file.\n");
+    return -1;
+  }
+
+  return EXIT_SUCCESS;
+}
+
+/**
+ *
+ *  @brief Frees the memory used by the autos accumulator.
+ *  @param[in] client A pointer to the dada_client_t object.
+ */
+void autos_destroy(dada_client_t *client)
+{
+  assert(client != 0);
+  dada_db_s *ctx = (dada_db_s *)client->context;
+
+  free(ctx->autos_buffer);
+  ctx->autos_buffer = NULL;
+  ctx->autos_buffer_bytes = 0;
+  ctx->autos_buffer_capacity = 0;
+}
\ No newline at end of file
@@ -0,0 +1,16 @@
+/**
+ * @file autos.h
+ * @author Greg Sleap
+ * @date 18 Oct 2026
+ * @brief This is the header for the code that extracts autocorrelations into a quick-look sidecar fits file
+ *
+ */
+#pragma once
+
+#include "dada_client.h"
+
+int autos_init_observation(dada_client_t *client);
+int autos_open_fits(dada_client_t *client);
+int autos_accumulate(dada_client_t *client, float *buffer);
+int autos_close_fits(dada_client_t *client, int fits_is_good);
+void autos_destroy(dada_client_t *client);
\ No newline at end of file
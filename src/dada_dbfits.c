@@ -7,20 +7,155 @@
  */
 #include <stdio.h>
 #include <errno.h>
+#include <limits.h>
+#include <stddef.h>
+#include <time.h>
+#include <unistd.h>
 #include "dada_dbfits.h"
 #include "../mwax_common/mwax_global_defs.h" // From mwax-common
+#include "autos.h"
+#include "dada_header.h"
+#include "diskprobe.h"
+#include "freespace.h"
 #include "global.h"
+#include "hdu_index.h"
 #include "health.h"
+#include "journal.h"
+#include "metrics.h"
+#include "probes.h"
+#include "rfi.h"
+#include "stats.h"
+#include "trace.h"
+#include "transpose.h"
 #include "utils.h"
+#include "warmup.h"
+
+#define HEADER_ANY_VALUE LONG_MIN, LONG_MAX
+
+// The keywords read_dada_header() reads into dada_db_s (dada_dbfits_open() reads MODE, OBS_ID and SUBOBS_ID first),
+// and the range of values validate_header() accepts for each. Checks involving more than one keyword are in
+// validate_header() itself.
+static const dada_header_field_s dada_db_header_schema[] = {
+    {HEADER_POPULATED, DADA_HEADER_INT, offsetof(dada_db_s, populated), 0, 1, HEADER_ANY_VALUE},
+    {HEADER_UTC_START, DADA_HEADER_STRING, offsetof(dada_db_s, utc_start), UTC_START_LEN, 1, HEADER_ANY_VALUE},
+    {HEADER_OBS_OFFSET, DADA_HEADER_INT, offsetof(dada_db_s, obs_offset), 0, 1, HEADER_ANY_VALUE},
+    {HEADER_NBIT, DADA_HEADER_INT, offsetof(dada_db_s, nbit), 0, 1, 8, INT_MAX},
+    {HEADER_NPOL, DADA_HEADER_INT, offsetof(dada_db_s, npol), 0, 1, 1, INT_MAX},
+    {HEADER_NINPUTS, DADA_HEADER_INT, offsetof(dada_db_s, ninputs), 0, 1, 1, INT_MAX},
+    {HEADER_INT_TIME_MSEC, DADA_HEADER_INT, offsetof(dada_db_s, int_time_msec), 0, 1, INT_TIME_MSEC_MIN, INT_MAX},
+    {HEADER_TRANSFER_SIZE, DADA_HEADER_UINT64, offsetof(dada_db_s, transfer_size), 0, 1, 1, LONG_MAX},
+    {HEADER_PROJ_ID, DADA_HEADER_STRING, offsetof(dada_db_s, proj_id), PROJ_ID_LEN, 1, HEADER_ANY_VALUE},
+    {HEADER_EXPOSURE_SECS, DADA_HEADER_INT, offsetof(dada_db_s, exposure_sec), 0, 1, HEADER_ANY_VALUE},
+    {HEADER_COARSE_CHANNEL, DADA_HEADER_INT, offsetof(dada_db_s, coarse_channel), 0, 1, 0, COARSE_CHANNEL_MAX},
+    {HEADER_CORR_COARSE_CHANNEL, DADA_HEADER_INT, offsetof(dada_db_s, corr_coarse_channel), 0, 1, 1, INT_MAX},
+    {HEADER_SECS_PER_SUBOBS, DADA_HEADER_INT, offsetof(dada_db_s, secs_per_subobs), 0, 1, 1, INT_MAX},
+    {HEADER_UNIXTIME, DADA_HEADER_LONG, offsetof(dada_db_s, unix_time), 0, 1, HEADER_ANY_VALUE},
+    {HEADER_UNIXTIME_MSEC, DADA_HEADER_INT, offsetof(dada_db_s, unix_time_msec), 0, 1, 0, 999},
+    {HEADER_FINE_CHAN_WIDTH_HZ, DADA_HEADER_INT, offsetof(dada_db_s, fine_chan_width_hz), 0, 1, 1, INT_MAX},
+    {HEADER_NFINE_CHAN, DADA_HEADER_INT, offsetof(dada_db_s, nfine_chan), 0, 1, 1, INT_MAX},
+    {HEADER_BANDWIDTH_HZ, DADA_HEADER_INT, offsetof(dada_db_s, bandwidth_hz), 0, 1, 1, INT_MAX},
+    {HEADER_FSCRUNCH_FACTOR, DADA_HEADER_INT, offsetof(dada_db_s, fscrunch_factor), 0, 1, 1, INT_MAX},
+    {HEADER_MC_IP, DADA_HEADER_STRING, offsetof(dada_db_s, multicast_ip), IP_AS_STRING_LEN, 1, HEADER_ANY_VALUE},
+    {HEADER_MC_PORT, DADA_HEADER_INT, offsetof(dada_db_s, multicast_port), 0, 1, HEADER_ANY_VALUE},
+    // for now if we don't get version info from other mwax components it is just a warning
+    {HEADER_MWAX_U2S_VERSION, DADA_HEADER_STRING, offsetof(dada_db_s, mwax_u2s_version), MWAX_VERSION_STRING_LEN, 0, HEADER_ANY_VALUE},
+    {HEADER_MWAX_DB2CORRELATE2DB_VERSION, DADA_HEADER_STRING, offsetof(dada_db_s, mwax_db2correlate2db_version), MWAX_VERSION_STRING_LEN, 0, HEADER_ANY_VALUE},
+};
+
+#define DADA_DB_HEADER_SCHEMA_FIELDS (int)(sizeof(dada_db_header_schema) / sizeof(dada_db_header_schema[0]))
 
 /**
  *
- *  @brief This is called at the begininning of each new 8 second sub-observation.
- *         We need check if we are in a new fits file or continuing the existing one.
+ *  @brief Records the end to end latency from the UNIX time of each integration in the fits file which has just been
+ *         closed to now (if it was renamed to .fits), then forgets them ready for the next file. With --async-close
+ *         the file has only been queued, and the finaliser records these once it has renamed it.
+ *  @param[in] ctx The dada_db_s context.
+ *  @param[in] fits_is_good 1 if the file was renamed, 0 if it was deleted.
+ */
+static void record_fits_renamed(dada_db_s *ctx, int fits_is_good)
+{
+  if (fits_is_good == 1 && !ctx->async_close)
+  {
+    uint64_t now_usec = metrics_unix_time_usec();
+
+    for (uint64_t i = 0; i < ctx->file_integration_count; i++)
+    {
+      uint64_t integration_usec = ctx->file_integration_usec[i];
+      metrics_record_latency_usec(METRICS_LATENCY_DATA_TO_FITS, (now_usec > integration_usec ? now_usec - integration_usec : 0));
+    }
+  }
+
+  ctx->file_integration_count = 0;
+}
+
+/**
+ *
+ *  @brief Records the latency of closing the fits file (unless it was queued for the finaliser, which records the
+ *         real close time itself) and the end to end latencies of its integrations. See record_fits_renamed().
+ *  @param[in] ctx The dada_db_s context.
+ *  @param[in] fits_is_good 1 if the file was renamed, 0 if it was deleted.
+ *  @param[in] close_start_ns When the close started (from metrics_now_ns()).
+ */
+static void record_fits_closed(dada_db_s *ctx, int fits_is_good, uint64_t close_start_ns)
+{
+  if (!ctx->async_close)
+  {
+    metrics_record_latency(METRICS_LATENCY_CLOSE_FITS, close_start_ns);
+  }
+
+  record_fits_renamed(ctx, fits_is_good);
+}
+
+/**
+ *
+ *  @brief Whether the HDU offsets of each integration are needed, for the .idx sidecar or the journal.
+ *  @param[in] ctx The dada_db_s context.
+ *  @returns 1 if they are needed, otherwise 0.
+ */
+static int hdu_offsets_needed(const dada_db_s *ctx)
+{
+  return (ctx->hdu_index_enabled || ctx->journal_enabled);
+}
+
+/**
+ *
+ *  @brief Works out the names of the next fits file of the observation (and its .tmp), in the destination (or
+ *         alternate) path. When joining an in progress observation, the file number is moved past any files a previous
+ *         run already wrote for it.
+ *  @param[in] ctx The dada_db_s context.
+ */
+static void make_fits_filename(dada_db_s *ctx)
+{
+  /* Work out the name of the file using the UTC START          */
+  /* Convert the UTC_START from the header format: YYYY-MM-DD-hh:mm:ss into YYYYMMDDhhmmss  */
+  int year, month, day, hour, minute, second;
+  sscanf(ctx->utc_start, "%d-%d-%d-%d:%d:%d", &year, &month, &day, &hour, &minute, &second);
+
+  // Observations which won't fit on the destination path may be redirected (see freespace.h)
+  const char *dir = (ctx->space_state == FREESPACE_STATE_REDIRECTED ? ctx->alternate_destination_dir : ctx->destination_dir);
+
+  for (;;)
+  {
+    /* Make a new filename- oooooooooo_YYYYMMDDhhmmss_chCCC_FFF.fits */
+    snprintf(ctx->fits_filename, FITS_FILENAME_LEN, "%s/%ld_%04d%02d%02d%02d%02d%02d_ch%03d_%03d.fits", dir, ctx->obs_id, year, month, day, hour, minute, second, ctx->coarse_channel, ctx->fits_file_number);
+    snprintf(ctx->temp_fits_filename, TEMP_FITS_FILENAME_LEN, "%s.tmp", ctx->fits_filename);
+
+    if (!ctx->join_in_progress || (access(ctx->fits_filename, F_OK) != 0 && access(ctx->temp_fits_filename, F_OK) != 0))
+    {
+      return;
+    }
+
+    ctx->fits_file_number++;
+  }
+}
+
+/**
+ *
+ *  @brief Checks the new sub-observation's header, and closes / creates fits files as needed. See dada_dbfits_open().
  *  @param[in] client A pointer to the dada_client_t object.
  *  @returns EXIT_SUCCESS on success, or -1 if there was an error.
  */
-int dada_dbfits_open(dada_client_t *client)
+static int open_sub_observation(dada_client_t *client)
 {
   assert(client != 0);
   dada_db_s *ctx = (dada_db_s *)client->context;
@@ -36,11 +171,18 @@ int dada_dbfits_open(dada_client_t *client)
   // we do not want to explicitly transfer the DADA header
   client->header_transfer = 0;
 
+  // Split the header into keywords once, rather than searching all of it for each one
+  if (dada_header_parse(&ctx->parsed_header, client->header, client->header_size, log) != EXIT_SUCCESS)
+  {
+    multilog(log, LOG_ERR, "dada_dbfits_open(): Error parsing header.\n");
+    return -1;
+  }
+
   // Read the command first
   strncpy(ctx->mode, "", MWAX_MODE_LEN);
-  if (ascii_header_get(client->header, HEADER_MODE, "%s", &ctx->mode) == -1)
+  if (dada_header_get_string(&ctx->parsed_header, HEADER_MODE, ctx->mode, MWAX_MODE_LEN) != DADA_HEADER_OK)
   {
-    multilog(log, LOG_ERR, "dada_dbfits_open(): %s not found in header.\n", HEADER_MODE);
+    multilog(log, LOG_ERR, "dada_dbfits_open(): %s not found in header (or is too long).\n", HEADER_MODE);
     return -1;
   }
 
@@ -84,16 +226,16 @@ int dada_dbfits_open(dada_client_t *client)
 
   // get the obs_id of this subobservation
   long this_obs_id = 0;
-  if (ascii_header_get(client->header, HEADER_OBS_ID, "%lu", &this_obs_id) == -1)
+  if (dada_header_get_long(&ctx->parsed_header, HEADER_OBS_ID, &this_obs_id) != DADA_HEADER_OK)
   {
-    multilog(log, LOG_ERR, "dada_dbfits_open(): %s not found in header.\n", HEADER_OBS_ID);
+    multilog(log, LOG_ERR, "dada_dbfits_open(): %s not found in header (or is not a number).\n", HEADER_OBS_ID);
     return -1;
   }
 
   long this_subobs_id = 0;
-  if (ascii_header_get(client->header, HEADER_SUBOBS_ID, "%lu", &this_subobs_id) == -1)
+  if (dada_header_get_long(&ctx->parsed_header, HEADER_SUBOBS_ID, &this_subobs_id) != DADA_HEADER_OK)
   {
-    multilog(log, LOG_ERR, "dada_dbfits_open(): %s not found in header.\n", HEADER_SUBOBS_ID);
+    multilog(log, LOG_ERR, "dada_dbfits_open(): %s not found in header (or is not a number).\n", HEADER_SUBOBS_ID);
     return -1;
   }
 
@@ -106,8 +248,17 @@ int dada_dbfits_open(dada_client_t *client)
 
   int is_new_obs_id = 0;
 
+  // Check the next sub-observation of the current observation will fit, before cfitsio finds out it doesn't
+  int space_action = FREESPACE_CONTINUE;
+
+  if (ctx->obs_id == this_obs_id && ctx->fits_ptr != NULL)
+  {
+    space_action = freespace_check_subobs(client);
+    health_manager_set_space_info(ctx->space_free_bytes, ctx->space_forecast_bytes, ctx->space_state);
+  }
+
   // Check this obs_id against our 'in progress' obsid
-  if (ctx->obs_id != this_obs_id || ctx->fits_file_size >= ctx->fits_file_size_limit)
+  if (ctx->obs_id != this_obs_id || ctx->fits_file_size >= ctx->fits_file_size_limit || space_action != FREESPACE_CONTINUE)
   {
     // We need a new fits file, since the obs_id is different or the file size limit was reached
     if (ctx->obs_id != this_obs_id)
@@ -124,7 +275,7 @@ int dada_dbfits_open(dada_client_t *client)
         multilog(log, LOG_INFO, "dada_dbfits_open(): New %s detected. Starting %lu...\n", HEADER_OBS_ID, this_obs_id);
       }
     }
-    else
+    else if (space_action == FREESPACE_CONTINUE)
     {
       multilog(log, LOG_INFO, "dada_dbfits_open(): Current file size (%lu bytes) exceeds max size (%lu bytes) of a fits file. Closing %s, Starting new file...\n", ctx->fits_file_size, ctx->fits_file_size_limit, ctx->temp_fits_filename);
     }
@@ -133,6 +284,8 @@ int dada_dbfits_open(dada_client_t *client)
     if (ctx->fits_ptr != NULL)
     {
       int good_fits = 1;
+      uint64_t close_start_ns = metrics_now_ns();
+      TRACE_BEGIN("close_fits");
 
       if (close_fits(client, &ctx->fits_ptr, good_fits))
       {
@@ -140,10 +293,28 @@ int dada_dbfits_open(dada_client_t *client)
         return -1;
       }
 
+      TRACE_END("close_fits");
+      record_fits_closed(ctx, good_fits, close_start_ns);
+
+      if (autos_close_fits(client, good_fits))
+      {
+        multilog(log, LOG_ERR, "dada_dbfits_open(): Error closing autos fits file.\n");
+        return -1;
+      }
+
       // Reset current file size
       ctx->fits_file_size = 0;
     }
 
+    if (space_action == FREESPACE_STOP)
+    {
+      // Set obs and subobs to 0 so the io and close methods know we have nothing to do but skip this obs until we get a fresh new one
+      ctx->obs_id = 0;
+      ctx->subobs_id = 0;
+
+      return EXIT_SUCCESS;
+    }
+
     // Check- has the obs id changed?
     if (is_new_obs_id == 1)
     {
@@ -155,7 +326,7 @@ int dada_dbfits_open(dada_client_t *client)
     }
     else
     {
-      // Do this only if we exceeded the size of a fits file and need a new file
+      // Do this only if we exceeded the size of a fits file (or were redirected / compressed) and need a new file
       ctx->fits_file_number++;
     }
 
@@ -163,21 +334,46 @@ int dada_dbfits_open(dada_client_t *client)
     if (ctx->obs_id != 0)
     {
       /* Create fits file for output                                */
-      /* Work out the name of the file using the UTC START          */
-      /* Convert the UTC_START from the header format: YYYY-MM-DD-hh:mm:ss into YYYYMMDDhhmmss  */
-      int year, month, day, hour, minute, second;
-      sscanf(ctx->utc_start, "%d-%d-%d-%d:%d:%d", &year, &month, &day, &hour, &minute, &second);
-
-      /* Make a new filename- oooooooooo_YYYYMMDDhhmmss_chCCC_FFF.fits */
-      snprintf(ctx->fits_filename, FITS_FILENAME_LEN, "%s/%ld_%04d%02d%02d%02d%02d%02d_ch%03d_%03d.fits", ctx->destination_dir, ctx->obs_id, year, month, day, hour, minute, second, ctx->coarse_channel, ctx->fits_file_number);
-      snprintf(ctx->temp_fits_filename, TEMP_FITS_FILENAME_LEN, "%s.tmp", ctx->fits_filename);
+      make_fits_filename(ctx);
 
       /* Create a temporary fits filename. Only once we are happy it's complete and good do we rename it back to .fits */
+      uint64_t create_start_ns = metrics_now_ns();
+      TRACE_BEGIN("create_fits");
+
       if (create_fits(client, &ctx->fits_ptr, ctx->temp_fits_filename))
       {
         multilog(log, LOG_ERR, "dada_dbfits_open(): Error creating new fits file.\n");
         return -1;
       }
+
+      TRACE_END("create_fits");
+      metrics_record_latency(METRICS_LATENCY_CREATE_FITS, create_start_ns);
+
+      /* Reserve the disk space it is expected to need (if enabled) */
+      if (ctx->preallocate && warmup_preallocate_fits(client) != EXIT_SUCCESS)
+      {
+        multilog(log, LOG_ERR, "dada_dbfits_open(): Error reserving disk space for the new fits file.\n");
+        return -1;
+      }
+
+      if (hdu_offsets_needed(ctx))
+      {
+        hdu_index_reset(&ctx->hdu_index, ctx->obs_id, ctx->coarse_channel, ctx->fits_file_number);
+      }
+
+      /* Start its journal (if enabled), so it can be recovered if we stop before it is complete */
+      if (ctx->journal_enabled && journal_open(&ctx->journal, ctx->fits_filename, ctx->obs_id, ctx->coarse_channel, ctx->fits_file_number, log) != EXIT_SUCCESS)
+      {
+        multilog(log, LOG_ERR, "dada_dbfits_open(): Error creating the journal of the new fits file.\n");
+        return -1;
+      }
+
+      /* Create the autos sidecar fits file (if enabled) to go with it */
+      if (autos_open_fits(client))
+      {
+        multilog(log, LOG_ERR, "dada_dbfits_open(): Error creating new autos fits file.\n");
+        return -1;
+      }
     }
 
     // Reset file size
@@ -194,9 +390,9 @@ int dada_dbfits_open(dada_client_t *client)
 
     /* Get the duration */
     int new_duration_sec = 0;
-    if (ascii_header_get(client->header, HEADER_EXPOSURE_SECS, "%i", &new_duration_sec) == -1)
+    if (dada_header_get_int(&ctx->parsed_header, HEADER_EXPOSURE_SECS, &new_duration_sec) != DADA_HEADER_OK)
     {
-      multilog(log, LOG_ERR, "dada_dbfits_open(): %s not found in header.\n", HEADER_EXPOSURE_SECS);
+      multilog(log, LOG_ERR, "dada_dbfits_open(): %s not found in header (or is not a number).\n", HEADER_EXPOSURE_SECS);
       return -1;
     }
 
@@ -208,9 +404,9 @@ int dada_dbfits_open(dada_client_t *client)
 
     /* Get the offset */
     int new_obs_offset_sec = 0;
-    if (ascii_header_get(client->header, HEADER_OBS_OFFSET, "%i", &new_obs_offset_sec) == -1)
+    if (dada_header_get_int(&ctx->parsed_header, HEADER_OBS_OFFSET, &new_obs_offset_sec) != DADA_HEADER_OK)
     {
-      multilog(log, LOG_ERR, "dada_dbfits_open(): %s not found in header.\n", HEADER_OBS_OFFSET);
+      multilog(log, LOG_ERR, "dada_dbfits_open(): %s not found in header (or is not a number).\n", HEADER_OBS_OFFSET);
       return -1;
     }
 
@@ -249,6 +445,256 @@ int dada_dbfits_open(dada_client_t *client)
   return EXIT_SUCCESS;
 }
 
+/**
+ *
+ *  @brief This is called at the begininning of each new 8 second sub-observation.
+ *         We need check if we are in a new fits file or continuing the existing one.
+ *  @param[in] client A pointer to the dada_client_t object.
+ *  @returns EXIT_SUCCESS on success, or -1 if there was an error.
+ */
+int dada_dbfits_open(dada_client_t *client)
+{
+  TRACE_BEGIN("dada_dbfits_open");
+  int result = open_sub_observation(client);
+  TRACE_END("dada_dbfits_open");
+
+  return result;
+}
+
+/**
+ *
+ *  @brief Moves the marker and UNIX time on to the next integration / timestep.
+ *  @param[in] ctx The dada_db_s context.
+ */
+static void advance_integration(dada_db_s *ctx)
+{
+  ctx->obs_marker_number += 1; // Increment the marker number
+
+  // Increment the UNIX time marker by: int_time_msec
+  ctx->unix_time_msec += ctx->int_time_msec;
+
+  while (ctx->unix_time_msec >= 1000)
+  {
+    ctx->unix_time += 1;
+    ctx->unix_time_msec -= 1000;
+  }
+}
+
+/**
+ *
+ *  @brief Records the end to end latency from an integration's UNIX time to now (all of its HDUs have just been
+ *         written), and keeps its time so the latency to its fits file being renamed can be recorded later.
+ *  @param[in] ctx The dada_db_s context.
+ *  @returns EXIT_SUCCESS on success, or -1 if there was an error.
+ */
+static int record_integration_written(dada_db_s *ctx)
+{
+  uint64_t integration_usec = ((uint64_t)ctx->unix_time * 1000000) + ((uint64_t)ctx->unix_time_msec * 1000);
+  uint64_t now_usec = metrics_unix_time_usec();
+
+  // The integration time comes from the correlator's clock, so allow for it being slightly ahead of ours
+  metrics_record_latency_usec(METRICS_LATENCY_DATA_TO_HDU, (now_usec > integration_usec ? now_usec - integration_usec : 0));
+
+  if (ctx->file_integration_count == ctx->file_integration_capacity)
+  {
+    uint64_t new_capacity = (ctx->file_integration_capacity == 0 ? 256 : ctx->file_integration_capacity * 2);
+    uint64_t *new_file_integration_usec = realloc(ctx->file_integration_usec, new_capacity * sizeof(uint64_t));
+
+    if (new_file_integration_usec == NULL)
+    {
+      multilog(ctx->log, LOG_ERR, "dada_dbfits_io(): Error allocating %lu bytes for the integration times of the fits file.\n", new_capacity * sizeof(uint64_t));
+      return -1;
+    }
+
+    ctx->file_integration_usec = new_file_integration_usec;
+    ctx->file_integration_capacity = new_capacity;
+  }
+
+  ctx->file_integration_usec[ctx->file_integration_count++] = integration_usec;
+
+  return EXIT_SUCCESS;
+}
+
+/**
+ *
+ *  @brief Logs the distribution of each latency over the observation which has just ended.
+ *  @param[in] ctx The dada_db_s context.
+ *  @param[in] log A pointer to the multilog_t logger.
+ */
+static void log_observation_latency(dada_db_s *ctx, multilog_t *log)
+{
+  if (ctx->obs_start_metrics == NULL)
+  {
+    return;
+  }
+
+  metrics_snapshot(ctx->obs_end_metrics);
+
+  for (int latency = 0; latency < METRICS_LATENCY_COUNT; latency++)
+  {
+    metrics_latency_summary_s summary;
+    metrics_summarise_latency(ctx->obs_end_metrics, ctx->obs_start_metrics, latency, &summary);
+
+    if (summary.count > 0)
+    {
+      multilog(log, LOG_INFO, "dada_dbfits_close(): obs_id %ld: latency %-12s n=%lu p50=%.3fs p99=%.3fs max=%.3fs\n", ctx->obs_id, metrics_latency_name(latency),
+               summary.count, summary.p50_usec / 1.0e6, summary.p99_usec / 1.0e6, summary.max_usec / 1.0e6);
+    }
+  }
+}
+
+/**
+ *
+ *  @brief Sends the current integration's perf counts to health and adds them to the observation's (if perf counters are enabled).
+ *  @param[in] ctx The dada_db_s context.
+ */
+static void end_integration_perf_counters(dada_db_s *ctx)
+{
+  if (ctx->perf.enabled)
+  {
+    health_manager_add_perf_info(ctx->perf.integration, ctx->perf.available);
+    perf_counters_end_integration(&ctx->perf);
+  }
+}
+
+/**
+ *
+ *  @brief Writes the current integration's visibilities into the sub-observation's visibility cube, creating the cube
+ *         first if this is its first integration. The weights are kept in ctx->cube_weights until finish_cube().
+ *  @param[in] client A pointer to the dada_client_t object.
+ *  @param[in] buffer The pointer to the visibilities of the integration.
+ *  @param[in] bytes The number of bytes of visibilities (one plane of the cube).
+ *  @param[in] nonfinite The number of NaN/Inf values in the integration.
+ *  @param[in] zero_baselines The number of zero-power baselines in the integration.
+ *  @returns EXIT_SUCCESS on success, or -1 if there was an error.
+ */
+static int write_cube_visibilities(dada_client_t *client, float *buffer, uint64_t bytes, uint64_t nonfinite, uint64_t zero_baselines)
+{
+  dada_db_s *ctx = (dada_db_s *)client->context;
+  multilog_t *log = (multilog_t *)ctx->log;
+
+  if (!ctx->cube_open)
+  {
+    if (create_fits_visibilities_cube_imghdu(client, ctx->fits_ptr, ctx->unix_time, ctx->unix_time_msec, ctx->obs_marker_number,
+                                             ctx->no_of_integrations_per_subobs, ctx->nbaselines, ctx->nfine_chan, ctx->npol))
+    {
+      multilog(log, LOG_ERR, "dada_dbfits_io(): Error creating new visibility cube HDU.\n");
+      return -1;
+    }
+
+    ctx->cube_open = 1;
+    ctx->cube_integrations = 0;
+    ctx->cube_unix_time = ctx->unix_time;
+    ctx->cube_unix_time_msec = ctx->unix_time_msec;
+    ctx->cube_marker = ctx->obs_marker_number;
+    ctx->cube_nonfinite = 0;
+    ctx->cube_zero_baselines = 0;
+    ctx->cube_first_index_record = ctx->hdu_index.header.record_count;
+
+    // Integrations which never arrive keep a weight of 0
+    memset(ctx->cube_weights, 0, ctx->expected_transfer_size_of_weights * ctx->no_of_integrations_per_subobs);
+  }
+
+  if (ctx->cube_integrations >= ctx->no_of_integrations_per_subobs)
+  {
+    multilog(log, LOG_ERR, "dada_dbfits_io(): Error, more than %d integrations in this sub observation; Marker = %d.\n", ctx->no_of_integrations_per_subobs, ctx->obs_marker_number);
+    return -1;
+  }
+
+  if (write_fits_visibilities_cube_plane(client, ctx->fits_ptr, ctx->cube_integrations, ctx->obs_marker_number, buffer, bytes))
+  {
+    multilog(log, LOG_ERR, "dada_dbfits_io(): Error writing into visibility cube HDU.\n");
+    return -1;
+  }
+
+  // The cube's header is complete once data has been written into it
+  if (hdu_offsets_needed(ctx) && ctx->cube_integrations == 0 &&
+      hdu_index_get_hdu_offsets(ctx->fits_ptr, &ctx->cube_vis_header_offset, &ctx->cube_vis_data_offset) != EXIT_SUCCESS)
+  {
+    multilog(log, LOG_ERR, "dada_dbfits_io(): Error getting the offset of the visibility cube HDU.\n");
+    return -1;
+  }
+
+  ctx->cube_nonfinite += nonfinite;
+  ctx->cube_zero_baselines += zero_baselines;
+
+  return EXIT_SUCCESS;
+}
+
+/**
+ *
+ *  @brief Finishes the sub-observation's visibility cube (if there is one): fills in its bad data counts, then writes
+ *         the weights cube after it, and the weights offsets of its integrations into the HDU index (if enabled).
+ *  @param[in] client A pointer to the dada_client_t object.
+ *  @returns EXIT_SUCCESS on success, or -1 if there was an error.
+ */
+static int finish_cube(dada_client_t *client)
+{
+  dada_db_s *ctx = (dada_db_s *)client->context;
+  multilog_t *log = (multilog_t *)ctx->log;
+
+  if (!ctx->cube_open)
+  {
+    return EXIT_SUCCESS;
+  }
+
+  ctx->cube_open = 0;
+
+  if (update_fits_bad_data_keys(client, ctx->fits_ptr, ctx->cube_nonfinite, ctx->cube_zero_baselines))
+  {
+    multilog(log, LOG_ERR, "dada_dbfits_close(): Error updating the visibility cube HDU.\n");
+    return -1;
+  }
+
+  uint64_t weights_cube_bytes = ctx->expected_transfer_size_of_weights * ctx->no_of_integrations_per_subobs;
+  uint64_t hdu_start_ns = metrics_now_ns();
+  TRACE_BEGIN("weights_hdu");
+
+  if (create_fits_weights_cube_imghdu(client, ctx->fits_ptr, ctx->cube_unix_time, ctx->cube_unix_time_msec, ctx->cube_marker,
+                                      ctx->no_of_integrations_per_subobs, ctx->nbaselines, ctx->npol, ctx->cube_weights, weights_cube_bytes))
+  {
+    multilog(log, LOG_ERR, "dada_dbfits_close(): Error writing weights cube HDU.\n");
+    return -1;
+  }
+
+  TRACE_END("weights_hdu");
+  metrics_record_latency(METRICS_LATENCY_WEIGHTS_HDU, hdu_start_ns);
+
+  // The bytes were counted as each integration was written
+  metrics_add_written(0, 2);
+
+  if (hdu_offsets_needed(ctx))
+  {
+    uint64_t weights_header_offset = 0;
+    uint64_t weights_data_offset = 0;
+
+    if (hdu_index_get_hdu_offsets(ctx->fits_ptr, &weights_header_offset, &weights_data_offset) != EXIT_SUCCESS)
+    {
+      multilog(log, LOG_ERR, "dada_dbfits_close(): Error getting the offset of the weights cube HDU.\n");
+      return -1;
+    }
+
+    for (uint64_t r = ctx->cube_first_index_record; r < ctx->hdu_index.header.record_count; r++)
+    {
+      hdu_index_record_s *record = &ctx->hdu_index.records[r];
+
+      record->weights_header_offset = weights_header_offset;
+      record->weights_data_offset = weights_data_offset + ((uint64_t)(record->marker - ctx->cube_marker) * ctx->expected_transfer_size_of_weights);
+    }
+  }
+
+  // The sub observation's integrations are now complete in the file
+  if (ctx->journal_enabled &&
+      journal_append(&ctx->journal, ctx->fits_ptr, &ctx->hdu_index.records[ctx->cube_first_index_record],
+                     ctx->hdu_index.header.record_count - ctx->cube_first_index_record, log) != EXIT_SUCCESS)
+  {
+    multilog(log, LOG_ERR, "dada_dbfits_close(): Error journalling the cube's integrations.\n");
+    return -1;
+  }
+
+  return EXIT_SUCCESS;
+}
+
 /**
  *
  *  @brief This is the function psrdada calls when we have new data to read.
@@ -279,6 +725,8 @@ int64_t dada_dbfits_io(dada_client_t *client, void *buffer, uint64_t bytes)
       uint64_t wrote = 0;
 
       multilog(log, LOG_DEBUG, "dada_dbfits_io(): Processing block %d.\n", ctx->block_number);
+      TRACE_BEGIN("dada_dbfits_io");
+      uint64_t io_start_ns = MWAX_PROBE_START_NS(integration_written);
 
       multilog(log, LOG_INFO, "dada_dbfits_io(): Writing %d of %d bytes into new image HDU; Marker = %d.\n", ctx->expected_transfer_size_of_integration, bytes, ctx->obs_marker_number);
 
@@ -290,9 +738,89 @@ int64_t dada_dbfits_io(dada_client_t *client, void *buffer, uint64_t bytes)
       uint64_t visibility_hdu_bytes = ctx->expected_transfer_size_of_integration;
       uint64_t weights_hdu_bytes = ctx->expected_transfer_size_of_weights;
 
+      // Scan this integration for NaN/Inf values and zero-power baselines
+      uint64_t zero_baselines = 0;
+      TRACE_BEGIN("scan_bad_data");
+      PERF_STAGE_BEGIN(&ctx->perf);
+      uint64_t nonfinite = scan_bad_data(ptr_data, ctx->nbaselines, ctx->nfine_chan * ctx->npol * ctx->npol * 2, ctx->bad_baselines, &zero_baselines);
+      PERF_STAGE_END(&ctx->perf, PERF_STAGE_SCAN_BAD_DATA);
+      TRACE_END("scan_bad_data");
+      int bad_data = (nonfinite > 0 || zero_baselines > 0);
+      // A cube has no gap to leave for a dropped integration, so instead all of its weights are zeroed (below)
+      int drop_integration = (bad_data && ctx->bad_data_policy == BAD_DATA_POLICY_DROP && !ctx->cube);
+
+      if (bad_data)
+      {
+        multilog(log, LOG_WARNING, "dada_dbfits_io(): Integration has %lu NaN/Inf values and %lu zero-power baselines; Marker = %d; Policy = %s.\n", nonfinite, zero_baselines, ctx->obs_marker_number, bad_data_policy_name(ctx->bad_data_policy));
+      }
+
+      health_manager_add_bad_data_info(nonfinite, zero_baselines, drop_integration);
+
+      if (drop_integration)
+      {
+        // Don't write anything for this integration, but keep the marker and time correct for the next one
+        advance_integration(ctx);
+
+        end_integration_perf_counters(ctx);
+
+        ctx->block_number += 1;
+        ctx->bytes_written += to_write;
+
+        TRACE_END("dada_dbfits_io");
+        return bytes;
+      }
+
+      // Flag this integration (if enabled). This works on the visibilities as they are in the ringbuffer.
+      if (ctx->rfi_threshold > 0)
+      {
+        TRACE_BEGIN("rfi_flag_integration");
+        PERF_STAGE_BEGIN(&ctx->perf);
+
+        if (rfi_flag_integration(client, ptr_data) != EXIT_SUCCESS)
+        {
+          // Error!
+          multilog(log, LOG_ERR, "dada_dbfits_io(): Error flagging integration.\n");
+          return -1;
+        }
+
+        PERF_STAGE_END(&ctx->perf, PERF_STAGE_RFI_FLAG);
+        TRACE_END("rfi_flag_integration");
+      }
+
+      // Reorder the visibilities if we are writing frequency-major. The ringbuffer is left untouched.
+      float *ptr_vis_hdu_data = ptr_data;
+
+      if (ctx->vis_layout == VIS_LAYOUT_FINECHAN_MAJOR)
+      {
+        TRACE_BEGIN("transpose_visibilities");
+        PERF_STAGE_BEGIN(&ctx->perf);
+        transpose_visibilities(ptr_data, ctx->transpose_buffer, ctx->nbaselines, ctx->nfine_chan, ctx->npol * ctx->npol * 2);
+        PERF_STAGE_END(&ctx->perf, PERF_STAGE_TRANSPOSE);
+        TRACE_END("transpose_visibilities");
+        ptr_vis_hdu_data = ctx->transpose_buffer;
+      }
+
       // Create the visibility HDU in the FITS file
-      if (create_fits_visibilities_imghdu(client, ctx->fits_ptr, ctx->unix_time, ctx->unix_time_msec, ctx->obs_marker_number,
-                                          ctx->nbaselines, ctx->nfine_chan, ctx->npol, ptr_data, visibility_hdu_bytes))
+      long file_size_before = ctx->fits_file_size;
+      int hdus_written = 0;
+      uint64_t hdu_start_ns = metrics_now_ns();
+      TRACE_BEGIN("visibilities_hdu");
+      PERF_STAGE_BEGIN(&ctx->perf);
+
+      int vis_error = 0;
+
+      if (ctx->cube)
+      {
+        vis_error = write_cube_visibilities(client, ptr_vis_hdu_data, visibility_hdu_bytes, nonfinite, zero_baselines);
+      }
+      else
+      {
+        vis_error = create_fits_visibilities_imghdu(client, ctx->fits_ptr, ctx->unix_time, ctx->unix_time_msec, ctx->obs_marker_number,
+                                                    ctx->nbaselines, ctx->nfine_chan, ctx->npol, ptr_vis_hdu_data, visibility_hdu_bytes,
+                                                    nonfinite, zero_baselines);
+      }
+
+      if (vis_error)
       {
         // Error!
         multilog(log, LOG_ERR, "dada_dbfits_io(): Error Writing into new visibility image HDU.\n");
@@ -300,12 +828,76 @@ int64_t dada_dbfits_io(dada_client_t *client, void *buffer, uint64_t bytes)
       }
       else
       {
+        PERF_STAGE_END(&ctx->perf, PERF_STAGE_VIS_HDU);
+        TRACE_END("visibilities_hdu");
+        metrics_record_latency(METRICS_LATENCY_VIS_HDU, hdu_start_ns);
+
+        // Where the HDUs of this integration are, for the .idx sidecar and the journal (if enabled)
+        hdu_index_record_s index_record = {.marker = ctx->obs_marker_number, .millitim = ctx->unix_time_msec, .time = ctx->unix_time,
+                                           .vis_data_bytes = visibility_hdu_bytes, .weights_data_bytes = weights_hdu_bytes};
+
+        if (ctx->cube)
+        {
+          // The cube HDUs are counted when they are finished
+          index_record.vis_header_offset = ctx->cube_vis_header_offset;
+          index_record.vis_data_offset = ctx->cube_vis_data_offset + ((uint64_t)ctx->cube_integrations * visibility_hdu_bytes);
+        }
+        else
+        {
+          hdus_written++;
+
+          if (hdu_offsets_needed(ctx) && hdu_index_get_hdu_offsets(ctx->fits_ptr, &index_record.vis_header_offset, &index_record.vis_data_offset) != EXIT_SUCCESS)
+          {
+            multilog(log, LOG_ERR, "dada_dbfits_io(): Error getting the offset of the visibility HDU.\n");
+            return -1;
+          }
+        }
+
         // Increment the data buffer pointer to skip the "data" so we point at the weights
         float *ptr_weights = ptr_data + (visibility_hdu_bytes / sizeof(float));
 
-        // Now write the weights HDU
-        if (create_fits_weights_imghdu(client, ctx->fits_ptr, ctx->unix_time, ctx->unix_time_msec, ctx->obs_marker_number,
-                                       ctx->nbaselines, ctx->npol, ptr_weights, weights_hdu_bytes))
+        // Zero the weights of any bad baselines (if enabled), or of the whole integration if it would have been dropped
+        // from a cube. We use a copy, so the ringbuffer is left untouched.
+        if (bad_data && ctx->bad_data_policy == BAD_DATA_POLICY_ZERO_WEIGHT)
+        {
+          int weights_per_baseline = ctx->npol * ctx->npol;
+
+          memcpy(ctx->bad_data_weights, ptr_weights, weights_hdu_bytes);
+
+          for (uint64_t baseline = 0; baseline < ctx->nbaselines; baseline++)
+          {
+            if (ctx->bad_baselines[baseline])
+            {
+              memset(&ctx->bad_data_weights[baseline * weights_per_baseline], 0, weights_per_baseline * sizeof(float));
+            }
+          }
+
+          ptr_weights = ctx->bad_data_weights;
+        }
+        else if (bad_data && ctx->bad_data_policy == BAD_DATA_POLICY_DROP)
+        {
+          memset(ctx->bad_data_weights, 0, weights_hdu_bytes);
+          ptr_weights = ctx->bad_data_weights;
+        }
+
+        // Now write the weights HDU (or, for a cube, keep them until the end of the sub observation)
+        int weights_error = 0;
+        hdu_start_ns = metrics_now_ns();
+        TRACE_BEGIN("weights_hdu");
+        PERF_STAGE_BEGIN(&ctx->perf);
+
+        if (ctx->cube)
+        {
+          memcpy(&ctx->cube_weights[ctx->cube_integrations * (weights_hdu_bytes / sizeof(float))], ptr_weights, weights_hdu_bytes);
+          ctx->cube_integrations++;
+        }
+        else
+        {
+          weights_error = create_fits_weights_imghdu(client, ctx->fits_ptr, ctx->unix_time, ctx->unix_time_msec, ctx->obs_marker_number,
+                                                     ctx->nbaselines, ctx->npol, ptr_weights, weights_hdu_bytes);
+        }
+
+        if (weights_error)
         {
           // Error!
           multilog(log, LOG_ERR, "dada_dbfits_io(): Error Writing into new weights image HDU.\n");
@@ -313,33 +905,125 @@ int64_t dada_dbfits_io(dada_client_t *client, void *buffer, uint64_t bytes)
         }
         else
         {
-          // Update weights in health struct
-          if (health_manager_set_weights_info(ptr_weights, ctx->ninputs / 2) != EXIT_SUCCESS)
+          PERF_STAGE_END(&ctx->perf, PERF_STAGE_WEIGHTS_HDU);
+          TRACE_END("weights_hdu");
+
+          if (!ctx->cube)
+          {
+            metrics_record_latency(METRICS_LATENCY_WEIGHTS_HDU, hdu_start_ns);
+            hdus_written++;
+          }
+
+          if (hdu_offsets_needed(ctx))
+          {
+            // A cube's weights offsets are filled in by finish_cube()
+            if ((!ctx->cube && hdu_index_get_hdu_offsets(ctx->fits_ptr, &index_record.weights_header_offset, &index_record.weights_data_offset) != EXIT_SUCCESS) ||
+                hdu_index_add(&ctx->hdu_index, &index_record) != EXIT_SUCCESS)
+            {
+              multilog(log, LOG_ERR, "dada_dbfits_io(): Error adding the integration to the HDU index.\n");
+              return -1;
+            }
+          }
+
+          // Now write the flags HDU (if enabled)
+          if (ctx->rfi_threshold > 0)
+          {
+            TRACE_BEGIN("flags_hdu");
+            PERF_STAGE_BEGIN(&ctx->perf);
+
+            if (create_fits_flags_imghdu(client, ctx->fits_ptr, ctx->unix_time, ctx->unix_time_msec, ctx->obs_marker_number,
+                                         ctx->nbaselines, ctx->nfine_chan, ctx->rfi_flags, ctx->expected_transfer_size_of_flags, ctx->rfi_flagged))
+            {
+              // Error!
+              multilog(log, LOG_ERR, "dada_dbfits_io(): Error Writing into new flags image HDU.\n");
+              return -1;
+            }
+
+            PERF_STAGE_END(&ctx->perf, PERF_STAGE_FLAGS_HDU);
+            TRACE_END("flags_hdu");
+            ctx->fits_file_size = ctx->fits_file_size + ctx->expected_transfer_size_of_flags;
+            hdus_written++;
+          }
+
+          // Now write the channel statistics HDU (if enabled). Like flagging, this works on the ringbuffer (baseline-major) order.
+          if (ctx->channel_stats)
+          {
+            TRACE_BEGIN("chanstats_hdu");
+            PERF_STAGE_BEGIN(&ctx->perf);
+            compute_channel_stats(ptr_data, ctx->nbaselines, &ctx->chan_stats);
+
+            if (create_fits_chanstats_bintblhdu(client, ctx->fits_ptr, ctx->unix_time, ctx->unix_time_msec, ctx->obs_marker_number,
+                                                ctx->nbaselines, ctx->nfine_chan, ctx->npol, &ctx->chan_stats))
+            {
+              // Error!
+              multilog(log, LOG_ERR, "dada_dbfits_io(): Error Writing into new channel statistics table HDU.\n");
+              return -1;
+            }
+
+            PERF_STAGE_END(&ctx->perf, PERF_STAGE_CHANSTATS_HDU);
+            TRACE_END("chanstats_hdu");
+            ctx->fits_file_size = ctx->fits_file_size + ctx->expected_transfer_size_of_chanstats;
+            hdus_written++;
+          }
+
+          // Update weights and auto power in health struct
+          TRACE_BEGIN("health_manager_set_weights_info");
+          PERF_STAGE_BEGIN(&ctx->perf);
+
+          if (health_manager_set_weights_info(ptr_weights, ptr_data, ctx->ninputs / 2, ctx->nfine_chan) != EXIT_SUCCESS)
           {
             // Error!
             multilog(log, LOG_ERR, "dada_dbfits_io(): Error setting health weights.\n");
             return -1;
           }
 
+          PERF_STAGE_END(&ctx->perf, PERF_STAGE_HEALTH_WEIGHTS);
+          TRACE_END("health_manager_set_weights_info");
+
+          // Add this integration's autocorrelations to the autos sidecar (if enabled)
+          TRACE_BEGIN("autos_accumulate");
+          PERF_STAGE_BEGIN(&ctx->perf);
+
+          if (autos_accumulate(client, ptr_data) != EXIT_SUCCESS)
+          {
+            // Error!
+            multilog(log, LOG_ERR, "dada_dbfits_io(): Error accumulating autocorrelations.\n");
+            return -1;
+          }
+
+          PERF_STAGE_END(&ctx->perf, PERF_STAGE_AUTOS);
+          TRACE_END("autos_accumulate");
+
+          // All of this integration's HDUs are now in the file (a cube's are journalled when it is finished)
+          if (ctx->journal_enabled && !ctx->cube &&
+              journal_append(&ctx->journal, ctx->fits_ptr, &ctx->hdu_index.records[ctx->hdu_index.header.record_count - 1], 1, log) != EXIT_SUCCESS)
+          {
+            multilog(log, LOG_ERR, "dada_dbfits_io(): Error journalling the integration.\n");
+            return -1;
+          }
+
           wrote = to_write;
           written += wrote;
           ctx->fits_file_size = ctx->fits_file_size + visibility_hdu_bytes + weights_hdu_bytes;
 
-          ctx->obs_marker_number += 1; // Increment the marker number
+          metrics_add_written(ctx->fits_file_size - file_size_before, hdus_written);
 
-          // Increment the UNIX time marker by: int_time_msec
-          ctx->unix_time_msec += ctx->int_time_msec;
-
-          while (ctx->unix_time_msec >= 1000)
+          if (record_integration_written(ctx) != EXIT_SUCCESS)
           {
-            ctx->unix_time += 1;
-            ctx->unix_time_msec -= 1000;
+            return -1;
           }
+
+          MWAX_PROBE4(integration_written, ctx->obs_id, ctx->obs_marker_number, written, MWAX_PROBE_ELAPSED_NS(io_start_ns));
+          end_integration_perf_counters(ctx);
+
+          advance_integration(ctx);
         }
       }
 
       ctx->block_number += 1;
       ctx->bytes_written += written;
+
+      TRACE_END("dada_dbfits_io");
     }
 
     return bytes;
@@ -404,6 +1088,12 @@ int dada_dbfits_close(dada_client_t *client, uint64_t bytes_written)
     // Check if we are actually processing an obs or just skipping it
     if (ctx->obs_id != 0)
     {
+      // Write the weights cube after this sub observation's visibility cube (if writing cubes)
+      if (finish_cube(client) != EXIT_SUCCESS)
+      {
+        return -1;
+      }
+
       // Some sanity checks:
       int current_duration = (int)((float)(ctx->obs_marker_number) * ((float)ctx->int_time_msec / 1000.0));
 
@@ -436,11 +1126,57 @@ int dada_dbfits_close(dada_client_t *client, uint64_t bytes_written)
       // Close existing fits file (if we have one)
       if (ctx->fits_ptr != NULL)
       {
+        uint64_t close_start_ns = metrics_now_ns();
+        TRACE_BEGIN("close_fits");
+
         if (close_fits(client, &ctx->fits_ptr, good_fits))
         {
           multilog(log, LOG_ERR, "dada_dbfits_close(): Error closing fits file.\n");
           return -1;
         }
+
+        TRACE_END("close_fits");
+        record_fits_closed(ctx, good_fits, close_start_ns);
+      }
+
+      if (autos_close_fits(client, good_fits))
+      {
+        multilog(log, LOG_ERR, "dada_dbfits_close(): Error closing autos fits file.\n");
+        return -1;
+      }
+
+      // Log the latencies and perf counters of this observation (if enabled)
+      if (ctx->obs_id != 0)
+      {
+        log_observation_latency(ctx, log);
+      }
+
+      if (ctx->perf.enabled && ctx->obs_id != 0)
+      {
+        perf_counters_log_observation(&ctx->perf, log, ctx->obs_id);
+      }
+
+      // Write out the timeline of this observation (if tracing is enabled). A failure here is not fatal.
+      if (g_trace_enabled && ctx->obs_id != 0)
+      {
+        char trace_label[32];
+        snprintf(trace_label, sizeof(trace_label), "%ld", ctx->obs_id);
+
+        if (trace_dump(log, trace_label) != EXIT_SUCCESS)
+        {
+          multilog(log, LOG_WARNING, "dada_dbfits_close(): Error writing trace file.\n");
+        }
+      }
+
+      // The disk probe thread can measure the destination path again
+      diskprobe_end_observation();
+
+      // The disk bandwidth and free space checks were for this observation. A refused observation (obs_id == 0) keeps
+      // its state until the next one starts
+      if (ctx->obs_id != 0)
+      {
+        health_manager_set_disk_info(diskprobe_bandwidth(), 0, DISKPROBE_STATE_UNKNOWN);
+        health_manager_set_space_info(0, 0, FREESPACE_STATE_UNKNOWN);
       }
     }
   }
@@ -466,52 +1202,9 @@ int validate_header(dada_client_t *client)
 
   multilog_t *log = (multilog_t *)client->log;
 
-  /* Do have a positive number of inputs (tile * pol) */
-  if (!(ctx->ninputs > 0))
-  {
-    multilog(log, LOG_ERR, "validate_heder(): %s is not greater than 0.\n", HEADER_NINPUTS);
-    return -1;
-  }
-
-  /* Coarse channel number needs to be in range 0-255 */
-  if (!(ctx->coarse_channel >= 0 && ctx->coarse_channel <= COARSE_CHANNEL_MAX))
-  {
-    multilog(log, LOG_ERR, "validate_heder(): %s is not between 0 and %d.\n", HEADER_COARSE_CHANNEL, COARSE_CHANNEL_MAX);
-    return -1;
-  }
-
-  /* Correlator coarse channel number must be in range 1-N */
-  if (!(ctx->corr_coarse_channel >= 1))
-  {
-    multilog(log, LOG_ERR, "validate_heder(): %s is not equal to or greater than 1.\n", HEADER_CORR_COARSE_CHANNEL);
-    return -1;
-  }
-
-  /* ProjectID needs to be less than 255 chars */
-  if (!(strlen(ctx->proj_id) <= PROJ_ID_LEN))
-  {
-    multilog(log, LOG_ERR, "validate_heder(): %s must be %d characters long.\n", HEADER_PROJ_ID, PROJ_ID_LEN);
-    return -1;
-  }
-
-  /* Bandwidth in Hz needs to be > 0 */
-  if (!(ctx->bandwidth_hz > 0))
-  {
-    multilog(log, LOG_ERR, "validate_heder(): %s is not greater than 0.\n", HEADER_BANDWIDTH_HZ);
-    return -1;
-  }
-
-  /* fsscrunch factor needs to be > 0 */
-  if (!(ctx->fscrunch_factor > 0))
-  {
-    multilog(log, LOG_ERR, "validate_heder(): %s is not greater than 0.\n", HEADER_FSCRUNCH_FACTOR);
-    return -1;
-  }
-
-  /* polarisations needs to be > 0 */
-  if (!(ctx->npol > 0))
+  /* Each value on its own must be in the range given in the schema */
+  if (dada_header_validate_fields(dada_db_header_schema, DADA_DB_HEADER_SCHEMA_FIELDS, ctx, log) != EXIT_SUCCESS)
   {
-    multilog(log, LOG_ERR, "validate_heder(): %s is not greater than 0.\n", HEADER_NPOL);
     return -1;
   }
 
@@ -529,13 +1222,6 @@ int validate_header(dada_client_t *client)
     return -1;
   }
 
-  /* seconds per sub observation must be > 0 */
-  if (!(ctx->secs_per_subobs > 0))
-  {
-    multilog(log, LOG_ERR, "validate_heder(): %s is not greater than 0.\n", HEADER_SECS_PER_SUBOBS);
-    return -1;
-  }
-
   /* Is exposure time min of 8 secs and a multiple of 8? */
   if (!(ctx->exposure_sec >= ctx->secs_per_subobs && (ctx->exposure_sec % ctx->secs_per_subobs == 0)))
   {
@@ -551,13 +1237,6 @@ int validate_header(dada_client_t *client)
     return -1;
   }
 
-  /* transfer size must be > 0*/
-  if (!(ctx->transfer_size > 0))
-  {
-    multilog(log, LOG_ERR, "validate_heder(): %s is not greater than 0.\n", HEADER_TRANSFER_SIZE);
-    return -1;
-  }
-
   /* bits per valye must be at least 8 and a multiple of a byte (8) */
   if (!(ctx->nbit >= 8 && (ctx->nbit % 8 == 0)))
   {
@@ -565,13 +1244,6 @@ int validate_header(dada_client_t *client)
     return -1;
   }
 
-  /* unix time msec must be between 0 and 999 */
-  if (!(ctx->unix_time_msec >= 0 || ctx->unix_time_msec < 1000))
-  {
-    multilog(log, LOG_ERR, "validate_heder(): %s must be between 0 and 999 milliseconds.\n", HEADER_UNIXTIME_MSEC);
-    return -1;
-  }
-
   return EXIT_SUCCESS;
 }
 
@@ -619,143 +1291,11 @@ int read_dada_header(dada_client_t *client)
   ctx->nbaselines = 0;
   ctx->obs_marker_number = 0;
 
-  if (ascii_header_get(client->header, HEADER_POPULATED, "%i", &ctx->populated) == -1)
-  {
-    multilog(log, LOG_ERR, "read_dada_header(): %s not found in header.\n", HEADER_POPULATED);
-    return -1;
-  }
-
-  if (ascii_header_get(client->header, HEADER_UTC_START, "%s", &ctx->utc_start) == -1)
-  {
-    multilog(log, LOG_ERR, "read_dada_header(): %s not found in header.\n", HEADER_UTC_START);
-    return -1;
-  }
-
-  if (ascii_header_get(client->header, HEADER_OBS_OFFSET, "%i", &ctx->obs_offset) == -1)
-  {
-    multilog(log, LOG_ERR, "read_dada_header(): %s not found in header.\n", HEADER_OBS_OFFSET);
-    return -1;
-  }
-
-  if (ascii_header_get(client->header, HEADER_NBIT, "%i", &ctx->nbit) == -1)
-  {
-    multilog(log, LOG_ERR, "read_dada_header(): %s not found in header.\n", HEADER_NBIT);
-    return -1;
-  }
-
-  if (ascii_header_get(client->header, HEADER_NPOL, "%i", &ctx->npol) == -1)
-  {
-    multilog(log, LOG_ERR, "read_dada_header(): %s not found in header.\n", HEADER_NPOL);
-    return -1;
-  }
-
-  if (ascii_header_get(client->header, HEADER_NINPUTS, "%i", &ctx->ninputs) == -1)
-  {
-    multilog(log, LOG_ERR, "read_dada_header(): %s not found in header.\n", HEADER_NINPUTS);
-    return -1;
-  }
-
-  if (ascii_header_get(client->header, HEADER_INT_TIME_MSEC, "%i", &ctx->int_time_msec) == -1)
-  {
-    multilog(log, LOG_ERR, "read_dada_header(): %s not found in header.\n", HEADER_INT_TIME_MSEC);
-    return -1;
-  }
-
-  if (ascii_header_get(client->header, HEADER_TRANSFER_SIZE, "%lu", &ctx->transfer_size) == -1)
-  {
-    multilog(log, LOG_ERR, "read_dada_header(): %s not found in header.\n", HEADER_TRANSFER_SIZE);
-    return -1;
-  }
-
-  if (ascii_header_get(client->header, HEADER_PROJ_ID, "%s", &ctx->proj_id) == -1)
-  {
-    multilog(log, LOG_ERR, "read_dada_header(): %s not found in header.\n", HEADER_PROJ_ID);
-    return -1;
-  }
-
-  if (ascii_header_get(client->header, HEADER_EXPOSURE_SECS, "%i", &ctx->exposure_sec) == -1)
-  {
-    multilog(log, LOG_ERR, "read_dada_header(): %s not found in header.\n", HEADER_EXPOSURE_SECS);
-    return -1;
-  }
-
-  if (ascii_header_get(client->header, HEADER_COARSE_CHANNEL, "%i", &ctx->coarse_channel) == -1)
-  {
-    multilog(log, LOG_ERR, "read_dada_header(): %s not found in header.\n", HEADER_COARSE_CHANNEL);
-    return -1;
-  }
-
-  if (ascii_header_get(client->header, HEADER_CORR_COARSE_CHANNEL, "%i", &ctx->corr_coarse_channel) == -1)
-  {
-    multilog(log, LOG_ERR, "read_dada_header(): %s not found in header.\n", HEADER_CORR_COARSE_CHANNEL);
-    return -1;
-  }
-
-  if (ascii_header_get(client->header, HEADER_SECS_PER_SUBOBS, "%i", &ctx->secs_per_subobs) == -1)
-  {
-    multilog(log, LOG_ERR, "read_dada_header(): %s not found in header.\n", HEADER_SECS_PER_SUBOBS);
-    return -1;
-  }
-
-  if (ascii_header_get(client->header, HEADER_UNIXTIME, "%lu", &ctx->unix_time) == -1)
-  {
-    multilog(log, LOG_ERR, "read_dada_header(): %s not found in header.\n", HEADER_UNIXTIME);
-    return -1;
-  }
-
-  if (ascii_header_get(client->header, HEADER_UNIXTIME_MSEC, "%i", &ctx->unix_time_msec) == -1)
-  {
-    multilog(log, LOG_ERR, "read_dada_header(): %s not found in header.\n", HEADER_UNIXTIME_MSEC);
-    return -1;
-  }
-
-  if (ascii_header_get(client->header, HEADER_FINE_CHAN_WIDTH_HZ, "%i", &ctx->fine_chan_width_hz) == -1)
-  {
-    multilog(log, LOG_ERR, "read_dada_header(): %s not found in header.\n", HEADER_FINE_CHAN_WIDTH_HZ);
-    return -1;
-  }
-
-  if (ascii_header_get(client->header, HEADER_NFINE_CHAN, "%i", &ctx->nfine_chan) == -1)
-  {
-    multilog(log, LOG_ERR, "read_dada_header(): %s not found in header.\n", HEADER_NFINE_CHAN);
-    return -1;
-  }
-
-  if (ascii_header_get(client->header, HEADER_BANDWIDTH_HZ, "%i", &ctx->bandwidth_hz) == -1)
-  {
-    multilog(log, LOG_ERR, "read_dada_header(): %s not found in header.\n", HEADER_BANDWIDTH_HZ);
-    return -1;
-  }
-
-  if (ascii_header_get(client->header, HEADER_FSCRUNCH_FACTOR, "%i", &ctx->fscrunch_factor) == -1)
-  {
-    multilog(log, LOG_ERR, "read_dada_header(): %s not found in header.\n", HEADER_FSCRUNCH_FACTOR);
-    return -1;
-  }
-
-  if (ascii_header_get(client->header, HEADER_MC_IP, "%s", &ctx->multicast_ip) == -1)
-  {
-    multilog(log, LOG_ERR, "read_dada_header(): %s not found in header.\n", HEADER_MC_IP);
-    return -1;
-  }
-
-  if (ascii_header_get(client->header, HEADER_MC_PORT, "%i", &ctx->multicast_port) == -1)
+  if (dada_header_read_fields(&ctx->parsed_header, dada_db_header_schema, DADA_DB_HEADER_SCHEMA_FIELDS, ctx, log) != EXIT_SUCCESS)
   {
-    multilog(log, LOG_ERR, "read_dada_header(): %s not found in header.\n", HEADER_MC_PORT);
     return -1;
   }
 
-  // for now if we don't get version info from other mwax components it is just a warning
-  if (ascii_header_get(client->header, HEADER_MWAX_U2S_VERSION, "%s", &ctx->mwax_u2s_version) == -1)
-  {
-    multilog(log, LOG_WARNING, "read_dada_header(): %s not found in header.\n", HEADER_MWAX_U2S_VERSION);
-  }
-
-  if (ascii_header_get(client->header, HEADER_MWAX_DB2CORRELATE2DB_VERSION, "%s", &ctx->mwax_db2correlate2db_version) == -1)
-  {
-    multilog(log, LOG_WARNING, "read_dada_header(): %s not found in header.\n", HEADER_MWAX_DB2CORRELATE2DB_VERSION);
-  }
-
   // Output what we found in the header
   multilog(log, LOG_INFO, "Populated?:               %s\n", (ctx->populated == 1 ? "yes" : "no"));
   multilog(log, LOG_INFO, "Obs Id:                   %lu\n", ctx->obs_id);
@@ -810,7 +1350,8 @@ int process_new_observation(dada_client_t *client, long new_obs_id, long new_sub
   multilog_t *log = (multilog_t *)ctx->log;
 
   // But the new_obs_id != new_subobs_id, then it means we are not at the start of an observation and we should skip it
-  if (new_obs_id != new_subobs_id)
+  // (unless we have been asked to join in progress observations)
+  if (new_obs_id != new_subobs_id && !ctx->join_in_progress)
   {
     multilog(log, LOG_WARNING, "dada_dbfil_open(): Detected an in progress observation (obs_id: %lu / sub_obs_id: %lu). Skipping this observation.\n", new_obs_id, new_subobs_id);
     // Set obs and subobs to 0 so the io and close methods know we have nothing to do
@@ -836,6 +1377,8 @@ int process_new_observation(dada_client_t *client, long new_obs_id, long new_sub
   ctx->subobs_id = new_subobs_id;
 
   // Read in all of the info from the header into our struct
+  TRACE_BEGIN("read_dada_header");
+
   if (read_dada_header(client))
   {
     // Error processing in header!
@@ -843,6 +1386,8 @@ int process_new_observation(dada_client_t *client, long new_obs_id, long new_sub
     return -1;
   }
 
+  TRACE_END("read_dada_header");
+
   /*                          */
   /* Sanity check what we got */
   /*                          */
@@ -851,6 +1396,21 @@ int process_new_observation(dada_client_t *client, long new_obs_id, long new_sub
     return -1;
   }
 
+  // Joining an in progress observation: carry on from its current marker, and name its files after the start of the
+  // observation (not this sub observation) so they match those written by the other coarse channels
+  if (new_obs_id != new_subobs_id)
+  {
+    time_t obs_start_time = (time_t)(ctx->unix_time - ctx->obs_offset);
+    struct tm obs_start_tm;
+
+    gmtime_r(&obs_start_time, &obs_start_tm);
+    strftime(ctx->utc_start, UTC_START_LEN, "%Y-%m-%d-%H:%M:%S", &obs_start_tm);
+    ctx->obs_marker_number = (ctx->obs_offset * 1000) / ctx->int_time_msec;
+
+    multilog(log, LOG_WARNING, "dada_dbfits_open(): Joining an in progress observation (obs_id: %lu / sub_obs_id: %lu) at marker %d (%s %d sec).\n",
+             new_obs_id, new_subobs_id, ctx->obs_marker_number, HEADER_OBS_OFFSET, ctx->obs_offset);
+  }
+
   // Calculate baselines
   ctx->nbaselines = (ctx->ninputs * (ctx->ninputs + 2)) / 8;
 
@@ -897,6 +1457,127 @@ int process_new_observation(dada_client_t *client, long new_obs_id, long new_sub
     return -1;
   }
 
+  // Make sure we have somewhere to transpose an integration into, if we are writing frequency-major
+  if (ctx->vis_layout == VIS_LAYOUT_FINECHAN_MAJOR && ctx->expected_transfer_size_of_integration > ctx->transpose_buffer_capacity)
+  {
+    float *new_buffer = realloc(ctx->transpose_buffer, ctx->expected_transfer_size_of_integration);
+
+    if (new_buffer == NULL)
+    {
+      multilog(log, LOG_ERR, "dada_dbfits_open(): Error allocating %lu bytes for the transpose buffer.\n", ctx->expected_transfer_size_of_integration);
+      return -1;
+    }
+
+    ctx->transpose_buffer = new_buffer;
+    ctx->transpose_buffer_capacity = ctx->expected_transfer_size_of_integration;
+  }
+
+  // Make sure we have somewhere to record the bad baselines of an integration (and to zero their weights, if needed)
+  if (ctx->nbaselines > ctx->bad_baselines_capacity)
+  {
+    unsigned char *new_bad_baselines = realloc(ctx->bad_baselines, ctx->nbaselines);
+
+    if (new_bad_baselines == NULL)
+    {
+      multilog(log, LOG_ERR, "dada_dbfits_open(): Error allocating %lu bytes for the bad baselines buffer.\n", ctx->nbaselines);
+      return -1;
+    }
+
+    ctx->bad_baselines = new_bad_baselines;
+    ctx->bad_baselines_capacity = ctx->nbaselines;
+  }
+
+  if (ctx->bad_data_policy != BAD_DATA_POLICY_KEEP && ctx->expected_transfer_size_of_weights > ctx->bad_data_weights_capacity)
+  {
+    float *new_weights = realloc(ctx->bad_data_weights, ctx->expected_transfer_size_of_weights);
+
+    if (new_weights == NULL)
+    {
+      multilog(log, LOG_ERR, "dada_dbfits_open(): Error allocating %lu bytes for the bad data weights buffer.\n", ctx->expected_transfer_size_of_weights);
+      return -1;
+    }
+
+    ctx->bad_data_weights = new_weights;
+    ctx->bad_data_weights_capacity = ctx->expected_transfer_size_of_weights;
+  }
+
+  // Make sure we have somewhere to keep the weights of a sub observation until its cube is finished
+  uint64_t cube_weights_bytes = ctx->expected_transfer_size_of_weights * ctx->no_of_integrations_per_subobs;
+
+  if (ctx->cube && cube_weights_bytes > ctx->cube_weights_capacity)
+  {
+    float *new_cube_weights = realloc(ctx->cube_weights, cube_weights_bytes);
+
+    if (new_cube_weights == NULL)
+    {
+      multilog(log, LOG_ERR, "dada_dbfits_open(): Error allocating %lu bytes for the weights cube buffer.\n", cube_weights_bytes);
+      return -1;
+    }
+
+    ctx->cube_weights = new_cube_weights;
+    ctx->cube_weights_capacity = cube_weights_bytes;
+  }
+
+  // Note the metrics at the start of this observation, so we can log its latencies when it ends
+  if (ctx->obs_start_metrics == NULL)
+  {
+    ctx->obs_start_metrics = malloc(sizeof(metrics_snapshot_s));
+    ctx->obs_end_metrics = malloc(sizeof(metrics_snapshot_s));
+
+    if (ctx->obs_start_metrics == NULL || ctx->obs_end_metrics == NULL)
+    {
+      multilog(log, LOG_ERR, "dada_dbfits_open(): Error allocating memory for the observation metrics.\n");
+      return -1;
+    }
+  }
+
+  metrics_snapshot(ctx->obs_start_metrics);
+
+  // Check the destination path can keep up with this observation. This may turn off the optional outputs below
+  if (ctx->disk_probe_bytes > 0)
+  {
+    diskprobe_admit_observation(client);
+    health_manager_set_disk_info(ctx->disk_bytes_per_sec, ctx->required_bytes_per_sec, ctx->disk_state);
+  }
+
+  // Check this observation will fit on the destination path. This may redirect or compress it, or refuse it
+  freespace_admit_observation(client);
+  health_manager_set_space_info(ctx->space_free_bytes, ctx->space_forecast_bytes, ctx->space_state);
+
+  if (ctx->space_state == FREESPACE_STATE_REFUSED)
+  {
+    // Set obs and subobs to 0 so the io and close methods know we have nothing to do
+    ctx->obs_id = 0;
+    ctx->subobs_id = 0;
+
+    return EXIT_SUCCESS;
+  }
+
+  // Setup the flags buffers for this observation
+  if (rfi_init_observation(client) != EXIT_SUCCESS)
+  {
+    return -1;
+  }
+
+  // Setup the channel statistics buffers for this observation
+  if (ctx->channel_stats)
+  {
+    // mean, rms and max (float) + nnan (int32) for each fine channel and pol
+    ctx->expected_transfer_size_of_chanstats = ctx->nfine_chan * ctx->npol * ctx->npol * (3 * sizeof(float) + sizeof(int32_t));
+
+    if (channel_stats_alloc(&ctx->chan_stats, ctx->nfine_chan, ctx->npol * ctx->npol) != EXIT_SUCCESS)
+    {
+      multilog(log, LOG_ERR, "dada_dbfits_open(): Error allocating channel statistics buffers.\n");
+      return -1;
+    }
+  }
+
+  // Setup the autos sidecar accumulator for this observation
+  if (autos_init_observation(client) != EXIT_SUCCESS)
+  {
+    return -1;
+  }
+
   // Reset the filenumber
   ctx->fits_file_number = 0;
 
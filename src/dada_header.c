@@ -0,0 +1,389 @@
+/**
+ * @file dada_header.c
+ * @author Greg Sleap
+ * @date 18 Oct 2026
+ * @brief This is the code that parses a PSRDADA ascii header in one pass, with typed accessors
+ *
+ * ascii_header_get() searches the whole header (typically 4096 bytes) for its keyword on every call, and a new
+ * observation looks up around 30 keywords. Instead the header is split into "KEYWORD value" lines once by
+ * dada_header_parse(), and each keyword is then found in the small index. The values are only read through typed
+ * accessors which reject anything that is not entirely a number in range, or is too long for the destination.
+ * A schema (an array of dada_header_field_s) describes which keywords go into which fields of a struct, whether they
+ * are required and what range of values is valid, so reading and validating a header are driven by one table.
+ */
+#include <ctype.h>
+#include <errno.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "dada_header.h"
+
+#define DADA_HEADER_NUMBER_LEN 32 // Longest number accepted (plenty for a 64 bit value)
+
+/**
+ *
+ *  @brief Splits a header into its "KEYWORD value" lines. Blank lines and comments (starting with #) are skipped. If
+ *         a keyword appears more than once the first is used, as with ascii_header_get().
+ *  @param[out] header The index to fill in. It points into text, so is only valid while text is.
+ *  @param[in] text The header. It ends at the first NUL or after text_size bytes, whichever is first.
+ *  @param[in] text_size The size of the header buffer.
+ *  @param[in] log The logger to use (may be NULL).
+ *  @returns EXIT_SUCCESS on success, or -1 if there was an error.
+ */
+int dada_header_parse(dada_header_s *header, const char *text, size_t text_size, multilog_t *log)
+{
+  header->count = 0;
+
+  if (text == NULL)
+  {
+    return -1;
+  }
+
+  const char *p = text;
+  const char *end = text + strnlen(text, text_size);
+
+  while (p < end)
+  {
+    const char *line_end = memchr(p, '\n', end - p);
+
+    if (line_end == NULL)
+    {
+      line_end = end;
+    }
+
+    while (p < line_end && isspace((unsigned char)*p))
+    {
+      p++;
+    }
+
+    if (p < line_end && *p != '#')
+    {
+      if (header->count == DADA_HEADER_MAX_KEYS)
+      {
+        if (log != NULL)
+        {
+          multilog(log, LOG_WARNING, "dada_header_parse(): More than %d keywords in header. The rest are ignored.\n", DADA_HEADER_MAX_KEYS);
+        }
+
+        break;
+      }
+
+      dada_header_entry_s *entry = &header->entries[header->count++];
+      entry->key = p;
+
+      while (p < line_end && !isspace((unsigned char)*p))
+      {
+        p++;
+      }
+
+      entry->key_len = (int)(p - entry->key);
+
+      while (p < line_end && isspace((unsigned char)*p))
+      {
+        p++;
+      }
+
+      entry->value = p;
+
+      while (p < line_end && !isspace((unsigned char)*p))
+      {
+        p++;
+      }
+
+      entry->value_len = (int)(p - entry->value);
+    }
+
+    p = line_end + 1;
+  }
+
+  return EXIT_SUCCESS;
+}
+
+/**
+ *
+ *  @brief Finds a keyword in a parsed header.
+ *  @param[in] header The parsed header.
+ *  @param[in] key The keyword.
+ *  @returns The first line with that keyword, or NULL if there is none.
+ */
+const dada_header_entry_s *dada_header_find(const dada_header_s *header, const char *key)
+{
+  int key_len = (int)strlen(key);
+
+  for (int i = 0; i < header->count; i++)
+  {
+    const dada_header_entry_s *entry = &header->entries[i];
+
+    if (entry->key_len == key_len && memcmp(entry->key, key, key_len) == 0)
+    {
+      return entry;
+    }
+  }
+
+  return NULL;
+}
+
+/**
+ *
+ *  @brief Copies the value of a keyword to a NUL terminated buffer, so it can be converted to a number.
+ *  @param[in] header The parsed header.
+ *  @param[in] key The keyword.
+ *  @param[out] number The value.
+ *  @returns DADA_HEADER_OK, DADA_HEADER_MISSING or DADA_HEADER_INVALID (empty, or too long to be a number).
+ */
+static int get_number_text(const dada_header_s *header, const char *key, char number[DADA_HEADER_NUMBER_LEN])
+{
+  const dada_header_entry_s *entry = dada_header_find(header, key);
+
+  if (entry == NULL)
+  {
+    return DADA_HEADER_MISSING;
+  }
+
+  if (entry->value_len == 0 || entry->value_len >= DADA_HEADER_NUMBER_LEN)
+  {
+    return DADA_HEADER_INVALID;
+  }
+
+  memcpy(number, entry->value, entry->value_len);
+  number[entry->value_len] = '\0';
+
+  return DADA_HEADER_OK;
+}
+
+/**
+ *
+ *  @brief Gets the value of a keyword as a long. The whole value must be a base 10 number in the range of a long.
+ *  @param[in] header The parsed header.
+ *  @param[in] key The keyword.
+ *  @param[out] value The value (unchanged unless DADA_HEADER_OK is returned).
+ *  @returns DADA_HEADER_OK, DADA_HEADER_MISSING or DADA_HEADER_INVALID.
+ */
+int dada_header_get_long(const dada_header_s *header, const char *key, long *value)
+{
+  char number[DADA_HEADER_NUMBER_LEN];
+  int result = get_number_text(header, key, number);
+
+  if (result != DADA_HEADER_OK)
+  {
+    return result;
+  }
+
+  char *number_end;
+  errno = 0;
+  long parsed = strtol(number, &number_end, 10);
+
+  if (errno != 0 || *number_end != '\0')
+  {
+    return DADA_HEADER_INVALID;
+  }
+
+  *value = parsed;
+
+  return DADA_HEADER_OK;
+}
+
+/**
+ *
+ *  @brief Gets the value of a keyword as an int. The whole value must be a base 10 number in the range of an int.
+ *  @param[in] header The parsed header.
+ *  @param[in] key The keyword.
+ *  @param[out] value The value (unchanged unless DADA_HEADER_OK is returned).
+ *  @returns DADA_HEADER_OK, DADA_HEADER_MISSING or DADA_HEADER_INVALID.
+ */
+int dada_header_get_int(const dada_header_s *header, const char *key, int *value)
+{
+  long parsed;
+  int result = dada_header_get_long(header, key, &parsed);
+
+  if (result != DADA_HEADER_OK)
+  {
+    return result;
+  }
+
+  if (parsed < INT_MIN || parsed > INT_MAX)
+  {
+    return DADA_HEADER_INVALID;
+  }
+
+  *value = (int)parsed;
+
+  return DADA_HEADER_OK;
+}
+
+/**
+ *
+ *  @brief Gets the value of a keyword as a uint64_t. The whole value must be a non-negative base 10 number.
+ *  @param[in] header The parsed header.
+ *  @param[in] key The keyword.
+ *  @param[out] value The value (unchanged unless DADA_HEADER_OK is returned).
+ *  @returns DADA_HEADER_OK, DADA_HEADER_MISSING or DADA_HEADER_INVALID.
+ */
+int dada_header_get_uint64(const dada_header_s *header, const char *key, uint64_t *value)
+{
+  char number[DADA_HEADER_NUMBER_LEN];
+  int result = get_number_text(header, key, number);
+
+  if (result != DADA_HEADER_OK)
+  {
+    return result;
+  }
+
+  // strtoull() would quietly negate a negative number
+  if (number[0] == '-')
+  {
+    return DADA_HEADER_INVALID;
+  }
+
+  char *number_end;
+  errno = 0;
+  unsigned long long parsed = strtoull(number, &number_end, 10);
+
+  if (errno != 0 || *number_end != '\0')
+  {
+    return DADA_HEADER_INVALID;
+  }
+
+  *value = (uint64_t)parsed;
+
+  return DADA_HEADER_OK;
+}
+
+/**
+ *
+ *  @brief Gets the value of a keyword as a string (the first word after the keyword, which may be empty).
+ *  @param[in] header The parsed header.
+ *  @param[in] key The keyword.
+ *  @param[out] value The value, NUL terminated (unchanged unless DADA_HEADER_OK is returned).
+ *  @param[in] value_size The size of value. A longer value is DADA_HEADER_INVALID rather than truncated.
+ *  @returns DADA_HEADER_OK, DADA_HEADER_MISSING or DADA_HEADER_INVALID.
+ */
+int dada_header_get_string(const dada_header_s *header, const char *key, char *value, size_t value_size)
+{
+  const dada_header_entry_s *entry = dada_header_find(header, key);
+
+  if (entry == NULL)
+  {
+    return DADA_HEADER_MISSING;
+  }
+
+  if ((size_t)entry->value_len >= value_size)
+  {
+    return DADA_HEADER_INVALID;
+  }
+
+  memcpy(value, entry->value, entry->value_len);
+  value[entry->value_len] = '\0';
+
+  return DADA_HEADER_OK;
+}
+
+/**
+ *
+ *  @brief Reads every keyword of a schema from a parsed header into the fields of dest. A missing required keyword,
+ *         or any value which is not valid for its type, is an error. A missing optional keyword is a warning, and
+ *         its field is left as it was.
+ *  @param[in] header The parsed header.
+ *  @param[in] fields The schema.
+ *  @param[in] nfields The number of elements in fields.
+ *  @param[out] dest The struct the schema's offsets refer to.
+ *  @param[in] log The logger to use.
+ *  @returns EXIT_SUCCESS on success, or -1 if there was an error.
+ */
+int dada_header_read_fields(const dada_header_s *header, const dada_header_field_s *fields, int nfields, void *dest,
+                            multilog_t *log)
+{
+  for (int f = 0; f < nfields; f++)
+  {
+    const dada_header_field_s *field = &fields[f];
+    char *field_ptr = (char *)dest + field->offset;
+    int result = DADA_HEADER_INVALID;
+
+    switch (field->type)
+    {
+    case DADA_HEADER_INT:
+      result = dada_header_get_int(header, field->key, (int *)field_ptr);
+      break;
+    case DADA_HEADER_LONG:
+      result = dada_header_get_long(header, field->key, (long *)field_ptr);
+      break;
+    case DADA_HEADER_UINT64:
+      result = dada_header_get_uint64(header, field->key, (uint64_t *)field_ptr);
+      break;
+    case DADA_HEADER_STRING:
+      result = dada_header_get_string(header, field->key, field_ptr, field->size);
+      break;
+    }
+
+    if (result == DADA_HEADER_MISSING)
+    {
+      if (field->required)
+      {
+        multilog(log, LOG_ERR, "read_dada_header(): %s not found in header.\n", field->key);
+        return -1;
+      }
+
+      multilog(log, LOG_WARNING, "read_dada_header(): %s not found in header.\n", field->key);
+    }
+    else if (result == DADA_HEADER_INVALID)
+    {
+      const dada_header_entry_s *entry = dada_header_find(header, field->key);
+      multilog(log, LOG_ERR, "read_dada_header(): %s has an invalid value '%.*s'.\n", field->key, entry->value_len, entry->value);
+      return -1;
+    }
+  }
+
+  return EXIT_SUCCESS;
+}
+
+/**
+ *
+ *  @brief Checks the number fields of dest which were read with a schema are within the schema's ranges.
+ *  @param[in] fields The schema.
+ *  @param[in] nfields The number of elements in fields.
+ *  @param[in] dest The struct the schema's offsets refer to.
+ *  @param[in] log The logger to use.
+ *  @returns EXIT_SUCCESS if every field is valid, or -1 if one is not.
+ */
+int dada_header_validate_fields(const dada_header_field_s *fields, int nfields, const void *dest, multilog_t *log)
+{
+  for (int f = 0; f < nfields; f++)
+  {
+    const dada_header_field_s *field = &fields[f];
+    const char *field_ptr = (const char *)dest + field->offset;
+    int in_range = 1;
+    long value = 0;
+
+    switch (field->type)
+    {
+    case DADA_HEADER_INT:
+      value = *(const int *)field_ptr;
+      in_range = (value >= field->min_value && value <= field->max_value);
+      break;
+    case DADA_HEADER_LONG:
+      value = *(const long *)field_ptr;
+      in_range = (value >= field->min_value && value <= field->max_value);
+      break;
+    case DADA_HEADER_UINT64:
+    {
+      uint64_t value64 = *(const uint64_t *)field_ptr;
+      value = (value64 > LONG_MAX ? LONG_MAX : (long)value64);
+      in_range = ((field->min_value <= 0 || value64 >= (uint64_t)field->min_value) &&
+                  (field->max_value == LONG_MAX || (field->max_value >= 0 && value64 <= (uint64_t)field->max_value)));
+      break;
+    }
+    case DADA_HEADER_STRING:
+      // Length was checked when it was read
+      break;
+    }
+
+    if (!in_range)
+    {
+      multilog(log, LOG_ERR, "validate_header(): %s (%ld) is not between %ld and %ld.\n", field->key, value, field->min_value, field->max_value);
+      return -1;
+    }
+  }
+
+  return EXIT_SUCCESS;
+}
\ No newline at end of file
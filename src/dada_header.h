@@ -0,0 +1,65 @@
+/**
+ * @file dada_header.h
+ * @author Greg Sleap
+ * @date 18 Oct 2026
+ * @brief This is the header for the code that parses a PSRDADA ascii header in one pass, with typed accessors
+ *
+ */
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "multilog.h"
+
+#define DADA_HEADER_MAX_KEYS 128 // Keywords indexed per header. Any after this are ignored (with a warning)
+
+// Results of the accessors
+#define DADA_HEADER_OK 0
+#define DADA_HEADER_MISSING -1 // The keyword is not in the header
+#define DADA_HEADER_INVALID -2 // The value is not a valid number, is out of range for the type or is too long
+
+// One "KEYWORD value" line of the header. Both point into the header, so are only valid while it is
+typedef struct
+{
+  const char *key;
+  const char *value; // First word after the keyword, as ascii_header_get() reads with "%s"
+  int key_len;
+  int value_len;
+} dada_header_entry_s;
+
+typedef struct
+{
+  dada_header_entry_s entries[DADA_HEADER_MAX_KEYS];
+  int count;
+} dada_header_s;
+
+typedef enum
+{
+  DADA_HEADER_INT,
+  DADA_HEADER_LONG,
+  DADA_HEADER_UINT64,
+  DADA_HEADER_STRING
+} dada_header_type_e;
+
+// One keyword of a schema: where its value goes, and what makes it valid
+typedef struct
+{
+  const char *key;
+  dada_header_type_e type;
+  size_t offset;  // offsetof() the field in the destination struct
+  size_t size;    // Size of a DADA_HEADER_STRING field (including the terminator)
+  int required;   // 1 == missing is an error. 0 == missing is a warning, and the field keeps its default
+  long min_value; // Valid range of a number (inclusive), checked by dada_header_validate_fields()
+  long max_value;
+} dada_header_field_s;
+
+int dada_header_parse(dada_header_s *header, const char *text, size_t text_size, multilog_t *log);
+const dada_header_entry_s *dada_header_find(const dada_header_s *header, const char *key);
+int dada_header_get_int(const dada_header_s *header, const char *key, int *value);
+int dada_header_get_long(const dada_header_s *header, const char *key, long *value);
+int dada_header_get_uint64(const dada_header_s *header, const char *key, uint64_t *value);
+int dada_header_get_string(const dada_header_s *header, const char *key, char *value, size_t value_size);
+int dada_header_read_fields(const dada_header_s *header, const dada_header_field_s *fields, int nfields, void *dest,
+                            multilog_t *log);
+int dada_header_validate_fields(const dada_header_field_s *fields, int nfields, const void *dest, multilog_t *log);
\ No newline at end of file
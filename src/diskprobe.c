@@ -0,0 +1,447 @@
+/**
+ * @file diskprobe.c
+ * @author Greg Sleap
+ * @date 18 Oct 2026
+ * @brief This is the code that measures the write bandwidth of the destination path and checks each observation can
+ *        be written at the rate it arrives (--disk-probe)
+ *
+ * Without this, the first sign that the destination path can't keep up with an observation is the ringbuffer
+ * filling up and the correlator dropping data. With --disk-probe=MB, a file of that size is written to the
+ * destination path with O_DIRECT (so it measures the disk, not the page cache) at startup, and then by a background
+ * thread every DISKPROBE_REFRESH_SECONDS. So that it doesn't compete with an observation for the disk, the thread
+ * waits for the end of any observation in progress, and abandons a measurement if one starts part way through. The
+ * thread reading the ringbuffer only ever reads the latest measurement, so it is never held up by one. At the start
+ * of every observation the sustained write rate it needs (its visibilities and weights per sub-observation, plus the
+ * HDUs of the active output options) is compared with the measured bandwidth. If it needs more, this is logged and
+ * sent in the health packets, and with --overload-policy=shed the optional outputs (flags, channel statistics and
+ * autocorrelation HDUs) are turned off for that observation.
+ */
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "diskprobe.h"
+#include "global.h"
+#include "trace.h"
+
+static const char *diskprobe_path = NULL;
+static uint64_t diskprobe_bytes = 0;
+static multilog_t *diskprobe_log = NULL;
+static double diskprobe_bytes_per_sec = 0; // Latest measurement. 0 == not measured
+static time_t diskprobe_last_attempt = 0;  // When it was last measured (or tried to be)
+static int diskprobe_in_observation = 0;   // 1 == an observation is being written, so don't measure
+static int diskprobe_stop = 0;
+static int diskprobe_thread_started = 0;
+static pthread_t diskprobe_thread;
+static pthread_mutex_t diskprobe_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t diskprobe_wake = PTHREAD_COND_INITIALIZER;
+
+/**
+ *
+ *  @brief Checks whether an observation is being written (see diskprobe_admit_observation()).
+ *  @returns 1 if it is, otherwise 0.
+ */
+static int diskprobe_observation_started()
+{
+  pthread_mutex_lock(&diskprobe_mutex);
+  int in_observation = diskprobe_in_observation;
+  pthread_mutex_unlock(&diskprobe_mutex);
+
+  return in_observation;
+}
+
+/**
+ *
+ *  @brief Measures the write bandwidth of a directory: writes bytes (rounded up to whole DISKPROBE_CHUNK_BYTES) of
+ *         incompressible data to a file with O_DIRECT, then syncs and deletes it. The first chunk is written before
+ *         the clock starts, so opening the file and the filesystem allocating its first extent are not included.
+ *         Filesystems without O_DIRECT (e.g. tmpfs) are written through the page cache and synced. If an observation
+ *         starts part way through, the measurement is abandoned between chunks.
+ *  @param[in] path The directory.
+ *  @param[in] bytes How much to write (at least DISKPROBE_CHUNK_BYTES are timed).
+ *  @param[out] bytes_per_sec The measured bandwidth.
+ *  @param[in] log The logger to use.
+ *  @returns EXIT_SUCCESS on success, or EXIT_FAILURE if there was an error or the measurement was abandoned.
+ */
+int diskprobe_measure(const char *path, uint64_t bytes, double *bytes_per_sec, multilog_t *log)
+{
+  char filename[PATH_MAX];
+  snprintf(filename, sizeof(filename), "%s/%s", path, DISKPROBE_FILENAME);
+
+  int direct = 1;
+  int fd = open(filename, O_WRONLY | O_CREAT | O_TRUNC | O_DIRECT, 0644);
+
+  if (fd < 0 && errno == EINVAL)
+  {
+    direct = 0;
+    fd = open(filename, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  }
+
+  if (fd < 0)
+  {
+    multilog(log, LOG_ERR, "diskprobe_measure(): Error creating %s: %s\n", filename, strerror(errno));
+    return EXIT_FAILURE;
+  }
+
+  void *buffer = NULL;
+
+  if (posix_memalign(&buffer, DISKPROBE_ALIGNMENT, DISKPROBE_CHUNK_BYTES) != 0)
+  {
+    multilog(log, LOG_ERR, "diskprobe_measure(): Error allocating %d bytes.\n", DISKPROBE_CHUNK_BYTES);
+    close(fd);
+    unlink(filename);
+    return EXIT_FAILURE;
+  }
+
+  // Random data (xorshift), so filesystems which compress or deduplicate can't make the disk look faster than it is
+  uint64_t state = 0x9e3779b97f4a7c15ul ^ (uint64_t)time(NULL);
+  uint64_t *words = (uint64_t *)buffer;
+
+  for (uint64_t i = 0; i < DISKPROBE_CHUNK_BYTES / sizeof(uint64_t); i++)
+  {
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    words[i] = state;
+  }
+
+  uint64_t chunks = (bytes + DISKPROBE_CHUNK_BYTES - 1) / DISKPROBE_CHUNK_BYTES;
+  int result = EXIT_SUCCESS;
+  uint64_t start_ns = 0;
+
+  for (uint64_t chunk = 0; chunk <= chunks && result == EXIT_SUCCESS; chunk++)
+  {
+    // Give way to an observation which has started since: the two would slow each other down and skew the measurement
+    if (diskprobe_observation_started())
+    {
+      multilog(log, LOG_INFO, "diskprobe_measure(): An observation has started. Abandoning the measurement of %s.\n", path);
+      result = EXIT_FAILURE;
+    }
+    else if (write(fd, buffer, DISKPROBE_CHUNK_BYTES) != DISKPROBE_CHUNK_BYTES)
+    {
+      multilog(log, LOG_ERR, "diskprobe_measure(): Error writing %s: %s\n", filename, strerror(errno));
+      result = EXIT_FAILURE;
+    }
+    else if (chunk == 0)
+    {
+      start_ns = metrics_now_ns();
+    }
+  }
+
+  if (result == EXIT_SUCCESS && fdatasync(fd) != 0)
+  {
+    multilog(log, LOG_ERR, "diskprobe_measure(): Error syncing %s: %s\n", filename, strerror(errno));
+    result = EXIT_FAILURE;
+  }
+
+  uint64_t elapsed_ns = metrics_now_ns() - start_ns;
+
+  close(fd);
+  unlink(filename);
+  free(buffer);
+
+  if (result == EXIT_SUCCESS)
+  {
+    *bytes_per_sec = (double)(chunks * DISKPROBE_CHUNK_BYTES) / ((elapsed_ns > 0 ? elapsed_ns : 1) / 1.0e9);
+
+    multilog(log, LOG_INFO, "diskprobe_measure(): %s can be written at %.1f MB/s (%lu MB%s in %.3f sec).\n", path, *bytes_per_sec / 1.0e6,
+             (chunks * DISKPROBE_CHUNK_BYTES) / (1024 * 1024), (direct ? " with O_DIRECT" : ", no O_DIRECT"), elapsed_ns / 1.0e9);
+  }
+
+  return result;
+}
+
+/**
+ *
+ *  @brief The disk probe thread: measures the bandwidth of the destination path every DISKPROBE_REFRESH_SECONDS, but
+ *         not while an observation is being written (it waits for it to end, and measures again as soon as one which
+ *         interrupted a measurement ends).
+ *  @param[in] args Not used.
+ *  @returns NULL.
+ */
+static void *diskprobe_thread_fn(void *args)
+{
+  (void)args;
+  trace_set_thread_name("disk probe");
+
+  pthread_mutex_lock(&diskprobe_mutex);
+
+  while (!diskprobe_stop)
+  {
+    time_t now = time(NULL);
+
+    if (diskprobe_in_observation || now < diskprobe_last_attempt + DISKPROBE_REFRESH_SECONDS)
+    {
+      // Sleep until the next measurement is due, or we are woken by the end of an observation (or to stop)
+      struct timespec until = {.tv_sec = (now < diskprobe_last_attempt + DISKPROBE_REFRESH_SECONDS ? diskprobe_last_attempt : now) + DISKPROBE_REFRESH_SECONDS, .tv_nsec = 0};
+      pthread_cond_timedwait(&diskprobe_wake, &diskprobe_mutex, &until);
+      continue;
+    }
+
+    diskprobe_last_attempt = now;
+    pthread_mutex_unlock(&diskprobe_mutex);
+
+    // If this fails the previous measurement is kept, and it is tried again in DISKPROBE_REFRESH_SECONDS
+    double bytes_per_sec = 0;
+
+    if (diskprobe_measure(diskprobe_path, diskprobe_bytes, &bytes_per_sec, diskprobe_log) == EXIT_SUCCESS)
+    {
+      health_manager_set_disk_bandwidth(bytes_per_sec);
+    }
+
+    pthread_mutex_lock(&diskprobe_mutex);
+
+    if (bytes_per_sec > 0)
+    {
+      diskprobe_bytes_per_sec = bytes_per_sec;
+    }
+    else if (diskprobe_in_observation)
+    {
+      // Abandoned for an observation, so it is due again as soon as that ends
+      diskprobe_last_attempt = 0;
+    }
+  }
+
+  pthread_mutex_unlock(&diskprobe_mutex);
+
+  return NULL;
+}
+
+/**
+ *
+ *  @brief Measures the bandwidth of the destination path, then starts the thread which measures it again every
+ *         DISKPROBE_REFRESH_SECONDS. Call before the first observation. A failed measurement is logged and tried again
+ *         by the thread.
+ *  @param[in] path The destination path.
+ *  @param[in] bytes How much to write to measure it (--disk-probe).
+ *  @param[in] log The logger to use.
+ *  @returns EXIT_SUCCESS on success, or EXIT_FAILURE if the thread could not be started.
+ */
+int diskprobe_init(const char *path, uint64_t bytes, multilog_t *log)
+{
+  diskprobe_path = path;
+  diskprobe_bytes = bytes;
+  diskprobe_log = log;
+  diskprobe_stop = 0;
+  diskprobe_in_observation = 0;
+  diskprobe_last_attempt = time(NULL);
+
+  if (diskprobe_measure(path, bytes, &diskprobe_bytes_per_sec, log) != EXIT_SUCCESS)
+  {
+    multilog(log, LOG_WARNING, "diskprobe_init(): WARNING: could not measure the bandwidth of %s. Trying again in %d seconds.\n", path, DISKPROBE_REFRESH_SECONDS);
+  }
+
+  health_manager_set_disk_bandwidth(diskprobe_bytes_per_sec);
+
+  if (pthread_create(&diskprobe_thread, NULL, diskprobe_thread_fn, NULL) != 0)
+  {
+    multilog(log, LOG_ERR, "diskprobe_init(): Error starting the disk probe thread.\n");
+    return EXIT_FAILURE;
+  }
+
+  diskprobe_thread_started = 1;
+
+  return EXIT_SUCCESS;
+}
+
+/**
+ *
+ *  @brief Returns the latest measured bandwidth of the destination path. This never waits for a measurement.
+ *  @returns The bandwidth in bytes per second, or 0 if it has not been measured.
+ */
+double diskprobe_bandwidth()
+{
+  pthread_mutex_lock(&diskprobe_mutex);
+  double bytes_per_sec = diskprobe_bytes_per_sec;
+  pthread_mutex_unlock(&diskprobe_mutex);
+
+  return bytes_per_sec;
+}
+
+/**
+ *
+ *  @brief Tells the disk probe thread an observation has ended (or been skipped), so it can measure again if due.
+ */
+void diskprobe_end_observation()
+{
+  pthread_mutex_lock(&diskprobe_mutex);
+  diskprobe_in_observation = 0;
+  pthread_cond_signal(&diskprobe_wake);
+  pthread_mutex_unlock(&diskprobe_mutex);
+}
+
+/**
+ *
+ *  @brief Stops the disk probe thread (waiting for a measurement in progress to finish). Safe to call if it was never
+ *         started.
+ */
+void diskprobe_destroy()
+{
+  if (!diskprobe_thread_started)
+  {
+    return;
+  }
+
+  pthread_mutex_lock(&diskprobe_mutex);
+  diskprobe_stop = 1;
+  pthread_cond_signal(&diskprobe_wake);
+  pthread_mutex_unlock(&diskprobe_mutex);
+
+  pthread_join(diskprobe_thread, NULL);
+  diskprobe_thread_started = 0;
+}
+
+/**
+ *
+ *  @brief Works out how many bytes each sub-observation of the current observation writes to the destination path:
+ *         its visibilities and weights, plus the header and padding of each HDU and the flags, channel statistics and
+ *         autocorrelation HDUs of the active output options. Call once the header has been read and the expected
+ *         transfer sizes worked out.
+ *  @param[in] client A pointer to the dada_client_t object.
+ *  @returns The number of bytes.
+ */
+uint64_t diskprobe_subobs_bytes(dada_client_t *client)
+{
+  assert(client != 0);
+  dada_db_s *ctx = (dada_db_s *)client->context;
+
+  uint64_t integrations = ctx->no_of_integrations_per_subobs;
+  uint64_t pols = (uint64_t)ctx->npol * ctx->npol;
+  uint64_t bytes = ctx->expected_transfer_size_of_subobs_plus_weights;
+
+  // Visibility and weights HDUs
+  bytes += (ctx->cube ? 2 : 2 * integrations) * DISKPROBE_FITS_HDU_OVERHEAD;
+
+  // Flags HDUs (bit packed fine channels of each baseline)
+  if (ctx->rfi_threshold > 0)
+  {
+    bytes += integrations * ((ctx->nbaselines * ((ctx->nfine_chan + 7) / 8)) + DISKPROBE_FITS_HDU_OVERHEAD);
+  }
+
+  // Channel statistics tables (mean, rms and max (float) and nnan (int32) of each fine channel and pol)
+  if (ctx->channel_stats)
+  {
+    bytes += integrations * ((ctx->nfine_chan * pols * (3 * sizeof(float) + sizeof(int32_t))) + DISKPROBE_FITS_HDU_OVERHEAD);
+  }
+
+  // Autocorrelations (complex floats of each tile, fine channel and pol), averaged over autos_average integrations
+  if (ctx->autos_average > 0)
+  {
+    uint64_t autos_hdus = (integrations + ctx->autos_average - 1) / ctx->autos_average;
+    bytes += autos_hdus * (((uint64_t)(ctx->ninputs / 2) * ctx->nfine_chan * pols * 2 * sizeof(float)) + DISKPROBE_FITS_HDU_OVERHEAD);
+  }
+
+  return bytes;
+}
+
+/**
+ *
+ *  @brief Works out the sustained rate the current observation will write to the destination path at: a
+ *         sub-observation's worth (see diskprobe_subobs_bytes()) every secs_per_subobs.
+ *  @param[in] client A pointer to the dada_client_t object.
+ *  @returns The rate in bytes per second.
+ */
+double diskprobe_required_rate(dada_client_t *client)
+{
+  assert(client != 0);
+  dada_db_s *ctx = (dada_db_s *)client->context;
+
+  return (double)diskprobe_subobs_bytes(client) / ctx->secs_per_subobs;
+}
+
+/**
+ *
+ *  @brief Checks the new observation can be written at the rate it arrives (if --disk-probe): compares the latest
+ *         measured bandwidth with the rate the observation needs, and holds off (or abandons) the next measurement
+ *         until the observation ends (see diskprobe_end_observation()). If it needs more, this is logged and, with
+ *         OVERLOAD_POLICY_SHED, the optional outputs are turned off for this observation (they are turned back on at
+ *         the start of every observation, before this check). Call once the header has been read and validated, and
+ *         before the buffers of the optional outputs are set up.
+ *  @param[in] client A pointer to the dada_client_t object.
+ *  @returns EXIT_SUCCESS. If the bandwidth has never been measured, the observation is not checked.
+ */
+int diskprobe_admit_observation(dada_client_t *client)
+{
+  assert(client != 0);
+  dada_db_s *ctx = (dada_db_s *)client->context;
+  multilog_t *log = (multilog_t *)ctx->log;
+
+  // Start from the output options as given on the command line
+  ctx->rfi_threshold = ctx->configured_rfi_threshold;
+  ctx->channel_stats = ctx->configured_channel_stats;
+  ctx->autos_average = ctx->configured_autos_average;
+
+  ctx->required_bytes_per_sec = diskprobe_required_rate(client);
+  ctx->disk_state = DISKPROBE_STATE_UNKNOWN;
+
+  if (ctx->disk_probe_bytes == 0)
+  {
+    return EXIT_SUCCESS;
+  }
+
+  pthread_mutex_lock(&diskprobe_mutex);
+  diskprobe_in_observation = 1;
+  ctx->disk_bytes_per_sec = diskprobe_bytes_per_sec;
+  pthread_mutex_unlock(&diskprobe_mutex);
+
+  if (ctx->disk_bytes_per_sec <= 0)
+  {
+    return EXIT_SUCCESS;
+  }
+
+  double headroom = (ctx->disk_bytes_per_sec / ctx->required_bytes_per_sec) - 1.0;
+
+  if (headroom >= 0)
+  {
+    ctx->disk_state = DISKPROBE_STATE_OK;
+    multilog(log, LOG_INFO, "dada_dbfits_open(): Observation needs %.1f MB/s of the %.1f MB/s the destination path can be written at (%.0f%% headroom).\n",
+             ctx->required_bytes_per_sec / 1.0e6, ctx->disk_bytes_per_sec / 1.0e6, headroom * 100.0);
+    return EXIT_SUCCESS;
+  }
+
+  multilog(log, LOG_WARNING, "dada_dbfits_open(): WARNING: Observation needs %.1f MB/s but the destination path can only be written at %.1f MB/s (%.0f%% headroom). The ringbuffer is likely to fill up!\n",
+           ctx->required_bytes_per_sec / 1.0e6, ctx->disk_bytes_per_sec / 1.0e6, headroom * 100.0);
+  ctx->disk_state = DISKPROBE_STATE_OVERLOADED;
+
+  if (ctx->overload_policy == OVERLOAD_POLICY_SHED && (ctx->rfi_threshold > 0 || ctx->channel_stats || ctx->autos_average > 0))
+  {
+    ctx->rfi_threshold = 0;
+    ctx->channel_stats = 0;
+    ctx->autos_average = 0;
+    ctx->required_bytes_per_sec = diskprobe_required_rate(client);
+    ctx->disk_state = DISKPROBE_STATE_SHED;
+
+    multilog(log, LOG_WARNING, "dada_dbfits_open(): Turned off the flags, channel statistics and autocorrelation outputs for this observation. It now needs %.1f MB/s.\n",
+             ctx->required_bytes_per_sec / 1.0e6);
+  }
+
+  return EXIT_SUCCESS;
+}
+
+/**
+ *
+ *  @brief Returns the name of a DISKPROBE_STATE_..., for the log.
+ *  @param[in] state The state.
+ *  @returns The name of the state.
+ */
+const char *diskprobe_state_name(int state)
+{
+  switch (state)
+  {
+  case DISKPROBE_STATE_OK:
+    return "ok";
+  case DISKPROBE_STATE_OVERLOADED:
+    return "overloaded";
+  case DISKPROBE_STATE_SHED:
+    return "shed";
+  default:
+    return "unknown";
+  }
+}
\ No newline at end of file
@@ -0,0 +1,34 @@
+/**
+ * @file diskprobe.h
+ * @author Greg Sleap
+ * @date 18 Oct 2026
+ * @brief This is the header for the code that measures the write bandwidth of the destination path and checks each
+ *        observation can be written at the rate it arrives (--disk-probe)
+ *
+ */
+#pragma once
+
+#include <stdint.h>
+#include "dada_client.h"
+#include "multilog.h"
+
+#define DISKPROBE_FILENAME ".mwax_db2fits_diskprobe.tmp" // Written and deleted in the destination path to measure it
+#define DISKPROBE_CHUNK_BYTES (4 * 1024 * 1024)          // Size of each write (a multiple of any O_DIRECT alignment)
+#define DISKPROBE_ALIGNMENT 4096                         // Alignment of the write buffer for O_DIRECT
+#define DISKPROBE_REFRESH_SECONDS 600                    // The disk probe thread measures again this often (waiting for the end of any observation)
+#define DISKPROBE_FITS_HDU_OVERHEAD 5760                 // Bytes to allow for the header and padding of each HDU (2 fits blocks)
+
+#define DISKPROBE_STATE_UNKNOWN 0    // Not measured (--disk-probe not given), or not in an observation
+#define DISKPROBE_STATE_OK 1         // The observation needs less than the measured bandwidth
+#define DISKPROBE_STATE_OVERLOADED 2 // ... needs more, and is being written as is (OVERLOAD_POLICY_WARN)
+#define DISKPROBE_STATE_SHED 3       // ... needed more, so the optional outputs are off for it (OVERLOAD_POLICY_SHED)
+
+int diskprobe_measure(const char *path, uint64_t bytes, double *bytes_per_sec, multilog_t *log);
+int diskprobe_init(const char *path, uint64_t bytes, multilog_t *log);
+double diskprobe_bandwidth();
+void diskprobe_end_observation();
+void diskprobe_destroy();
+uint64_t diskprobe_subobs_bytes(dada_client_t *client);
+double diskprobe_required_rate(dada_client_t *client);
+int diskprobe_admit_observation(dada_client_t *client);
+const char *diskprobe_state_name(int state);
\ No newline at end of file
@@ -0,0 +1,287 @@
+/**
+ * @file file_source.c
+ * @author Greg Sleap
+ * @date 18 Oct 2026
+ * @brief This is the code that replays .dada files through the dada client callbacks, without ringbuffers
+ *
+ * A .dada file is a psrdada ascii header (HDR_SIZE bytes, normally 4096) followed by the data of one sub-observation,
+ * as written by dada_dbdisk or the test data generators in tests/. Each file is memory mapped and passed, one
+ * integration at a time and without copying, to the same open/io/close callbacks dada_client_read() calls.
+ */
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "ascii_header.h"
+#include "dada_def.h"
+#include "file_source.h"
+#include "../mwax_common/mwax_global_defs.h" // From mwax-common
+#include "global.h"
+
+// Files in an input directory with these extensions are replayed
+static const char *file_source_extensions[] = {".dada", ".dat"};
+
+/**
+ *
+ *  @brief scandir() filter for the files in an input directory that should be replayed.
+ *  @param[in] entry The directory entry.
+ *  @returns 1 if the entry has one of the file_source_extensions, otherwise 0.
+ */
+static int is_replay_file(const struct dirent *entry)
+{
+  const char *extension = strrchr(entry->d_name, '.');
+
+  if (extension == NULL)
+  {
+    return 0;
+  }
+
+  for (size_t i = 0; i < sizeof(file_source_extensions) / sizeof(file_source_extensions[0]); i++)
+  {
+    if (strcmp(extension, file_source_extensions[i]) == 0)
+    {
+      return 1;
+    }
+  }
+
+  return 0;
+}
+
+/**
+ *
+ *  @brief Passes madvise() advice for a range of a mapping that may not start on a page boundary.
+ *  @param[in] mapping The start of the mapping.
+ *  @param[in] offset Offset of the range from the start of the mapping.
+ *  @param[in] length Length of the range in bytes.
+ *  @param[in] advice The madvise() advice, e.g. MADV_WILLNEED.
+ */
+static void advise_range(char *mapping, uint64_t offset, uint64_t length, int advice)
+{
+  uint64_t page_size = sysconf(_SC_PAGESIZE);
+  uint64_t page_offset = offset - (offset % page_size);
+
+  madvise(mapping + page_offset, length + (offset - page_offset), advice);
+}
+
+/**
+ *
+ *  @brief Replays a .dada file, or every .dada/.dat file in a directory in name order, through the client's callbacks.
+ *  @param[in] client A pointer to the dada_client_t object, with its open, io and close functions set.
+ *  @param[in] path The file or directory to replay.
+ *  @returns EXIT_SUCCESS when every file has been replayed (or a quit was requested), or -1 if there was an error.
+ */
+int file_source_read(dada_client_t *client, const char *path)
+{
+  multilog_t *log = client->log;
+
+  struct stat path_stat;
+
+  if (stat(path, &path_stat) != 0)
+  {
+    multilog(log, LOG_ERR, "file_source_read(): Error reading %s: %s.\n", path, strerror(errno));
+    return -1;
+  }
+
+  if (!S_ISDIR(path_stat.st_mode))
+  {
+    return file_source_read_file(client, path);
+  }
+
+  struct dirent **entries = NULL;
+  int count = scandir(path, &entries, is_replay_file, alphasort);
+
+  if (count < 0)
+  {
+    multilog(log, LOG_ERR, "file_source_read(): Error reading directory %s: %s.\n", path, strerror(errno));
+    return -1;
+  }
+
+  multilog(log, LOG_INFO, "file_source_read(): Replaying %d files from %s.\n", count, path);
+
+  int result = EXIT_SUCCESS;
+
+  for (int i = 0; i < count; i++)
+  {
+    if (result == EXIT_SUCCESS && !quit_get())
+    {
+      char filename[PATH_MAX];
+      snprintf(filename, PATH_MAX, "%s/%s", path, entries[i]->d_name);
+
+      result = file_source_read_file(client, filename);
+    }
+
+    free(entries[i]);
+  }
+
+  free(entries);
+
+  return result;
+}
+
+/**
+ *
+ *  @brief Replays one .dada file through the client's callbacks: open with its header, io for each integration in
+ *         turn (straight from the mapped file, like a ringbuffer block), then close.
+ *  @param[in] client A pointer to the dada_client_t object, with its open, io and close functions set.
+ *  @param[in] filename The file to replay.
+ *  @returns EXIT_SUCCESS on success (including a QUIT header, which requests a quit), or -1 if there was an error.
+ */
+int file_source_read_file(dada_client_t *client, const char *filename)
+{
+  dada_db_s *ctx = (dada_db_s *)client->context;
+  multilog_t *log = client->log;
+
+  int fd = open(filename, O_RDONLY);
+
+  if (fd < 0)
+  {
+    multilog(log, LOG_ERR, "file_source_read_file(): Error opening %s: %s.\n", filename, strerror(errno));
+    return -1;
+  }
+
+  struct stat file_stat;
+
+  if (fstat(fd, &file_stat) != 0 || !S_ISREG(file_stat.st_mode) || file_stat.st_size == 0)
+  {
+    multilog(log, LOG_ERR, "file_source_read_file(): %s is not a regular file, or is empty.\n", filename);
+    close(fd);
+    return -1;
+  }
+
+  uint64_t file_size = file_stat.st_size;
+
+  // Private, so nothing the pipeline does to a buffer can change the file. Pages are only read as they are needed
+  char *mapping = mmap(NULL, file_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+  close(fd);
+
+  if (mapping == MAP_FAILED)
+  {
+    multilog(log, LOG_ERR, "file_source_read_file(): Error mapping %s: %s.\n", filename, strerror(errno));
+    return -1;
+  }
+
+  madvise(mapping, file_size, MADV_SEQUENTIAL);
+
+  // The header is DADA_DEFAULT_HEADER_SIZE bytes, unless its HDR_SIZE says otherwise
+  uint64_t header_size = (file_size < DADA_DEFAULT_HEADER_SIZE ? file_size : DADA_DEFAULT_HEADER_SIZE);
+  char *header = calloc(header_size + 1, 1);
+
+  if (header == NULL)
+  {
+    multilog(log, LOG_ERR, "file_source_read_file(): Error allocating memory for the header of %s.\n", filename);
+    munmap(mapping, file_size);
+    return -1;
+  }
+
+  memcpy(header, mapping, header_size);
+
+  uint64_t hdr_size = 0;
+
+  if (ascii_header_get(header, "HDR_SIZE", "%lu", &hdr_size) == 1 && hdr_size != header_size)
+  {
+    if (hdr_size > file_size)
+    {
+      multilog(log, LOG_ERR, "file_source_read_file(): HDR_SIZE of %s (%lu bytes) is larger than the file (%lu bytes).\n", filename, hdr_size, file_size);
+      free(header);
+      munmap(mapping, file_size);
+      return -1;
+    }
+
+    header_size = hdr_size;
+    free(header);
+    header = calloc(header_size + 1, 1);
+
+    if (header == NULL)
+    {
+      multilog(log, LOG_ERR, "file_source_read_file(): Error allocating memory for the header of %s.\n", filename);
+      munmap(mapping, file_size);
+      return -1;
+    }
+
+    memcpy(header, mapping, header_size);
+  }
+
+  uint64_t data_size = file_size - header_size;
+
+  multilog(log, LOG_INFO, "file_source_read_file(): Replaying %s (%lu byte header, %lu bytes of data).\n", filename, header_size, data_size);
+
+  client->header = header;
+  client->header_size = header_size;
+
+  // Each integration is passed to io on its own, so everything after the header is the largest possible "block"
+  ctx->block_size = data_size;
+
+  int result = EXIT_SUCCESS;
+
+  if (client->open_function(client) < 0)
+  {
+    if (is_mwax_mode_quit(ctx->mode) == 1)
+    {
+      multilog(log, LOG_INFO, "file_source_read_file(): %s is a QUIT header.\n", filename);
+      quit_set(1);
+    }
+    else
+    {
+      multilog(log, LOG_ERR, "file_source_read_file(): Error opening %s.\n", filename);
+      result = -1;
+    }
+  }
+  else
+  {
+    // Observations that are being skipped (or are not correlator observations) are passed on in one go
+    uint64_t integration_size = data_size;
+
+    if (is_mwax_mode_correlator(ctx->mode) == 1 && ctx->obs_id != 0)
+    {
+      integration_size = ctx->expected_transfer_size_of_integration_plus_weights;
+    }
+
+    uint64_t offset = 0;
+
+    while (integration_size > 0 && offset + integration_size <= data_size && !quit_get())
+    {
+      // Start reading the next integration while this one is processed
+      if (offset + 2 * integration_size <= data_size)
+      {
+        advise_range(mapping, header_size + offset + integration_size, integration_size, MADV_WILLNEED);
+      }
+
+      if (client->io_function(client, mapping + header_size + offset, integration_size) < 0)
+      {
+        multilog(log, LOG_ERR, "file_source_read_file(): Error processing the data at offset %lu of %s.\n", header_size + offset, filename);
+        result = -1;
+        break;
+      }
+
+      // ... and drop this one from the mapping, so replaying a large file does not grow our resident memory
+      advise_range(mapping, header_size + offset, integration_size, MADV_DONTNEED);
+
+      offset += integration_size;
+    }
+
+    if (result == EXIT_SUCCESS && offset < data_size && !quit_get())
+    {
+      multilog(log, LOG_WARNING, "file_source_read_file(): The last %lu bytes of %s are less than an integration and were ignored.\n", data_size - offset, filename);
+    }
+
+    if (client->close_function(client, offset) < 0)
+    {
+      multilog(log, LOG_ERR, "file_source_read_file(): Error closing %s.\n", filename);
+      result = -1;
+    }
+  }
+
+  client->header = NULL;
+  client->header_size = 0;
+  free(header);
+  munmap(mapping, file_size);
+
+  return result;
+}
\ No newline at end of file
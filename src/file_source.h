@@ -0,0 +1,13 @@
+/**
+ * @file file_source.h
+ * @author Greg Sleap
+ * @date 18 Oct 2026
+ * @brief This is the header for the code that replays .dada files through the dada client callbacks, without ringbuffers
+ *
+ */
+#pragma once
+
+#include "dada_client.h"
+
+int file_source_read(dada_client_t *client, const char *path);
+int file_source_read_file(dada_client_t *client, const char *filename);
\ No newline at end of file
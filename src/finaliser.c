@@ -0,0 +1,260 @@
+/**
+ * @file finaliser.c
+ * @author Greg Sleap
+ * @date 18 Oct 2026
+ * @brief This is the code that closes and renames fits files on a separate thread (--async-close)
+ *
+ * Closing a fits file flushes cfitsio's buffers and (if it is good) renames it from .tmp to .fits, which on a busy
+ * or network filesystem can take milliseconds. With --async-close the thread reading the ringbuffer just queues the
+ * file here and carries on with the next observation. Files are closed in the order they were queued.
+ */
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "finaliser.h"
+#include "fitswriter.h"
+#include "global.h"
+#include "hdu_index.h"
+#include "journal.h"
+#include "metrics.h"
+#include "trace.h"
+
+typedef struct
+{
+  fitsfile *fptr;
+  int fits_is_good;
+  char temp_filename[TEMP_FITS_FILENAME_LEN];
+  char filename[FITS_FILENAME_LEN];
+  uint64_t *integration_usec; // UNIX time (usec) of each integration in the file, for the end to end latency
+  uint64_t integration_count;
+  int has_index;      // 1 == write index as the .idx sidecar once the file is renamed
+  hdu_index_s index;
+  journal_s journal;  // The file's journal (if open): removed once the file is renamed (or deleted), then closed
+  int record_metrics; // 1 == record the close latency and end to end latency (the visibilities file, not the autos)
+} finaliser_job_s;
+
+static finaliser_job_s finaliser_queue[FINALISER_QUEUE_LEN];
+static int finaliser_head = 0;  // Next job to close
+static int finaliser_count = 0; // Jobs queued (including the one being closed)
+static int finaliser_stop = 0;
+static int finaliser_failed = 0; // 1 == a close failed since the last finaliser_submit()
+static multilog_t *finaliser_log = NULL;
+static pthread_t finaliser_thread;
+static pthread_mutex_t finaliser_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t finaliser_queued = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t finaliser_done = PTHREAD_COND_INITIALIZER;
+
+/**
+ *
+ *  @brief The finaliser thread: closes (and renames or deletes) each queued fits file in turn.
+ *  @param[in] args Not used.
+ *  @returns NULL.
+ */
+static void *finaliser_thread_fn(void *args)
+{
+  (void)args;
+  trace_set_thread_name("fits finaliser");
+
+  pthread_mutex_lock(&finaliser_mutex);
+
+  while (1)
+  {
+    while (finaliser_count == 0 && !finaliser_stop)
+    {
+      pthread_cond_wait(&finaliser_queued, &finaliser_mutex);
+    }
+
+    if (finaliser_count == 0)
+    {
+      break;
+    }
+
+    // The job stays in the queue (so its slot is not reused) until it is done
+    finaliser_job_s *job = &finaliser_queue[finaliser_head];
+    pthread_mutex_unlock(&finaliser_mutex);
+
+    uint64_t close_start_ns = metrics_now_ns();
+    TRACE_BEGIN("close_fits");
+    int result = close_and_rename_fits(finaliser_log, &job->fptr, job->fits_is_good, job->temp_filename, job->filename);
+    TRACE_END("close_fits");
+
+    if (result == EXIT_SUCCESS && job->journal.fd >= 0)
+    {
+      journal_remove(job->filename, finaliser_log);
+    }
+
+    journal_close(&job->journal);
+
+    if (result == EXIT_SUCCESS && job->has_index && job->fits_is_good == 1)
+    {
+      result = hdu_index_write(&job->index, job->filename, finaliser_log);
+    }
+
+    if (result == EXIT_SUCCESS && job->record_metrics)
+    {
+      metrics_record_latency(METRICS_LATENCY_CLOSE_FITS, close_start_ns);
+
+      if (job->fits_is_good == 1)
+      {
+        uint64_t now_usec = metrics_unix_time_usec();
+
+        for (uint64_t i = 0; i < job->integration_count; i++)
+        {
+          metrics_record_latency_usec(METRICS_LATENCY_DATA_TO_FITS, (now_usec > job->integration_usec[i] ? now_usec - job->integration_usec[i] : 0));
+        }
+      }
+    }
+
+    free(job->integration_usec);
+    job->integration_usec = NULL;
+    hdu_index_free(&job->index);
+
+    pthread_mutex_lock(&finaliser_mutex);
+
+    if (result != EXIT_SUCCESS)
+    {
+      multilog(finaliser_log, LOG_ERR, "finaliser: Error closing %s.\n", job->temp_filename);
+      finaliser_failed = 1;
+    }
+
+    finaliser_head = (finaliser_head + 1) % FINALISER_QUEUE_LEN;
+    finaliser_count--;
+    pthread_cond_broadcast(&finaliser_done);
+  }
+
+  pthread_mutex_unlock(&finaliser_mutex);
+
+  return NULL;
+}
+
+/**
+ *
+ *  @brief Starts the finaliser thread. cfitsio must be built reentrant, as files are closed while others are written.
+ *  @param[in] log The logger to use.
+ *  @returns EXIT_SUCCESS on success, or EXIT_FAILURE if there was an error.
+ */
+int finaliser_init(multilog_t *log)
+{
+  finaliser_log = log;
+
+  if (!fits_is_reentrant())
+  {
+    multilog(log, LOG_ERR, "finaliser_init(): cfitsio was not built reentrant (--enable-reentrant), so fits files cannot be closed on another thread.\n");
+    return EXIT_FAILURE;
+  }
+
+  finaliser_head = 0;
+  finaliser_count = 0;
+  finaliser_stop = 0;
+  finaliser_failed = 0;
+
+  if (pthread_create(&finaliser_thread, NULL, finaliser_thread_fn, NULL) != 0)
+  {
+    multilog(log, LOG_ERR, "finaliser_init(): Error starting the finaliser thread.\n");
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
+
+/**
+ *
+ *  @brief Queues a fits file to be closed, and then renamed (if it is good) or deleted. Waits if the queue is full.
+ *  @param[in] fptr The fits file. The caller must not use it again.
+ *  @param[in] fits_is_good 1 == good, complete file: close and rename it. 0 == delete it.
+ *  @param[in] temp_filename The name it was created with.
+ *  @param[in] filename The name to rename it to.
+ *  @param[in] integration_usec UNIX time (usec) of each integration in the file (copied), or NULL.
+ *  @param[in] integration_count Number of elements in integration_usec.
+ *  @param[in] index The HDU offsets to write as the file's .idx sidecar once it is renamed (copied), or NULL.
+ *  @param[in,out] journal The file's open journal (--journal), to remove once it is renamed or deleted, or NULL. Once
+ *                 queued, the finaliser thread owns it (and its lock) and *journal is left closed.
+ *  @param[in] record_metrics 1 == record the close latency and (once renamed) the end to end latency of each integration.
+ *  @returns EXIT_SUCCESS on success, or -1 if there was an error (including a previously queued file failing to close).
+ */
+int finaliser_submit(fitsfile *fptr, int fits_is_good, const char *temp_filename, const char *filename,
+                     const uint64_t *integration_usec, uint64_t integration_count, const hdu_index_s *index,
+                     journal_s *journal, int record_metrics)
+{
+  uint64_t *integration_usec_copy = NULL;
+  hdu_index_s index_copy = {0};
+
+  if (index != NULL && hdu_index_copy(&index_copy, index) != EXIT_SUCCESS)
+  {
+    multilog(finaliser_log, LOG_ERR, "finaliser_submit(): Error allocating memory for the index of %s.\n", temp_filename);
+    return -1;
+  }
+
+  if (integration_count > 0)
+  {
+    integration_usec_copy = malloc(integration_count * sizeof(uint64_t));
+
+    if (integration_usec_copy == NULL)
+    {
+      multilog(finaliser_log, LOG_ERR, "finaliser_submit(): Error allocating memory for %s.\n", temp_filename);
+      hdu_index_free(&index_copy);
+      return -1;
+    }
+
+    memcpy(integration_usec_copy, integration_usec, integration_count * sizeof(uint64_t));
+  }
+
+  pthread_mutex_lock(&finaliser_mutex);
+
+  while (finaliser_count == FINALISER_QUEUE_LEN)
+  {
+    pthread_cond_wait(&finaliser_done, &finaliser_mutex);
+  }
+
+  finaliser_job_s *job = &finaliser_queue[(finaliser_head + finaliser_count) % FINALISER_QUEUE_LEN];
+  job->fptr = fptr;
+  job->fits_is_good = fits_is_good;
+  strncpy(job->temp_filename, temp_filename, TEMP_FITS_FILENAME_LEN - 1);
+  job->temp_filename[TEMP_FITS_FILENAME_LEN - 1] = '\0';
+  strncpy(job->filename, filename, FITS_FILENAME_LEN - 1);
+  job->filename[FITS_FILENAME_LEN - 1] = '\0';
+  job->integration_usec = integration_usec_copy;
+  job->integration_count = (integration_usec_copy == NULL ? 0 : integration_count);
+  job->has_index = (index != NULL);
+  job->index = index_copy;
+  journal_init(&job->journal);
+
+  if (journal != NULL)
+  {
+    job->journal = *journal;
+    journal_init(journal);
+  }
+
+  job->record_metrics = record_metrics;
+  finaliser_count++;
+
+  // A failure is reported (once) to the next caller, as the caller of the failed close has already moved on
+  int failed = finaliser_failed;
+  finaliser_failed = 0;
+
+  pthread_cond_signal(&finaliser_queued);
+  pthread_mutex_unlock(&finaliser_mutex);
+
+  if (failed)
+  {
+    multilog(finaliser_log, LOG_ERR, "finaliser_submit(): A previously queued fits file could not be closed.\n");
+    return -1;
+  }
+
+  return EXIT_SUCCESS;
+}
+
+/**
+ *
+ *  @brief Closes every queued fits file, then stops the finaliser thread.
+ */
+void finaliser_destroy()
+{
+  pthread_mutex_lock(&finaliser_mutex);
+  finaliser_stop = 1;
+  pthread_cond_signal(&finaliser_queued);
+  pthread_mutex_unlock(&finaliser_mutex);
+
+  pthread_join(finaliser_thread, NULL);
+}
\ No newline at end of file
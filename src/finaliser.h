@@ -0,0 +1,22 @@
+/**
+ * @file finaliser.h
+ * @author Greg Sleap
+ * @date 18 Oct 2026
+ * @brief This is the header for the code that closes and renames fits files on a separate thread (--async-close)
+ *
+ */
+#pragma once
+
+#include <stdint.h>
+#include "fitsio.h"
+#include "hdu_index.h"
+#include "journal.h"
+#include "multilog.h"
+
+#define FINALISER_QUEUE_LEN 16 // Files waiting to be closed. Once full, the thread reading the ringbuffer waits
+
+int finaliser_init(multilog_t *log);
+int finaliser_submit(fitsfile *fptr, int fits_is_good, const char *temp_filename, const char *filename,
+                     const uint64_t *integration_usec, uint64_t integration_count, const hdu_index_s *index,
+                     journal_s *journal, int record_metrics);
+void finaliser_destroy();
\ No newline at end of file
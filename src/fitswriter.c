@@ -11,10 +11,17 @@
 #include <stdio.h>
 #include <string.h>
 
+#include "finaliser.h"
 #include "fitswriter.h"
 #include "fitswriter.h"
 #include "global.h"
+#include "hdu_index.h"
+#include "journal.h"
+#include "warmup.h"
+#include "metrics.h"
 #include "multilog.h"
+#include "probes.h"
+#include "trace.h"
 #include "utils.h"
 #include "version.h"
 
@@ -24,9 +31,11 @@
  *  @param[in] client A pointer to the dada_client_t object.
  *  @param[out] fptr pointer to the pointer of the fitsfile created.
  *  @param[in] filename Full path and name of the fits file to create.
+ *  @param[in] data_format_comment1 First comment describing the layout of the HDUs which will follow.
+ *  @param[in] data_format_comment2 Second comment describing the layout of the HDUs which will follow (or NULL).
  *  @returns EXIT_SUCCESS on success, or -1 if there was an error.
  */
-int create_fits(dada_client_t *client, fitsfile **fptr, const char *filename)
+static int create_fits_file(dada_client_t *client, fitsfile **fptr, const char *filename, const char *data_format_comment1, const char *data_format_comment2)
 {
   assert(client != 0);
   dada_db_s *ctx = (dada_db_s *)client->context;
@@ -148,7 +157,7 @@ int create_fits(dada_client_t *client, fitsfile **fptr, const char *filename)
   }
 
   // Data format comment1
-  if (fits_write_comment(*fptr, "Visibilities: 1 integration per HDU: [baseline][finechan][pol][r,i]", &status))
+  if (fits_write_comment(*fptr, data_format_comment1, &status))
   {
     char error_text[30] = "";
     fits_get_errstatus(status, error_text);
@@ -157,12 +166,15 @@ int create_fits(dada_client_t *client, fitsfile **fptr, const char *filename)
   }
 
   // Data format comment2
-  if (fits_write_comment(*fptr, "Weights: 1 integration per HDU: [baseline][pol][weight]", &status))
+  if (data_format_comment2 != NULL)
   {
-    char error_text[30] = "";
-    fits_get_errstatus(status, error_text);
-    multilog(log, LOG_ERR, "create_fits(): Error writing visibility format comment to file %s. Error: %d -- %s\n", filename, status, error_text);
-    return -1;
+    if (fits_write_comment(*fptr, data_format_comment2, &status))
+    {
+      char error_text[30] = "";
+      fits_get_errstatus(status, error_text);
+      multilog(log, LOG_ERR, "create_fits(): Error writing visibility format comment to file %s. Error: %d -- %s\n", filename, status, error_text);
+      return -1;
+    }
   }
 
   // MARKER
@@ -306,21 +318,159 @@ int create_fits(dada_client_t *client, fitsfile **fptr, const char *filename)
 
 /**
  *
- *  @brief Closes the fits file, and renames it to remove the .tmp extension.
+ *  @brief Creates a blank new visibilities fits file called 'filename' and populates it with data from the psrdada header.
  *  @param[in] client A pointer to the dada_client_t object.
- *  @param[in,out] fptr Pointer to a pointer to the fitsfile structure.
- *  @param[in] fits_is_good integer indicating if we have a complete, good fits file. 0 == Not good- do not rename- instead delete, 1 == Good, complete FITS file. Close and do rename.
- *  @returns EXIT_SUCCESS on success, or EXIT_FAILURE if there was an error.
+ *  @param[out] fptr pointer to the pointer of the fitsfile created.
+ *  @param[in] filename Full path and name of the fits file to create.
+ *  @returns EXIT_SUCCESS on success, or -1 if there was an error.
  */
-int close_fits(dada_client_t *client, fitsfile **fptr, int fits_is_good)
+int create_fits(dada_client_t *client, fitsfile **fptr, const char *filename)
 {
   assert(client != 0);
   dada_db_s *ctx = (dada_db_s *)client->context;
 
   assert(ctx->log != 0);
-  multilog_t *log = (multilog_t *)ctx->log;
+  multilog_t *log = (multilog_t *)client->log;
+  uint64_t start_ns = MWAX_PROBE_START_NS(create_fits);
+
+  int status = 0;
+
+  const char *vis_format_comment = (ctx->vis_layout == VIS_LAYOUT_FINECHAN_MAJOR ? "Visibilities: 1 integration per HDU: [finechan][baseline][pol][r,i]"
+                                                                                 : "Visibilities: 1 integration per HDU: [baseline][finechan][pol][r,i]");
+  const char *weights_format_comment = "Weights: 1 integration per HDU: [baseline][pol][weight]";
+
+  if (ctx->cube)
+  {
+    vis_format_comment = (ctx->vis_layout == VIS_LAYOUT_FINECHAN_MAJOR ? "Visibilities: 1 sub-observation per HDU: [time][finechan][baseline][pol][r,i]"
+                                                                       : "Visibilities: 1 sub-observation per HDU: [time][baseline][finechan][pol][r,i]");
+    weights_format_comment = "Weights: 1 sub-observation per HDU: [time][baseline][pol][weight]";
+  }
+
+  if (create_fits_file(client, fptr, filename, vis_format_comment, weights_format_comment))
+  {
+    return -1;
+  }
+
+  // VISORDER
+  char vis_order[FLEN_VALUE];
+  strncpy(vis_order, vis_layout_name(ctx->vis_layout), FLEN_VALUE - 1);
+  vis_order[FLEN_VALUE - 1] = '\0';
+
+  if (fits_write_key(*fptr, TSTRING, MWA_FITS_KEY_VISORDER, vis_order, "Order of visibility axes (slowest to fastest)", &status))
+  {
+    char error_text[30] = "";
+    fits_get_errstatus(status, error_text);
+    multilog(log, LOG_ERR, "create_fits(): Error writing fits key: %s to file %s. Error: %d -- %s\n", MWA_FITS_KEY_VISORDER, filename, status, error_text);
+    return -1;
+  }
+
+  // CUBE
+  if (ctx->cube)
+  {
+    int cube = TRUE;
+
+    if (fits_write_key(*fptr, TLOGICAL, MWA_FITS_KEY_CUBE, &(cube), "Each HDU holds every integration of a sub-observation", &status))
+    {
+      char error_text[30] = "";
+      fits_get_errstatus(status, error_text);
+      multilog(log, LOG_ERR, "create_fits(): Error writing fits key: %s to file %s. Error: %d -- %s\n", MWA_FITS_KEY_CUBE, filename, status, error_text);
+      return -1;
+    }
+  }
+
+  if (ctx->rfi_threshold > 0)
+  {
+    // Data format comment3
+    if (fits_write_comment(*fptr, "Flags: 1 integration per HDU: [baseline][finechan/8] bit packed, LSB first", &status))
+    {
+      char error_text[30] = "";
+      fits_get_errstatus(status, error_text);
+      multilog(log, LOG_ERR, "create_fits(): Error writing flags format comment to file %s. Error: %d -- %s\n", filename, status, error_text);
+      return -1;
+    }
+
+    // RFITHRSH
+    float rfi_threshold = ctx->rfi_threshold;
+
+    if (fits_write_key(*fptr, TFLOAT, MWA_FITS_KEY_RFI_THRESHOLD, &(rfi_threshold), "RFI flagging threshold (sigma from median)", &status))
+    {
+      char error_text[30] = "";
+      fits_get_errstatus(status, error_text);
+      multilog(log, LOG_ERR, "create_fits(): Error writing fits key: %s to file %s. Error: %d -- %s\n", MWA_FITS_KEY_RFI_THRESHOLD, filename, status, error_text);
+      return -1;
+    }
+  }
+
+  // Compress the image HDUs which follow (the space policy turns this on for observations which won't fit otherwise).
+  // Not quantising the floats keeps it lossless.
+  if (ctx->compression_mode == COMPRESSION_MODE_GZIP)
+  {
+    if (fits_set_compression_type(*fptr, GZIP_2, &status) || fits_set_quantize_level(*fptr, 0.0, &status))
+    {
+      char error_text[30] = "";
+      fits_get_errstatus(status, error_text);
+      multilog(log, LOG_ERR, "create_fits(): Error setting compression of file %s. Error: %d -- %s\n", filename, status, error_text);
+      return -1;
+    }
+  }
+
+  MWAX_PROBE3(create_fits, ctx->obs_id, filename, MWAX_PROBE_ELAPSED_NS(start_ns));
+
+  return (EXIT_SUCCESS);
+}
+
+/**
+ *
+ *  @brief Creates a blank new autocorrelation (sidecar) fits file called 'filename' and populates it with data from the psrdada header.
+ *  @param[in] client A pointer to the dada_client_t object.
+ *  @param[out] fptr pointer to the pointer of the fitsfile created.
+ *  @param[in] filename Full path and name of the fits file to create.
+ *  @returns EXIT_SUCCESS on success, or -1 if there was an error.
+ */
+int create_autos_fits(dada_client_t *client, fitsfile **fptr, const char *filename)
+{
+  assert(client != 0);
+  dada_db_s *ctx = (dada_db_s *)client->context;
+
+  assert(ctx->log != 0);
+  multilog_t *log = (multilog_t *)client->log;
+
+  int status = 0;
+
+  if (create_fits_file(client, fptr, filename, "Autocorrelations: NAVERAGE integrations per HDU: [tile][finechan][pol][r,i]", NULL))
+  {
+    return -1;
+  }
+
+  // NAVERAGE
+  int naverage = ctx->autos_average;
+
+  if (fits_write_key(*fptr, TINT, MWA_FITS_KEY_NAVERAGE, &(naverage), "Integrations averaged into each HDU", &status))
+  {
+    char error_text[30] = "";
+    fits_get_errstatus(status, error_text);
+    multilog(log, LOG_ERR, "create_autos_fits(): Error writing fits key: %s to file %s. Error: %d -- %s\n", MWA_FITS_KEY_NAVERAGE, filename, status, error_text);
+    return -1;
+  }
+
+  return (EXIT_SUCCESS);
+}
 
+/**
+ *
+ *  @brief Closes a fits file, and renames it from temp_filename to filename (i.e. removes the .tmp extension). A
+ *         failed rename is an error, as the complete file is still only in temp_filename.
+ *  @param[in] log A pointer to the logger.
+ *  @param[in,out] fptr Pointer to a pointer to the fitsfile structure.
+ *  @param[in] fits_is_good integer indicating if we have a complete, good fits file. 0 == Not good- do not rename- instead delete, 1 == Good, complete FITS file. Close and do rename.
+ *  @param[in] temp_filename The name the fits file was created with.
+ *  @param[in] filename The name the fits file should have once it is complete.
+ *  @returns EXIT_SUCCESS on success, or EXIT_FAILURE if there was an error.
+ */
+int close_and_rename_fits(multilog_t *log, fitsfile **fptr, int fits_is_good, const char *temp_filename, const char *filename)
+{
   multilog(log, LOG_DEBUG, "close_fits(): Starting.\n");
+  uint64_t start_ns = MWAX_PROBE_START_NS(close_fits);
 
   int status = 0;
 
@@ -366,19 +516,114 @@ int close_fits(dada_client_t *client, fitsfile **fptr, int fits_is_good)
   // We should now rename it to .fits so it is picked up for archiving
   if (fits_is_good == 1)
   {
-    if (rename(ctx->temp_fits_filename, ctx->fits_filename) == 0)
+    TRACE_BEGIN("rename");
+    int rename_result = rename(temp_filename, filename);
+    TRACE_END("rename");
+
+    if (rename_result == 0)
     {
-      multilog(log, LOG_INFO, "close_fits(): rename of %s to %s successful.\n", ctx->temp_fits_filename, ctx->fits_filename);
+      multilog(log, LOG_INFO, "close_fits(): rename of %s to %s successful.\n", temp_filename, filename);
     }
     else
     {
-      multilog(log, LOG_ERR, "close_fits(): ERROR renaming %s to %s.\n", ctx->temp_fits_filename, ctx->fits_filename);
+      multilog(log, LOG_ERR, "close_fits(): ERROR renaming %s to %s: %s\n", temp_filename, filename, strerror(errno));
+      return EXIT_FAILURE;
     }
   }
 
+  MWAX_PROBE3(close_fits, filename, fits_is_good, MWAX_PROBE_ELAPSED_NS(start_ns));
+
   return (EXIT_SUCCESS);
 }
 
+/**
+ *
+ *  @brief Closes the fits file, and renames it to remove the .tmp extension, then removes its journal (if --journal)
+ *         and writes its .idx sidecar (if --hdu-index). With --async-close this is all queued for the finaliser
+ *         thread, which also records the close and end to end latencies once it is done. If the file can't be closed
+ *         and renamed its journal is kept, so the next run can recover the .tmp file.
+ *  @param[in] client A pointer to the dada_client_t object.
+ *  @param[in,out] fptr Pointer to a pointer to the fitsfile structure.
+ *  @param[in] fits_is_good integer indicating if we have a complete, good fits file. 0 == Not good- do not rename- instead delete, 1 == Good, complete FITS file. Close and do rename.
+ *  @returns EXIT_SUCCESS on success, or EXIT_FAILURE (-1 if queued) if there was an error.
+ */
+int close_fits(dada_client_t *client, fitsfile **fptr, int fits_is_good)
+{
+  assert(client != 0);
+  dada_db_s *ctx = (dada_db_s *)client->context;
+
+  assert(ctx->log != 0);
+  multilog_t *log = (multilog_t *)ctx->log;
+
+  const hdu_index_s *index = (ctx->hdu_index_enabled ? &ctx->hdu_index : NULL);
+
+  // Give back the disk space reserved for it (with --preallocate) which it did not use. If this fails the file is still
+  // good, it just takes up more space than it needs to.
+  if (ctx->preallocate && fits_is_good == 1)
+  {
+    warmup_release_fits(client, *fptr);
+  }
+
+  // Nothing more is journalled, but the journal stays open (and locked) until the file has been renamed (or deleted),
+  // so a run recovering the directory leaves it alone. With --async-close the finaliser thread takes it over.
+  if (ctx->async_close)
+  {
+    int result = finaliser_submit(*fptr, fits_is_good, ctx->temp_fits_filename, ctx->fits_filename, ctx->file_integration_usec, ctx->file_integration_count, index,
+                                  (ctx->journal_enabled ? &ctx->journal : NULL), 1);
+    journal_close(&ctx->journal);
+    *fptr = NULL;
+    return result;
+  }
+
+  int result = close_and_rename_fits(log, fptr, fits_is_good, ctx->temp_fits_filename, ctx->fits_filename);
+
+  if (result == EXIT_SUCCESS && ctx->journal_enabled)
+  {
+    journal_remove(ctx->fits_filename, log);
+  }
+
+  journal_close(&ctx->journal);
+
+  if (result != EXIT_SUCCESS)
+  {
+    return EXIT_FAILURE;
+  }
+
+  // The index is only written once the fits file it describes is complete
+  if (index != NULL && fits_is_good == 1)
+  {
+    return hdu_index_write(index, ctx->fits_filename, log);
+  }
+
+  return EXIT_SUCCESS;
+}
+
+/**
+ *
+ *  @brief Closes the autocorrelation fits file, and renames it to remove the .tmp extension.
+ *  @param[in] client A pointer to the dada_client_t object.
+ *  @param[in,out] fptr Pointer to a pointer to the fitsfile structure.
+ *  @param[in] fits_is_good integer indicating if we have a complete, good fits file. 0 == Not good- do not rename- instead delete, 1 == Good, complete FITS file. Close and do rename.
+ *  @returns EXIT_SUCCESS on success, or EXIT_FAILURE if there was an error.
+ */
+int close_autos_fits(dada_client_t *client, fitsfile **fptr, int fits_is_good)
+{
+  assert(client != 0);
+  dada_db_s *ctx = (dada_db_s *)client->context;
+
+  assert(ctx->log != 0);
+  multilog_t *log = (multilog_t *)ctx->log;
+
+  if (ctx->async_close)
+  {
+    int result = finaliser_submit(*fptr, fits_is_good, ctx->temp_autos_fits_filename, ctx->autos_fits_filename, NULL, 0, NULL, 0, 0);
+    *fptr = NULL;
+    return result;
+  }
+
+  return close_and_rename_fits(log, fptr, fits_is_good, ctx->temp_autos_fits_filename, ctx->autos_fits_filename);
+}
+
 /**
  *
  *  @brief Opens a fits file for reading.
@@ -422,10 +667,13 @@ int open_fits(dada_client_t *client, fitsfile **fptr, const char *filename)
  *  @param[in] int_time The integration time of the observation (milliseconds).
  *  @param[in] buffer The pointer to the data to write into the HDU.
  *  @param[in] bytes The number of bytes in the buffer to write.
+ *  @param[in] nonfinite The number of NaN/Inf values in the buffer.
+ *  @param[in] zero_baselines The number of baselines in the buffer with zero power.
  *  @returns EXIT_SUCCESS on success, or EXIT_FAILURE if there was an error.
  */
 int create_fits_visibilities_imghdu(dada_client_t *client, fitsfile *fptr, time_t unix_time, int unix_millisecond_time, int marker,
-                                    int baselines, int fine_channels, int polarisations, float *buffer, uint64_t bytes)
+                                    int baselines, int fine_channels, int polarisations, float *buffer, uint64_t bytes,
+                                    uint64_t nonfinite, uint64_t zero_baselines)
 {
   //
   // Each imagehdu will be [baseline][freq][pols][real][imaginary] for an integration
@@ -468,11 +716,17 @@ int create_fits_visibilities_imghdu(dada_client_t *client, fitsfile *fptr, time_
   //  2    128
   //  ...
   //
+  //  If the frequency-major layout (VIS_LAYOUT_FINECHAN_MAJOR) is selected, the buffer has already been transposed
+  //  to [finechan][baseline][pol][r,i], so:
+  //  NAXIS1 = BASELINES * NPOL * NPOL * 2 (real/imag)
+  //  NAXIS2 = FINE_CHAN
+  //
   assert(client != 0);
   dada_db_s *ctx = (dada_db_s *)client->context;
 
   assert(ctx->log != 0);
   multilog_t *log = (multilog_t *)ctx->log;
+  uint64_t start_ns = MWAX_PROBE_START_NS(vis_hdu_write);
 
   int status = 0;
   int bitpix = FLOAT_IMG; // complex(r,i)  = 2x4 bytes
@@ -480,6 +734,12 @@ int create_fits_visibilities_imghdu(dada_client_t *client, fitsfile *fptr, time_
   uint64_t axis1_rows = fine_channels * polarisations * polarisations * 2; //  we x2 as we store real and imaginary;
   uint64_t axis2_cols = baselines;
 
+  if (ctx->vis_layout == VIS_LAYOUT_FINECHAN_MAJOR)
+  {
+    axis1_rows = (uint64_t)baselines * polarisations * polarisations * 2;
+    axis2_cols = fine_channels;
+  }
+
   long naxes[2] = {axis1_rows, axis2_cols};
 
   multilog(log, LOG_DEBUG, "create_fits_visibilities_imghdu(): Creating new visibility HDU in fits file with dimensions %lld x %lld...\n", (long long)axis1_rows, (long long)axis2_cols);
@@ -526,6 +786,28 @@ int create_fits_visibilities_imghdu(dada_client_t *client, fitsfile *fptr, time_
     return EXIT_FAILURE;
   }
 
+  // NNONFIN
+  long nnonfinite = (long)nonfinite;
+
+  if (fits_write_key(fptr, TLONG, MWA_FITS_KEY_NNONFINITE, &nnonfinite, (char *)"Number of NaN/Inf values", &status))
+  {
+    char error_text[30] = "";
+    fits_get_errstatus(status, error_text);
+    multilog(log, LOG_ERR, "create_fits_visibilities_imghdu(): Error writing key %s into visibility HDU. Error: %d -- %s\n", MWA_FITS_KEY_NNONFINITE, status, error_text);
+    return EXIT_FAILURE;
+  }
+
+  // NZEROBL
+  long nzero_baselines = (long)zero_baselines;
+
+  if (fits_write_key(fptr, TLONG, MWA_FITS_KEY_NZERO_BASELINES, &nzero_baselines, (char *)"Number of baselines with zero power", &status))
+  {
+    char error_text[30] = "";
+    fits_get_errstatus(status, error_text);
+    multilog(log, LOG_ERR, "create_fits_visibilities_imghdu(): Error writing key %s into visibility HDU. Error: %d -- %s\n", MWA_FITS_KEY_NZERO_BASELINES, status, error_text);
+    return EXIT_FAILURE;
+  }
+
   /* Write the array */
   long nelements = bytes / (abs(bitpix) / 8);
 
@@ -546,6 +828,8 @@ int create_fits_visibilities_imghdu(dada_client_t *client, fitsfile *fptr, time_
     return EXIT_FAILURE;
   }
 
+  MWAX_PROBE4(vis_hdu_write, ctx->obs_id, marker, bytes, MWAX_PROBE_ELAPSED_NS(start_ns));
+
   return EXIT_SUCCESS;
 }
 
@@ -583,6 +867,7 @@ int create_fits_weights_imghdu(dada_client_t *client, fitsfile *fptr, time_t uni
 
   assert(ctx->log != 0);
   multilog_t *log = (multilog_t *)ctx->log;
+  uint64_t start_ns = MWAX_PROBE_START_NS(weights_hdu_write);
 
   int status = 0;
   int bitpix = FLOAT_IMG; // complex(r,i)  = 2x4 bytes
@@ -656,5 +941,651 @@ int create_fits_weights_imghdu(dada_client_t *client, fitsfile *fptr, time_t uni
     return EXIT_FAILURE;
   }
 
+  MWAX_PROBE4(weights_hdu_write, ctx->obs_id, marker, bytes, MWAX_PROBE_ELAPSED_NS(start_ns));
+
+  return EXIT_SUCCESS;
+}
+
+/**
+ *
+ *  @brief Creates a new visibility cube IMGHDU in an existing fits file, to hold every integration of a sub-observation.
+ *         The integrations are written into it one at a time, as they arrive, with write_fits_visibilities_cube_plane().
+ *  @param[in] client A pointer to the dada_client_t object.
+ *  @param[in] fptr Pointer to the fits file we will write to.
+ *  @param[in] unix_time The Unix time of the first integration / timestep in the cube.
+ *  @param[in] unix_millisecond_time Number of milliseconds since the last integer of unix_time.
+ *  @param[in] marker The marker of the first integration / timestep in the cube (0 based).
+ *  @param[in] integrations The number of integrations in the cube.
+ *  @param[in] baselines The number of baselines in the data (used to calculate number of elements).
+ *  @param[in] fine_channels The number of fine channels (used to calculate number of elements).
+ *  @param[in] polarisations The number of pols in each antenna-normally 2 (used to calculate number of elements).
+ *  @returns EXIT_SUCCESS on success, or EXIT_FAILURE if there was an error.
+ */
+int create_fits_visibilities_cube_imghdu(dada_client_t *client, fitsfile *fptr, time_t unix_time, int unix_millisecond_time, int marker,
+                                         int integrations, int baselines, int fine_channels, int polarisations)
+{
+  // NAXIS1 and NAXIS2 are as for a visibility HDU (see create_fits_visibilities_imghdu()), and:
+  // NAXIS3 = INTEGRATIONS
+  //
+  // So each integration is a contiguous plane of the cube, in time order.
+  //
+  assert(client != 0);
+  dada_db_s *ctx = (dada_db_s *)client->context;
+
+  assert(ctx->log != 0);
+  multilog_t *log = (multilog_t *)ctx->log;
+
+  int status = 0;
+  int bitpix = FLOAT_IMG; // complex(r,i)  = 2x4 bytes
+  long naxis = 3;
+  uint64_t axis1_rows = fine_channels * polarisations * polarisations * 2; //  we x2 as we store real and imaginary;
+  uint64_t axis2_cols = baselines;
+
+  if (ctx->vis_layout == VIS_LAYOUT_FINECHAN_MAJOR)
+  {
+    axis1_rows = (uint64_t)baselines * polarisations * polarisations * 2;
+    axis2_cols = fine_channels;
+  }
+
+  long naxes[3] = {axis1_rows, axis2_cols, integrations};
+
+  multilog(log, LOG_DEBUG, "create_fits_visibilities_cube_imghdu(): Creating new visibility cube HDU in fits file with dimensions %lld x %lld x %d...\n", (long long)axis1_rows, (long long)axis2_cols, integrations);
+
+  // Create new IMGHDU
+  if (fits_create_img(fptr, bitpix, naxis, naxes, &status))
+  {
+    char error_text[30] = "";
+    fits_get_errstatus(status, error_text);
+    multilog(log, LOG_ERR, "create_fits_visibilities_cube_imghdu(): Error creating visibility cube ImgHDU in fits file. Error: %d -- %s\n", status, error_text);
+    return EXIT_FAILURE;
+  }
+
+  // TIME  - cotter uses this to align each channel
+  char key_time[FLEN_KEYWORD] = "TIME";
+
+  if (fits_write_key(fptr, TLONG, key_time, &unix_time, (char *)"Unix time (seconds) of the first integration", &status))
+  {
+    char error_text[30] = "";
+    fits_get_errstatus(status, error_text);
+    multilog(log, LOG_ERR, "create_fits_visibilities_cube_imghdu(): Error writing key %s into visibility cube HDU. Error: %d -- %s\n", key_time, status, error_text);
+    return EXIT_FAILURE;
+  }
+
+  // MILLITIME - provides millisecond component of TIME
+  char key_millitim[FLEN_KEYWORD] = "MILLITIM";
+
+  if (fits_update_key(fptr, TINT, key_millitim, &unix_millisecond_time, (char *)"Milliseconds since TIME", &status))
+  {
+    char error_text[30] = "";
+    fits_get_errstatus(status, error_text);
+    multilog(log, LOG_ERR, "create_fits_visibilities_cube_imghdu(): Error writing %s into visibility cube HDU. Error: %d -- %s\n", key_millitim, status, error_text);
+    return EXIT_FAILURE;
+  }
+
+  // MARKER
+  char key_marker[FLEN_KEYWORD] = "MARKER";
+
+  if (fits_write_key(fptr, TINT, key_marker, &marker, (char *)"Data offset marker of the first integration", &status))
+  {
+    char error_text[30] = "";
+    fits_get_errstatus(status, error_text);
+    multilog(log, LOG_ERR, "create_fits_visibilities_cube_imghdu(): Error writing key %s into visibility cube HDU. Error: %d -- %s\n", key_marker, status, error_text);
+    return EXIT_FAILURE;
+  }
+
+  // NNONFIN and NZEROBL - these are not known until every integration has been written, see update_fits_bad_data_keys()
+  long zero = 0;
+
+  if (fits_write_key(fptr, TLONG, MWA_FITS_KEY_NNONFINITE, &zero, (char *)"Number of NaN/Inf values", &status))
+  {
+    char error_text[30] = "";
+    fits_get_errstatus(status, error_text);
+    multilog(log, LOG_ERR, "create_fits_visibilities_cube_imghdu(): Error writing key %s into visibility cube HDU. Error: %d -- %s\n", MWA_FITS_KEY_NNONFINITE, status, error_text);
+    return EXIT_FAILURE;
+  }
+
+  if (fits_write_key(fptr, TLONG, MWA_FITS_KEY_NZERO_BASELINES, &zero, (char *)"Number of baselines with zero power", &status))
+  {
+    char error_text[30] = "";
+    fits_get_errstatus(status, error_text);
+    multilog(log, LOG_ERR, "create_fits_visibilities_cube_imghdu(): Error writing key %s into visibility cube HDU. Error: %d -- %s\n", MWA_FITS_KEY_NZERO_BASELINES, status, error_text);
+    return EXIT_FAILURE;
+  }
+
   return EXIT_SUCCESS;
 }
+
+/**
+ *
+ *  @brief Writes one integration into the visibility cube IMGHDU created by create_fits_visibilities_cube_imghdu(), which
+ *         must still be the current HDU.
+ *  @param[in] client A pointer to the dada_client_t object.
+ *  @param[in] fptr Pointer to the fits file we will write to.
+ *  @param[in] integration Which integration (plane) of the cube this is (0 based).
+ *  @param[in] marker The artificial counter we use to keep track of which integration/timestep this is within the observation (0 based).
+ *  @param[in] buffer The pointer to the visibilities of the integration.
+ *  @param[in] bytes The number of bytes in the buffer to write (one plane of the cube).
+ *  @returns EXIT_SUCCESS on success, or EXIT_FAILURE if there was an error.
+ */
+int write_fits_visibilities_cube_plane(dada_client_t *client, fitsfile *fptr, int integration, int marker, float *buffer, uint64_t bytes)
+{
+  assert(client != 0);
+  dada_db_s *ctx = (dada_db_s *)client->context;
+
+  assert(ctx->log != 0);
+  multilog_t *log = (multilog_t *)ctx->log;
+  uint64_t start_ns = MWAX_PROBE_START_NS(vis_hdu_write);
+
+  int status = 0;
+  LONGLONG nelements = bytes / sizeof(float);
+  LONGLONG first_element = ((LONGLONG)integration * nelements) + 1;
+
+  if (fits_write_img(fptr, TFLOAT, first_element, nelements, buffer, &status))
+  {
+    char error_text[30] = "";
+    fits_get_errstatus(status, error_text);
+    multilog(log, LOG_ERR, "write_fits_visibilities_cube_plane(): Error writing integration %d into visibility cube HDU in fits file. Error: %d -- %s\n", integration, status, error_text);
+    return EXIT_FAILURE;
+  }
+
+  MWAX_PROBE4(vis_hdu_write, ctx->obs_id, marker, bytes, MWAX_PROBE_ELAPSED_NS(start_ns));
+
+  return EXIT_SUCCESS;
+}
+
+/**
+ *
+ *  @brief Updates the bad data counts (NNONFIN and NZEROBL) of the current HDU, e.g. once every integration of a visibility cube has been written.
+ *  @param[in] client A pointer to the dada_client_t object.
+ *  @param[in] fptr Pointer to the fits file we will write to.
+ *  @param[in] nonfinite The number of NaN/Inf values.
+ *  @param[in] zero_baselines The number of baselines with zero power.
+ *  @returns EXIT_SUCCESS on success, or EXIT_FAILURE if there was an error.
+ */
+int update_fits_bad_data_keys(dada_client_t *client, fitsfile *fptr, uint64_t nonfinite, uint64_t zero_baselines)
+{
+  assert(client != 0);
+  dada_db_s *ctx = (dada_db_s *)client->context;
+
+  assert(ctx->log != 0);
+  multilog_t *log = (multilog_t *)ctx->log;
+
+  int status = 0;
+  long nnonfinite = (long)nonfinite;
+  long nzero_baselines = (long)zero_baselines;
+
+  if (fits_update_key(fptr, TLONG, MWA_FITS_KEY_NNONFINITE, &nnonfinite, (char *)"Number of NaN/Inf values", &status) ||
+      fits_update_key(fptr, TLONG, MWA_FITS_KEY_NZERO_BASELINES, &nzero_baselines, (char *)"Number of baselines with zero power", &status))
+  {
+    char error_text[30] = "";
+    fits_get_errstatus(status, error_text);
+    multilog(log, LOG_ERR, "update_fits_bad_data_keys(): Error updating bad data keys. Error: %d -- %s\n", status, error_text);
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
+
+/**
+ *
+ *  @brief Creates a new weights cube IMGHDU, holding the weights of every integration of a sub-observation, in an existing fits file.
+ *  @param[in] client A pointer to the dada_client_t object.
+ *  @param[in] fptr Pointer to the fits file we will write to.
+ *  @param[in] unix_time The Unix time of the first integration / timestep in the cube.
+ *  @param[in] unix_millisecond_time Number of milliseconds since the last integer of unix_time.
+ *  @param[in] marker The marker of the first integration / timestep in the cube (0 based).
+ *  @param[in] integrations The number of integrations in the cube.
+ *  @param[in] baselines The number of baselines in the data (used to calculate number of elements).
+ *  @param[in] polarisations The number of pols in each antenna-normally 2 (used to calculate number of elements).
+ *  @param[in] buffer The pointer to the weights to write into the HDU: [time][baseline][pol].
+ *  @param[in] bytes The number of bytes in the buffer to write.
+ *  @returns EXIT_SUCCESS on success, or EXIT_FAILURE if there was an error.
+ */
+int create_fits_weights_cube_imghdu(dada_client_t *client, fitsfile *fptr, time_t unix_time, int unix_millisecond_time, int marker,
+                                    int integrations, int baselines, int polarisations, float *buffer, uint64_t bytes)
+{
+  // NAXIS1 = NPOL * NPOL
+  // NAXIS2 = BASELINES
+  // NAXIS3 = INTEGRATIONS
+  //
+  assert(client != 0);
+  dada_db_s *ctx = (dada_db_s *)client->context;
+
+  assert(ctx->log != 0);
+  multilog_t *log = (multilog_t *)ctx->log;
+  uint64_t start_ns = MWAX_PROBE_START_NS(weights_hdu_write);
+
+  int status = 0;
+  int bitpix = FLOAT_IMG;
+  long naxis = 3;
+  uint64_t axis1_rows = polarisations * polarisations;
+  uint64_t axis2_cols = baselines;
+
+  long naxes[3] = {axis1_rows, axis2_cols, integrations};
+
+  multilog(log, LOG_DEBUG, "create_fits_weights_cube_imghdu(): Creating new weights cube HDU in fits file with dimensions %lld x %lld x %d...\n", (long long)axis1_rows, (long long)axis2_cols, integrations);
+
+  // Create new IMGHDU
+  if (fits_create_img(fptr, bitpix, naxis, naxes, &status))
+  {
+    char error_text[30] = "";
+    fits_get_errstatus(status, error_text);
+    multilog(log, LOG_ERR, "create_fits_weights_cube_imghdu(): Error creating weights cube ImgHDU in fits file. Error: %d -- %s\n", status, error_text);
+    return EXIT_FAILURE;
+  }
+
+  // TIME
+  char key_time[FLEN_KEYWORD] = "TIME";
+
+  if (fits_write_key(fptr, TLONG, key_time, &unix_time, (char *)"Unix time (seconds) of the first integration", &status))
+  {
+    char error_text[30] = "";
+    fits_get_errstatus(status, error_text);
+    multilog(log, LOG_ERR, "create_fits_weights_cube_imghdu(): Error writing key %s into weights cube HDU. Error: %d -- %s\n", key_time, status, error_text);
+    return EXIT_FAILURE;
+  }
+
+  // MILLITIME - provides millisecond component of TIME
+  char key_millitim[FLEN_KEYWORD] = "MILLITIM";
+
+  if (fits_update_key(fptr, TINT, key_millitim, &unix_millisecond_time, (char *)"Milliseconds since TIME", &status))
+  {
+    char error_text[30] = "";
+    fits_get_errstatus(status, error_text);
+    multilog(log, LOG_ERR, "create_fits_weights_cube_imghdu(): Error writing key %s into weights cube HDU. Error: %d -- %s\n", key_millitim, status, error_text);
+    return EXIT_FAILURE;
+  }
+
+  // MARKER
+  char key_marker[FLEN_KEYWORD] = "MARKER";
+
+  if (fits_write_key(fptr, TINT, key_marker, &marker, (char *)"Data offset marker of the first integration", &status))
+  {
+    char error_text[30] = "";
+    fits_get_errstatus(status, error_text);
+    multilog(log, LOG_ERR, "create_fits_weights_cube_imghdu(): Error writing key %s into weights cube HDU. Error: %d -- %s\n", key_marker, status, error_text);
+    return EXIT_FAILURE;
+  }
+
+  // Check that number of elements * bytes per element matches what we expect
+  long nelements = bytes / (abs(bitpix) / 8);
+  u_int64_t expected_bytes = (axis1_rows * axis2_cols * integrations * (abs(bitpix) / 8));
+
+  if (bytes != expected_bytes)
+  {
+    multilog(log, LOG_ERR, "create_fits_weights_cube_imghdu(): Weights cube HDU bytes (%lu bytes) does not match calculated size from header parameters (%lu bytes).\n", bytes, expected_bytes);
+    return EXIT_FAILURE;
+  }
+
+  // Actually write the HDU data
+  if (fits_write_img(fptr, TFLOAT, 1, nelements, buffer, &status))
+  {
+    char error_text[30] = "";
+    fits_get_errstatus(status, error_text);
+    multilog(log, LOG_ERR, "create_fits_weights_cube_imghdu(): Error writing data into weights cube HDU in fits file. Error: %d -- %s\n", status, error_text);
+    return EXIT_FAILURE;
+  }
+
+  MWAX_PROBE4(weights_hdu_write, ctx->obs_id, marker, bytes, MWAX_PROBE_ELAPSED_NS(start_ns));
+
+  return EXIT_SUCCESS;
+}
+
+/**
+ *
+ *  @brief Creates a new (RFI) flags IMGHDU in an existing fits file.
+ *  @param[in] client A pointer to the dada_client_t object.
+ *  @param[in] fptr Pointer to the fits file we will write to.
+ *  @param[in] unix_time The Unix time for this integration / timestep.
+ *  @param[in] unix_millisecond_time Number of milliseconds since the last integer of unix_time.
+ *  @param[in] marker The artificial counter we use to keep track of which integration/timestep this is within the observation (0 based).
+ *  @param[in] baselines The number of baselines in the data (used to calculate number of elements).
+ *  @param[in] fine_channels The number of fine channels (used to calculate number of elements).
+ *  @param[in] buffer The pointer to the bit packed flags to write into the HDU.
+ *  @param[in] bytes The number of bytes in the buffer to write.
+ *  @param[in] flagged The number of baseline/fine channels flagged in this integration.
+ *  @returns EXIT_SUCCESS on success, or EXIT_FAILURE if there was an error.
+ */
+int create_fits_flags_imghdu(dada_client_t *client, fitsfile *fptr, time_t unix_time, int unix_millisecond_time, int marker,
+                             int baselines, int fine_channels, unsigned char *buffer, uint64_t bytes, uint64_t flagged)
+{
+  // NAXIS1 = (FINE_CHAN + 7) / 8 - fine channel f is bit (f % 8) of byte (f / 8), LSB first. 1 == flagged
+  // NAXIS2 = BASELINES
+  //
+  //           Flags
+  // Baseline  Ch01-08  Ch09-16 ...
+  //    1-1    byte     byte
+  //    1-2    byte     byte
+  //    ...
+  //
+  assert(client != 0);
+  dada_db_s *ctx = (dada_db_s *)client->context;
+
+  assert(ctx->log != 0);
+  multilog_t *log = (multilog_t *)ctx->log;
+  uint64_t start_ns = MWAX_PROBE_START_NS(flags_hdu_write);
+
+  int status = 0;
+  int bitpix = BYTE_IMG;
+  long naxis = 2;
+  uint64_t axis1_rows = (fine_channels + 7) / 8;
+  uint64_t axis2_cols = baselines;
+
+  long naxes[2] = {axis1_rows, axis2_cols};
+
+  multilog(log, LOG_DEBUG, "create_fits_flags_imghdu(): Creating new flags HDU in fits file with dimensions %lld x %lld...\n", (long long)axis1_rows, (long long)axis2_cols);
+
+  // Create new IMGHDU
+  if (fits_create_img(fptr, bitpix, naxis, naxes, &status))
+  {
+    char error_text[30] = "";
+    fits_get_errstatus(status, error_text);
+    multilog(log, LOG_ERR, "create_fits_flags_imghdu(): Error creating flags ImgHDU in fits file. Error: %d -- %s\n", status, error_text);
+    return EXIT_FAILURE;
+  }
+
+  // TIME
+  char key_time[FLEN_KEYWORD] = "TIME";
+
+  if (fits_write_key(fptr, TLONG, key_time, &unix_time, (char *)"Unix time (seconds)", &status))
+  {
+    char error_text[30] = "";
+    fits_get_errstatus(status, error_text);
+    multilog(log, LOG_ERR, "create_fits_flags_imghdu(): Error writing key %s into flags HDU. Error: %d -- %s\n", key_time, status, error_text);
+    return EXIT_FAILURE;
+  }
+
+  // MILLITIME - provides millisecond component of TIME
+  char key_millitim[FLEN_KEYWORD] = "MILLITIM";
+
+  if (fits_update_key(fptr, TINT, key_millitim, &unix_millisecond_time, (char *)"Milliseconds since TIME", &status))
+  {
+    char error_text[30] = "";
+    fits_get_errstatus(status, error_text);
+    multilog(log, LOG_ERR, "create_fits_flags_imghdu(): Error writing key %s into flags HDU. Error: %d -- %s\n", key_millitim, status, error_text);
+    return EXIT_FAILURE;
+  }
+
+  // MARKER
+  char key_marker[FLEN_KEYWORD] = "MARKER";
+
+  if (fits_write_key(fptr, TINT, key_marker, &marker, (char *)"Data offset marker (all channels should match)", &status))
+  {
+    char error_text[30] = "";
+    fits_get_errstatus(status, error_text);
+    multilog(log, LOG_ERR, "create_fits_flags_imghdu(): Error writing key %s into flags HDU. Error: %d -- %s\n", key_marker, status, error_text);
+    return EXIT_FAILURE;
+  }
+
+  // NFLAGGED
+  long nflagged = (long)flagged;
+
+  if (fits_write_key(fptr, TLONG, MWA_FITS_KEY_NFLAGGED, &nflagged, (char *)"Number of baseline/fine channels flagged", &status))
+  {
+    char error_text[30] = "";
+    fits_get_errstatus(status, error_text);
+    multilog(log, LOG_ERR, "create_fits_flags_imghdu(): Error writing key %s into flags HDU. Error: %d -- %s\n", MWA_FITS_KEY_NFLAGGED, status, error_text);
+    return EXIT_FAILURE;
+  }
+
+  // Check that number of elements * bytes per element matches what we expect
+  u_int64_t expected_bytes = axis1_rows * axis2_cols;
+  if (bytes != expected_bytes)
+  {
+    multilog(log, LOG_ERR, "create_fits_flags_imghdu(): Flags HDU bytes (%lu bytes) does not match calculated size from header parameters (%lu bytes).\n", bytes, expected_bytes);
+    return EXIT_FAILURE;
+  }
+
+  // Actually write the HDU data
+  if (fits_write_img(fptr, TBYTE, 1, bytes, buffer, &status))
+  {
+    char error_text[30] = "";
+    fits_get_errstatus(status, error_text);
+    multilog(log, LOG_ERR, "create_fits_flags_imghdu(): Error writing data into flags HDU in fits file. Error: %d -- %s\n", status, error_text);
+    return EXIT_FAILURE;
+  }
+
+  MWAX_PROBE4(flags_hdu_write, ctx->obs_id, marker, bytes, MWAX_PROBE_ELAPSED_NS(start_ns));
+
+  return EXIT_SUCCESS;
+}
+
+/**
+ *
+ *  @brief Creates a new autocorrelations IMGHDU in an existing (sidecar) fits file.
+ *  @param[in] client A pointer to the dada_client_t object.
+ *  @param[in] fptr Pointer to the fits file we will write to.
+ *  @param[in] unix_time The Unix time of the first integration / timestep averaged into this HDU.
+ *  @param[in] unix_millisecond_time Number of milliseconds since the last integer of unix_time.
+ *  @param[in] marker The marker of the first integration / timestep averaged into this HDU (0 based).
+ *  @param[in] naverage The number of integrations averaged into this HDU.
+ *  @param[in] tiles The number of tiles in the data (used to calculate number of elements).
+ *  @param[in] fine_channels The number of fine channels (used to calculate number of elements).
+ *  @param[in] polarisations The number of pols in each antenna-normally 2 (used to calculate number of elements).
+ *  @param[in] buffer The pointer to the data to write into the HDU.
+ *  @param[in] bytes The number of bytes in the buffer to write.
+ *  @returns EXIT_SUCCESS on success, or EXIT_FAILURE if there was an error.
+ */
+int create_fits_autos_imghdu(dada_client_t *client, fitsfile *fptr, time_t unix_time, int unix_millisecond_time, int marker, int naverage,
+                             int tiles, int fine_channels, int polarisations, float *buffer, uint64_t bytes)
+{
+  // NAXIS1 = FINE_CHAN * NPOL * NPOL * 2 (real/imag)
+  // NAXIS2 = TILES
+  //
+  //           Freq/Pol
+  // Tile      Ch01xx  Ch01xy  Ch01yx  Ch01yy  Ch02xx  Ch02xy  Ch02yx  Ch02yy ...
+  //    1      r,i     r,i     r,i     r,i     r,i     r,i     r,i     r,i    ...
+  //    2      r,i     r,i     r,i     r,i     r,i     r,i     r,i     r,i
+  //    ...
+  //
+  assert(client != 0);
+  dada_db_s *ctx = (dada_db_s *)client->context;
+
+  assert(ctx->log != 0);
+  multilog_t *log = (multilog_t *)ctx->log;
+  uint64_t start_ns = MWAX_PROBE_START_NS(autos_hdu_write);
+
+  int status = 0;
+  int bitpix = FLOAT_IMG;
+  long naxis = 2;
+  uint64_t axis1_rows = fine_channels * polarisations * polarisations * 2; //  we x2 as we store real and imaginary;
+  uint64_t axis2_cols = tiles;
+
+  long naxes[2] = {axis1_rows, axis2_cols};
+
+  multilog(log, LOG_DEBUG, "create_fits_autos_imghdu(): Creating new autos HDU in fits file with dimensions %lld x %lld...\n", (long long)axis1_rows, (long long)axis2_cols);
+
+  // Create new IMGHDU
+  if (fits_create_img(fptr, bitpix, naxis, naxes, &status))
+  {
+    char error_text[30] = "";
+    fits_get_errstatus(status, error_text);
+    multilog(log, LOG_ERR, "create_fits_autos_imghdu(): Error creating autos ImgHDU in fits file. Error: %d -- %s\n", status, error_text);
+    return EXIT_FAILURE;
+  }
+
+  // TIME
+  char key_time[FLEN_KEYWORD] = "TIME";
+
+  if (fits_write_key(fptr, TLONG, key_time, &unix_time, (char *)"Unix time (seconds)", &status))
+  {
+    char error_text[30] = "";
+    fits_get_errstatus(status, error_text);
+    multilog(log, LOG_ERR, "create_fits_autos_imghdu(): Error writing key %s into autos HDU. Error: %d -- %s\n", key_time, status, error_text);
+    return EXIT_FAILURE;
+  }
+
+  // MILLITIME - provides millisecond component of TIME
+  char key_millitim[FLEN_KEYWORD] = "MILLITIM";
+
+  if (fits_update_key(fptr, TINT, key_millitim, &unix_millisecond_time, (char *)"Milliseconds since TIME", &status))
+  {
+    char error_text[30] = "";
+    fits_get_errstatus(status, error_text);
+    multilog(log, LOG_ERR, "create_fits_autos_imghdu(): Error writing key %s into autos HDU. Error: %d -- %s\n", key_millitim, status, error_text);
+    return EXIT_FAILURE;
+  }
+
+  // MARKER
+  char key_marker[FLEN_KEYWORD] = "MARKER";
+
+  if (fits_write_key(fptr, TINT, key_marker, &marker, (char *)"Data offset marker of first integration", &status))
+  {
+    char error_text[30] = "";
+    fits_get_errstatus(status, error_text);
+    multilog(log, LOG_ERR, "create_fits_autos_imghdu(): Error writing key %s into autos HDU. Error: %d -- %s\n", key_marker, status, error_text);
+    return EXIT_FAILURE;
+  }
+
+  // NAVERAGE - may be less than the configured value if the file was closed part way through an average
+  if (fits_write_key(fptr, TINT, MWA_FITS_KEY_NAVERAGE, &naverage, (char *)"Integrations averaged into this HDU", &status))
+  {
+    char error_text[30] = "";
+    fits_get_errstatus(status, error_text);
+    multilog(log, LOG_ERR, "create_fits_autos_imghdu(): Error writing key %s into autos HDU. Error: %d -- %s\n", MWA_FITS_KEY_NAVERAGE, status, error_text);
+    return EXIT_FAILURE;
+  }
+
+  /* Write the array */
+  long nelements = bytes / (abs(bitpix) / 8);
+
+  // Check that number of elements * bytes per element matches what we expect
+  u_int64_t expected_bytes = (axis1_rows * axis2_cols * (abs(bitpix) / 8));
+  if (bytes != expected_bytes)
+  {
+    multilog(log, LOG_ERR, "create_fits_autos_imghdu(): Autos HDU bytes (%lu bytes) does not match calculated size from header parameters (%lu bytes).\n", bytes, expected_bytes);
+    return EXIT_FAILURE;
+  }
+
+  // Actually write the HDU data
+  if (fits_write_img(fptr, TFLOAT, 1, nelements, buffer, &status))
+  {
+    char error_text[30] = "";
+    fits_get_errstatus(status, error_text);
+    multilog(log, LOG_ERR, "create_fits_autos_imghdu(): Error writing data into autos HDU in fits file. Error: %d -- %s\n", status, error_text);
+    return EXIT_FAILURE;
+  }
+
+  MWAX_PROBE4(autos_hdu_write, ctx->obs_id, marker, bytes, MWAX_PROBE_ELAPSED_NS(start_ns));
+
+  return EXIT_SUCCESS;
+}
+
+/**
+ *
+ *  @brief Creates a new per fine channel statistics BINTABLE HDU in an existing fits file.
+ *  @param[in] client A pointer to the dada_client_t object.
+ *  @param[in] fptr Pointer to the fits file we will write to.
+ *  @param[in] unix_time The Unix time for this integration / timestep.
+ *  @param[in] unix_millisecond_time Number of milliseconds since the last integer of unix_time.
+ *  @param[in] marker The artificial counter we use to keep track of which integration/timestep this is within the observation (0 based).
+ *  @param[in] baselines The number of baselines the statistics were computed over.
+ *  @param[in] fine_channels The number of fine channels (one row per fine channel).
+ *  @param[in] polarisations The number of pols in each antenna-normally 2 (each column is a vector of pol*pol values).
+ *  @param[in] stats The statistics to write, as computed by compute_channel_stats().
+ *  @returns EXIT_SUCCESS on success, or EXIT_FAILURE if there was an error.
+ */
+int create_fits_chanstats_bintblhdu(dada_client_t *client, fitsfile *fptr, time_t unix_time, int unix_millisecond_time, int marker,
+                                    int baselines, int fine_channels, int polarisations, channel_stats_s *stats)
+{
+  // One row per fine channel. Each column is a vector of [xx,xy,yx,yy] values
+  //
+  // Row(Ch)  MEAN_PWR  RMS_PWR  MAX_PWR  NNAN
+  //    1     4E        4E       4E       4J
+  //    2     4E        4E       4E       4J
+  //    ...
+  //
+  assert(client != 0);
+  dada_db_s *ctx = (dada_db_s *)client->context;
+
+  assert(ctx->log != 0);
+  multilog_t *log = (multilog_t *)ctx->log;
+  uint64_t start_ns = MWAX_PROBE_START_NS(chanstats_hdu_write);
+
+  int status = 0;
+  int pols = polarisations * polarisations;
+  char tform_float[FLEN_VALUE];
+  char tform_int[FLEN_VALUE];
+
+  snprintf(tform_float, FLEN_VALUE, "%dE", pols);
+  snprintf(tform_int, FLEN_VALUE, "%dJ", pols);
+
+  char *ttype[] = {"MEAN_PWR", "RMS_PWR", "MAX_PWR", "NNAN"};
+  char *tform[] = {tform_float, tform_float, tform_float, tform_int};
+  char *tunit[] = {"", "", "", ""};
+
+  multilog(log, LOG_DEBUG, "create_fits_chanstats_bintblhdu(): Creating new channel statistics HDU in fits file with %d rows of %d pols...\n", fine_channels, pols);
+
+  if (stats->nvalues != fine_channels * pols)
+  {
+    multilog(log, LOG_ERR, "create_fits_chanstats_bintblhdu(): Channel statistics size (%d values) does not match calculated size from header parameters (%d values).\n", stats->nvalues, fine_channels * pols);
+    return EXIT_FAILURE;
+  }
+
+  // Create new BINTABLE
+  if (fits_create_tbl(fptr, BINARY_TBL, fine_channels, 4, ttype, tform, tunit, MWA_FITS_VALUE_CHANSTATS_EXTNAME, &status))
+  {
+    char error_text[30] = "";
+    fits_get_errstatus(status, error_text);
+    multilog(log, LOG_ERR, "create_fits_chanstats_bintblhdu(): Error creating channel statistics BinTableHDU in fits file. Error: %d -- %s\n", status, error_text);
+    return EXIT_FAILURE;
+  }
+
+  // TIME
+  char key_time[FLEN_KEYWORD] = "TIME";
+
+  if (fits_write_key(fptr, TLONG, key_time, &unix_time, (char *)"Unix time (seconds)", &status))
+  {
+    char error_text[30] = "";
+    fits_get_errstatus(status, error_text);
+    multilog(log, LOG_ERR, "create_fits_chanstats_bintblhdu(): Error writing key %s into channel statistics HDU. Error: %d -- %s\n", key_time, status, error_text);
+    return EXIT_FAILURE;
+  }
+
+  // MILLITIME - provides millisecond component of TIME
+  char key_millitim[FLEN_KEYWORD] = "MILLITIM";
+
+  if (fits_update_key(fptr, TINT, key_millitim, &unix_millisecond_time, (char *)"Milliseconds since TIME", &status))
+  {
+    char error_text[30] = "";
+    fits_get_errstatus(status, error_text);
+    multilog(log, LOG_ERR, "create_fits_chanstats_bintblhdu(): Error writing key %s into channel statistics HDU. Error: %d -- %s\n", key_millitim, status, error_text);
+    return EXIT_FAILURE;
+  }
+
+  // MARKER
+  char key_marker[FLEN_KEYWORD] = "MARKER";
+
+  if (fits_write_key(fptr, TINT, key_marker, &marker, (char *)"Data offset marker (all channels should match)", &status))
+  {
+    char error_text[30] = "";
+    fits_get_errstatus(status, error_text);
+    multilog(log, LOG_ERR, "create_fits_chanstats_bintblhdu(): Error writing key %s into channel statistics HDU. Error: %d -- %s\n", key_marker, status, error_text);
+    return EXIT_FAILURE;
+  }
+
+  // NBASELN
+  if (fits_write_key(fptr, TINT, MWA_FITS_KEY_NBASELINES, &baselines, (char *)"Number of baselines the statistics are over", &status))
+  {
+    char error_text[30] = "";
+    fits_get_errstatus(status, error_text);
+    multilog(log, LOG_ERR, "create_fits_chanstats_bintblhdu(): Error writing key %s into channel statistics HDU. Error: %d -- %s\n", MWA_FITS_KEY_NBASELINES, status, error_text);
+    return EXIT_FAILURE;
+  }
+
+  // Write the columns. Each one is nvalues long, which cfitsio spreads across the fine channel rows
+  if (fits_write_col(fptr, TFLOAT, 1, 1, 1, stats->nvalues, stats->mean_power, &status) ||
+      fits_write_col(fptr, TFLOAT, 2, 1, 1, stats->nvalues, stats->rms_power, &status) ||
+      fits_write_col(fptr, TFLOAT, 3, 1, 1, stats->nvalues, stats->max_power, &status) ||
+      fits_write_col(fptr, TINT32BIT, 4, 1, 1, stats->nvalues, stats->nnan, &status))
+  {
+    char error_text[30] = "";
+    fits_get_errstatus(status, error_text);
+    multilog(log, LOG_ERR, "create_fits_chanstats_bintblhdu(): Error writing data into channel statistics HDU in fits file. Error: %d -- %s\n", status, error_text);
+    return EXIT_FAILURE;
+  }
+
+  MWAX_PROBE4(chanstats_hdu_write, ctx->obs_id, marker, (uint64_t)stats->nvalues * (3 * sizeof(float) + sizeof(int32_t)), MWAX_PROBE_ELAPSED_NS(start_ns));
+
+  return EXIT_SUCCESS;
+}
\ No newline at end of file
@@ -9,6 +9,7 @@
 
 #include "fitsio.h"
 #include "dada_client.h"
+#include "stats.h"
 
 // Keys and some hard coded values for the 1st HDU of the fits file produced
 #define MWA_FITS_KEY_SIMPLE "SIMPLE"
@@ -35,11 +36,36 @@
 #define MWA_FITS_KEY_MWAX_U2S_VERSION "U2S_VER"
 #define MWA_FITS_KEY_MWAX_DB2CORRELATE2DB_VERSION "CBF_VER"
 #define MWA_FITS_KEY_MWAX_DB2FITS_VERSION "DB2F_VER"
+#define MWA_FITS_KEY_NAVERAGE "NAVERAGE"
+#define MWA_FITS_KEY_VISORDER "VISORDER"
+#define MWA_FITS_KEY_RFI_THRESHOLD "RFITHRSH"
+#define MWA_FITS_KEY_NFLAGGED "NFLAGGED"
+#define MWA_FITS_KEY_NBASELINES "NBASELN"
+#define MWA_FITS_KEY_NNONFINITE "NNONFIN"
+#define MWA_FITS_KEY_NZERO_BASELINES "NZEROBL"
+#define MWA_FITS_KEY_CUBE "CUBE"
+#define MWA_FITS_VALUE_CHANSTATS_EXTNAME "CHANSTATS"
 
 int open_fits(dada_client_t *client, fitsfile **fptr, const char *filename);
 int create_fits(dada_client_t *client, fitsfile **fptr, const char *filename);
 int close_fits(dada_client_t *client, fitsfile **fptr, int fits_is_good);
+int close_and_rename_fits(multilog_t *log, fitsfile **fptr, int fits_is_good, const char *temp_filename, const char *filename);
+int create_autos_fits(dada_client_t *client, fitsfile **fptr, const char *filename);
+int close_autos_fits(dada_client_t *client, fitsfile **fptr, int fits_is_good);
 int create_fits_visibilities_imghdu(dada_client_t *client, fitsfile *fptr, time_t unix_time, int unix_millisecond_time,
-                                    int marker, int baselines, int fine_channels, int polarisations, float *buffer, uint64_t bytes);
+                                    int marker, int baselines, int fine_channels, int polarisations, float *buffer, uint64_t bytes,
+                                    uint64_t nonfinite, uint64_t zero_baselines);
 int create_fits_weights_imghdu(dada_client_t *client, fitsfile *fptr, time_t unix_time, int unix_millisecond_time,
                                int marker, int baselines, int polarisations, float *buffer, uint64_t bytes);
+int create_fits_visibilities_cube_imghdu(dada_client_t *client, fitsfile *fptr, time_t unix_time, int unix_millisecond_time, int marker,
+                                         int integrations, int baselines, int fine_channels, int polarisations);
+int write_fits_visibilities_cube_plane(dada_client_t *client, fitsfile *fptr, int integration, int marker, float *buffer, uint64_t bytes);
+int update_fits_bad_data_keys(dada_client_t *client, fitsfile *fptr, uint64_t nonfinite, uint64_t zero_baselines);
+int create_fits_weights_cube_imghdu(dada_client_t *client, fitsfile *fptr, time_t unix_time, int unix_millisecond_time, int marker,
+                                    int integrations, int baselines, int polarisations, float *buffer, uint64_t bytes);
+int create_fits_flags_imghdu(dada_client_t *client, fitsfile *fptr, time_t unix_time, int unix_millisecond_time, int marker,
+                             int baselines, int fine_channels, unsigned char *buffer, uint64_t bytes, uint64_t flagged);
+int create_fits_autos_imghdu(dada_client_t *client, fitsfile *fptr, time_t unix_time, int unix_millisecond_time, int marker, int naverage,
+                             int tiles, int fine_channels, int polarisations, float *buffer, uint64_t bytes);
+int create_fits_chanstats_bintblhdu(dada_client_t *client, fitsfile *fptr, time_t unix_time, int unix_millisecond_time, int marker,
+                                    int baselines, int fine_channels, int polarisations, channel_stats_s *stats);
\ No newline at end of file
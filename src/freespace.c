@@ -0,0 +1,263 @@
+/**
+ * @file freespace.c
+ * @author Greg Sleap
+ * @date 18 Oct 2026
+ * @brief This is the code that forecasts the disk space each observation needs and acts before the destination path
+ *        fills up (--space-policy)
+ *
+ * The size of everything an observation will write is known from its header: a sub-observation's worth of HDUs (see
+ * diskprobe_subobs_bytes()) for each sub-observation still to come. At the start of each observation this forecast is
+ * compared with the free space of the destination path (statvfs, less FREESPACE_RESERVE_BYTES). If it won't fit, the
+ * --space-policy decides what happens: warn (write it anyway), redirect (write its files to --alternate-path, if that
+ * has room), compress (write its visibilities, weights and flags as lossless GZIP compressed HDUs) or refuse (don't
+ * write it at all). Either way this is logged and sent in the health packets.
+ *
+ * Other things may be writing to the same filesystem, so at the start of each sub-observation the forecast for the
+ * rest of the observation is compared again. If not even that sub-observation fits, rather than let cfitsio fail part
+ * way through an integration, a new fits file is started (on the alternate path, or compressed) or, if that is not
+ * possible, the current fits file is closed (so it has every complete integration) and the rest of the observation
+ * is skipped. Closed files queued for the finaliser thread are already on disk, so they are in the free space. The
+ * unused part of the current fits file's --preallocate reservation is added back, as it is already set aside for the
+ * rest of the observation.
+ */
+#include <assert.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/statvfs.h>
+
+#include "diskprobe.h"
+#include "freespace.h"
+#include "global.h"
+
+/**
+ *
+ *  @brief Gets the free space of a directory's filesystem which we can use (i.e. not including the blocks reserved
+ *         for root).
+ *  @param[in] path The directory.
+ *  @param[out] free_bytes The free space in bytes.
+ *  @param[in] log The logger to use.
+ *  @returns EXIT_SUCCESS on success, or EXIT_FAILURE if there was an error.
+ */
+int freespace_query(const char *path, uint64_t *free_bytes, multilog_t *log)
+{
+  struct statvfs fs_stat;
+
+  if (statvfs(path, &fs_stat) != 0)
+  {
+    multilog(log, LOG_WARNING, "freespace_query(): Error getting the free space of %s: %s\n", path, strerror(errno));
+    return EXIT_FAILURE;
+  }
+
+  *free_bytes = (uint64_t)fs_stat.f_bavail * fs_stat.f_frsize;
+
+  return EXIT_SUCCESS;
+}
+
+/**
+ *
+ *  @brief Forecasts how many bytes the current observation will write from the sub-observation starting at obs_offset
+ *         to its end (at least one sub-observation's worth).
+ *  @param[in] client A pointer to the dada_client_t object.
+ *  @param[in] obs_offset The offset (seconds) of the first sub-observation to include.
+ *  @returns The number of bytes.
+ */
+uint64_t freespace_forecast(dada_client_t *client, int obs_offset)
+{
+  assert(client != 0);
+  dada_db_s *ctx = (dada_db_s *)client->context;
+
+  int remaining_subobs = (ctx->exposure_sec - obs_offset + ctx->secs_per_subobs - 1) / ctx->secs_per_subobs;
+
+  return (uint64_t)(remaining_subobs > 1 ? remaining_subobs : 1) * diskprobe_subobs_bytes(client);
+}
+
+/**
+ *
+ *  @brief Checks the alternate path (if any) has room for a number of bytes.
+ *  @param[in] ctx The dada_db_s context.
+ *  @param[in] bytes The number of bytes.
+ *  @param[out] free_bytes The free space of the alternate path.
+ *  @returns 1 if it has room, otherwise 0.
+ */
+static int alternate_has_room(dada_db_s *ctx, uint64_t bytes, uint64_t *free_bytes)
+{
+  if (ctx->alternate_destination_dir == NULL || freespace_query(ctx->alternate_destination_dir, free_bytes, ctx->log) != EXIT_SUCCESS)
+  {
+    return 0;
+  }
+
+  return (bytes + FREESPACE_RESERVE_BYTES <= *free_bytes);
+}
+
+/**
+ *
+ *  @brief Checks the new observation will fit on the destination path, and if it won't, acts on the space policy:
+ *         sets ctx->space_state to FREESPACE_STATE_REDIRECTED (make_fits_filename() then uses the alternate path),
+ *         sets ctx->compression_mode (create_fits() then compresses the HDUs), or sets FREESPACE_STATE_REFUSED (the
+ *         caller then skips the observation). Every observation starts on the destination path, uncompressed. Call once
+ *         the header has been read and validated, and the output options for this observation decided.
+ *  @param[in] client A pointer to the dada_client_t object.
+ *  @returns EXIT_SUCCESS. Not being able to read the free space is logged, and the observation written as is.
+ */
+int freespace_admit_observation(dada_client_t *client)
+{
+  assert(client != 0);
+  dada_db_s *ctx = (dada_db_s *)client->context;
+  multilog_t *log = (multilog_t *)ctx->log;
+
+  ctx->compression_mode = COMPRESSION_MODE_NONE;
+  ctx->space_state = FREESPACE_STATE_UNKNOWN;
+  ctx->space_forecast_bytes = freespace_forecast(client, ctx->obs_offset);
+  ctx->space_free_bytes = 0;
+
+  if (freespace_query(ctx->destination_dir, &ctx->space_free_bytes, log) != EXIT_SUCCESS)
+  {
+    return EXIT_SUCCESS;
+  }
+
+  if (ctx->space_forecast_bytes + FREESPACE_RESERVE_BYTES <= ctx->space_free_bytes)
+  {
+    ctx->space_state = FREESPACE_STATE_OK;
+    multilog(log, LOG_INFO, "dada_dbfits_open(): Observation needs %.3f GB of the %.3f GB free in %s.\n",
+             ctx->space_forecast_bytes / 1.0e9, ctx->space_free_bytes / 1.0e9, ctx->destination_dir);
+    return EXIT_SUCCESS;
+  }
+
+  multilog(log, LOG_WARNING, "dada_dbfits_open(): WARNING: Observation needs %.3f GB but only %.3f GB is free in %s (keeping %.3f GB free). Space policy = %s.\n",
+           ctx->space_forecast_bytes / 1.0e9, ctx->space_free_bytes / 1.0e9, ctx->destination_dir, FREESPACE_RESERVE_BYTES / 1.0e9, space_policy_name(ctx->space_policy));
+  ctx->space_state = FREESPACE_STATE_LOW;
+
+  uint64_t alternate_free_bytes = 0;
+
+  switch (ctx->space_policy)
+  {
+  case SPACE_POLICY_REDIRECT:
+    if (alternate_has_room(ctx, ctx->space_forecast_bytes, &alternate_free_bytes))
+    {
+      ctx->space_state = FREESPACE_STATE_REDIRECTED;
+      ctx->space_free_bytes = alternate_free_bytes;
+      multilog(log, LOG_WARNING, "dada_dbfits_open(): Writing this observation to %s (%.3f GB free).\n", ctx->alternate_destination_dir, alternate_free_bytes / 1.0e9);
+    }
+    else
+    {
+      multilog(log, LOG_ERR, "dada_dbfits_open(): The alternate path %s does not have room either (%.3f GB free). Writing this observation to %s anyway.\n",
+               ctx->alternate_destination_dir, alternate_free_bytes / 1.0e9, ctx->destination_dir);
+    }
+    break;
+
+  case SPACE_POLICY_COMPRESS:
+    ctx->compression_mode = COMPRESSION_MODE_GZIP;
+    ctx->space_state = FREESPACE_STATE_COMPRESSED;
+    multilog(log, LOG_WARNING, "dada_dbfits_open(): Compressing this observation's HDUs (%s).\n", compression_mode_name(ctx->compression_mode));
+    break;
+
+  case SPACE_POLICY_REFUSE:
+    ctx->space_state = FREESPACE_STATE_REFUSED;
+    multilog(log, LOG_ERR, "dada_dbfits_open(): Refusing observation %lu: it does not fit in %s.\n", ctx->obs_id, ctx->destination_dir);
+    break;
+
+  default:
+    break;
+  }
+
+  return EXIT_SUCCESS;
+}
+
+/**
+ *
+ *  @brief Checks the next sub-observation of the current observation will fit where its fits file is being written.
+ *         The forecast for the rest of the observation is updated (and a warning logged the first time it no longer
+ *         fits). If not even this sub-observation fits, acts on the space policy: redirect to the alternate path or
+ *         compress (each at most once per observation) in a new fits file, otherwise stop the observation.
+ *  @param[in] client A pointer to the dada_client_t object.
+ *  @returns FREESPACE_CONTINUE, FREESPACE_NEW_FILE or FREESPACE_STOP.
+ */
+int freespace_check_subobs(dada_client_t *client)
+{
+  assert(client != 0);
+  dada_db_s *ctx = (dada_db_s *)client->context;
+  multilog_t *log = (multilog_t *)ctx->log;
+
+  const char *path = (ctx->space_state == FREESPACE_STATE_REDIRECTED ? ctx->alternate_destination_dir : ctx->destination_dir);
+  uint64_t free_bytes = 0;
+
+  if (freespace_query(path, &free_bytes, log) != EXIT_SUCCESS)
+  {
+    return FREESPACE_CONTINUE;
+  }
+
+  // The current fits file's reservation (--preallocate) is counted as used, but the part of it not written into yet is
+  // for the rest of this observation, so it is free as far as the forecast is concerned
+  if (ctx->preallocated_bytes > (uint64_t)ctx->fits_file_size)
+  {
+    free_bytes += ctx->preallocated_bytes - ctx->fits_file_size;
+  }
+
+  uint64_t subobs_bytes = diskprobe_subobs_bytes(client);
+  ctx->space_forecast_bytes = freespace_forecast(client, ctx->obs_offset + ctx->secs_per_subobs);
+  ctx->space_free_bytes = free_bytes;
+
+  if (ctx->space_forecast_bytes + FREESPACE_RESERVE_BYTES > free_bytes && ctx->space_state == FREESPACE_STATE_OK)
+  {
+    ctx->space_state = FREESPACE_STATE_LOW;
+    multilog(log, LOG_WARNING, "dada_dbfits_open(): WARNING: The rest of the observation needs %.3f GB but only %.3f GB is now free in %s.\n",
+             ctx->space_forecast_bytes / 1.0e9, free_bytes / 1.0e9, path);
+  }
+
+  if (subobs_bytes + FREESPACE_RESERVE_BYTES <= free_bytes)
+  {
+    return FREESPACE_CONTINUE;
+  }
+
+  multilog(log, LOG_ERR, "dada_dbfits_open(): The next sub-observation needs %.3f GB but only %.3f GB is free in %s.\n", subobs_bytes / 1.0e9, free_bytes / 1.0e9, path);
+
+  uint64_t alternate_free_bytes = 0;
+
+  if (ctx->space_policy == SPACE_POLICY_REDIRECT && ctx->space_state != FREESPACE_STATE_REDIRECTED && alternate_has_room(ctx, subobs_bytes, &alternate_free_bytes))
+  {
+    ctx->space_state = FREESPACE_STATE_REDIRECTED;
+    ctx->space_free_bytes = alternate_free_bytes;
+    multilog(log, LOG_WARNING, "dada_dbfits_open(): Writing the rest of this observation to %s (%.3f GB free).\n", ctx->alternate_destination_dir, alternate_free_bytes / 1.0e9);
+    return FREESPACE_NEW_FILE;
+  }
+
+  if (ctx->space_policy == SPACE_POLICY_COMPRESS && ctx->compression_mode == COMPRESSION_MODE_NONE)
+  {
+    ctx->compression_mode = COMPRESSION_MODE_GZIP;
+    ctx->space_state = FREESPACE_STATE_COMPRESSED;
+    multilog(log, LOG_WARNING, "dada_dbfits_open(): Compressing the HDUs of the rest of this observation (%s).\n", compression_mode_name(ctx->compression_mode));
+    return FREESPACE_NEW_FILE;
+  }
+
+  ctx->space_state = FREESPACE_STATE_REFUSED;
+  multilog(log, LOG_ERR, "dada_dbfits_open(): Stopping observation %lu before %s fills up. The rest of it will be skipped.\n", ctx->obs_id, path);
+
+  return FREESPACE_STOP;
+}
+
+/**
+ *
+ *  @brief Returns the name of a FREESPACE_STATE_..., for the log.
+ *  @param[in] state The state.
+ *  @returns The name of the state.
+ */
+const char *freespace_state_name(int state)
+{
+  switch (state)
+  {
+  case FREESPACE_STATE_OK:
+    return "ok";
+  case FREESPACE_STATE_LOW:
+    return "low";
+  case FREESPACE_STATE_REDIRECTED:
+    return "redirected";
+  case FREESPACE_STATE_COMPRESSED:
+    return "compressed";
+  case FREESPACE_STATE_REFUSED:
+    return "refused";
+  default:
+    return "unknown";
+  }
+}
\ No newline at end of file
@@ -0,0 +1,32 @@
+/**
+ * @file freespace.h
+ * @author Greg Sleap
+ * @date 18 Oct 2026
+ * @brief This is the header for the code that forecasts the disk space each observation needs and acts before the
+ *        destination path fills up (--space-policy)
+ *
+ */
+#pragma once
+
+#include <stdint.h>
+#include "dada_client.h"
+#include "multilog.h"
+
+#define FREESPACE_RESERVE_BYTES (1024l * 1024 * 1024) // Always leave this much free on the destination path
+
+#define FREESPACE_STATE_UNKNOWN 0    // Not in an observation, or the free space could not be read
+#define FREESPACE_STATE_OK 1         // The rest of the observation fits
+#define FREESPACE_STATE_LOW 2        // ... won't fit, and is being written as is (SPACE_POLICY_WARN, or nowhere better to put it)
+#define FREESPACE_STATE_REDIRECTED 3 // ... won't fit, so its files are being written to the alternate path
+#define FREESPACE_STATE_COMPRESSED 4 // ... won't fit, so its files are being compressed
+#define FREESPACE_STATE_REFUSED 5    // ... won't fit, so it is not being written
+
+#define FREESPACE_CONTINUE 0 // freespace_check_subobs(): carry on with the current fits file
+#define FREESPACE_NEW_FILE 1 // ... start a new fits file (redirected or compressed)
+#define FREESPACE_STOP 2     // ... close the current fits file and skip the rest of the observation
+
+int freespace_query(const char *path, uint64_t *free_bytes, multilog_t *log);
+uint64_t freespace_forecast(dada_client_t *client, int obs_offset);
+int freespace_admit_observation(dada_client_t *client);
+int freespace_check_subobs(dada_client_t *client);
+const char *freespace_state_name(int state);
\ No newline at end of file
@@ -5,12 +5,12 @@
  * @brief This is the code for anything global
  *
  */
-#include <assert.h>
 #include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include "global.h"
+#include "utils.h"
 
 pthread_mutex_t g_quit_mutex;
 int g_quit = 0;
@@ -18,6 +18,8 @@ int g_quit = 0;
 pthread_mutex_t g_health_manager_mutex;
 health_thread_data_s g_health_manager;
 
+metrics_s g_metrics;
+
 dada_db_s g_ctx;
 
 /**
@@ -71,6 +73,97 @@ int quit_destroy()
     return EXIT_SUCCESS;
 }
 
+/**
+ *
+ *  @brief Returns the name of a visibility layout, as written into the VISORDER fits key.
+ *  @param[in] vis_layout VIS_LAYOUT_BASELINE_MAJOR or VIS_LAYOUT_FINECHAN_MAJOR.
+ *  @returns The name of the layout.
+ */
+const char *vis_layout_name(int vis_layout)
+{
+    switch (vis_layout)
+    {
+    case VIS_LAYOUT_FINECHAN_MAJOR:
+        return "FINECHAN_BASELINE_POL";
+    default:
+        return "BASELINE_FINECHAN_POL";
+    }
+}
+
+/**
+ *
+ *  @brief Returns the name of a bad data policy, as used on the command line.
+ *  @param[in] bad_data_policy BAD_DATA_POLICY_KEEP, BAD_DATA_POLICY_ZERO_WEIGHT or BAD_DATA_POLICY_DROP.
+ *  @returns The name of the policy.
+ */
+const char *bad_data_policy_name(int bad_data_policy)
+{
+    switch (bad_data_policy)
+    {
+    case BAD_DATA_POLICY_ZERO_WEIGHT:
+        return "zero-weight";
+    case BAD_DATA_POLICY_DROP:
+        return "drop";
+    default:
+        return "keep";
+    }
+}
+
+/**
+ *
+ *  @brief Returns the name of a compression mode, for the log.
+ *  @param[in] compression_mode COMPRESSION_MODE_NONE or COMPRESSION_MODE_GZIP.
+ *  @returns The name of the mode.
+ */
+const char *compression_mode_name(int compression_mode)
+{
+    switch (compression_mode)
+    {
+    case COMPRESSION_MODE_GZIP:
+        return "gzip lossless";
+    default:
+        return "none";
+    }
+}
+
+/**
+ *
+ *  @brief Returns the name of an overload policy, as used on the command line.
+ *  @param[in] overload_policy OVERLOAD_POLICY_WARN or OVERLOAD_POLICY_SHED.
+ *  @returns The name of the policy.
+ */
+const char *overload_policy_name(int overload_policy)
+{
+    switch (overload_policy)
+    {
+    case OVERLOAD_POLICY_SHED:
+        return "shed";
+    default:
+        return "warn";
+    }
+}
+
+/**
+ *
+ *  @brief Returns the name of a space policy, as used on the command line.
+ *  @param[in] space_policy SPACE_POLICY_WARN, SPACE_POLICY_REDIRECT, SPACE_POLICY_COMPRESS or SPACE_POLICY_REFUSE.
+ *  @returns The name of the policy.
+ */
+const char *space_policy_name(int space_policy)
+{
+    switch (space_policy)
+    {
+    case SPACE_POLICY_REDIRECT:
+        return "redirect";
+    case SPACE_POLICY_COMPRESS:
+        return "compress";
+    case SPACE_POLICY_REFUSE:
+        return "refuse";
+    default:
+        return "warn";
+    }
+}
+
 ///
 /// NOTE: the "health_manager" methods below are for the main program to manipulate the g_health_manager struct which will eventually be passed to the health thread to create a UDP health packet.
 ///
@@ -78,9 +171,10 @@ int quit_destroy()
 /**
  *
  *  @brief This creates the mutex used to ensure access to g_health_manager is thread-safe. It also inits the other attributes. g_health_manager is the global var which keeps info which will eventually be used to send health info.
- *  @returns EXIT_SUCCESS on success.
+ *  @param[in] bandpass_bins - number of bins in the bandpass summary of each tile (0 == none)
+ *  @returns EXIT_SUCCESS on success, or EXIT_FAILURE if the tile weights could not be allocated.
  */
-int health_manager_init()
+int health_manager_init(int bandpass_bins)
 {
     pthread_mutex_init(&g_health_manager_mutex, NULL);
 
@@ -88,18 +182,87 @@ int health_manager_init()
     g_health_manager.status = STATUS_RUNNING;
     g_health_manager.obs_id = 0;
     g_health_manager.subobs_id = 0;
-    g_health_manager.weights_counter = 0;
+    pthread_mutex_unlock(&g_health_manager_mutex);
+
+    // The totals start at zero. This is done before the health thread is started so there are no readers yet
+    memset(&g_health_manager.totals, 0, sizeof(health_totals_s));
+    atomic_store(&g_health_manager.totals_sequence, 0);
 
-    for (int i = 0; i < NTILES_MAX; i++)
+    // Start with room for NTILES_MAX tiles. This grows if an observation has more
+    health_tile_weights_s *tile_weights = health_tile_weights_alloc(NTILES_MAX, bandpass_bins);
+
+    if (tile_weights == NULL)
     {
-        g_health_manager.weights_per_tile_x[i] = NAN;
-        g_health_manager.weights_per_tile_y[i] = NAN;
+        return EXIT_FAILURE;
     }
-    pthread_mutex_unlock(&g_health_manager_mutex);
+
+    atomic_store(&g_health_manager.tile_weights, tile_weights);
 
     return EXIT_SUCCESS;
 }
 
+/**
+ *
+ *  @brief Allocates zeroed running totals of the weights and auto power of each tile, as one block.
+ *  @param[in] capacity - number of tiles to make room for
+ *  @param[in] bandpass_bins - number of bins in the bandpass summary of each tile (0 == none)
+ *  @returns The tile weights, or NULL if they could not be allocated.
+ */
+health_tile_weights_s *health_tile_weights_alloc(int capacity, int bandpass_bins)
+{
+    size_t values_per_tile = 4 + (2 * (size_t)bandpass_bins);
+    health_tile_weights_s *tile_weights = calloc(1, sizeof(health_tile_weights_s) + (values_per_tile * capacity * sizeof(double)));
+
+    if (tile_weights == NULL)
+    {
+        return NULL;
+    }
+
+    tile_weights->capacity = capacity;
+    tile_weights->bandpass_bins = bandpass_bins;
+    tile_weights->retired = NULL;
+    tile_weights->weights_per_tile_x = (double *)(tile_weights + 1);
+    tile_weights->weights_per_tile_y = tile_weights->weights_per_tile_x + capacity;
+    tile_weights->auto_power_per_tile_x = tile_weights->weights_per_tile_y + capacity;
+    tile_weights->auto_power_per_tile_y = tile_weights->auto_power_per_tile_x + capacity;
+    tile_weights->bandpass_per_tile = tile_weights->auto_power_per_tile_y + capacity;
+
+    return tile_weights;
+}
+
+/**
+ *
+ *  @brief Copies the totals of every tile src has room for into dest, which must have room for at least as many tiles
+ *         (and the same number of bandpass bins).
+ *  @param[out] dest - the block to copy to
+ *  @param[in] src - the block to copy from
+ */
+void health_tile_weights_copy(health_tile_weights_s *dest, const health_tile_weights_s *src)
+{
+    size_t bytes = src->capacity * sizeof(double);
+
+    memcpy(dest->weights_per_tile_x, src->weights_per_tile_x, bytes);
+    memcpy(dest->weights_per_tile_y, src->weights_per_tile_y, bytes);
+    memcpy(dest->auto_power_per_tile_x, src->auto_power_per_tile_x, bytes);
+    memcpy(dest->auto_power_per_tile_y, src->auto_power_per_tile_y, bytes);
+    memcpy(dest->bandpass_per_tile, src->bandpass_per_tile, bytes * 2 * src->bandpass_bins);
+}
+
+/**
+ *
+ *  @brief Frees tile weights allocated by health_tile_weights_alloc(), along with any smaller blocks they replaced.
+ *  @param[in] tile_weights - the tile weights (may be NULL)
+ */
+void health_tile_weights_free(health_tile_weights_s *tile_weights)
+{
+    while (tile_weights != NULL)
+    {
+        health_tile_weights_s *retired = tile_weights->retired;
+        free(tile_weights);
+        tile_weights = retired;
+    }
+}
+
 /**
  *
  *  @brief A thread-safe way to set the values of g_health_manager.
@@ -120,64 +283,254 @@ int health_manager_set_info(int status, long obs_id, long subobs_id)
 
 /**
  *
- *  @brief A thread-safe way to set the weights values of g_health_manager.
- *  @param[in] buffer - pointer to buffer containing baseline weights
- *  @param[in] ntiles - number of tiles in observation
- *  @returns EXIT_SUCCESS on success.
+ *  @brief Sets the destination path bandwidth info sent with the health packets (see diskprobe.h).
+ *  @param[in] disk_bytes_per_sec - the measured write bandwidth of the destination path (0 == not measured)
+ *  @param[in] required_bytes_per_sec - the rate the current observation writes at (0 == not in an observation)
+ *  @param[in] disk_state - DISKPROBE_STATE_... of the current observation
+ *  @returns EXIT_SUCCESS
+ */
+int health_manager_set_disk_info(double disk_bytes_per_sec, double required_bytes_per_sec, int disk_state)
+{
+    pthread_mutex_lock(&g_health_manager_mutex);
+    g_health_manager.disk_bytes_per_sec = disk_bytes_per_sec;
+    g_health_manager.required_bytes_per_sec = required_bytes_per_sec;
+    g_health_manager.disk_state = disk_state;
+    pthread_mutex_unlock(&g_health_manager_mutex);
+    return EXIT_SUCCESS;
+}
+
+/**
+ *
+ *  @brief Sets just the measured bandwidth of the destination path sent with the health packets (from the disk probe thread).
+ *  @param[in] disk_bytes_per_sec - the measured write bandwidth of the destination path (0 == not measured)
+ *  @returns EXIT_SUCCESS
+ */
+int health_manager_set_disk_bandwidth(double disk_bytes_per_sec)
+{
+    pthread_mutex_lock(&g_health_manager_mutex);
+    g_health_manager.disk_bytes_per_sec = disk_bytes_per_sec;
+    pthread_mutex_unlock(&g_health_manager_mutex);
+    return EXIT_SUCCESS;
+}
+
+/**
+ *
+ *  @brief Sets the destination path free space info sent with the health packets (see freespace.h).
+ *  @param[in] free_bytes - the free space where the current observation is being written
+ *  @param[in] forecast_bytes - the space the rest of the current observation needs
+ *  @param[in] space_state - FREESPACE_STATE_... of the current observation
+ *  @returns EXIT_SUCCESS
  */
-int health_manager_set_weights_info(float *buffer, int ntiles)
+int health_manager_set_space_info(uint64_t free_bytes, uint64_t forecast_bytes, int space_state)
 {
     pthread_mutex_lock(&g_health_manager_mutex);
+    g_health_manager.space_free_bytes = free_bytes;
+    g_health_manager.space_forecast_bytes = forecast_bytes;
+    g_health_manager.space_state = space_state;
+    pthread_mutex_unlock(&g_health_manager_mutex);
+    return EXIT_SUCCESS;
+}
+
+/**
+ *
+ *  @brief Starts an update of g_health_manager.totals. Only the thread reading the ringbuffer may call this.
+ */
+static void health_manager_totals_write_begin()
+{
+    unsigned int sequence = atomic_load_explicit(&g_health_manager.totals_sequence, memory_order_relaxed);
 
-    // Update the weights arrays and counter
-    g_health_manager.weights_counter++;
+    // Make the sequence odd, so readers know an update is in progress, before touching the totals
+    atomic_store_explicit(&g_health_manager.totals_sequence, sequence + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+}
 
-    int baseline = 0;
+/**
+ *
+ *  @brief Finishes an update of g_health_manager.totals started by health_manager_totals_write_begin().
+ */
+static void health_manager_totals_write_end()
+{
+    unsigned int sequence = atomic_load_explicit(&g_health_manager.totals_sequence, memory_order_relaxed);
+
+    // Make the sequence even again, after all of the updates to the totals are visible
+    atomic_store_explicit(&g_health_manager.totals_sequence, sequence + 1, memory_order_release);
+}
+
+/**
+ *
+ *  @brief Adds the weights and autocorrelation power of one integration to the running totals in g_health_manager. This never blocks.
+ *  @param[in] buffer - pointer to buffer containing baseline weights
+ *  @param[in] visibilities - pointer to the visibilities: [baseline][finechan][pol][r,i]
+ *  @param[in] ntiles - number of tiles in observation
+ *  @param[in] nfine_chan - number of fine channels
+ *  @returns EXIT_SUCCESS on success, or EXIT_FAILURE if there was no room for ntiles and more could not be allocated.
+ */
+int health_manager_set_weights_info(float *buffer, const float *visibilities, int ntiles, int nfine_chan)
+{
+    health_totals_s *totals = &g_health_manager.totals;
 
-    // If for some reason we have ntiles from subfile header be > NTILES_MAX we should abort!
-    assert(ntiles <= NTILES_MAX);
+    // Only this thread changes the tile weights pointer, so no ordering is needed to read it here
+    health_tile_weights_s *tile_weights = atomic_load_explicit(&g_health_manager.tile_weights, memory_order_relaxed);
 
-    // If weights are all NANs, reset to 0 so we can start to accumulate, otherwise leave as is
-    if (isnanf(g_health_manager.weights_per_tile_x[0]))
+    // The first integration with more tiles than there is room for: carry the totals over to a bigger block. The old
+    // block is not freed, as the health thread may be copying it right now
+    if (ntiles > tile_weights->capacity)
     {
-        for (int i = 0; i < ntiles; i++)
+        int capacity = (tile_weights->capacity * 2 > ntiles ? tile_weights->capacity * 2 : ntiles);
+        health_tile_weights_s *grown = health_tile_weights_alloc(capacity, tile_weights->bandpass_bins);
+
+        if (grown == NULL)
         {
-            g_health_manager.weights_per_tile_x[i] = 0;
-            g_health_manager.weights_per_tile_y[i] = 0;
+            multilog(g_ctx.log, LOG_ERR, "health_manager_set_weights_info(): could not allocate the weights of %d tiles.\n", capacity);
+            return EXIT_FAILURE;
         }
+
+        health_tile_weights_copy(grown, tile_weights);
+        grown->retired = tile_weights;
+        tile_weights = grown;
     }
 
-    // Loop through all baselines
+    health_manager_totals_write_begin();
+
+    totals->ntiles = ntiles;
+    totals->weights_counter++;
+
+    // Pick out the XX and YY weights of each autocorrelation- this is effectively the tile weight for X and Y pols.
+    accumulate_auto_weights(buffer, ntiles, tile_weights->weights_per_tile_x, tile_weights->weights_per_tile_y);
+
+    // And the power (and bandpass) of each tile's autocorrelation, to spot dead tiles which still have good weights
+    accumulate_auto_power(visibilities, ntiles, nfine_chan, tile_weights->bandpass_bins, tile_weights->auto_power_per_tile_x, tile_weights->auto_power_per_tile_y, tile_weights->bandpass_per_tile);
+
+    atomic_store_explicit(&g_health_manager.tile_weights, tile_weights, memory_order_release);
+
+    health_manager_totals_write_end();
+
+#ifdef DEBUG
+    // Only this thread writes the totals, so it is safe to read them here
     for (int i = 0; i < ntiles; i++)
     {
-        for (int j = 0; j <= i; j++)
+        uint64_t xx_index = get_auto_baseline_index(i) * 4;
+        uint64_t yy_index = xx_index + 3;
+
+        multilog(g_ctx.log, LOG_DEBUG, "health_manager_set_weights_info(): counter = %d, tile = %d, weight.x = %f, weight.y = %f, cuml weight.x = %f, cuml weight.y = %f\n", (int)totals->weights_counter, i, buffer[xx_index], buffer[yy_index], tile_weights->weights_per_tile_x[i], tile_weights->weights_per_tile_y[i]);
+    }
+#endif
+
+    return EXIT_SUCCESS;
+}
+
+/**
+ *
+ *  @brief Adds the bad data counts of one integration to the running totals in g_health_manager. This never blocks.
+ *  @param[in] nonfinite - number of NaN/Inf visibility values in the integration
+ *  @param[in] zero_baselines - number of baselines with zero power in the integration
+ *  @param[in] dropped - 1 if the integration was dropped, 0 if it was written
+ *  @returns EXIT_SUCCESS on success.
+ */
+int health_manager_add_bad_data_info(uint64_t nonfinite, uint64_t zero_baselines, int dropped)
+{
+    health_totals_s *totals = &g_health_manager.totals;
+
+    health_manager_totals_write_begin();
+
+    totals->bad_data_scanned++;
+    totals->bad_data_integrations += (nonfinite > 0 || zero_baselines > 0);
+    totals->bad_data_dropped += dropped;
+    totals->bad_data_nonfinite += nonfinite;
+    totals->bad_data_zero_baselines += zero_baselines;
+
+    health_manager_totals_write_end();
+
+    return EXIT_SUCCESS;
+}
+
+/**
+ *
+ *  @brief Adds one integration's hardware performance counts to the running totals in g_health_manager (lock-free).
+ *  @param[in] stages - the counts of each stage (PERF_STAGE_COUNT of them)
+ *  @param[in] available - bit mask of the counters being read
+ *  @returns EXIT_SUCCESS on success.
+ */
+int health_manager_add_perf_info(const perf_stage_counts_s *stages, int available)
+{
+    health_totals_s *totals = &g_health_manager.totals;
+
+    health_manager_totals_write_begin();
+
+    totals->perf_counters_available = available;
+
+    for (int stage = 0; stage < PERF_STAGE_COUNT; stage++)
+    {
+        totals->perf_stages[stage].samples += stages[stage].samples;
+
+        for (int counter = 0; counter < PERF_COUNTER_COUNT; counter++)
         {
-            //
-            // If we are an autocorrelation, then we get the XX and YY weights
-            // and this is effectively the tile weight for X and Y pols.
-            //
-            if (i == j)
-            {
-                int xx_index = baseline * 4; // There are 4 pols per baseline in the weights provided to us.
-                int yy_index = xx_index + 3; // Pols are ordered xx, xy, yx, yy, so add 3 to the xx index ot get yy.
+            totals->perf_stages[stage].counts[counter] += stages[stage].counts[counter];
+        }
+    }
 
-                g_health_manager.weights_per_tile_x[i] += buffer[xx_index];
-                g_health_manager.weights_per_tile_y[i] += buffer[yy_index];
+    health_manager_totals_write_end();
 
-#ifdef DEBUG
-                multilog(g_ctx.log, LOG_DEBUG, "health_manager_set_weights_info(): counter = %d, tile = %d, weight.x = %f, weight.y = %f, cuml weight.x = %f, cuml weight.y = %f\n", g_health_manager.weights_counter, i, buffer[xx_index], buffer[yy_index], g_health_manager.weights_per_tile_x[i], g_health_manager.weights_per_tile_y[i]);
-#endif
+    return EXIT_SUCCESS;
+}
+
+/**
+ *
+ *  @brief Takes a consistent copy of the running totals in g_health_manager without blocking the writer. If the
+ *         totals are updated while they are being copied, the copy is retried.
+ *  @param[out] out_totals - the copy of the totals
+ *  @param[in,out] out_tile_weights - the copy of the tile weights. This is replaced by a bigger block (from
+ *                 health_tile_weights_alloc()) if it does not have room for all of the tiles.
+ *  @returns EXIT_SUCCESS on success, or EXIT_FAILURE if a bigger block for the tile weights could not be allocated.
+ */
+int health_manager_get_totals(health_totals_s *out_totals, health_tile_weights_s **out_tile_weights)
+{
+    unsigned int sequence_before;
+    unsigned int sequence_after;
+
+    do
+    {
+        sequence_before = atomic_load_explicit(&g_health_manager.totals_sequence, memory_order_acquire);
+
+        // The copy may race with the writer, but then the sequence will have changed and it will be discarded
+        memcpy(out_totals, &g_health_manager.totals, sizeof(health_totals_s));
+
+        // Blocks the writer has replaced are never freed while it is running, so this is safe to copy even if the
+        // pointer is stale. The whole block is copied, so a torn ntiles can't make us read past the end of it
+        health_tile_weights_s *tile_weights = atomic_load_explicit(&g_health_manager.tile_weights, memory_order_acquire);
+
+        if ((*out_tile_weights)->capacity < tile_weights->capacity || (*out_tile_weights)->bandpass_bins != tile_weights->bandpass_bins)
+        {
+            health_tile_weights_s *grown = health_tile_weights_alloc(tile_weights->capacity, tile_weights->bandpass_bins);
+
+            if (grown == NULL)
+            {
+                return EXIT_FAILURE;
             }
 
-            // incremement baseline counter
-            baseline++;
+            health_tile_weights_free(*out_tile_weights);
+            *out_tile_weights = grown;
         }
-    }
 
-    pthread_mutex_unlock(&g_health_manager_mutex);
+        health_tile_weights_copy(*out_tile_weights, tile_weights);
+
+        atomic_thread_fence(memory_order_acquire);
+        sequence_after = atomic_load_explicit(&g_health_manager.totals_sequence, memory_order_relaxed);
+    } while ((sequence_before & 1) || sequence_before != sequence_after);
+
     return EXIT_SUCCESS;
 }
 
+/**
+ *
+ *  @brief Frees the tile weights (and any smaller blocks they replaced). Only call this once the ringbuffer
+ *         reader and the health thread have both finished, as either may still be using them.
+ */
+void health_manager_free_tile_weights()
+{
+    health_tile_weights_free(atomic_exchange(&g_health_manager.tile_weights, NULL));
+}
+
 /**
  *
  *  @brief Destroys the g_health_manager_mutex.
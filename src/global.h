@@ -12,9 +12,16 @@
 #include <fitsio.h>
 #include <linux/limits.h>
 #include <pthread.h>
+#include <stdatomic.h>
 #include <stdint.h>
+#include <time.h>
+#include "dada_header.h"
 #include "fitswriter.h"
+#include "hdu_index.h"
+#include "journal.h"
+#include "metrics.h"
 #include "multilog.h"
+#include "perfcounters.h"
 
 #define STATUS_OFFLINE 0
 #define STATUS_RUNNING 1
@@ -31,9 +38,55 @@
 #define IP_AS_STRING_LEN 16                            // xxx.xxx.xxx.xxx
 #define COARSE_CHANNEL_MAX 255                         // Highest possible coarse channel number
 #define INT_TIME_MSEC_MIN 200                          // Minimum integration time (milliseconds)
-#define NTILES_MAX 256                                 // Maxium number of tiles. This is ONLY used by the health packets. It's convenient to have a fixed array for the health packets
-                                                       // since before we see the first observation we won't know how many tiles to expect, meaning the receiving code handling the health
-                                                       // packets needs to be overly complex to handly 0 or n tiles.
+#define VIS_LAYOUT_BASELINE_MAJOR 0                    // Visibility HDUs are [baseline][finechan][pol][r,i] (default)
+#define VIS_LAYOUT_FINECHAN_MAJOR 1                    // Visibility HDUs are [finechan][baseline][pol][r,i]
+#define BAD_DATA_POLICY_KEEP 0                         // Integrations with NaN/Inf values or zero-power baselines are written as is (default)
+#define BAD_DATA_POLICY_ZERO_WEIGHT 1                  // ... are written, but the weights of the bad baselines are set to 0
+#define BAD_DATA_POLICY_DROP 2                         // ... are not written at all
+#define OVERLOAD_POLICY_WARN 0                         // Observations which need more than the measured disk bandwidth are logged and written as is (default)
+#define OVERLOAD_POLICY_SHED 1                         // ... are logged and written without the flags, channel statistics and autos outputs
+#define SPACE_POLICY_WARN 0                            // Observations which won't fit on the destination path are logged and written as is (default)
+#define SPACE_POLICY_REDIRECT 1                        // ... are written to the alternate path
+#define SPACE_POLICY_COMPRESS 2                        // ... are written with compressed HDUs
+#define SPACE_POLICY_REFUSE 3                          // ... are not written
+#define COMPRESSION_MODE_NONE 0                        // HDUs are written uncompressed (default)
+#define COMPRESSION_MODE_GZIP 1                        // Image HDUs are written tile compressed with GZIP_2 (byte shuffled), without quantising (lossless)
+#define NTILES_MAX 256                                 // Number of tiles in the fixed weights arrays of the health packet. It's convenient to have a fixed array for the health packets
+                                                       // since before we see the first observation we won't know how many tiles to expect. Any number of tiles is supported though:
+                                                       // the weights of every tile are also sent in the chunked tile weights messages (see health.h).
+
+#define BANDPASS_BINS_MAX 64                           // Most bins in the per tile bandpass summary sent with the health packets
+
+// The running totals of the weights and autocorrelation power of each tile. These are on the heap so any number of tiles is supported: when an
+// observation has more tiles than there is room for, a bigger block replaces this one (see health_manager_set_weights_info()).
+typedef struct health_tile_weights_s
+{
+    int capacity;                          // Number of tiles there is room for
+    int bandpass_bins;                     // Number of bins in each tile's bandpass summary (0 == none)
+    struct health_tile_weights_s *retired; // The smaller block this one replaced. Kept until health_manager_free_tile_weights(), as the health thread may still be copying it
+    double *weights_per_tile_x;            // Sum of the XX weight of each tile's autocorrelation (capacity of them, following this struct)
+    double *weights_per_tile_y;            // Sum of the YY weight of each tile's autocorrelation (capacity of them, following this struct)
+    double *auto_power_per_tile_x;         // Sum of the mean XX power of each tile's autocorrelation (capacity of them, following this struct)
+    double *auto_power_per_tile_y;         // Sum of the mean YY power of each tile's autocorrelation (capacity of them, following this struct)
+    double *bandpass_per_tile;             // Sum of the mean power in each bandpass bin: [tile][pol x,y][bin] (capacity * 2 * bandpass_bins of them)
+} health_tile_weights_s;
+
+// Running totals from every integration since the program started. These are only ever written by the thread
+// reading the ringbuffer and are read by the health thread, which sends the change since its last copy.
+typedef struct
+{
+    int ntiles;                            // Number of tiles in the most recent integration
+    uint64_t weights_counter;              // Number of integrations whose weights and auto power have been added (these are in health_thread_data_s.tile_weights)
+
+    uint64_t bad_data_scanned;             // Number of integrations scanned for bad data
+    uint64_t bad_data_integrations;        // Number of integrations with at least one bad baseline
+    uint64_t bad_data_dropped;             // Number of integrations dropped
+    uint64_t bad_data_nonfinite;           // Number of NaN/Inf visibility values
+    uint64_t bad_data_zero_baselines;      // Number of baselines with zero power
+
+    int perf_counters_available;                         // Bit mask (1 << PERF_COUNTER_...) of the counters being read. 0 == disabled
+    perf_stage_counts_s perf_stages[PERF_STAGE_COUNT]; // Hardware performance counters of each stage of dada_dbfits_io()
+} health_totals_s;
 
 typedef struct
 {
@@ -50,18 +103,31 @@ typedef struct
     // Data that changes during main loop
     long obs_id;
     long subobs_id;
+
+    // Destination path bandwidth (see diskprobe.h)
+    double disk_bytes_per_sec;     // Measured write bandwidth. 0 == not measured
+    double required_bytes_per_sec; // Rate the current observation writes at. 0 == not in an observation
+    int disk_state;                // DISKPROBE_STATE_...
+
+    // Destination path free space (see freespace.h)
+    uint64_t space_free_bytes;     // Free space where the current observation is being written
+    uint64_t space_forecast_bytes; // Space the rest of the current observation needs
+    int space_state;               // FREESPACE_STATE_...
+
     // The weights are in the dada datablock in after the visibilties.
-    // Here we keep 2 arrays of floats, 1 element per tile
-    // and accumulate the weights and increment the weights
-    // counter each time we accumulate. We want to get the tile weights,
-    // so we cheat and use the XX and YY (the weights given to mwax_db2fits
-    // are for baselines, not tiles).
-    // Then each health tick, we get the average weight for xx and yy
-    // (using weights_counter as the denominator) and send this with
-    // the health packet.
-    float weights_per_tile_x[NTILES_MAX];
-    float weights_per_tile_y[NTILES_MAX];
-    int weights_counter;
+    // We want to get the tile weights, so we cheat and use the XX and YY
+    // of each tile's autocorrelation (the weights given to mwax_db2fits
+    // are for baselines, not tiles) and add them to the running totals.
+    // Then each health tick, the health thread takes a copy of the totals
+    // and sends the average weight for xx and yy since its last copy.
+    //
+    // The totals are protected by a sequence lock rather than the mutex, so
+    // the thread reading the ringbuffer never waits on the health thread:
+    // totals_sequence is odd while the totals are being updated, and a copy
+    // is only good if totals_sequence was even and unchanged throughout.
+    atomic_uint totals_sequence;
+    health_totals_s totals;
+    _Atomic(health_tile_weights_s *) tile_weights;
 } health_thread_data_s;
 
 typedef struct dada_db_s
@@ -91,8 +157,98 @@ typedef struct dada_db_s
     int fits_file_number;
     long fits_file_size;
     long fits_file_size_limit;
+    int async_close;                                 // 1 == fits files are closed and renamed by the finaliser thread, not the ringbuffer reader
+    int hdu_index_enabled;                           // 1 == write a .idx sidecar of the HDU offsets of each integration with each fits file
+    hdu_index_s hdu_index;                           // The HDU offsets of each integration in the current fits file
+    int journal_enabled;                             // 1 == journal the completed integrations of each fits file, so it can be recovered after a crash
+    journal_s journal;                               // The journal of the current fits file
+    int join_in_progress;                            // 1 == join an observation which is already in progress, rather than skipping it
+    int preallocate;                                 // 1 == reserve the disk space each fits file is expected to need when it is created
+    uint64_t preallocated_bytes;                     // Disk space reserved for the current fits file when it was created. 0 == none
+
+    // Destination path bandwidth check
+    uint64_t disk_probe_bytes;                       // Bytes to write to measure the destination path's bandwidth. 0 == no measurement or check
+    int overload_policy;                             // OVERLOAD_POLICY_WARN or OVERLOAD_POLICY_SHED
+    double disk_bytes_per_sec;                       // The measured bandwidth the current observation was checked against. 0 == not measured
+    double required_bytes_per_sec;                   // Rate the current observation writes at
+    int disk_state;                                  // DISKPROBE_STATE_... of the current observation
+    float configured_rfi_threshold;                  // rfi_threshold, channel_stats and autos_average as given on the command line, as
+    int configured_channel_stats;                    // OVERLOAD_POLICY_SHED turns them off for an observation
+    int configured_autos_average;
+
+    // Destination path free space forecast
+    int space_policy;                                // SPACE_POLICY_WARN, SPACE_POLICY_REDIRECT, SPACE_POLICY_COMPRESS or SPACE_POLICY_REFUSE
+    char *alternate_destination_dir;                 // Where SPACE_POLICY_REDIRECT writes observations which won't fit on destination_dir. NULL == none
+    int compression_mode;                            // COMPRESSION_MODE_... of the current observation's fits files
+    uint64_t space_free_bytes;                       // Free space where the current observation is being written
+    uint64_t space_forecast_bytes;                   // Space the rest of the current observation needs
+    int space_state;                                 // FREESPACE_STATE_... of the current observation
+
+    // Visibility output layout
+    int vis_layout;                                  // VIS_LAYOUT_BASELINE_MAJOR or VIS_LAYOUT_FINECHAN_MAJOR
+    float *transpose_buffer;                         // Staging buffer for the frequency-major visibilities of one integration
+    uint64_t transpose_buffer_capacity;              // Allocated size of transpose_buffer
+
+    // Sub-observation cube output
+    int cube;                                        // 1 == write one visibility cube and one weights cube HDU per sub-observation, rather than 2 HDUs per integration
+    int cube_open;                                   // 1 == the current sub-observation's visibility cube HDU has been created, but its weights cube not yet written
+    int cube_integrations;                           // Number of integrations written into the current cube so far
+    long cube_unix_time;                             // UNIX time of the first integration in the cube
+    int cube_unix_time_msec;                         // UNIX milliseconds of the first integration in the cube
+    int cube_marker;                                 // Marker of the first integration in the cube
+    uint64_t cube_nonfinite;                         // Number of NaN/Inf values in the cube so far
+    uint64_t cube_zero_baselines;                    // Number of zero-power baselines (summed over integrations) in the cube so far
+    uint64_t cube_vis_header_offset;                 // Byte offset of the visibility cube's header, for the HDU index
+    uint64_t cube_vis_data_offset;                   // Byte offset of the visibility cube's data, for the HDU index
+    uint64_t cube_first_index_record;                // The HDU index record of the cube's first integration, whose weights offsets are filled in when it is finished
+    float *cube_weights;                             // Weights of every integration in the cube, [time][baseline][pol], written when the cube is finished
+    uint64_t cube_weights_capacity;                  // Allocated size of cube_weights
+
+    // RFI flagging
+    float rfi_threshold;                             // Flag fine channels more than this many sigma from the median. 0 == no flagging (and no flags HDUs)
+    int rfi_threads;                                 // Number of threads to flag with
+    unsigned char *rfi_flags;                        // Bit packed flags for the current integration: [baseline][finechan / 8]
+    uint64_t rfi_flags_capacity;                     // Allocated size of rfi_flags
+    float *rfi_scratch;                              // Per thread scratch space for flagging
+    uint64_t rfi_scratch_capacity;                   // Allocated size of rfi_scratch
+    uint64_t rfi_flagged;                            // Number of baseline/fine channels flagged in the current integration
+
+    // Per fine channel statistics
+    int channel_stats;                               // 1 == write a channel statistics BINTABLE HDU after each integration
+    channel_stats_s chan_stats;                      // Statistics of the current integration
+
+    // Bad data detection
+    int bad_data_policy;                             // BAD_DATA_POLICY_KEEP, BAD_DATA_POLICY_ZERO_WEIGHT or BAD_DATA_POLICY_DROP
+    unsigned char *bad_baselines;                    // 1 per baseline with NaN/Inf values or zero power in the current integration
+    uint64_t bad_baselines_capacity;                 // Allocated size of bad_baselines
+    float *bad_data_weights;                         // Staging buffer for the weights with the bad baselines zeroed (BAD_DATA_POLICY_ZERO_WEIGHT)
+    uint64_t bad_data_weights_capacity;              // Allocated size of bad_data_weights
+
+    // Hardware performance counters
+    perf_counters_s perf;                            // Counters around each stage of dada_dbfits_io(). perf.enabled == 0 if disabled
+
+    // End to end latency
+    uint64_t *file_integration_usec;                 // UNIX time (usec) of each integration in the current fits file, for when it is renamed
+    uint64_t file_integration_count;                 // Number of integrations in file_integration_usec
+    uint64_t file_integration_capacity;              // Allocated size (elements) of file_integration_usec
+    metrics_snapshot_s *obs_start_metrics;           // The metrics when the observation started, so its latencies can be logged when it ends
+    metrics_snapshot_s *obs_end_metrics;             // The metrics when the observation ended
+
+    // Autocorrelation sidecar FITS info
+    int autos_average;                               // Number of integrations averaged into each autos HDU. 0 == no autos sidecar file
+    fitsfile *autos_fits_ptr;
+    char autos_fits_filename[PATH_MAX - 4];          // we subtract 4 so we ensure temp_autos_fits_filename can fit autos_fits_filename + '.tmp'
+    char temp_autos_fits_filename[PATH_MAX];
+    float *autos_buffer;                             // Accumulated autocorrelations for the current average: [tile][finechan][pol][r,i]
+    uint64_t autos_buffer_bytes;                     // Size of autos_buffer in use for this observation
+    uint64_t autos_buffer_capacity;                  // Allocated size of autos_buffer
+    int autos_counter;                               // Number of integrations accumulated in autos_buffer so far
+    long autos_unix_time;                            // UNIX time of the first integration in autos_buffer
+    int autos_unix_time_msec;                        // UNIX milliseconds of the first integration in autos_buffer
+    int autos_marker;                                // Marker of the first integration in autos_buffer
 
     // Observation info
+    dada_header_s parsed_header;                     // The current sub-observation's header, split into keywords once by dada_dbfits_open()
     int populated;
     long obs_id;
     long subobs_id;
@@ -124,6 +280,8 @@ typedef struct dada_db_s
     int no_of_integrations_per_subobs;
     uint64_t expected_transfer_size_of_one_fine_channel;
     uint64_t expected_transfer_size_of_weights;
+    uint64_t expected_transfer_size_of_flags;
+    uint64_t expected_transfer_size_of_chanstats;
     uint64_t expected_transfer_size_of_integration;
     uint64_t expected_transfer_size_of_integration_plus_weights;
     uint64_t expected_transfer_size_of_subobs;
@@ -137,15 +295,37 @@ int quit_get();
 int quit_destroy();
 
 // Methods for managing data which will be used eventually to send health packets
-int health_manager_init();
+int health_manager_init(int bandpass_bins);
 int health_manager_set_info(int status, long obs_id, long subobs_id);
 int health_manager_get_info(int *status, long *obs_id, long *subobs_id, float *weights_per_tile_x, float *weights_per_tile_y);
-int health_manager_set_weights_info(float *buffer, int ntiles);
+int health_manager_set_weights_info(float *buffer, const float *visibilities, int ntiles, int nfine_chan);
+int health_manager_add_bad_data_info(uint64_t nonfinite, uint64_t zero_baselines, int dropped);
+int health_manager_set_disk_info(double disk_bytes_per_sec, double required_bytes_per_sec, int disk_state);
+int health_manager_set_disk_bandwidth(double disk_bytes_per_sec);
+int health_manager_set_space_info(uint64_t free_bytes, uint64_t forecast_bytes, int space_state);
+int health_manager_add_perf_info(const perf_stage_counts_s *stages, int available);
+int health_manager_get_totals(health_totals_s *out_totals, health_tile_weights_s **out_tile_weights);
+health_tile_weights_s *health_tile_weights_alloc(int capacity, int bandpass_bins);
+void health_tile_weights_copy(health_tile_weights_s *dest, const health_tile_weights_s *src);
+void health_tile_weights_free(health_tile_weights_s *tile_weights);
+void health_manager_free_tile_weights();
 int health_manager_destroy();
 
 // Method for compression mode
 const char *compression_mode_name(int compression_mode);
 
+// Method for visibility layout
+const char *vis_layout_name(int vis_layout);
+
+// Method for bad data policy
+const char *bad_data_policy_name(int bad_data_policy);
+
+// Method for overload policy
+const char *overload_policy_name(int overload_policy);
+
+// Method for space policy
+const char *space_policy_name(int space_policy);
+
 // Ensure these global vars only get create once for the entire program (not per compile unit)
 #ifndef GLOBAL_H
 #define GLOBAL_H
@@ -155,5 +335,7 @@ extern int g_quit;
 extern pthread_mutex_t g_health_manager_mutex;
 extern health_thread_data_s g_health_manager;
 
+extern metrics_s g_metrics;
+
 extern dada_db_s g_ctx;
 #endif
\ No newline at end of file
@@ -0,0 +1,406 @@
+/**
+ * @file hdu_index.c
+ * @author Greg Sleap
+ * @date 18 Oct 2026
+ * @brief This is the code that writes and reads the .idx sidecar file of the byte offsets of every visibility and
+ *        weights HDU (--hdu-index)
+ *
+ * Finding integration N of a fits file otherwise means reading every HDU header before it. The writer knows where
+ * each HDU went as it writes it, so it records the offsets (from cfitsio) of each integration's visibility and weights
+ * HDUs, and writes them to a small binary file next to the fits file once that is complete. A reader memory maps the
+ * index and the fits file and goes straight to the data of any integration, without copying or parsing anything.
+ */
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "hdu_index.h"
+
+_Static_assert(sizeof(hdu_index_header_s) == 64, "hdu_index_header_s must be 64 bytes");
+_Static_assert(sizeof(hdu_index_record_s) == 64, "hdu_index_record_s must be 64 bytes");
+
+/**
+ *
+ *  @brief Empties the index, ready for a new fits file. The records are kept allocated.
+ *  @param[in,out] index The index.
+ *  @param[in] obs_id The obs id of the fits file.
+ *  @param[in] coarse_channel The coarse channel of the fits file.
+ *  @param[in] fits_file_number The number of the fits file in the observation.
+ */
+void hdu_index_reset(hdu_index_s *index, long obs_id, int coarse_channel, int fits_file_number)
+{
+  memset(&index->header, 0, sizeof(hdu_index_header_s));
+  memcpy(index->header.magic, HDU_INDEX_MAGIC, HDU_INDEX_MAGIC_LEN);
+  index->header.version = HDU_INDEX_VERSION;
+  index->header.record_size = sizeof(hdu_index_record_s);
+  index->header.obs_id = obs_id;
+  index->header.coarse_channel = coarse_channel;
+  index->header.fits_file_number = fits_file_number;
+}
+
+/**
+ *
+ *  @brief Gets the byte offsets of the current HDU (i.e. the one just written) of a fits file.
+ *  @param[in] fptr The fits file.
+ *  @param[out] header_offset Offset of the HDU's header from the start of the file.
+ *  @param[out] data_offset Offset of the HDU's data from the start of the file.
+ *  @returns EXIT_SUCCESS on success, or EXIT_FAILURE if there was an error.
+ */
+int hdu_index_get_hdu_offsets(fitsfile *fptr, uint64_t *header_offset, uint64_t *data_offset)
+{
+  LONGLONG head_start = 0;
+  LONGLONG data_start = 0;
+  LONGLONG data_end = 0;
+  int status = 0;
+
+  if (fits_get_hduaddrll(fptr, &head_start, &data_start, &data_end, &status))
+  {
+    return EXIT_FAILURE;
+  }
+
+  *header_offset = (uint64_t)head_start;
+  *data_offset = (uint64_t)data_start;
+
+  return EXIT_SUCCESS;
+}
+
+/**
+ *
+ *  @brief Adds an integration to the index, growing it if needed.
+ *  @param[in,out] index The index.
+ *  @param[in] record The integration's HDU offsets.
+ *  @returns EXIT_SUCCESS on success, or EXIT_FAILURE if there was an error.
+ */
+int hdu_index_add(hdu_index_s *index, const hdu_index_record_s *record)
+{
+  if (index->header.record_count == index->capacity)
+  {
+    uint64_t new_capacity = (index->capacity == 0 ? 64 : index->capacity * 2);
+    hdu_index_record_s *records = realloc(index->records, new_capacity * sizeof(hdu_index_record_s));
+
+    if (records == NULL)
+    {
+      return EXIT_FAILURE;
+    }
+
+    index->records = records;
+    index->capacity = new_capacity;
+  }
+
+  index->records[index->header.record_count++] = *record;
+
+  return EXIT_SUCCESS;
+}
+
+/**
+ *
+ *  @brief Copies an index (e.g. so it can be written after the original has moved on to the next fits file).
+ *  @param[out] dest The copy. Free it with hdu_index_free().
+ *  @param[in] src The index to copy.
+ *  @returns EXIT_SUCCESS on success, or EXIT_FAILURE if there was an error.
+ */
+int hdu_index_copy(hdu_index_s *dest, const hdu_index_s *src)
+{
+  dest->header = src->header;
+  dest->records = NULL;
+  dest->capacity = 0;
+
+  if (src->header.record_count > 0)
+  {
+    dest->records = malloc(src->header.record_count * sizeof(hdu_index_record_s));
+
+    if (dest->records == NULL)
+    {
+      dest->header.record_count = 0;
+      return EXIT_FAILURE;
+    }
+
+    memcpy(dest->records, src->records, src->header.record_count * sizeof(hdu_index_record_s));
+    dest->capacity = src->header.record_count;
+  }
+
+  return EXIT_SUCCESS;
+}
+
+/**
+ *
+ *  @brief Frees the records of an index.
+ *  @param[in,out] index The index.
+ */
+void hdu_index_free(hdu_index_s *index)
+{
+  free(index->records);
+  index->records = NULL;
+  index->capacity = 0;
+  index->header.record_count = 0;
+}
+
+/**
+ *
+ *  @brief Works out the name of the index of a fits file: the same name, with .idx instead of .fits.
+ *  @param[in] fits_filename The fits filename.
+ *  @param[out] index_filename The index filename.
+ *  @param[in] index_filename_size The size of index_filename.
+ */
+void hdu_index_filename(const char *fits_filename, char *index_filename, size_t index_filename_size)
+{
+  size_t len = strlen(fits_filename);
+
+  if (len >= 5 && strcmp(fits_filename + len - 5, ".fits") == 0)
+  {
+    len -= 5;
+  }
+
+  snprintf(index_filename, index_filename_size, "%.*s%s", (int)len, fits_filename, HDU_INDEX_EXTENSION);
+}
+
+/**
+ *
+ *  @brief Writes the index of a complete fits file. It is written to a .tmp file and then renamed, so a reader never
+ *         sees a partial index.
+ *  @param[in] index The index.
+ *  @param[in] fits_filename The (final) name of the fits file it is the index of.
+ *  @param[in] log The logger to use.
+ *  @returns EXIT_SUCCESS on success, or EXIT_FAILURE if there was an error.
+ */
+int hdu_index_write(const hdu_index_s *index, const char *fits_filename, multilog_t *log)
+{
+  char index_filename[PATH_MAX];
+  char temp_index_filename[PATH_MAX + 4];
+  hdu_index_filename(fits_filename, index_filename, sizeof(index_filename));
+  snprintf(temp_index_filename, sizeof(temp_index_filename), "%s.tmp", index_filename);
+
+  FILE *index_file = fopen(temp_index_filename, "wb");
+
+  if (index_file == NULL)
+  {
+    multilog(log, LOG_ERR, "hdu_index_write(): Error creating %s: %s\n", temp_index_filename, strerror(errno));
+    return EXIT_FAILURE;
+  }
+
+  int ok = (fwrite(&index->header, sizeof(hdu_index_header_s), 1, index_file) == 1);
+
+  if (ok && index->header.record_count > 0)
+  {
+    ok = (fwrite(index->records, sizeof(hdu_index_record_s), index->header.record_count, index_file) == index->header.record_count);
+  }
+
+  if (fclose(index_file) != 0)
+  {
+    ok = 0;
+  }
+
+  if (!ok || rename(temp_index_filename, index_filename) != 0)
+  {
+    multilog(log, LOG_ERR, "hdu_index_write(): Error writing %s: %s\n", index_filename, strerror(errno));
+    unlink(temp_index_filename);
+    return EXIT_FAILURE;
+  }
+
+  multilog(log, LOG_DEBUG, "hdu_index_write(): Wrote %lu integrations to %s\n", index->header.record_count, index_filename);
+
+  return EXIT_SUCCESS;
+}
+
+/**
+ *
+ *  @brief Memory maps a whole file read only.
+ *  @param[in] filename The file.
+ *  @param[out] size The size of the file.
+ *  @returns The mapping, or NULL if there was an error (or the file is empty).
+ */
+static void *map_file(const char *filename, size_t *size)
+{
+  int fd = open(filename, O_RDONLY);
+
+  if (fd == -1)
+  {
+    return NULL;
+  }
+
+  struct stat file_stat;
+  void *map = NULL;
+
+  if (fstat(fd, &file_stat) == 0 && file_stat.st_size > 0)
+  {
+    *size = (size_t)file_stat.st_size;
+    map = mmap(NULL, *size, PROT_READ, MAP_SHARED, fd, 0);
+
+    if (map == MAP_FAILED)
+    {
+      map = NULL;
+    }
+  }
+
+  // The mapping stays valid after the file is closed
+  close(fd);
+
+  return map;
+}
+
+/**
+ *
+ *  @brief Opens the index of a fits file (filename.idx) and the fits file itself for reading. Both are memory mapped,
+ *         and the index is checked against the fits file.
+ *  @param[out] reader The reader. Close it with hdu_index_reader_close().
+ *  @param[in] fits_filename The fits file.
+ *  @returns EXIT_SUCCESS on success, or EXIT_FAILURE if either file could not be mapped or the index is not valid.
+ */
+int hdu_index_reader_open(hdu_index_reader_s *reader, const char *fits_filename)
+{
+  memset(reader, 0, sizeof(hdu_index_reader_s));
+
+  char index_filename[PATH_MAX];
+  hdu_index_filename(fits_filename, index_filename, sizeof(index_filename));
+
+  reader->index_map = map_file(index_filename, &reader->index_map_size);
+  reader->fits = map_file(fits_filename, &reader->fits_size);
+
+  if (reader->index_map == NULL || reader->fits == NULL || reader->index_map_size < sizeof(hdu_index_header_s))
+  {
+    hdu_index_reader_close(reader);
+    return EXIT_FAILURE;
+  }
+
+  reader->header = (const hdu_index_header_s *)reader->index_map;
+
+  if (memcmp(reader->header->magic, HDU_INDEX_MAGIC, HDU_INDEX_MAGIC_LEN) != 0 || reader->header->version != HDU_INDEX_VERSION ||
+      reader->header->record_size != sizeof(hdu_index_record_s) ||
+      reader->header->record_count > (reader->index_map_size - sizeof(hdu_index_header_s)) / sizeof(hdu_index_record_s))
+  {
+    hdu_index_reader_close(reader);
+    return EXIT_FAILURE;
+  }
+
+  reader->records = (const hdu_index_record_s *)((const uint8_t *)reader->index_map + sizeof(hdu_index_header_s));
+  reader->record_count = reader->header->record_count;
+
+  // Every HDU must be within the fits file, so the data pointers handed out are always safe to read
+  for (uint64_t r = 0; r < reader->record_count; r++)
+  {
+    const hdu_index_record_s *record = &reader->records[r];
+
+    if (record->vis_data_offset > reader->fits_size || record->vis_data_bytes > reader->fits_size - record->vis_data_offset ||
+        record->weights_data_offset > reader->fits_size || record->weights_data_bytes > reader->fits_size - record->weights_data_offset)
+    {
+      hdu_index_reader_close(reader);
+      return EXIT_FAILURE;
+    }
+  }
+
+  return EXIT_SUCCESS;
+}
+
+/**
+ *
+ *  @brief Unmaps the index and fits file.
+ *  @param[in,out] reader The reader.
+ */
+void hdu_index_reader_close(hdu_index_reader_s *reader)
+{
+  if (reader->index_map != NULL)
+  {
+    munmap(reader->index_map, reader->index_map_size);
+  }
+
+  if (reader->fits != NULL)
+  {
+    munmap((void *)reader->fits, reader->fits_size);
+  }
+
+  memset(reader, 0, sizeof(hdu_index_reader_s));
+}
+
+/**
+ *
+ *  @brief Finds the integration with a marker. Markers increase through a fits file, so this is a binary search.
+ *  @param[in] reader The reader.
+ *  @param[in] marker The marker.
+ *  @returns The integration's record, or NULL if there is none with that marker.
+ */
+const hdu_index_record_s *hdu_index_reader_find_marker(const hdu_index_reader_s *reader, int marker)
+{
+  uint64_t low = 0;
+  uint64_t high = reader->record_count;
+
+  while (low < high)
+  {
+    uint64_t mid = low + (high - low) / 2;
+
+    if (reader->records[mid].marker < marker)
+    {
+      low = mid + 1;
+    }
+    else
+    {
+      high = mid;
+    }
+  }
+
+  return (low < reader->record_count && reader->records[low].marker == marker) ? &reader->records[low] : NULL;
+}
+
+/**
+ *
+ *  @brief Gets the visibilities of an integration, in place in the mapped fits file (big-endian, as in any fits
+ *         file: see hdu_index_copy_floats()).
+ *  @param[in] reader The reader.
+ *  @param[in] integration The integration (0 is the first in the file).
+ *  @param[out] bytes The size of the visibilities.
+ *  @returns The visibilities, or NULL if there is no such integration.
+ */
+const void *hdu_index_reader_visibilities(const hdu_index_reader_s *reader, uint64_t integration, uint64_t *bytes)
+{
+  if (integration >= reader->record_count)
+  {
+    return NULL;
+  }
+
+  *bytes = reader->records[integration].vis_data_bytes;
+
+  return reader->fits + reader->records[integration].vis_data_offset;
+}
+
+/**
+ *
+ *  @brief Gets the weights of an integration, in place in the mapped fits file (big-endian).
+ *  @param[in] reader The reader.
+ *  @param[in] integration The integration (0 is the first in the file).
+ *  @param[out] bytes The size of the weights.
+ *  @returns The weights, or NULL if there is no such integration.
+ */
+const void *hdu_index_reader_weights(const hdu_index_reader_s *reader, uint64_t integration, uint64_t *bytes)
+{
+  if (integration >= reader->record_count)
+  {
+    return NULL;
+  }
+
+  *bytes = reader->records[integration].weights_data_bytes;
+
+  return reader->fits + reader->records[integration].weights_data_offset;
+}
+
+/**
+ *
+ *  @brief Copies big-endian floats (e.g. from hdu_index_reader_visibilities()) into native floats.
+ *  @param[out] dest The native floats.
+ *  @param[in] big_endian_src The big-endian floats (need not be aligned).
+ *  @param[in] count The number of floats.
+ */
+void hdu_index_copy_floats(float *dest, const void *big_endian_src, uint64_t count)
+{
+  const uint8_t *src = (const uint8_t *)big_endian_src;
+
+  for (uint64_t i = 0; i < count; i++)
+  {
+    uint32_t bits = ((uint32_t)src[i * 4] << 24) | ((uint32_t)src[i * 4 + 1] << 16) | ((uint32_t)src[i * 4 + 2] << 8) | src[i * 4 + 3];
+    memcpy(&dest[i], &bits, sizeof(float));
+  }
+}
\ No newline at end of file
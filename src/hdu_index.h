@@ -0,0 +1,86 @@
+/**
+ * @file hdu_index.h
+ * @author Greg Sleap
+ * @date 18 Oct 2026
+ * @brief This is the header for the .idx sidecar file of the byte offsets of every visibility and weights HDU
+ *
+ */
+#pragma once
+
+#include <fitsio.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "multilog.h"
+
+#define HDU_INDEX_MAGIC "MWAXIDX1"
+#define HDU_INDEX_MAGIC_LEN 8
+#define HDU_INDEX_VERSION 1
+#define HDU_INDEX_EXTENSION ".idx" // Replaces .fits
+
+//
+// The .idx file is a hdu_index_header_s followed by record_count hdu_index_record_s, one per integration in the order
+// they are in the fits file. All values are little-endian (the byte order of the machine that wrote them), unlike the
+// fits file. Offsets are from the start of the fits file. Both structs are 64 bytes with no padding.
+//
+typedef struct
+{
+  char magic[HDU_INDEX_MAGIC_LEN]; // HDU_INDEX_MAGIC (not NUL terminated)
+  uint32_t version;                // HDU_INDEX_VERSION
+  uint32_t record_size;            // sizeof(hdu_index_record_s), so readers can skip fields added in later versions
+  uint64_t record_count;           // Number of integrations
+  int64_t obs_id;
+  int32_t coarse_channel;
+  int32_t fits_file_number;        // The _FFF of the fits filename
+  uint8_t reserved[24];
+} hdu_index_header_s;
+
+typedef struct
+{
+  int32_t marker;                 // MARKER of the integration
+  int32_t millitim;               // MILLITIM
+  int64_t time;                   // TIME (UNIX seconds)
+  uint64_t vis_header_offset;     // Byte offset of the visibility HDU's header
+  uint64_t vis_data_offset;       // Byte offset of the visibility HDU's data (big-endian floats, as in any fits file)
+  uint64_t vis_data_bytes;        // Size of the visibility data (excluding the padding to a whole fits block)
+  uint64_t weights_header_offset; // Byte offset of the weights HDU's header
+  uint64_t weights_data_offset;   // Byte offset of the weights HDU's data
+  uint64_t weights_data_bytes;    // Size of the weights data
+} hdu_index_record_s;
+
+// The index of the fits file being written
+typedef struct
+{
+  hdu_index_header_s header;
+  hdu_index_record_s *records;
+  uint64_t capacity; // Allocated size (elements) of records
+} hdu_index_s;
+
+// An index and its fits file, memory mapped for reading
+typedef struct
+{
+  const hdu_index_header_s *header;
+  const hdu_index_record_s *records;
+  uint64_t record_count;
+  const uint8_t *fits;  // The whole fits file
+  size_t fits_size;
+  void *index_map;
+  size_t index_map_size;
+} hdu_index_reader_s;
+
+// Writing
+void hdu_index_reset(hdu_index_s *index, long obs_id, int coarse_channel, int fits_file_number);
+int hdu_index_get_hdu_offsets(fitsfile *fptr, uint64_t *header_offset, uint64_t *data_offset);
+int hdu_index_add(hdu_index_s *index, const hdu_index_record_s *record);
+int hdu_index_copy(hdu_index_s *dest, const hdu_index_s *src);
+void hdu_index_free(hdu_index_s *index);
+void hdu_index_filename(const char *fits_filename, char *index_filename, size_t index_filename_size);
+int hdu_index_write(const hdu_index_s *index, const char *fits_filename, multilog_t *log);
+
+// Reading
+int hdu_index_reader_open(hdu_index_reader_s *reader, const char *fits_filename);
+void hdu_index_reader_close(hdu_index_reader_s *reader);
+const hdu_index_record_s *hdu_index_reader_find_marker(const hdu_index_reader_s *reader, int marker);
+const void *hdu_index_reader_visibilities(const hdu_index_reader_s *reader, uint64_t integration, uint64_t *bytes);
+const void *hdu_index_reader_weights(const hdu_index_reader_s *reader, uint64_t integration, uint64_t *bytes);
+void hdu_index_copy_floats(float *dest, const void *big_endian_src, uint64_t count);
\ No newline at end of file
@@ -7,15 +7,100 @@
  */
 #include <arpa/inet.h>
 #include <math.h>
+#include <stddef.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/socket.h>
 #include <unistd.h>
 #include <time.h>
 #include "health.h"
+#include "probes.h"
+#include "trace.h"
 #include "utils.h"
 #include "version.h"
 
+/**
+ *
+ *  @brief Fills in a health packet latency summary from the change in a latency histogram between two metrics snapshots.
+ *  @param[in] metrics The latest snapshot.
+ *  @param[in] previous_metrics The snapshot the previous health packet used.
+ *  @param[in] latency Which latency (METRICS_LATENCY_...).
+ *  @param[out] out_latency The summary in the health packet. Values too big for 32 bits are capped.
+ */
+static void health_latency_summary(const metrics_snapshot_s *metrics, const metrics_snapshot_s *previous_metrics, int latency, health_latency_s *out_latency)
+{
+    metrics_latency_summary_s summary;
+    metrics_summarise_latency(metrics, previous_metrics, latency, &summary);
+
+    out_latency->count = (summary.count > UINT32_MAX ? UINT32_MAX : summary.count);
+    out_latency->p50_usec = (summary.p50_usec > UINT32_MAX ? UINT32_MAX : summary.p50_usec);
+    out_latency->p99_usec = (summary.p99_usec > UINT32_MAX ? UINT32_MAX : summary.p99_usec);
+    out_latency->max_usec = (summary.max_usec > UINT32_MAX ? UINT32_MAX : summary.max_usec);
+}
+
+/**
+ *
+ *  @brief Works out the average of a tile's weight, auto power or bandpass bin since the previous health packet.
+ *  @param[in] totals The running totals (e.g. weights_per_tile_x of the latest copy of the tile weights).
+ *  @param[in] previous_totals The same running totals from the copy the previous health packet used.
+ *  @param[in] previous_capacity Number of tiles in the previous copy. Tiles beyond this had no totals then.
+ *  @param[in] tile Which tile.
+ *  @param[in] index Index of the value in totals (the tile, or for the bandpass, the tile's bin).
+ *  @param[in] weights_counter Number of integrations added since the previous health packet.
+ *  @returns The average.
+ */
+static float tile_average(const double *totals, const double *previous_totals, int previous_capacity, int tile, uint64_t index, uint64_t weights_counter)
+{
+    double previous_total = (tile < previous_capacity ? previous_totals[index] : 0);
+
+    return (totals[index] - previous_total) / weights_counter;
+}
+
+// Set by the health thread once its socket and buffers are ready, so main() can start reading straight away rather
+// than sleeping for long enough that it must have started
+static pthread_mutex_t health_ready_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t health_ready_cond = PTHREAD_COND_INITIALIZER;
+static int health_ready = 0;
+
+/**
+ *
+ *  @brief Tells anyone waiting in health_wait_ready() that the health thread is ready to send.
+ */
+static void health_set_ready()
+{
+    pthread_mutex_lock(&health_ready_mutex);
+    health_ready = 1;
+    pthread_cond_broadcast(&health_ready_cond);
+    pthread_mutex_unlock(&health_ready_mutex);
+}
+
+/**
+ *
+ *  @brief Waits for the health thread to be ready to send (it exits the process if it can't be).
+ *  @param[in] timeout_sec The longest to wait.
+ *  @returns EXIT_SUCCESS once it is ready, or EXIT_FAILURE if it was not ready in time.
+ */
+int health_wait_ready(int timeout_sec)
+{
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += timeout_sec;
+
+    pthread_mutex_lock(&health_ready_mutex);
+
+    int rc = 0;
+
+    while (!health_ready && rc == 0)
+    {
+        rc = pthread_cond_timedwait(&health_ready_cond, &health_ready_mutex, &deadline);
+    }
+
+    int ready = health_ready;
+    pthread_mutex_unlock(&health_ready_mutex);
+
+    return (ready ? EXIT_SUCCESS : EXIT_FAILURE);
+}
+
 /**
  *
  *  @brief This is the main health thread function to send health out_udp_data for this process via UDP.
@@ -31,6 +116,8 @@ void *health_thread_fn(void *args)
 
     multilog(health_args->log, LOG_INFO, "Health: Thread started.\n");
 
+    trace_set_thread_name("health");
+
     health_args->health_udp_interface_ip = malloc(sizeof(char) * IP_AS_STRING_LEN);
 
     // Get the ip for the outbound multicast interface for health
@@ -112,6 +199,54 @@ void *health_thread_fn(void *args)
     // Gather stats
     health_udp_data_s out_udp_data;
 
+    // Running totals from the thread reading the ringbuffer: the latest copy, and the copy the previous health packet used
+    health_totals_s totals;
+    health_totals_s previous_totals;
+
+    // ... and the same for the weights of each tile. These grow if an observation has more than NTILES_MAX tiles
+    int bandpass_bins = atomic_load(&health_args->tile_weights)->bandpass_bins;
+    health_tile_weights_s *tile_weights = health_tile_weights_alloc(NTILES_MAX, bandpass_bins);
+    health_tile_weights_s *previous_tile_weights = health_tile_weights_alloc(NTILES_MAX, bandpass_bins);
+
+    if (tile_weights == NULL || previous_tile_weights == NULL || health_manager_get_totals(&previous_totals, &previous_tile_weights) != EXIT_SUCCESS)
+    {
+        multilog(health_args->log, LOG_ERR, "Health: Could not allocate memory for tile weights.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    // The tile weights messages sent after each health packet
+    health_tile_weights_msg_s out_tile_weights_msg;
+    memset(&out_tile_weights_msg, 0, sizeof(out_tile_weights_msg));
+    out_tile_weights_msg.header.magic = HEALTH_TILE_WEIGHTS_MAGIC;
+    out_tile_weights_msg.header.version = HEALTH_TILE_WEIGHTS_VERSION;
+    out_tile_weights_msg.header.header_size = sizeof(health_tile_weights_header_s);
+    strncpy(out_tile_weights_msg.header.hostname, health_args->hostname, HOST_NAME_LEN);
+    out_tile_weights_msg.header.bandpass_bins = bandpass_bins;
+
+    // As many tiles as fit in each message: weights, auto power and the bandpass bins for both pols
+    int values_per_tile = 4 + (2 * bandpass_bins);
+    int tiles_per_chunk = (sizeof(out_tile_weights_msg.values) / sizeof(float)) / values_per_tile;
+
+    // Copies of the metrics: the latest, and the one the previous health packet used (these are too big for the stack)
+    metrics_snapshot_s *metrics = malloc(sizeof(metrics_snapshot_s));
+    metrics_snapshot_s *previous_metrics = malloc(sizeof(metrics_snapshot_s));
+
+    if (metrics == NULL || previous_metrics == NULL)
+    {
+        multilog(health_args->log, LOG_ERR, "Health: Could not allocate memory for metrics.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    metrics_snapshot(previous_metrics);
+    uint64_t previous_metrics_ns = metrics_now_ns();
+
+    // Ringbuffer block counts (and when they were sampled) for the last HEALTH_RATE_WINDOW_SAMPLES health packets,
+    // so the read and write rates are not thrown about by a block arriving just before or after a packet
+    uint64_t window_ns[HEALTH_RATE_WINDOW_SAMPLES];
+    uint64_t window_bufs_written[HEALTH_RATE_WINDOW_SAMPLES];
+    uint64_t window_bufs_read[HEALTH_RATE_WINDOW_SAMPLES];
+    uint64_t window_count = 0;
+
     // initialise Weights in UDP struct
     for (int i = 0; i < NTILES_MAX; i++)
     {
@@ -130,6 +265,16 @@ void *health_thread_fn(void *args)
     // Time
     out_udp_data.start_time = start_time;
 
+    // Extension info
+    out_udp_data.ext_version = HEALTH_EXT_VERSION;
+    out_udp_data.ext_size = sizeof(health_udp_data_s) - offsetof(health_udp_data_s, ext_version);
+    out_udp_data.bad_data_policy = g_ctx.bad_data_policy;
+    out_udp_data.sequence = 0;
+    out_udp_data.bandpass_bins = bandpass_bins;
+
+    multilog(health_args->log, LOG_INFO, "Health: Ready.\n");
+    health_set_ready();
+
     int quit = quit_get();
 
     while (!quit)
@@ -142,31 +287,47 @@ void *health_thread_fn(void *args)
         out_udp_data.status = g_health_manager.status;
         out_udp_data.obs_id = g_health_manager.obs_id;
         out_udp_data.subobs_id = g_health_manager.subobs_id;
+        out_udp_data.disk_bytes_per_sec = g_health_manager.disk_bytes_per_sec;
+        out_udp_data.required_bytes_per_sec = g_health_manager.required_bytes_per_sec;
+        out_udp_data.disk_state = g_health_manager.disk_state;
+        out_udp_data.space_free_bytes = g_health_manager.space_free_bytes;
+        out_udp_data.space_forecast_bytes = g_health_manager.space_forecast_bytes;
+        out_udp_data.space_state = g_health_manager.space_state;
+        pthread_mutex_unlock(&g_health_manager_mutex);
+
+        // Get a copy of the running totals. This never blocks the thread reading the ringbuffer.
+        TRACE_BEGIN("health_packet");
+        uint64_t packet_start_ns = MWAX_PROBE_START_NS(health_packet_sent);
+        if (health_manager_get_totals(&totals, &tile_weights) != EXIT_SUCCESS)
+        {
+            multilog(health_args->log, LOG_ERR, "Health: Could not allocate memory for tile weights.\n");
+            exit(EXIT_FAILURE);
+        }
 
         // We want to provide the health packet with an average
-        // of the weights we've been accumulating,
+        // of the weights accumulated since the last health packet,
         // but only if we have at least 1 set of weights
 
-        // NOTE: before the first obs comes through ninputs will be 0!
-        // and weights counter will be 0 too
-        int ntiles = g_ctx.ninputs / 2;
+        // NOTE: before the first obs comes through ntiles will be 0!
+        int ntiles = totals.ntiles;
+        uint64_t weights_counter = totals.weights_counter - previous_totals.weights_counter;
 
         // If there has been at least one timestep with weights since the last health packet we will have ntiles>0 too...
-        if (g_health_manager.weights_counter > 0)
+        if (weights_counter > 0)
         {
             // Store the average weight per tile and pol in the UDP health struct
-            for (int tile = 0; tile < ntiles; tile++)
-            {
-                out_udp_data.weights_per_tile_x[tile] = g_health_manager.weights_per_tile_x[tile] / g_health_manager.weights_counter;
-                out_udp_data.weights_per_tile_y[tile] = g_health_manager.weights_per_tile_y[tile] / g_health_manager.weights_counter;
-            }
-
-            // reset the weights now that we have got them ready to send via UDP
-            g_health_manager.weights_counter = 0;
-            for (int tile = 0; tile < ntiles; tile++)
+            for (int tile = 0; tile < NTILES_MAX; tile++)
             {
-                g_health_manager.weights_per_tile_x[tile] = 0.0;
-                g_health_manager.weights_per_tile_y[tile] = 0.0;
+                if (tile < ntiles)
+                {
+                    out_udp_data.weights_per_tile_x[tile] = tile_average(tile_weights->weights_per_tile_x, previous_tile_weights->weights_per_tile_x, previous_tile_weights->capacity, tile, tile, weights_counter);
+                    out_udp_data.weights_per_tile_y[tile] = tile_average(tile_weights->weights_per_tile_y, previous_tile_weights->weights_per_tile_y, previous_tile_weights->capacity, tile, tile, weights_counter);
+                }
+                else
+                {
+                    out_udp_data.weights_per_tile_x[tile] = NAN;
+                    out_udp_data.weights_per_tile_y[tile] = NAN;
+                }
             }
         }
         else
@@ -180,13 +341,110 @@ void *health_thread_fn(void *args)
             }
         }
 
-        pthread_mutex_unlock(&g_health_manager_mutex);
+        // Every tile's weights go in the tile weights messages, however many tiles there are
+        out_udp_data.sequence++;
+        out_udp_data.ntiles = (weights_counter > 0 ? ntiles : 0);
+        out_udp_data.tile_weights_chunks = (out_udp_data.ntiles + tiles_per_chunk - 1) / tiles_per_chunk;
+
+        // A tile with no power in either pol is dead, whatever its weights say
+        out_udp_data.dead_tiles = 0;
+
+        for (int tile = 0; tile < out_udp_data.ntiles; tile++)
+        {
+            float auto_power_x = tile_average(tile_weights->auto_power_per_tile_x, previous_tile_weights->auto_power_per_tile_x, previous_tile_weights->capacity, tile, tile, weights_counter);
+            float auto_power_y = tile_average(tile_weights->auto_power_per_tile_y, previous_tile_weights->auto_power_per_tile_y, previous_tile_weights->capacity, tile, tile, weights_counter);
+
+            out_udp_data.dead_tiles += (auto_power_x == 0 || auto_power_y == 0);
+        }
+
+        // Bad data counts since the last health packet
+        out_udp_data.bad_data_scanned = totals.bad_data_scanned - previous_totals.bad_data_scanned;
+        out_udp_data.bad_data_integrations = totals.bad_data_integrations - previous_totals.bad_data_integrations;
+        out_udp_data.bad_data_dropped = totals.bad_data_dropped - previous_totals.bad_data_dropped;
+        out_udp_data.bad_data_nonfinite = totals.bad_data_nonfinite - previous_totals.bad_data_nonfinite;
+        out_udp_data.bad_data_zero_baselines = totals.bad_data_zero_baselines - previous_totals.bad_data_zero_baselines;
+
+        // Hardware performance counters since the last health packet
+        out_udp_data.perf_counters_available = totals.perf_counters_available;
+
+        for (int stage = 0; stage < PERF_STAGE_COUNT; stage++)
+        {
+            out_udp_data.perf_stages[stage].samples = totals.perf_stages[stage].samples - previous_totals.perf_stages[stage].samples;
+            out_udp_data.perf_stages[stage].cycles = totals.perf_stages[stage].counts[PERF_COUNTER_CYCLES] - previous_totals.perf_stages[stage].counts[PERF_COUNTER_CYCLES];
+            out_udp_data.perf_stages[stage].instructions = totals.perf_stages[stage].counts[PERF_COUNTER_INSTRUCTIONS] - previous_totals.perf_stages[stage].counts[PERF_COUNTER_INSTRUCTIONS];
+            out_udp_data.perf_stages[stage].llc_misses = totals.perf_stages[stage].counts[PERF_COUNTER_LLC_MISSES] - previous_totals.perf_stages[stage].counts[PERF_COUNTER_LLC_MISSES];
+            out_udp_data.perf_stages[stage].page_faults = totals.perf_stages[stage].counts[PERF_COUNTER_PAGE_FAULTS] - previous_totals.perf_stages[stage].counts[PERF_COUNTER_PAGE_FAULTS];
+        }
+
+        // The next health packet will report the change from these totals
+        previous_totals = totals;
+
+        // Throughput and latency since the last health packet
+        metrics_snapshot(metrics);
+        uint64_t metrics_ns = metrics_now_ns();
+
+        out_udp_data.bytes_per_sec = (double)(metrics->bytes_written - previous_metrics->bytes_written) / ((metrics_ns - previous_metrics_ns) / 1.0e9);
+        out_udp_data.hdus_written = metrics->hdus_written - previous_metrics->hdus_written;
+
+        for (int latency = 0; latency < HEALTH_EXT_V2_LATENCY_COUNT; latency++)
+        {
+            health_latency_summary(metrics, previous_metrics, latency, &out_udp_data.latency[latency]);
+        }
+
+        health_latency_summary(metrics, previous_metrics, METRICS_LATENCY_DATA_TO_HDU, &out_udp_data.data_to_hdu);
+        health_latency_summary(metrics, previous_metrics, METRICS_LATENCY_DATA_TO_FITS, &out_udp_data.data_to_fits);
+
+        // Swap, so the next health packet will report the change from this copy
+        metrics_snapshot_s *swap_metrics = previous_metrics;
+        previous_metrics = metrics;
+        metrics = swap_metrics;
+        previous_metrics_ns = metrics_ns;
+
+        // Ringbuffer occupancy. These counters live in shared memory and are read without the ringbuffer's
+        // semaphores (like dada_dbmonitor does), so this never blocks the writer or the thread reading the ringbuffer.
+        // When replaying files (--input-file) there is no ringbuffer, so they are all 0
+        int have_ringbuffer = (health_args->data_block != NULL);
+        out_udp_data.ringbuffer_nreaders = have_ringbuffer ? ipcbuf_get_nreaders(health_args->data_block) : 0;
+        out_udp_data.header_bufsz = have_ringbuffer ? ipcbuf_get_bufsz(health_args->header_block) : 0;
+        out_udp_data.header_nbufs = have_ringbuffer ? ipcbuf_get_nbufs(health_args->header_block) : 0;
+        out_udp_data.header_full_bufs = have_ringbuffer ? ipcbuf_get_nfull(health_args->header_block) : 0;
+        out_udp_data.header_clear_bufs = have_ringbuffer ? ipcbuf_get_nclear(health_args->header_block) : 0;
+        out_udp_data.data_bufsz = have_ringbuffer ? ipcbuf_get_bufsz(health_args->data_block) : 0;
+        out_udp_data.data_nbufs = have_ringbuffer ? ipcbuf_get_nbufs(health_args->data_block) : 0;
+        out_udp_data.data_full_bufs = have_ringbuffer ? ipcbuf_get_nfull(health_args->data_block) : 0;
+        out_udp_data.data_clear_bufs = have_ringbuffer ? ipcbuf_get_nclear(health_args->data_block) : 0;
+        out_udp_data.data_bufs_written = have_ringbuffer ? ipcbuf_get_write_count(health_args->data_block) : 0;
+        out_udp_data.data_bufs_read = have_ringbuffer ? ipcbuf_get_read_count(health_args->data_block) : 0;
+
+        // Rates are from the oldest sample in the window (the one this sample replaces once the window is full)
+        int window_index = window_count % HEALTH_RATE_WINDOW_SAMPLES;
+        int oldest_index = window_count < HEALTH_RATE_WINDOW_SAMPLES ? 0 : window_index;
+
+        if (window_count > 0)
+        {
+            double window_sec = (metrics_ns - window_ns[oldest_index]) / 1.0e9;
+            out_udp_data.data_write_bufs_per_sec = (out_udp_data.data_bufs_written - window_bufs_written[oldest_index]) / window_sec;
+            out_udp_data.data_read_bufs_per_sec = (out_udp_data.data_bufs_read - window_bufs_read[oldest_index]) / window_sec;
+        }
+        else
+        {
+            out_udp_data.data_write_bufs_per_sec = 0;
+            out_udp_data.data_read_bufs_per_sec = 0;
+        }
+
+        window_ns[window_index] = metrics_ns;
+        window_bufs_written[window_index] = out_udp_data.data_bufs_written;
+        window_bufs_read[window_index] = out_udp_data.data_bufs_read;
+        window_count++;
+
+        out_udp_data.headroom_sec = have_ringbuffer ? ringbuffer_headroom_seconds(out_udp_data.data_clear_bufs, out_udp_data.data_write_bufs_per_sec, out_udp_data.data_read_bufs_per_sec) : INFINITY;
+
 // debug dump of health
 #ifdef DEBUG
         char health_debug_string[2048];
         snprintf(health_debug_string,
                  2048,
-                 "v=%d.%d.%d h=%s start=%ld now=%ld up=%g st=%d obsid=%ld subobs=%ld",
+                 "v=%d.%d.%d h=%s start=%ld now=%ld up=%g st=%d obsid=%ld subobs=%ld bad(scanned=%d ints=%d dropped=%d nonfinite=%lu zerobl=%lu) bytes/s=%.0f hdus=%lu vis_hdu(n=%u p50=%u p99=%u max=%u us) data_rb(full=%lu clear=%lu write/s=%.2f read/s=%.2f headroom=%.1fs)",
                  out_udp_data.version_major,
                  out_udp_data.version_minor,
                  out_udp_data.version_build,
@@ -196,7 +454,23 @@ void *health_thread_fn(void *args)
                  out_udp_data.up_time,
                  out_udp_data.status,
                  out_udp_data.obs_id,
-                 out_udp_data.subobs_id);
+                 out_udp_data.subobs_id,
+                 out_udp_data.bad_data_scanned,
+                 out_udp_data.bad_data_integrations,
+                 out_udp_data.bad_data_dropped,
+                 out_udp_data.bad_data_nonfinite,
+                 out_udp_data.bad_data_zero_baselines,
+                 out_udp_data.bytes_per_sec,
+                 out_udp_data.hdus_written,
+                 out_udp_data.latency[METRICS_LATENCY_VIS_HDU].count,
+                 out_udp_data.latency[METRICS_LATENCY_VIS_HDU].p50_usec,
+                 out_udp_data.latency[METRICS_LATENCY_VIS_HDU].p99_usec,
+                 out_udp_data.latency[METRICS_LATENCY_VIS_HDU].max_usec,
+                 out_udp_data.data_full_bufs,
+                 out_udp_data.data_clear_bufs,
+                 out_udp_data.data_write_bufs_per_sec,
+                 out_udp_data.data_read_bufs_per_sec,
+                 out_udp_data.headroom_sec);
 
         // If we have weights array initialised we'll dump it
         char xx_health_debug_string[2048] = "xx=";
@@ -205,7 +479,7 @@ void *health_thread_fn(void *args)
         int tiles_to_dump = 1;
         if (ntiles > 0)
         {
-            tiles_to_dump = ntiles;
+            tiles_to_dump = (ntiles < NTILES_MAX ? ntiles : NTILES_MAX);
         }
 
         for (int tile = 0; tile < tiles_to_dump; tile++)
@@ -219,7 +493,7 @@ void *health_thread_fn(void *args)
         }
 
         // put all the log info together
-        multilog(health_args->log, LOG_DEBUG, "health: %s %s %s. Resetting weights...\n", health_debug_string, xx_health_debug_string, yy_health_debug_string);
+        multilog(health_args->log, LOG_DEBUG, "health: %s %s %s.\n", health_debug_string, xx_health_debug_string, yy_health_debug_string);
 #endif
 
         // send the message
@@ -231,6 +505,60 @@ void *health_thread_fn(void *args)
             exit(EXIT_FAILURE);
         }
 
+        // Then the averages of every tile, tiles_per_chunk tiles per message
+        for (int chunk = 0; chunk < out_udp_data.tile_weights_chunks; chunk++)
+        {
+            int first_tile = chunk * tiles_per_chunk;
+            int chunk_ntiles = (out_udp_data.ntiles - first_tile < tiles_per_chunk ? out_udp_data.ntiles - first_tile : tiles_per_chunk);
+            float *values = out_tile_weights_msg.values;
+
+            out_tile_weights_msg.header.sequence = out_udp_data.sequence;
+            out_tile_weights_msg.header.chunk_index = chunk;
+            out_tile_weights_msg.header.chunk_count = out_udp_data.tile_weights_chunks;
+            out_tile_weights_msg.header.ntiles = out_udp_data.ntiles;
+            out_tile_weights_msg.header.first_tile = first_tile;
+            out_tile_weights_msg.header.chunk_ntiles = chunk_ntiles;
+            out_tile_weights_msg.header.health_time = out_udp_data.health_time;
+            out_tile_weights_msg.header.obs_id = out_udp_data.obs_id;
+
+            for (int i = 0; i < chunk_ntiles; i++)
+            {
+                int tile = first_tile + i;
+                int previous_capacity = previous_tile_weights->capacity;
+
+                values[i] = tile_average(tile_weights->weights_per_tile_x, previous_tile_weights->weights_per_tile_x, previous_capacity, tile, tile, weights_counter);
+                values[chunk_ntiles + i] = tile_average(tile_weights->weights_per_tile_y, previous_tile_weights->weights_per_tile_y, previous_capacity, tile, tile, weights_counter);
+                values[(2 * chunk_ntiles) + i] = tile_average(tile_weights->auto_power_per_tile_x, previous_tile_weights->auto_power_per_tile_x, previous_capacity, tile, tile, weights_counter);
+                values[(3 * chunk_ntiles) + i] = tile_average(tile_weights->auto_power_per_tile_y, previous_tile_weights->auto_power_per_tile_y, previous_capacity, tile, tile, weights_counter);
+
+                for (int bin = 0; bin < 2 * bandpass_bins; bin++)
+                {
+                    values[(4 * chunk_ntiles) + (i * 2 * bandpass_bins) + bin] = tile_average(tile_weights->bandpass_per_tile, previous_tile_weights->bandpass_per_tile, previous_capacity, tile, ((uint64_t)tile * 2 * bandpass_bins) + bin, weights_counter);
+                }
+            }
+
+            if (sendto(sock, &out_tile_weights_msg, sizeof(health_tile_weights_header_s) + (values_per_tile * chunk_ntiles * sizeof(float)), 0,
+                       (struct sockaddr *)&groupSock,
+                       sizeof(groupSock)) < 0)
+            {
+                multilog(health_args->log, LOG_ERR, "Health: Could not send tile weights multicast datagram: call to sendto() failed.\n");
+                exit(EXIT_FAILURE);
+            }
+        }
+
+        // Swap, so the next health packet will report the change from this copy of the tile weights
+        health_tile_weights_s *swap_tile_weights = previous_tile_weights;
+        previous_tile_weights = tile_weights;
+        tile_weights = swap_tile_weights;
+        TRACE_END("health_packet");
+        MWAX_PROBE4(health_packet_sent, out_udp_data.obs_id, out_udp_data.subobs_id, out_udp_data.status, MWAX_PROBE_ELAPSED_NS(packet_start_ns));
+
+        // Dump the trace if SIGUSR1 asked for it (this is done here rather than in the signal handler)
+        if (trace_dump_requested())
+        {
+            trace_dump(health_args->log, "sigusr1");
+        }
+
         // Wait for 1 second
         sleep(HEALTH_SLEEP_SECONDS);
 
@@ -250,8 +578,37 @@ void *health_thread_fn(void *args)
     }
 
     free(health_args->health_udp_interface_ip);
+    free(metrics);
+    free(previous_metrics);
+    health_tile_weights_free(tile_weights);
+    health_tile_weights_free(previous_tile_weights);
 
     multilog(health_args->log, LOG_INFO, "Health: Thread finished.\n");
 
     return EXIT_SUCCESS;
+}
+
+/**
+ *
+ *  @brief Works out how long until the ringbuffer has no clear blocks left for the writer.
+ *  @param[in] clear_bufs Number of blocks currently available to the writer.
+ *  @param[in] write_bufs_per_sec Rate blocks are being written.
+ *  @param[in] read_bufs_per_sec Rate blocks are being read (and so cleared).
+ *  @returns Seconds of headroom, 0 if there are no clear blocks now, or INFINITY if we are keeping up.
+ */
+double ringbuffer_headroom_seconds(uint64_t clear_bufs, double write_bufs_per_sec, double read_bufs_per_sec)
+{
+    double fill_bufs_per_sec = write_bufs_per_sec - read_bufs_per_sec;
+
+    if (clear_bufs == 0)
+    {
+        return 0;
+    }
+
+    if (fill_bufs_per_sec <= 0)
+    {
+        return INFINITY;
+    }
+
+    return clear_bufs / fill_bufs_per_sec;
 }
\ No newline at end of file
@@ -8,9 +8,32 @@
 #pragma once
 
 #include "global.h"
+#include "metrics.h"
 #include "multilog.h"
 
+#define HEALTH_EXT_V2_LATENCY_COUNT 4 // The first 4 METRICS_LATENCY_... are in ext_version 2. Later ones have their own fields
+#define HEALTH_TILE_WEIGHTS_MAGIC 0x5754584d // "MXTW" in little endian: marks a tile weights message
+#define HEALTH_TILE_WEIGHTS_VERSION 2        // Version of the tile weights message
+#define HEALTH_TILE_WEIGHTS_MAX_BYTES 1472   // Most bytes in one tile weights message (keeps each message within a 1500 byte MTU)
+
 #pragma pack(push, 1)
+typedef struct
+{
+    uint32_t count;    // Number of samples
+    uint32_t p50_usec; // Median (microseconds)
+    uint32_t p99_usec; // 99th percentile (microseconds)
+    uint32_t max_usec; // Max (microseconds)
+} health_latency_s;
+
+typedef struct
+{
+    uint64_t samples;      // Number of times the stage ran
+    uint64_t cycles;       // CPU cycles (user space)
+    uint64_t instructions; // Instructions retired (user space)
+    uint64_t llc_misses;   // Last level cache misses (user space)
+    uint64_t page_faults;  // Page faults
+} health_perf_stage_s;
+
 typedef struct
 {
     int version_major;
@@ -27,9 +50,102 @@ typedef struct
     float weights_per_tile_x[NTILES_MAX];
     float weights_per_tile_y[NTILES_MAX];
 
+    // Extension. Fields are only ever appended here, incrementing HEALTH_EXT_VERSION each time, so receivers can check
+    // ext_version for the fields they know about and use ext_size to find the end of the extension.
+    int ext_version; // HEALTH_EXT_VERSION
+    int ext_size;    // Size in bytes of the extension, from ext_version onwards
+
+    // ext_version >= 1: bad data counts since the last health packet
+    int bad_data_policy;                   // 0=keep, 1=zero-weight, 2=drop
+    int bad_data_scanned;                  // Number of integrations scanned
+    int bad_data_integrations;             // Number of integrations with NaN/Inf values or zero-power baselines
+    int bad_data_dropped;                  // Number of integrations dropped
+    uint64_t bad_data_nonfinite;           // Number of NaN/Inf visibility values
+    uint64_t bad_data_zero_baselines;      // Number of baselines with zero power
+
+    // ext_version >= 2: throughput and latency since the last health packet
+    double bytes_per_sec;                             // Bytes written to fits files per second
+    uint64_t hdus_written;                            // Number of HDUs written
+    health_latency_s latency[HEALTH_EXT_V2_LATENCY_COUNT]; // create_fits, close_fits, visibility HDU, weights HDU (METRICS_LATENCY_...)
+
+    // ext_version >= 3: ringbuffer occupancy, sampled when the health packet is assembled
+    int ringbuffer_nreaders;         // Number of readers of the data ringbuffer
+    uint64_t header_bufsz;           // Size in bytes of each header block
+    uint64_t header_nbufs;           // Number of header blocks
+    uint64_t header_full_bufs;       // Number of header blocks written and not yet read
+    uint64_t header_clear_bufs;      // Number of header blocks available to the writer
+    uint64_t data_bufsz;             // Size in bytes of each data block
+    uint64_t data_nbufs;             // Number of data blocks
+    uint64_t data_full_bufs;         // Number of data blocks written and not yet read
+    uint64_t data_clear_bufs;        // Number of data blocks available to the writer
+    uint64_t data_bufs_written;      // Total data blocks written since the ringbuffer was created
+    uint64_t data_bufs_read;         // Total data blocks read since the ringbuffer was created
+    double data_write_bufs_per_sec;  // Rate data blocks are written (over the last HEALTH_RATE_WINDOW_SAMPLES packets)
+    double data_read_bufs_per_sec;   // Rate data blocks are read by us (over the last HEALTH_RATE_WINDOW_SAMPLES packets)
+    double headroom_sec;             // Seconds until the data ringbuffer is full at the current rates, or +Inf if it is not filling
+
+    // ext_version >= 4: hardware performance counters of each stage of dada_dbfits_io() since the last health packet
+    int perf_counters_available;                     // Bit mask (1 << PERF_COUNTER_...) of the counters being read. 0 == disabled (--perf-counters)
+    health_perf_stage_s perf_stages[PERF_STAGE_COUNT]; // scan_bad_data, rfi_flag, transpose, vis_hdu, weights_hdu, flags_hdu, chanstats_hdu, health_weights, autos (PERF_STAGE_...)
+
+    // ext_version >= 5: end to end latency since the last health packet, from the UNIX time of each integration
+    health_latency_s data_to_hdu;  // ... to all of its HDUs being written
+    health_latency_s data_to_fits; // ... to its fits file being renamed to .fits (values are capped at ~71 minutes)
+
+    // ext_version >= 6: the weights of every tile (not just the first NTILES_MAX) follow in tile weights messages
+    uint32_t sequence;       // Incremented for every health packet. The tile weights messages that follow have the same sequence
+    int ntiles;              // Number of tiles with weights since the last health packet (may be more than NTILES_MAX), or 0 if none
+    int tile_weights_chunks; // Number of tile weights messages sent after this packet
+
+    // ext_version >= 7: autocorrelation power of each tile (which is in the tile weights messages) since the last health packet
+    int bandpass_bins; // Number of bins in each tile's bandpass summary (--bandpass-bins). 0 == none
+    int dead_tiles;    // Number of tiles whose mean XX or YY autocorrelation power is 0
+
+    // ext_version >= 8: destination path bandwidth (--disk-probe), see diskprobe.h
+    double disk_bytes_per_sec;     // Most recently measured write bandwidth of the destination path. 0 == not measured
+    double required_bytes_per_sec; // Rate the current observation writes at. 0 == not known
+    int disk_state;                // DISKPROBE_STATE_... of the current observation
+
+    // ext_version >= 9: destination path free space forecast (--space-policy), see freespace.h
+    uint64_t space_free_bytes;     // Free space where the current observation is being written
+    uint64_t space_forecast_bytes; // Space the rest of the current observation needs
+    int space_state;               // FREESPACE_STATE_... of the current observation
 } health_udp_data_s;
+
+// After each health packet, the averages of every tile since the last packet are sent in as many of these messages as
+// are needed, so there is no limit on the number of tiles. Each is this header, followed by (float32) the XX weights of
+// chunk_ntiles tiles, then their YY weights, and (version >= 2) their mean XX autocorrelation power, mean YY
+// autocorrelation power and bandpass summaries [chunk_ntiles][pol x,y][bandpass_bins]. Receivers can tell them apart
+// from health packets by the magic.
+typedef struct
+{
+    uint32_t magic;               // HEALTH_TILE_WEIGHTS_MAGIC
+    uint16_t version;             // HEALTH_TILE_WEIGHTS_VERSION
+    uint16_t header_size;         // Size in bytes of this header, i.e. where the weights start
+    uint32_t sequence;            // Sequence of the health packet these weights belong to
+    uint16_t chunk_index;         // Index of this message (0 to chunk_count-1)
+    uint16_t chunk_count;         // Number of messages carrying the weights for this health packet
+    uint32_t ntiles;              // Total number of tiles
+    uint32_t first_tile;          // Index of the first tile in this message
+    uint32_t chunk_ntiles;        // Number of tiles in this message
+    char hostname[HOST_NAME_LEN]; // Hostname mwax_db2fits is running on
+    int64_t health_time;          // UNIX time the health packet was generated
+    int64_t obs_id;               // Obsid of current obs or 0 if not currently processing an observation
+    uint32_t bandpass_bins;       // (version >= 2) Number of bins in each tile's bandpass summary
+} health_tile_weights_header_s;
+
+typedef struct
+{
+    health_tile_weights_header_s header;
+    float values[(HEALTH_TILE_WEIGHTS_MAX_BYTES - sizeof(health_tile_weights_header_s)) / sizeof(float)]; // See above
+} health_tile_weights_msg_s;
 #pragma pack(pop)
 
 #define HEALTH_SLEEP_SECONDS 1 // How often does the health thread send data?
+#define HEALTH_EXT_VERSION 9   // Version of the extension fields in the health packet
+#define HEALTH_RATE_WINDOW_SAMPLES 10 // Number of health packets the ringbuffer read/write rates are averaged over
+#define HEALTH_READY_TIMEOUT_SECONDS 10 // How long main() waits for the health thread to be ready to send
 
-void *health_thread_fn(void *args);
\ No newline at end of file
+void *health_thread_fn(void *args);
+int health_wait_ready(int timeout_sec);
+double ringbuffer_headroom_seconds(uint64_t clear_bufs, double write_bufs_per_sec, double read_bufs_per_sec);
\ No newline at end of file
@@ -0,0 +1,397 @@
+/**
+ * @file journal.c
+ * @author Greg Sleap
+ * @date 18 Oct 2026
+ * @brief This is the code that journals the completed integrations of each fits file being written, and recovers
+ *        the .tmp files left behind when mwax_db2fits stops part way through an observation (--journal)
+ *
+ * A fits file is only renamed from .tmp to .fits once it is complete, so if mwax_db2fits is killed or crashes the
+ * whole file is abandoned, even if it holds hours of good integrations. With --journal, each time an integration's
+ * HDUs are complete cfitsio's buffers are flushed to the file and a small record (the integration's HDU offsets and
+ * the size of the file so far) is appended to a journal next to it. On the next start every journal in the
+ * destination directory is replayed: its .tmp file is truncated to the end of the last integration that made it to
+ * disk and renamed to .fits, and (with --hdu-index) its .idx written from the records.
+ *
+ * The records are written straight to the kernel, so they survive the process dying, but they are not synced to
+ * disk, so they do not survive the machine losing power.
+ *
+ * A journal is locked (flock) for as long as its fits file is being written and renamed, and the lock goes when the
+ * process does. Recovery skips any journal it can't lock, as another mwax_db2fits sharing the directory is still
+ * writing that file.
+ */
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "journal.h"
+
+_Static_assert(sizeof(journal_header_s) == 64, "journal_header_s must be 64 bytes");
+_Static_assert(sizeof(journal_record_s) == 80, "journal_record_s must be 80 bytes");
+
+/**
+ *
+ *  @brief 32 bit FNV-1a hash of a journal record, excluding its checksum.
+ *  @param[in] record The record.
+ *  @returns The checksum.
+ */
+static uint32_t journal_checksum(const journal_record_s *record)
+{
+  const unsigned char *bytes = (const unsigned char *)record;
+  uint32_t hash = 2166136261u;
+
+  for (size_t i = 0; i < offsetof(journal_record_s, checksum); i++)
+  {
+    hash ^= bytes[i];
+    hash *= 16777619u;
+  }
+
+  return hash;
+}
+
+/**
+ *
+ *  @brief Works out the name of the journal of a fits file.
+ *  @param[in] fits_filename The (final, .fits) fits filename.
+ *  @param[out] journal_filename The journal filename.
+ *  @param[in] journal_filename_size The size of journal_filename.
+ */
+static void journal_filename(const char *fits_filename, char *journal_filename, size_t journal_filename_size)
+{
+  snprintf(journal_filename, journal_filename_size, "%s%s", fits_filename, JOURNAL_EXTENSION);
+}
+
+/**
+ *
+ *  @brief Initialises a journal as not open.
+ *  @param[out] journal The journal.
+ */
+void journal_init(journal_s *journal)
+{
+  journal->fd = -1;
+  journal->sequence = 0;
+}
+
+/**
+ *
+ *  @brief Creates the journal of a new fits file, replacing any old one, and locks it until journal_close().
+ *  @param[in,out] journal The journal.
+ *  @param[in] fits_filename The (final, .fits) name of the fits file.
+ *  @param[in] obs_id The obs id of the fits file.
+ *  @param[in] coarse_channel The coarse channel of the fits file.
+ *  @param[in] fits_file_number The number of the fits file in the observation.
+ *  @param[in] log The logger to use.
+ *  @returns EXIT_SUCCESS on success, or EXIT_FAILURE if there was an error.
+ */
+int journal_open(journal_s *journal, const char *fits_filename, long obs_id, int coarse_channel, int fits_file_number, multilog_t *log)
+{
+  char filename[PATH_MAX + 4];
+  journal_filename(fits_filename, filename, sizeof(filename));
+
+  journal_close(journal);
+
+  journal->fd = open(filename, O_WRONLY | O_CREAT | O_APPEND, 0644);
+
+  if (journal->fd < 0)
+  {
+    multilog(log, LOG_ERR, "journal_open(): Error creating %s: %s\n", filename, strerror(errno));
+    return EXIT_FAILURE;
+  }
+
+  // Lock it before emptying it, so a run recovering the directory never sees it part way through
+  if (flock(journal->fd, LOCK_EX) != 0 || ftruncate(journal->fd, 0) != 0)
+  {
+    multilog(log, LOG_ERR, "journal_open(): Error locking %s: %s\n", filename, strerror(errno));
+    journal_close(journal);
+    return EXIT_FAILURE;
+  }
+
+  journal_header_s header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, JOURNAL_MAGIC, JOURNAL_MAGIC_LEN);
+  header.version = JOURNAL_VERSION;
+  header.record_size = sizeof(journal_record_s);
+  header.obs_id = obs_id;
+  header.coarse_channel = coarse_channel;
+  header.fits_file_number = fits_file_number;
+
+  if (write(journal->fd, &header, sizeof(header)) != sizeof(header))
+  {
+    multilog(log, LOG_ERR, "journal_open(): Error writing %s: %s\n", filename, strerror(errno));
+    journal_close(journal);
+    return EXIT_FAILURE;
+  }
+
+  journal->sequence = 0;
+
+  return EXIT_SUCCESS;
+}
+
+/**
+ *
+ *  @brief Records that one or more integrations are complete: flushes the fits file, so everything up to the end of
+ *         its current (last) HDU, including the padding of its data, has been handed to the kernel, then appends a
+ *         record for each integration.
+ *  @param[in,out] journal The journal.
+ *  @param[in] fptr The fits file, whose current HDU is the last one of the integrations.
+ *  @param[in] records The HDU offsets of each integration.
+ *  @param[in] count The number of integrations.
+ *  @param[in] log The logger to use.
+ *  @returns EXIT_SUCCESS on success, or EXIT_FAILURE if there was an error.
+ */
+int journal_append(journal_s *journal, fitsfile *fptr, const hdu_index_record_s *records, uint64_t count, multilog_t *log)
+{
+  LONGLONG head_start = 0;
+  LONGLONG data_start = 0;
+  LONGLONG data_end = 0;
+  int status = 0;
+
+  if (fits_flush_file(fptr, &status) || fits_get_hduaddrll(fptr, &head_start, &data_start, &data_end, &status))
+  {
+    char error_text[30] = "";
+    fits_get_errstatus(status, error_text);
+    multilog(log, LOG_ERR, "journal_append(): Error flushing fits file. Error: %d -- %s\n", status, error_text);
+    return EXIT_FAILURE;
+  }
+
+  for (uint64_t i = 0; i < count; i++)
+  {
+    journal_record_s record;
+    memset(&record, 0, sizeof(record));
+    record.hdus = records[i];
+    record.file_size = (uint64_t)data_end;
+    record.sequence = journal->sequence;
+    record.checksum = journal_checksum(&record);
+
+    if (write(journal->fd, &record, sizeof(record)) != sizeof(record))
+    {
+      multilog(log, LOG_ERR, "journal_append(): Error writing journal: %s\n", strerror(errno));
+      return EXIT_FAILURE;
+    }
+
+    journal->sequence++;
+  }
+
+  return EXIT_SUCCESS;
+}
+
+/**
+ *
+ *  @brief Closes (and so unlocks) a journal, if it is open. The file is kept until journal_remove().
+ *  @param[in,out] journal The journal.
+ */
+void journal_close(journal_s *journal)
+{
+  if (journal->fd >= 0)
+  {
+    close(journal->fd);
+  }
+
+  journal->fd = -1;
+}
+
+/**
+ *
+ *  @brief Removes the journal of a fits file, once the fits file has been renamed (or deleted).
+ *  @param[in] fits_filename The (final, .fits) name of the fits file.
+ *  @param[in] log The logger to use.
+ */
+void journal_remove(const char *fits_filename, multilog_t *log)
+{
+  char filename[PATH_MAX + 4];
+  journal_filename(fits_filename, filename, sizeof(filename));
+
+  if (unlink(filename) != 0 && errno != ENOENT)
+  {
+    multilog(log, LOG_WARNING, "journal_remove(): Error removing %s: %s\n", filename, strerror(errno));
+  }
+}
+
+/**
+ *
+ *  @brief Recovers the fits file of one journal: truncates its .tmp file to the end of the last complete integration
+ *         and renames it to .fits (or deletes it, if it has no complete integrations), then removes the journal. A
+ *         journal which is locked (i.e. another process is still writing its fits file) is skipped.
+ *  @param[in] fits_filename The (final, .fits) name of the fits file.
+ *  @param[in] write_index 1 == write the .idx sidecar of the recovered file.
+ *  @param[in] log The logger to use.
+ *  @returns EXIT_SUCCESS on success, or EXIT_FAILURE if there was an error (the files are left as they are).
+ */
+static int journal_recover_file(const char *fits_filename, int write_index, multilog_t *log)
+{
+  char filename[PATH_MAX + 4];
+  char temp_fits_filename[PATH_MAX + 4];
+  journal_filename(fits_filename, filename, sizeof(filename));
+  snprintf(temp_fits_filename, sizeof(temp_fits_filename), "%s.tmp", fits_filename);
+
+  int fd = open(filename, O_RDONLY);
+
+  if (fd < 0)
+  {
+    multilog(log, LOG_WARNING, "journal_recover(): Error opening %s: %s\n", filename, strerror(errno));
+    return EXIT_FAILURE;
+  }
+
+  // Held until the journal is removed, so two runs starting together don't both recover it
+  if (flock(fd, LOCK_EX | LOCK_NB) != 0)
+  {
+    multilog(log, LOG_INFO, "journal_recover(): %s is locked by another process, which is still writing its fits file. Skipping it.\n", filename);
+    close(fd);
+    return EXIT_SUCCESS;
+  }
+
+  FILE *journal_file = fdopen(fd, "rb");
+
+  if (journal_file == NULL)
+  {
+    multilog(log, LOG_WARNING, "journal_recover(): Error opening %s: %s\n", filename, strerror(errno));
+    close(fd);
+    return EXIT_FAILURE;
+  }
+
+  journal_header_s header;
+
+  if (fread(&header, sizeof(header), 1, journal_file) != 1 || memcmp(header.magic, JOURNAL_MAGIC, JOURNAL_MAGIC_LEN) != 0 ||
+      header.version != JOURNAL_VERSION || header.record_size != sizeof(journal_record_s))
+  {
+    multilog(log, LOG_WARNING, "journal_recover(): %s is not a journal (or is from a different version). Ignoring it.\n", filename);
+    fclose(journal_file);
+    return EXIT_FAILURE;
+  }
+
+  // If there is no .tmp file we stopped after it was renamed (or deleted), but before its journal was removed
+  struct stat temp_stat;
+
+  if (stat(temp_fits_filename, &temp_stat) != 0)
+  {
+    journal_remove(fits_filename, log);
+    fclose(journal_file);
+    return EXIT_SUCCESS;
+  }
+
+  // Replay the records, up to the first one which was only partly written or whose HDUs did not all reach the file
+  hdu_index_s index = {0};
+  hdu_index_reset(&index, header.obs_id, header.coarse_channel, header.fits_file_number);
+  uint64_t file_size = 0;
+  journal_record_s record;
+
+  while (fread(&record, sizeof(record), 1, journal_file) == 1)
+  {
+    if (record.checksum != journal_checksum(&record) || record.sequence != index.header.record_count ||
+        record.file_size > (uint64_t)temp_stat.st_size || record.file_size < file_size)
+    {
+      break;
+    }
+
+    if (hdu_index_add(&index, &record.hdus) != EXIT_SUCCESS)
+    {
+      multilog(log, LOG_ERR, "journal_recover(): Error allocating memory for the index of %s.\n", temp_fits_filename);
+      fclose(journal_file);
+      hdu_index_free(&index);
+      return EXIT_FAILURE;
+    }
+
+    file_size = record.file_size;
+  }
+
+  int result = EXIT_SUCCESS;
+
+  if (index.header.record_count == 0)
+  {
+    multilog(log, LOG_WARNING, "journal_recover(): %s has no complete integrations. Deleting it.\n", temp_fits_filename);
+
+    if (unlink(temp_fits_filename) != 0)
+    {
+      multilog(log, LOG_ERR, "journal_recover(): Error deleting %s: %s\n", temp_fits_filename, strerror(errno));
+      result = EXIT_FAILURE;
+    }
+  }
+  else if (truncate(temp_fits_filename, (off_t)file_size) != 0 || rename(temp_fits_filename, fits_filename) != 0)
+  {
+    multilog(log, LOG_ERR, "journal_recover(): Error truncating %s to %lu bytes and renaming it to %s: %s\n", temp_fits_filename, file_size, fits_filename, strerror(errno));
+    result = EXIT_FAILURE;
+  }
+  else
+  {
+    multilog(log, LOG_INFO, "journal_recover(): Recovered %lu integrations (%lu of %lu bytes) of %s.\n", index.header.record_count, file_size,
+             (uint64_t)temp_stat.st_size, fits_filename);
+
+    if (write_index)
+    {
+      result = hdu_index_write(&index, fits_filename, log);
+    }
+  }
+
+  if (result == EXIT_SUCCESS)
+  {
+    journal_remove(fits_filename, log);
+  }
+
+  fclose(journal_file);
+  hdu_index_free(&index);
+
+  return result;
+}
+
+/**
+ *
+ *  @brief scandir() filter for the journals in a directory.
+ *  @param[in] entry The directory entry.
+ *  @returns 1 if the entry is the journal of a fits file, otherwise 0.
+ */
+static int is_journal_file(const struct dirent *entry)
+{
+  const char *suffix = ".fits" JOURNAL_EXTENSION;
+  size_t len = strlen(entry->d_name);
+  size_t suffix_len = strlen(suffix);
+
+  return (len > suffix_len && strcmp(entry->d_name + len - suffix_len, suffix) == 0);
+}
+
+/**
+ *
+ *  @brief Recovers the fits file of every journal left in a directory (i.e. by a previous run which did not finish
+ *         its observation). A file which can't be recovered is logged and left as it is.
+ *  @param[in] directory The destination directory.
+ *  @param[in] write_index 1 == write the .idx sidecar of each recovered file.
+ *  @param[in] log The logger to use.
+ *  @returns EXIT_SUCCESS on success, or EXIT_FAILURE if the directory could not be read.
+ */
+int journal_recover(const char *directory, int write_index, multilog_t *log)
+{
+  struct dirent **entries = NULL;
+  int count = scandir(directory, &entries, is_journal_file, alphasort);
+
+  if (count < 0)
+  {
+    multilog(log, LOG_ERR, "journal_recover(): Error reading directory %s: %s\n", directory, strerror(errno));
+    return EXIT_FAILURE;
+  }
+
+  if (count > 0)
+  {
+    multilog(log, LOG_INFO, "journal_recover(): Found %d journals in %s.\n", count, directory);
+  }
+
+  for (int i = 0; i < count; i++)
+  {
+    // The fits filename is the journal filename without JOURNAL_EXTENSION
+    char fits_filename[PATH_MAX];
+    snprintf(fits_filename, sizeof(fits_filename), "%s/%.*s", directory, (int)(strlen(entries[i]->d_name) - strlen(JOURNAL_EXTENSION)), entries[i]->d_name);
+
+    journal_recover_file(fits_filename, write_index, log);
+
+    free(entries[i]);
+  }
+
+  free(entries);
+
+  return EXIT_SUCCESS;
+}
\ No newline at end of file
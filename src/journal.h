@@ -0,0 +1,55 @@
+/**
+ * @file journal.h
+ * @author Greg Sleap
+ * @date 18 Oct 2026
+ * @brief This is the header for the journal of completed integrations of each fits file being written (--journal)
+ *
+ */
+#pragma once
+
+#include <fitsio.h>
+#include <stdint.h>
+
+#include "hdu_index.h"
+#include "multilog.h"
+
+#define JOURNAL_MAGIC "MWAXJNL1"
+#define JOURNAL_MAGIC_LEN 8
+#define JOURNAL_VERSION 1
+#define JOURNAL_EXTENSION ".jnl" // Appended to the (final, .fits) name of the fits file
+
+//
+// The journal of a fits file is a journal_header_s, then a journal_record_s is appended as each integration's HDUs
+// are completed. Values are in the byte order of the machine that wrote them.
+//
+typedef struct
+{
+  char magic[JOURNAL_MAGIC_LEN]; // JOURNAL_MAGIC (not NUL terminated)
+  uint32_t version;              // JOURNAL_VERSION
+  uint32_t record_size;          // sizeof(journal_record_s)
+  int64_t obs_id;
+  int32_t coarse_channel;
+  int32_t fits_file_number;
+  uint8_t reserved[32];
+} journal_header_s;
+
+typedef struct
+{
+  hdu_index_record_s hdus; // Where the integration's visibility and weights HDUs are
+  uint64_t file_size;      // Size of the fits file to the end of the integration's last HDU (whole 2880 byte blocks)
+  uint32_t sequence;       // 0 for the first integration in the file, then 1, 2...
+  uint32_t checksum;       // Of the rest of the record, so one that was only partly written is ignored
+} journal_record_s;
+
+typedef struct
+{
+  int fd;            // -1 == not open
+  uint32_t sequence; // Sequence of the next record
+} journal_s;
+
+void journal_init(journal_s *journal);
+int journal_open(journal_s *journal, const char *fits_filename, long obs_id, int coarse_channel, int fits_file_number, multilog_t *log);
+int journal_append(journal_s *journal, fitsfile *fptr, const hdu_index_record_s *records, uint64_t count, multilog_t *log);
+void journal_close(journal_s *journal);
+void journal_remove(const char *fits_filename, multilog_t *log);
+int journal_recover(const char *directory, int write_index, multilog_t *log);
\ No newline at end of file
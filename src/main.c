@@ -15,12 +15,21 @@
 #include <unistd.h>
 
 #include "args.h"
+#include "autos.h"
 #include "dada_dbfits.h"
+#include "diskprobe.h"
+#include "file_source.h"
+#include "finaliser.h"
 #include "fitsio.h"
 #include "health.h"
+#include "journal.h"
 #include "multilog.h"
+#include "rfi.h"
+#include "stats.h"
+#include "trace.h"
 #include "utils.h"
 #include "version.h"
+#include "warmup.h"
 
 /**
  *
@@ -38,6 +47,17 @@ void sig_handler(int signum)
   quit_set(1);
 }
 
+/**
+ *
+ *  @brief This captures SIGUSR1 and asks for the trace to be dumped (the health thread does the dump).
+ *  @param[in] signum Signal number to handle.
+ */
+void trace_sig_handler(int signum)
+{
+  (void)signum;
+  trace_request_dump();
+}
+
 /**
  *
  *  @brief This is main, duh!
@@ -88,9 +108,30 @@ int main(int argc, char *argv[])
   multilog(g_ctx.log, LOG_INFO, "* Health UDP IP:         %s\n", globalArgs.health_ip);
   multilog(g_ctx.log, LOG_INFO, "* Health UDP Port:       %d\n", globalArgs.health_port);
   multilog(g_ctx.log, LOG_INFO, "* FITS size limit:       %ld bytes\n", globalArgs.file_size_limit);
+  multilog(g_ctx.log, LOG_INFO, "* Visibility order:      %s\n", vis_layout_name(globalArgs.vis_layout));
+  multilog(g_ctx.log, LOG_INFO, "* RFI threshold:         %0.2f sigma%s\n", globalArgs.rfi_threshold, (globalArgs.rfi_threshold == 0 ? " (disabled)" : ""));
+  multilog(g_ctx.log, LOG_INFO, "* RFI threads:           %d\n", globalArgs.rfi_threads);
+  multilog(g_ctx.log, LOG_INFO, "* Bad data policy:       %s\n", bad_data_policy_name(globalArgs.bad_data_policy));
+  multilog(g_ctx.log, LOG_INFO, "* Channel statistics:    %s\n", (globalArgs.channel_stats ? "enabled" : "disabled"));
+  multilog(g_ctx.log, LOG_INFO, "* Autos average:         %d integrations%s\n", globalArgs.autos_average, (globalArgs.autos_average == 0 ? " (disabled)" : ""));
+  multilog(g_ctx.log, LOG_INFO, "* Trace directory:       %s\n", (globalArgs.trace_dir ? globalArgs.trace_dir : "(disabled)"));
+  multilog(g_ctx.log, LOG_INFO, "* Perf counters:         %s\n", (globalArgs.perf_counters ? "enabled" : "disabled"));
+  multilog(g_ctx.log, LOG_INFO, "* Bandpass bins:         %d%s\n", globalArgs.bandpass_bins, (globalArgs.bandpass_bins == 0 ? " (disabled)" : ""));
+  multilog(g_ctx.log, LOG_INFO, "* Input file:            %s\n", (globalArgs.input_file ? globalArgs.input_file : "(ringbuffer)"));
+  multilog(g_ctx.log, LOG_INFO, "* Async close:           %s\n", (globalArgs.async_close ? "enabled" : "disabled"));
+  multilog(g_ctx.log, LOG_INFO, "* HDU index:             %s\n", (globalArgs.hdu_index ? "enabled" : "disabled"));
+  multilog(g_ctx.log, LOG_INFO, "* Cube output:           %s\n", (globalArgs.cube ? "enabled" : "disabled"));
+  multilog(g_ctx.log, LOG_INFO, "* Journal:               %s\n", (globalArgs.journal ? "enabled" : "disabled"));
+  multilog(g_ctx.log, LOG_INFO, "* Join in progress obs:  %s\n", (globalArgs.join_in_progress ? "enabled" : "disabled"));
+  multilog(g_ctx.log, LOG_INFO, "* Preallocate files:     %s\n", (globalArgs.preallocate ? "enabled" : "disabled"));
+  multilog(g_ctx.log, LOG_INFO, "* Disk probe:            %d MB%s\n", globalArgs.disk_probe_mb, (globalArgs.disk_probe_mb == 0 ? " (disabled)" : ""));
+  multilog(g_ctx.log, LOG_INFO, "* Overload policy:       %s\n", overload_policy_name(globalArgs.overload_policy));
+  multilog(g_ctx.log, LOG_INFO, "* Space policy:          %s\n", space_policy_name(globalArgs.space_policy));
+  multilog(g_ctx.log, LOG_INFO, "* Alternate path:        %s\n", (globalArgs.alternate_path != NULL ? globalArgs.alternate_path : "none"));
 
   // This tells us if we need to quit
   int quit = 0;
+  int exit_code = EXIT_SUCCESS;
   quit_init(); // Setup quit mutex
   quit_set(quit);
 
@@ -100,37 +141,116 @@ int main(int argc, char *argv[])
   multilog(g_ctx.log, LOG_INFO, "main(): Configured to catch SIGTERM.\n");
   signal(SIGTERM, sig_handler);
 
-  // create the input HDU
-  multilog(g_ctx.log, LOG_INFO, "main(): Creating HDU handle...\n");
-  in_hdu = dada_hdu_create(logger);
+  // Tracing needs to be enabled before any threads are launched
+  if (globalArgs.trace_dir != NULL)
+  {
+    if (trace_init(globalArgs.trace_dir) != EXIT_SUCCESS)
+    {
+      multilog(g_ctx.log, LOG_ERR, "main: ERROR: could not initialise tracing\n");
+      return EXIT_FAILURE;
+    }
 
-  multilog(g_ctx.log, LOG_INFO, "main(): Assigning key %x to HDU handle.\n", globalArgs.input_db_key);
-  dada_hdu_set_key(in_hdu, in_key);
+    trace_set_thread_name("ringbuffer reader");
 
-  multilog(g_ctx.log, LOG_INFO, "main(): Connecting to HDU with key %x...\n", globalArgs.input_db_key);
-  if (dada_hdu_connect(in_hdu) < 0)
-  {
-    multilog(g_ctx.log, LOG_ERR, "main: ERROR: could not connect to input HDU\n");
-    return EXIT_FAILURE;
+    multilog(g_ctx.log, LOG_INFO, "main(): Configured to catch SIGUSR1 (dump trace).\n");
+    signal(SIGUSR1, trace_sig_handler);
   }
 
-  multilog(g_ctx.log, LOG_INFO, "main(): Locking HDU %x handle for read...\n", globalArgs.input_db_key);
-  if (dada_hdu_lock_read(in_hdu) < 0)
+  // create the input HDU (unless we are replaying files)
+  if (globalArgs.input_file == NULL)
   {
-    multilog(g_ctx.log, LOG_ERR, "main: ERROR: could not lock read on input HDU\n");
-    return EXIT_FAILURE;
+    multilog(g_ctx.log, LOG_INFO, "main(): Creating HDU handle...\n");
+    in_hdu = dada_hdu_create(logger);
+
+    multilog(g_ctx.log, LOG_INFO, "main(): Assigning key %x to HDU handle.\n", globalArgs.input_db_key);
+    dada_hdu_set_key(in_hdu, in_key);
+
+    multilog(g_ctx.log, LOG_INFO, "main(): Connecting to HDU with key %x...\n", globalArgs.input_db_key);
+    if (dada_hdu_connect(in_hdu) < 0)
+    {
+      multilog(g_ctx.log, LOG_ERR, "main: ERROR: could not connect to input HDU\n");
+      return EXIT_FAILURE;
+    }
+
+    multilog(g_ctx.log, LOG_INFO, "main(): Locking HDU %x handle for read...\n", globalArgs.input_db_key);
+    if (dada_hdu_lock_read(in_hdu) < 0)
+    {
+      multilog(g_ctx.log, LOG_ERR, "main: ERROR: could not lock read on input HDU\n");
+      return EXIT_FAILURE;
+    }
   }
 
   // Pass stuff to the context
   g_ctx.destination_dir = globalArgs.destination_path;
   g_ctx.fits_file_size_limit = globalArgs.file_size_limit;
+  g_ctx.autos_average = globalArgs.autos_average;
+  g_ctx.vis_layout = globalArgs.vis_layout;
+  g_ctx.rfi_threshold = globalArgs.rfi_threshold;
+  g_ctx.rfi_threads = globalArgs.rfi_threads;
+  g_ctx.channel_stats = globalArgs.channel_stats;
+  g_ctx.bad_data_policy = globalArgs.bad_data_policy;
+  g_ctx.async_close = globalArgs.async_close;
+  g_ctx.hdu_index_enabled = globalArgs.hdu_index;
+  g_ctx.cube = globalArgs.cube;
+  g_ctx.journal_enabled = globalArgs.journal;
+  g_ctx.join_in_progress = globalArgs.join_in_progress;
+  g_ctx.preallocate = globalArgs.preallocate;
+  g_ctx.disk_probe_bytes = (uint64_t)globalArgs.disk_probe_mb * 1024 * 1024;
+  g_ctx.overload_policy = globalArgs.overload_policy;
+  g_ctx.configured_rfi_threshold = globalArgs.rfi_threshold;
+  g_ctx.configured_channel_stats = globalArgs.channel_stats;
+  g_ctx.configured_autos_average = globalArgs.autos_average;
+  g_ctx.space_policy = globalArgs.space_policy;
+  g_ctx.alternate_destination_dir = globalArgs.alternate_path;
+  journal_init(&g_ctx.journal);
+
+  // Recover any fits files a previous run did not finish, before we start writing new ones
+  if (g_ctx.journal_enabled)
+  {
+    multilog(g_ctx.log, LOG_INFO, "main(): Recovering any unfinished fits files in %s...\n", g_ctx.destination_dir);
+
+    if (journal_recover(g_ctx.destination_dir, g_ctx.hdu_index_enabled, g_ctx.log) != EXIT_SUCCESS)
+    {
+      multilog(g_ctx.log, LOG_ERR, "main: ERROR: could not recover unfinished fits files\n");
+      return EXIT_FAILURE;
+    }
+
+    // ...and in the alternate path, where observations which would not fit may have been redirected
+    if (g_ctx.alternate_destination_dir != NULL)
+    {
+      multilog(g_ctx.log, LOG_INFO, "main(): Recovering any unfinished fits files in %s...\n", g_ctx.alternate_destination_dir);
+
+      if (journal_recover(g_ctx.alternate_destination_dir, g_ctx.hdu_index_enabled, g_ctx.log) != EXIT_SUCCESS)
+      {
+        multilog(g_ctx.log, LOG_ERR, "main: ERROR: could not recover unfinished fits files\n");
+        return EXIT_FAILURE;
+      }
+    }
+  }
+
+  if (g_ctx.async_close)
+  {
+    multilog(g_ctx.log, LOG_INFO, "main(): Launching fits finaliser thread...\n");
+
+    if (finaliser_init(g_ctx.log) != EXIT_SUCCESS)
+    {
+      multilog(g_ctx.log, LOG_ERR, "main: ERROR: could not start the fits finaliser thread\n");
+      return EXIT_FAILURE;
+    }
+  }
+
+  // Perf counters count the calling thread, which is the one that reads the ringbuffer (i.e. this one)
+  memset(&g_ctx.perf, 0, sizeof(perf_counters_s));
+
+  if (globalArgs.perf_counters)
+  {
+    perf_counters_open(&g_ctx.perf, g_ctx.log);
+  }
 
   // set up DADA read client
   multilog(g_ctx.log, LOG_INFO, "main(): Creating DADA client...\n", globalArgs.input_db_key);
   client = dada_client_create();
   client->log = g_ctx.log;
-  client->data_block = in_hdu->data_block;
-  client->header_block = in_hdu->header_block;
   client->open_function = dada_dbfits_open;
   client->io_function = dada_dbfits_io;
   client->io_block_function = dada_dbfits_io_block;
@@ -138,15 +258,25 @@ int main(int argc, char *argv[])
   client->direction = dada_client_reader;
   client->context = &g_ctx;
 
-  // Set some useful params based on our ringbuffer config
-  g_ctx.block_size = ipcbuf_get_bufsz((ipcbuf_t *)(client->data_block));
-  multilog(g_ctx.log, LOG_INFO, "main(): Block size (one integration) is %lu bytes.\n", g_ctx.block_size);
+  if (in_hdu != NULL)
+  {
+    client->data_block = in_hdu->data_block;
+    client->header_block = in_hdu->header_block;
+
+    // Set some useful params based on our ringbuffer config
+    g_ctx.block_size = ipcbuf_get_bufsz((ipcbuf_t *)(client->data_block));
+    multilog(g_ctx.log, LOG_INFO, "main(): Block size (one integration) is %lu bytes.\n", g_ctx.block_size);
+  }
 
   // Zero the structure
   memset(&g_health_manager, 0, sizeof(g_health_manager));
 
   // Initialise health
-  health_manager_init();
+  if (health_manager_init(globalArgs.bandpass_bins) != EXIT_SUCCESS)
+  {
+    multilog(g_ctx.log, LOG_ERR, "main: ERROR: could not initialise the health manager\n");
+    return EXIT_FAILURE;
+  }
 
   g_health_manager.log = logger;
   g_health_manager.status = STATUS_RUNNING;
@@ -166,11 +296,48 @@ int main(int argc, char *argv[])
   pthread_t health_thread;
   pthread_create(&health_thread, NULL, health_thread_fn, (void *)&g_health_manager);
 
-  // Wait a few seconds for health to start
-  sleep(4);
+  // Get ready for the first observation while the health thread starts
+  if (warmup_run(client, globalArgs.trace_dir) != EXIT_SUCCESS)
+  {
+    multilog(g_ctx.log, LOG_ERR, "main: ERROR: could not get ready for the first observation\n");
+    return EXIT_FAILURE;
+  }
+
+  // Measure the destination path's bandwidth, and start the thread which measures it again between observations
+  if (g_ctx.disk_probe_bytes > 0 && diskprobe_init(g_ctx.destination_dir, g_ctx.disk_probe_bytes, g_ctx.log) != EXIT_SUCCESS)
+  {
+    multilog(g_ctx.log, LOG_ERR, "main: ERROR: could not start the disk probe thread\n");
+    return EXIT_FAILURE;
+  }
+
+  // ...then wait for health to be ready to send
+  if (health_wait_ready(HEALTH_READY_TIMEOUT_SECONDS) != EXIT_SUCCESS)
+  {
+    multilog(g_ctx.log, LOG_ERR, "main: ERROR: the health thread was not ready after %d seconds\n", HEALTH_READY_TIMEOUT_SECONDS);
+    return EXIT_FAILURE;
+  }
+
+  // Replaying files is done in one go, then we quit
+  if (globalArgs.input_file != NULL)
+  {
+    multilog(g_ctx.log, LOG_INFO, "main(): mwax_db2fits is started and replaying %s.\n", globalArgs.input_file);
+
+    if (file_source_read(client, globalArgs.input_file) != EXIT_SUCCESS)
+    {
+      multilog(g_ctx.log, LOG_ERR, "main: error replaying %s\n", globalArgs.input_file);
+      exit_code = EXIT_FAILURE;
+    }
+
+    quit_set(1);
+    quit = 1;
+    g_health_manager.status = STATUS_SHUTTING_DOWN;
+  }
+  else
+  {
+    multilog(g_ctx.log, LOG_INFO, "main(): mwax_db2fits is statred and ready to read from ringbuffer.\n");
+  }
 
   // main loop
-  multilog(g_ctx.log, LOG_INFO, "main(): mwax_db2fits is statred and ready to read from ringbuffer.\n");
   while (!quit)
   {
     multilog(g_ctx.log, LOG_INFO, "main: dada_client_read()\n");
@@ -210,18 +377,54 @@ int main(int argc, char *argv[])
 
   multilog(g_ctx.log, LOG_INFO, "mwax_db2fits stopping...\n");
 
+  // Let any queued fits files be closed and renamed
+  if (g_ctx.async_close)
+  {
+    multilog(g_ctx.log, LOG_INFO, "main: waiting for the fits finaliser thread\n");
+    finaliser_destroy();
+  }
+
+  diskprobe_destroy();
+
   // Wait for health thread to terminate
   pthread_join(health_thread, NULL);
 
-  multilog(g_ctx.log, LOG_INFO, "main: dada_hdu_disconnect()\n");
-  if (dada_hdu_disconnect(in_hdu) < 0)
+  // Both the reader and the health thread are done with the tile weights now
+  health_manager_free_tile_weights();
+
+  if (in_hdu != NULL)
   {
-    multilog(g_ctx.log, LOG_ERR, "main: failed to disconnect HDU\n");
-    return EXIT_FAILURE;
+    multilog(g_ctx.log, LOG_INFO, "main: dada_hdu_disconnect()\n");
+    if (dada_hdu_disconnect(in_hdu) < 0)
+    {
+      multilog(g_ctx.log, LOG_ERR, "main: failed to disconnect HDU\n");
+      return EXIT_FAILURE;
+    }
   }
 
+  // free the autos accumulator, flags, channel statistics, bad data and transpose staging buffers
+  autos_destroy(client);
+  rfi_destroy(client);
+  channel_stats_free(&g_ctx.chan_stats);
+  free(g_ctx.bad_baselines);
+  free(g_ctx.bad_data_weights);
+  free(g_ctx.transpose_buffer);
+  free(g_ctx.cube_weights);
+  free(g_ctx.file_integration_usec);
+  hdu_index_free(&g_ctx.hdu_index);
+  journal_close(&g_ctx.journal); // Left behind (with its .tmp file) if we stopped part way through a fits file, for the next run to recover
+  free(g_ctx.obs_start_metrics);
+  free(g_ctx.obs_end_metrics);
+  perf_counters_close(&g_ctx.perf);
+
+  // free the trace ring buffers (all threads have finished)
+  trace_destroy();
+
   // destroy HDUs and read client
-  dada_hdu_destroy(in_hdu);
+  if (in_hdu != NULL)
+  {
+    dada_hdu_destroy(in_hdu);
+  }
   dada_client_destroy(client);
 
   multilog(g_ctx.log, LOG_INFO, "mwax_db2fits stopped\n");
@@ -232,5 +435,5 @@ int main(int argc, char *argv[])
   // Destroy mutexes
   quit_destroy();
 
-  return EXIT_SUCCESS;
+  return exit_code;
 }
@@ -0,0 +1,226 @@
+/**
+ * @file metrics.c
+ * @author Greg Sleap
+ * @date 18 Oct 2026
+ * @brief This is the code that keeps throughput and latency metrics for the health packets
+ *
+ * The thread reading the ringbuffer only ever adds to counters (relaxed atomic adds, so it never waits).
+ * The health thread takes a copy of the counters each tick and works out the throughput and latency
+ * percentiles over the interval from the difference between this copy and the previous one.
+ */
+#include <time.h>
+
+#include "global.h"
+#include "metrics.h"
+
+/**
+ *
+ *  @brief Returns a monotonic timestamp, for timing things with metrics_record_latency().
+ *  @returns The current CLOCK_MONOTONIC time in nanoseconds.
+ */
+uint64_t metrics_now_ns()
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+
+  return ((uint64_t)now.tv_sec * 1000000000ull) + now.tv_nsec;
+}
+
+/**
+ *
+ *  @brief Returns the wall clock time, for comparing with the UNIX time of an integration.
+ *  @returns The current CLOCK_REALTIME time in microseconds since the UNIX epoch.
+ */
+uint64_t metrics_unix_time_usec()
+{
+  struct timespec now;
+  clock_gettime(CLOCK_REALTIME, &now);
+
+  return ((uint64_t)now.tv_sec * 1000000ull) + (now.tv_nsec / 1000);
+}
+
+/**
+ *
+ *  @brief Returns the name of a latency, for logging.
+ *  @param[in] latency METRICS_LATENCY_...
+ *  @returns The name of the latency.
+ */
+const char *metrics_latency_name(int latency)
+{
+  switch (latency)
+  {
+  case METRICS_LATENCY_CREATE_FITS:
+    return "create_fits";
+  case METRICS_LATENCY_CLOSE_FITS:
+    return "close_fits";
+  case METRICS_LATENCY_VIS_HDU:
+    return "vis_hdu";
+  case METRICS_LATENCY_WEIGHTS_HDU:
+    return "weights_hdu";
+  case METRICS_LATENCY_DATA_TO_HDU:
+    return "data_to_hdu";
+  case METRICS_LATENCY_DATA_TO_FITS:
+    return "data_to_fits";
+  default:
+    return "unknown";
+  }
+}
+
+/**
+ *
+ *  @brief Returns the histogram bucket for a value.
+ *  @param[in] value The value (microseconds).
+ *  @returns The bucket index, from 0 to METRICS_HISTOGRAM_BUCKETS - 1.
+ */
+int metrics_histogram_bucket(uint64_t value)
+{
+  if (value < METRICS_HISTOGRAM_SUB_BUCKETS)
+  {
+    return (int)value;
+  }
+
+  int msb = 63 - __builtin_clzll(value);
+
+  if (msb >= METRICS_HISTOGRAM_MAX_BITS)
+  {
+    return METRICS_HISTOGRAM_BUCKETS - 1;
+  }
+
+  // Keep the top METRICS_HISTOGRAM_SUB_BITS + 1 bits: the leading 1 picks the range, the rest the bucket within it
+  int shift = msb - METRICS_HISTOGRAM_SUB_BITS;
+  int sub_bucket = (int)(value >> shift) - METRICS_HISTOGRAM_SUB_BUCKETS;
+
+  return ((shift + 1) * METRICS_HISTOGRAM_SUB_BUCKETS) + sub_bucket;
+}
+
+/**
+ *
+ *  @brief Returns the highest value which falls into a histogram bucket (so percentiles are never under-reported).
+ *  @param[in] bucket The bucket index.
+ *  @returns The highest value (microseconds) in the bucket.
+ */
+uint64_t metrics_histogram_bucket_value(int bucket)
+{
+  if (bucket < METRICS_HISTOGRAM_SUB_BUCKETS)
+  {
+    return (uint64_t)bucket;
+  }
+
+  int shift = (bucket / METRICS_HISTOGRAM_SUB_BUCKETS) - 1;
+  uint64_t sub_bucket = bucket % METRICS_HISTOGRAM_SUB_BUCKETS;
+
+  return ((METRICS_HISTOGRAM_SUB_BUCKETS + sub_bucket + 1) << shift) - 1;
+}
+
+/**
+ *
+ *  @brief Records how long something took, from a start time to now.
+ *  @param[in] latency Which latency histogram to add to (METRICS_LATENCY_...).
+ *  @param[in] start_ns The metrics_now_ns() timestamp from when it started.
+ */
+void metrics_record_latency(int latency, uint64_t start_ns)
+{
+  uint64_t elapsed_usec = (metrics_now_ns() - start_ns) / 1000;
+
+  metrics_record_latency_usec(latency, elapsed_usec);
+}
+
+/**
+ *
+ *  @brief Records a latency which has already been worked out.
+ *  @param[in] latency Which latency histogram to add to (METRICS_LATENCY_...).
+ *  @param[in] usec The latency in microseconds.
+ */
+void metrics_record_latency_usec(int latency, uint64_t usec)
+{
+  atomic_fetch_add_explicit(&g_metrics.latency_counts[latency][metrics_histogram_bucket(usec)], 1, memory_order_relaxed);
+}
+
+/**
+ *
+ *  @brief Adds to the number of bytes and HDUs written.
+ *  @param[in] bytes Number of bytes written.
+ *  @param[in] hdus Number of HDUs written.
+ */
+void metrics_add_written(uint64_t bytes, uint64_t hdus)
+{
+  atomic_fetch_add_explicit(&g_metrics.bytes_written, bytes, memory_order_relaxed);
+  atomic_fetch_add_explicit(&g_metrics.hdus_written, hdus, memory_order_relaxed);
+}
+
+/**
+ *
+ *  @brief Takes a copy of the running totals. Each counter is read atomically, but they are not read all at once,
+ *         so a copy taken during an update may see part of it; the rest shows up in the next interval.
+ *  @param[out] out_snapshot The copy.
+ */
+void metrics_snapshot(metrics_snapshot_s *out_snapshot)
+{
+  out_snapshot->bytes_written = atomic_load_explicit(&g_metrics.bytes_written, memory_order_relaxed);
+  out_snapshot->hdus_written = atomic_load_explicit(&g_metrics.hdus_written, memory_order_relaxed);
+
+  for (int latency = 0; latency < METRICS_LATENCY_COUNT; latency++)
+  {
+    for (int bucket = 0; bucket < METRICS_HISTOGRAM_BUCKETS; bucket++)
+    {
+      out_snapshot->latency_counts[latency][bucket] = atomic_load_explicit(&g_metrics.latency_counts[latency][bucket], memory_order_relaxed);
+    }
+  }
+}
+
+/**
+ *
+ *  @brief Works out the count, p50, p99 and max of a latency over the interval between two snapshots.
+ *  @param[in] now The snapshot at the end of the interval.
+ *  @param[in] previous The snapshot at the start of the interval.
+ *  @param[in] latency Which latency histogram (METRICS_LATENCY_...).
+ *  @param[out] out_summary The summary. The percentiles and max are 0 if there were no samples.
+ */
+void metrics_summarise_latency(const metrics_snapshot_s *now, const metrics_snapshot_s *previous, int latency,
+                               metrics_latency_summary_s *out_summary)
+{
+  uint64_t count = 0;
+
+  for (int bucket = 0; bucket < METRICS_HISTOGRAM_BUCKETS; bucket++)
+  {
+    count += now->latency_counts[latency][bucket] - previous->latency_counts[latency][bucket];
+  }
+
+  out_summary->count = count;
+  out_summary->p50_usec = 0;
+  out_summary->p99_usec = 0;
+  out_summary->max_usec = 0;
+
+  if (count == 0)
+  {
+    return;
+  }
+
+  // The rank (1 based) of the sample at each percentile
+  uint64_t p50_rank = (count * 50 + 99) / 100;
+  uint64_t p99_rank = (count * 99 + 99) / 100;
+  uint64_t seen = 0;
+
+  for (int bucket = 0; bucket < METRICS_HISTOGRAM_BUCKETS; bucket++)
+  {
+    uint64_t in_bucket = now->latency_counts[latency][bucket] - previous->latency_counts[latency][bucket];
+
+    if (in_bucket == 0)
+    {
+      continue;
+    }
+
+    if (seen < p50_rank && seen + in_bucket >= p50_rank)
+    {
+      out_summary->p50_usec = metrics_histogram_bucket_value(bucket);
+    }
+
+    if (seen < p99_rank && seen + in_bucket >= p99_rank)
+    {
+      out_summary->p99_usec = metrics_histogram_bucket_value(bucket);
+    }
+
+    seen += in_bucket;
+    out_summary->max_usec = metrics_histogram_bucket_value(bucket);
+  }
+}
\ No newline at end of file
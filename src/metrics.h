@@ -0,0 +1,66 @@
+/**
+ * @file metrics.h
+ * @author Greg Sleap
+ * @date 18 Oct 2026
+ * @brief This is the header for the code that keeps throughput and latency metrics for the health packets
+ *
+ */
+#pragma once
+
+#include <stdatomic.h>
+#include <stdint.h>
+
+// Latencies we keep a histogram of
+#define METRICS_LATENCY_CREATE_FITS 0
+#define METRICS_LATENCY_CLOSE_FITS 1
+#define METRICS_LATENCY_VIS_HDU 2
+#define METRICS_LATENCY_WEIGHTS_HDU 3
+#define METRICS_LATENCY_DATA_TO_HDU 4  // From an integration's UNIX time to all of its HDUs being written
+#define METRICS_LATENCY_DATA_TO_FITS 5 // From an integration's UNIX time to its fits file being renamed to .fits
+#define METRICS_LATENCY_COUNT 6
+
+// HDR style log-linear histogram of microseconds: values below 2^METRICS_HISTOGRAM_SUB_BITS have their own bucket,
+// then each power of 2 range above that is split into 2^METRICS_HISTOGRAM_SUB_BITS buckets (so ~3% resolution).
+#define METRICS_HISTOGRAM_SUB_BITS 5
+#define METRICS_HISTOGRAM_SUB_BUCKETS (1 << METRICS_HISTOGRAM_SUB_BITS)
+#define METRICS_HISTOGRAM_MAX_BITS 36 // Values of 2^36 usec (~19 hours) or more go in the last bucket
+#define METRICS_HISTOGRAM_BUCKETS (METRICS_HISTOGRAM_SUB_BUCKETS * (METRICS_HISTOGRAM_MAX_BITS - METRICS_HISTOGRAM_SUB_BITS + 1))
+
+// Running totals updated (without locks) by the thread reading the ringbuffer
+typedef struct
+{
+  atomic_uint_least64_t bytes_written;
+  atomic_uint_least64_t hdus_written;
+  atomic_uint_least64_t latency_counts[METRICS_LATENCY_COUNT][METRICS_HISTOGRAM_BUCKETS];
+} metrics_s;
+
+// A copy of the running totals, so the change over an interval can be worked out
+typedef struct
+{
+  uint64_t bytes_written;
+  uint64_t hdus_written;
+  uint64_t latency_counts[METRICS_LATENCY_COUNT][METRICS_HISTOGRAM_BUCKETS];
+} metrics_snapshot_s;
+
+// Summary of one latency histogram over an interval
+typedef struct
+{
+  uint64_t count;
+  uint64_t p50_usec;
+  uint64_t p99_usec;
+  uint64_t max_usec;
+} metrics_latency_summary_s;
+
+uint64_t metrics_now_ns();
+uint64_t metrics_unix_time_usec();
+void metrics_record_latency(int latency, uint64_t start_ns);
+void metrics_record_latency_usec(int latency, uint64_t usec);
+void metrics_add_written(uint64_t bytes, uint64_t hdus);
+void metrics_snapshot(metrics_snapshot_s *out_snapshot);
+void metrics_summarise_latency(const metrics_snapshot_s *now, const metrics_snapshot_s *previous, int latency,
+                               metrics_latency_summary_s *out_summary);
+
+const char *metrics_latency_name(int latency);
+
+int metrics_histogram_bucket(uint64_t value);
+uint64_t metrics_histogram_bucket_value(int bucket);
\ No newline at end of file
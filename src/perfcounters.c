@@ -0,0 +1,350 @@
+/**
+ * @file perfcounters.c
+ * @author Greg Sleap
+ * @date 18 Oct 2026
+ * @brief This is the code that reads hardware performance counters around each stage of processing
+ *
+ * The counters are opened with perf_event_open() for the calling thread only (the thread reading the ringbuffer)
+ * and only count user space, so they work with the default perf_event_paranoid setting. They are opened as one
+ * group so each stage boundary is a single read(). Counters the machine (or VM) does not have are skipped.
+ *
+ * A stage which runs on a team of OpenMP threads (RFI flagging) is also counted on each worker thread, with counters
+ * of its own opened the first time it runs (see perf_counters_worker_read()). Counters which are inherited by the
+ * worker threads would also count them spinning between parallel regions, while other stages are being counted.
+ */
+#include <errno.h>
+#include <linux/perf_event.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "perfcounters.h"
+
+// The calling OpenMP worker thread's counters, and whether they are open: 0 = not tried yet, 1 = open, -1 = none
+static __thread perf_counters_s t_worker_perf;
+static __thread int t_worker_perf_state = 0;
+
+/**
+ *
+ *  @brief Returns the name of a counter, for logging.
+ *  @param[in] counter PERF_COUNTER_...
+ *  @returns The name of the counter.
+ */
+const char *perf_counter_name(int counter)
+{
+  switch (counter)
+  {
+  case PERF_COUNTER_CYCLES:
+    return "cycles";
+  case PERF_COUNTER_INSTRUCTIONS:
+    return "instructions";
+  case PERF_COUNTER_LLC_MISSES:
+    return "llc_misses";
+  case PERF_COUNTER_PAGE_FAULTS:
+    return "page_faults";
+  default:
+    return "unknown";
+  }
+}
+
+/**
+ *
+ *  @brief Returns the name of a stage, for logging.
+ *  @param[in] stage PERF_STAGE_...
+ *  @returns The name of the stage.
+ */
+const char *perf_stage_name(int stage)
+{
+  switch (stage)
+  {
+  case PERF_STAGE_SCAN_BAD_DATA:
+    return "scan_bad_data";
+  case PERF_STAGE_RFI_FLAG:
+    return "rfi_flag";
+  case PERF_STAGE_TRANSPOSE:
+    return "transpose";
+  case PERF_STAGE_VIS_HDU:
+    return "vis_hdu";
+  case PERF_STAGE_WEIGHTS_HDU:
+    return "weights_hdu";
+  case PERF_STAGE_FLAGS_HDU:
+    return "flags_hdu";
+  case PERF_STAGE_CHANSTATS_HDU:
+    return "chanstats_hdu";
+  case PERF_STAGE_HEALTH_WEIGHTS:
+    return "health_weights";
+  case PERF_STAGE_AUTOS:
+    return "autos";
+  default:
+    return "unknown";
+  }
+}
+
+/**
+ *
+ *  @brief Opens one counter, adding it to the group (or starting the group if it is the first).
+ *  @param[in] perf The perf counters.
+ *  @param[in] counter PERF_COUNTER_...
+ *  @param[in] type perf_event_attr type.
+ *  @param[in] config perf_event_attr config.
+ *  @returns The file descriptor, or -1 if the counter could not be opened.
+ */
+static int perf_counter_open(perf_counters_s *perf, int counter, uint32_t type, uint64_t config)
+{
+  struct perf_event_attr attr;
+  memset(&attr, 0, sizeof(attr));
+  attr.size = sizeof(attr);
+  attr.type = type;
+  attr.config = config;
+  attr.disabled = (perf->group_fd == -1); // The group leader starts disabled and enables the whole group
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  attr.read_format = PERF_FORMAT_GROUP;
+
+  int fd = (int)syscall(SYS_perf_event_open, &attr, 0, -1, perf->group_fd, 0);
+
+  if (fd == -1)
+  {
+    return -1;
+  }
+
+  if (perf->group_fd == -1)
+  {
+    perf->group_fd = fd;
+  }
+
+  perf->fds[counter] = fd;
+  perf->available |= (1 << counter);
+  perf->read_index[counter] = perf->ncounters;
+  perf->ncounters++;
+
+  return fd;
+}
+
+/**
+ *
+ *  @brief Opens and starts the counters for the calling thread. If none can be opened, perf->enabled is left 0.
+ *  @param[out] perf The perf counters.
+ *  @param[in] log A pointer to the multilog_t logger, or NULL to not log (e.g. for a worker thread).
+ *  @returns EXIT_SUCCESS if at least one counter was opened, or EXIT_FAILURE if none could be.
+ */
+int perf_counters_open(perf_counters_s *perf, multilog_t *log)
+{
+  memset(perf, 0, sizeof(perf_counters_s));
+  perf->group_fd = -1;
+
+  for (int counter = 0; counter < PERF_COUNTER_COUNT; counter++)
+  {
+    perf->fds[counter] = -1;
+    perf->read_index[counter] = -1;
+  }
+
+  const uint32_t types[PERF_COUNTER_COUNT] = {PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_SOFTWARE};
+  const uint64_t configs[PERF_COUNTER_COUNT] = {PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_SW_PAGE_FAULTS};
+
+  for (int counter = 0; counter < PERF_COUNTER_COUNT; counter++)
+  {
+    if (perf_counter_open(perf, counter, types[counter], configs[counter]) == -1 && log != NULL)
+    {
+      multilog(log, LOG_WARNING, "perf_counters_open(): Could not open %s counter: %s%s.\n", perf_counter_name(counter), strerror(errno),
+               ((errno == EACCES || errno == EPERM) ? " (check /proc/sys/kernel/perf_event_paranoid)" : ""));
+    }
+  }
+
+  if (perf->group_fd == -1)
+  {
+    if (log != NULL)
+    {
+      multilog(log, LOG_WARNING, "perf_counters_open(): No performance counters are available; continuing without them.\n");
+    }
+    return EXIT_FAILURE;
+  }
+
+  ioctl(perf->group_fd, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+  ioctl(perf->group_fd, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+  perf->enabled = 1;
+
+  if (log != NULL)
+  {
+    multilog(log, LOG_INFO, "perf_counters_open(): Opened %d of %d performance counters.\n", perf->ncounters, PERF_COUNTER_COUNT);
+  }
+
+  return EXIT_SUCCESS;
+}
+
+/**
+ *
+ *  @brief Closes the counters. This is safe to call on zeroed perf counters which were never opened.
+ *  @param[in,out] perf The perf counters.
+ */
+void perf_counters_close(perf_counters_s *perf)
+{
+  for (int counter = 0; counter < PERF_COUNTER_COUNT; counter++)
+  {
+    if (perf->available & (1 << counter))
+    {
+      close(perf->fds[counter]);
+      perf->fds[counter] = -1;
+    }
+  }
+
+  perf->group_fd = -1;
+  perf->available = 0;
+  perf->enabled = 0;
+}
+
+/**
+ *
+ *  @brief Reads the current value of every counter with one read() of the group.
+ *  @param[in] perf The perf counters.
+ *  @param[out] values The value of each counter (0 for counters which are not available).
+ *  @returns EXIT_SUCCESS on success, or EXIT_FAILURE if the read failed.
+ */
+static int perf_counters_read(perf_counters_s *perf, uint64_t values[PERF_COUNTER_COUNT])
+{
+  // Group read format: nr, then one value per counter in the order they were added
+  uint64_t buffer[1 + PERF_COUNTER_COUNT];
+
+  if (read(perf->group_fd, buffer, sizeof(uint64_t) * (1 + perf->ncounters)) != (ssize_t)(sizeof(uint64_t) * (1 + perf->ncounters)))
+  {
+    return EXIT_FAILURE;
+  }
+
+  for (int counter = 0; counter < PERF_COUNTER_COUNT; counter++)
+  {
+    values[counter] = (perf->read_index[counter] == -1 ? 0 : buffer[1 + perf->read_index[counter]]);
+  }
+
+  return EXIT_SUCCESS;
+}
+
+/**
+ *
+ *  @brief Notes the counter values at the start of a stage. Use PERF_STAGE_BEGIN() rather than calling this.
+ *  @param[in,out] perf The perf counters.
+ */
+void perf_counters_stage_begin(perf_counters_s *perf)
+{
+  if (perf_counters_read(perf, perf->stage_start) != EXIT_SUCCESS)
+  {
+    memset(perf->stage_start, 0, sizeof(perf->stage_start));
+  }
+}
+
+/**
+ *
+ *  @brief Adds the counts since perf_counters_stage_begin() to a stage of the current integration. Use PERF_STAGE_END() rather than calling this.
+ *  @param[in,out] perf The perf counters.
+ *  @param[in] stage PERF_STAGE_...
+ */
+void perf_counters_stage_end(perf_counters_s *perf, int stage)
+{
+  uint64_t values[PERF_COUNTER_COUNT];
+
+  if (perf_counters_read(perf, values) != EXIT_SUCCESS)
+  {
+    return;
+  }
+
+  perf_stage_counts_s *counts = &perf->integration[stage];
+  counts->samples++;
+
+  for (int counter = 0; counter < PERF_COUNTER_COUNT; counter++)
+  {
+    counts->counts[counter] += values[counter] - perf->stage_start[counter];
+  }
+}
+
+/**
+ *
+ *  @brief Reads the calling OpenMP worker thread's counters, opening them the first time. They stay open for the life
+ *         of the thread. Nothing is logged- the counters which can't be opened have already been warned about for the
+ *         thread reading the ringbuffer.
+ *  @param[out] values The value of each counter (all 0 if the thread has no counters).
+ */
+void perf_counters_worker_read(uint64_t values[PERF_COUNTER_COUNT])
+{
+  if (t_worker_perf_state == 0)
+  {
+    t_worker_perf_state = (perf_counters_open(&t_worker_perf, NULL) == EXIT_SUCCESS ? 1 : -1);
+  }
+
+  if (t_worker_perf_state != 1 || perf_counters_read(&t_worker_perf, values) != EXIT_SUCCESS)
+  {
+    memset(values, 0, sizeof(uint64_t) * PERF_COUNTER_COUNT);
+  }
+}
+
+/**
+ *
+ *  @brief Adds the counts of the OpenMP worker threads to a stage of the current integration (PERF_STAGE_END() only
+ *         counts the thread reading the ringbuffer).
+ *  @param[in,out] perf The perf counters.
+ *  @param[in] stage PERF_STAGE_...
+ *  @param[in] counts The sum of each counter over the worker threads.
+ */
+void perf_counters_add_workers(perf_counters_s *perf, int stage, const uint64_t counts[PERF_COUNTER_COUNT])
+{
+  for (int counter = 0; counter < PERF_COUNTER_COUNT; counter++)
+  {
+    perf->integration[stage].counts[counter] += counts[counter];
+  }
+}
+
+/**
+ *
+ *  @brief Adds the current integration's counts to the observation's, and clears them for the next integration.
+ *  @param[in,out] perf The perf counters.
+ */
+void perf_counters_end_integration(perf_counters_s *perf)
+{
+  for (int stage = 0; stage < PERF_STAGE_COUNT; stage++)
+  {
+    perf->observation[stage].samples += perf->integration[stage].samples;
+
+    for (int counter = 0; counter < PERF_COUNTER_COUNT; counter++)
+    {
+      perf->observation[stage].counts[counter] += perf->integration[stage].counts[counter];
+    }
+  }
+
+  memset(perf->integration, 0, sizeof(perf->integration));
+}
+
+/**
+ *
+ *  @brief Logs a summary of each stage over the observation, then clears the counts for the next observation.
+ *         Instructions per cycle (IPC) and LLC misses per 1000 instructions (MPKI) show whether a stage is compute or memory bound.
+ *  @param[in,out] perf The perf counters.
+ *  @param[in] log A pointer to the multilog_t logger.
+ *  @param[in] obs_id The observation the counts are for.
+ */
+void perf_counters_log_observation(perf_counters_s *perf, multilog_t *log, long obs_id)
+{
+  for (int stage = 0; stage < PERF_STAGE_COUNT; stage++)
+  {
+    perf_stage_counts_s *counts = &perf->observation[stage];
+
+    if (counts->samples == 0)
+    {
+      continue;
+    }
+
+    uint64_t cycles = counts->counts[PERF_COUNTER_CYCLES];
+    uint64_t instructions = counts->counts[PERF_COUNTER_INSTRUCTIONS];
+    uint64_t llc_misses = counts->counts[PERF_COUNTER_LLC_MISSES];
+
+    double ipc = (cycles > 0 ? (double)instructions / cycles : 0);
+    double mpki = (instructions > 0 ? (double)llc_misses * 1000.0 / instructions : 0);
+
+    multilog(log, LOG_INFO, "perf_counters(): obs_id %ld: %-14s n=%lu cycles/run=%lu instructions/run=%lu llc_misses/run=%lu page_faults/run=%lu IPC=%.2f MPKI=%.2f\n",
+             obs_id, perf_stage_name(stage), counts->samples,
+             cycles / counts->samples, instructions / counts->samples, llc_misses / counts->samples,
+             counts->counts[PERF_COUNTER_PAGE_FAULTS] / counts->samples, ipc, mpki);
+  }
+
+  memset(perf->observation, 0, sizeof(perf->observation));
+}
\ No newline at end of file
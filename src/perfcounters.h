@@ -0,0 +1,81 @@
+/**
+ * @file perfcounters.h
+ * @author Greg Sleap
+ * @date 18 Oct 2026
+ * @brief This is the header for the code that reads hardware performance counters around each stage of processing
+ *
+ */
+#pragma once
+
+#include <stdint.h>
+#include "multilog.h"
+
+// Counters we read (in this order)
+#define PERF_COUNTER_CYCLES 0
+#define PERF_COUNTER_INSTRUCTIONS 1
+#define PERF_COUNTER_LLC_MISSES 2
+#define PERF_COUNTER_PAGE_FAULTS 3
+#define PERF_COUNTER_COUNT 4
+
+// Stages of dada_dbfits_io() we count
+#define PERF_STAGE_SCAN_BAD_DATA 0
+#define PERF_STAGE_RFI_FLAG 1
+#define PERF_STAGE_TRANSPOSE 2
+#define PERF_STAGE_VIS_HDU 3
+#define PERF_STAGE_WEIGHTS_HDU 4
+#define PERF_STAGE_FLAGS_HDU 5
+#define PERF_STAGE_CHANSTATS_HDU 6
+#define PERF_STAGE_HEALTH_WEIGHTS 7
+#define PERF_STAGE_AUTOS 8
+#define PERF_STAGE_COUNT 9
+
+// Counts for each stage
+typedef struct
+{
+  uint64_t samples;                    // Number of times the stage ran
+  uint64_t counts[PERF_COUNTER_COUNT]; // Sum of each counter over those runs
+} perf_stage_counts_s;
+
+typedef struct
+{
+  int enabled;                                       // 1 if at least one counter could be opened
+  int group_fd;                                      // The counters are opened as one group, so one read() gets them all
+  int fds[PERF_COUNTER_COUNT];                       // -1 if the counter is not available on this machine
+  int available;                                     // Bit mask (1 << PERF_COUNTER_...) of the counters which could be opened
+  int read_index[PERF_COUNTER_COUNT];                // Position of each counter in the group read
+  int ncounters;                                     // Number of counters in the group
+  uint64_t stage_start[PERF_COUNTER_COUNT];          // Counter values when the current stage began
+  perf_stage_counts_s integration[PERF_STAGE_COUNT]; // Counts for the current integration
+  perf_stage_counts_s observation[PERF_STAGE_COUNT]; // Counts since the start of the observation
+} perf_counters_s;
+
+// Bracket a stage. When perf counters are disabled this is just the test of enabled.
+#define PERF_STAGE_BEGIN(perf)                     \
+  do                                               \
+  {                                                \
+    if (__builtin_expect((perf)->enabled, 0))      \
+    {                                              \
+      perf_counters_stage_begin(perf);             \
+    }                                              \
+  } while (0)
+
+#define PERF_STAGE_END(perf, stage)                \
+  do                                               \
+  {                                                \
+    if (__builtin_expect((perf)->enabled, 0))      \
+    {                                              \
+      perf_counters_stage_end((perf), (stage));    \
+    }                                              \
+  } while (0)
+
+int perf_counters_open(perf_counters_s *perf, multilog_t *log);
+void perf_counters_close(perf_counters_s *perf);
+void perf_counters_stage_begin(perf_counters_s *perf);
+void perf_counters_stage_end(perf_counters_s *perf, int stage);
+void perf_counters_end_integration(perf_counters_s *perf);
+void perf_counters_worker_read(uint64_t values[PERF_COUNTER_COUNT]);
+void perf_counters_add_workers(perf_counters_s *perf, int stage, const uint64_t counts[PERF_COUNTER_COUNT]);
+void perf_counters_log_observation(perf_counters_s *perf, multilog_t *log, long obs_id);
+
+const char *perf_counter_name(int counter);
+const char *perf_stage_name(int stage);
\ No newline at end of file
@@ -0,0 +1,14 @@
+/**
+ * @file probes.c
+ * @author Greg Sleap
+ * @date 18 Oct 2026
+ * @brief The semaphores of the USDT probes in probes.h
+ *
+ * Tracers find each probe's semaphore from its ELF note and increment it (in the .probes section) while attached.
+ */
+#include "probes.h"
+
+#ifdef HAVE_SYS_SDT_H
+#define MWAX_PROBE_DEFINE_SEMAPHORE(name) volatile unsigned short MWAX_PROBE_SEMAPHORE(name) __attribute__((unused, section(".probes")));
+MWAX_PROBES(MWAX_PROBE_DEFINE_SEMAPHORE)
+#endif
\ No newline at end of file
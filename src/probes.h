@@ -0,0 +1,99 @@
+/**
+ * @file probes.h
+ * @author Greg Sleap
+ * @date 18 Oct 2026
+ * @brief USDT (SystemTap compatible) static probe points, for attaching bpftrace or perf to a running mwax_db2fits
+ *
+ * Each probe is a single NOP plus an ELF note describing where its arguments are, so they cost (almost) nothing
+ * until a tracer attaches. Each probe also has a semaphore (in probes.c), which tracers such as bpftrace and
+ * systemtap increment while they are attached, and the probe's arguments (e.g. a duration from metrics_now_ns()) are
+ * only evaluated while it is non-zero. If sys/sdt.h is not available when building, the probes compile to nothing
+ * (their arguments are never evaluated, but still count as used).
+ * All probes are in the mwax_db2fits provider, e.g. usdt:./bin/mwax_db2fits:mwax_db2fits:vis_hdu_write
+ */
+#pragma once
+
+// All of the probes, so probes.c can define a semaphore for each
+#define MWAX_PROBES(X)    \
+  X(integration_written)  \
+  X(create_fits)          \
+  X(close_fits)           \
+  X(vis_hdu_write)        \
+  X(weights_hdu_write)    \
+  X(flags_hdu_write)      \
+  X(chanstats_hdu_write)  \
+  X(autos_hdu_write)      \
+  X(health_packet_sent)
+
+#ifdef HAVE_SYS_SDT_H
+#define _SDT_HAS_SEMAPHORES 1
+#include <sys/sdt.h>
+
+#define MWAX_PROBE_SEMAPHORE(name) mwax_db2fits_##name##_semaphore
+#define MWAX_PROBE_DECLARE_SEMAPHORE(name) extern volatile unsigned short MWAX_PROBE_SEMAPHORE(name);
+MWAX_PROBES(MWAX_PROBE_DECLARE_SEMAPHORE)
+
+#define MWAX_PROBE_ENABLED(name) __builtin_expect(MWAX_PROBE_SEMAPHORE(name) != 0, 0)
+#define MWAX_PROBE_FIRE3(name, arg1, arg2, arg3) DTRACE_PROBE3(mwax_db2fits, name, arg1, arg2, arg3)
+#define MWAX_PROBE_FIRE4(name, arg1, arg2, arg3, arg4) DTRACE_PROBE4(mwax_db2fits, name, arg1, arg2, arg3, arg4)
+#else
+#define MWAX_PROBE_ENABLED(name) 0
+#define MWAX_PROBE_FIRE3(name, arg1, arg2, arg3) \
+  do                                             \
+  {                                              \
+    (void)(arg1);                                \
+    (void)(arg2);                                \
+    (void)(arg3);                                \
+  } while (0)
+
+#define MWAX_PROBE_FIRE4(name, arg1, arg2, arg3, arg4) \
+  do                                                   \
+  {                                                    \
+    (void)(arg1);                                      \
+    (void)(arg2);                                      \
+    (void)(arg3);                                      \
+    (void)(arg4);                                      \
+  } while (0)
+#endif
+
+#define MWAX_PROBE3(name, arg1, arg2, arg3)        \
+  do                                               \
+  {                                                \
+    if (MWAX_PROBE_ENABLED(name))                  \
+    {                                              \
+      MWAX_PROBE_FIRE3(name, arg1, arg2, arg3);    \
+    }                                              \
+  } while (0)
+
+#define MWAX_PROBE4(name, arg1, arg2, arg3, arg4)     \
+  do                                                  \
+  {                                                   \
+    if (MWAX_PROBE_ENABLED(name))                     \
+    {                                                 \
+      MWAX_PROBE_FIRE4(name, arg1, arg2, arg3, arg4); \
+    }                                                 \
+  } while (0)
+
+// When to time a probe's duration from: 0 unless the probe is enabled, so the clock isn't read for nothing
+#define MWAX_PROBE_START_NS(name) (MWAX_PROBE_ENABLED(name) ? metrics_now_ns() : 0)
+
+// The duration (ns) since start_ns, or 0 if the probe was not enabled at the start
+#define MWAX_PROBE_ELAPSED_NS(start_ns) ((start_ns) != 0 ? metrics_now_ns() - (start_ns) : 0)
+
+//
+// Probes and their arguments (durations are in nanoseconds)
+//
+// dada_dbfits_io():
+//   integration_written(long obs_id, int marker, uint64_t bytes, uint64_t duration_ns)
+//
+// fitswriter:
+//   create_fits(long obs_id, const char *filename, uint64_t duration_ns)
+//   close_fits(const char *filename, int fits_is_good, uint64_t duration_ns)
+//   vis_hdu_write(long obs_id, int marker, uint64_t bytes, uint64_t duration_ns)
+//   weights_hdu_write(long obs_id, int marker, uint64_t bytes, uint64_t duration_ns)
+//   flags_hdu_write(long obs_id, int marker, uint64_t bytes, uint64_t duration_ns)
+//   chanstats_hdu_write(long obs_id, int marker, uint64_t bytes, uint64_t duration_ns)
+//   autos_hdu_write(long obs_id, int marker, uint64_t bytes, uint64_t duration_ns)
+//
+// health_thread_fn():
+//   health_packet_sent(long obs_id, long subobs_id, int status, uint64_t duration_ns)
\ No newline at end of file
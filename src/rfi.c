@@ -0,0 +1,337 @@
+/**
+ * @file rfi.c
+ * @author Greg Sleap
+ * @date 18 Oct 2026
+ * @brief This is the code that flags RFI in each integration before it is written
+ *
+ * For each baseline we look at the XX and YY amplitudes across the fine channels and flag any
+ * fine channel which is more than threshold sigma (estimated robustly using the median absolute
+ * deviation) away from the median in either pol. Baselines are shared out across a team of
+ * OpenMP threads (each of which counts itself with --perf-counters). The flags are bit packed:
+ * [baseline][finechan / 8], with fine channel f being bit (f % 8) (least significant bit first)
+ * of byte f / 8 in each baseline's row.
+ */
+#include <assert.h>
+#include <math.h>
+#include <omp.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "global.h"
+#include "multilog.h"
+#include "perfcounters.h"
+#include "rfi.h"
+
+/**
+ *
+ *  @brief Returns the k-th smallest value in an array (Hoare's selection). The array is reordered in the process.
+ *  @param[in,out] values The array to search.
+ *  @param[in] n Number of elements in values.
+ *  @param[in] k Index (0 based) of the element to return if values were sorted.
+ *  @returns The k-th smallest value.
+ */
+static float select_kth(float *values, int n, int k)
+{
+  int left = 0;
+  int right = n - 1;
+
+  while (left < right)
+  {
+    float pivot = values[k];
+    int i = left;
+    int j = right;
+
+    do
+    {
+      while (values[i] < pivot)
+        i++;
+      while (pivot < values[j])
+        j--;
+
+      if (i <= j)
+      {
+        float tmp = values[i];
+        values[i] = values[j];
+        values[j] = tmp;
+        i++;
+        j--;
+      }
+    } while (i <= j);
+
+    if (j < k)
+      left = i;
+    if (k < i)
+      right = j;
+  }
+
+  return values[k];
+}
+
+/**
+ *
+ *  @brief Flags one polarisation of one baseline, OR-ing any flagged fine channels into flags. Fine channels with a
+ *         NaN/Inf amplitude are always flagged, and left out of the median and MAD of the rest. The MAD is at least
+ *         RFI_MIN_MAD_FRACTION of the median, so when most channels have exactly the same amplitude (quantised data,
+ *         zero-padded band edges) the others are not all flagged for differing slightly. If every finite amplitude
+ *         is 0, nothing else is flagged.
+ *  @param[in] baseline_data The visibilities for this baseline: [finechan][pol][r,i].
+ *  @param[in] pol_index The index of the pol to look at (0 == xx).
+ *  @param[in] values_per_fine_channel Number of floats per fine channel (pol * pol * 2).
+ *  @param[in] fine_channels Number of fine channels.
+ *  @param[in] threshold Number of sigma from the median to flag at.
+ *  @param[out] flags The bit packed flags for this baseline.
+ *  @param[in] amplitudes Scratch space of fine_channels floats.
+ *  @param[in] work Scratch space of fine_channels floats.
+ */
+static void rfi_flag_pol(const float *baseline_data, int pol_index, int values_per_fine_channel, int fine_channels, float threshold,
+                         unsigned char *flags, float *amplitudes, float *work)
+{
+  int finite = 0;
+
+  for (int f = 0; f < fine_channels; f++)
+  {
+    float re = baseline_data[(f * values_per_fine_channel) + (pol_index * 2)];
+    float im = baseline_data[(f * values_per_fine_channel) + (pol_index * 2) + 1];
+    amplitudes[f] = sqrtf((re * re) + (im * im));
+
+    if (isfinite(amplitudes[f]))
+    {
+      work[finite++] = amplitudes[f];
+    }
+    else
+    {
+      flags[f / 8] |= (unsigned char)(1 << (f % 8));
+    }
+  }
+
+  if (finite == 0)
+  {
+    return;
+  }
+
+  float median = select_kth(work, finite, finite / 2);
+
+  for (int i = 0; i < finite; i++)
+  {
+    work[i] = fabsf(work[i] - median);
+  }
+
+  float mad = fmaxf(select_kth(work, finite, finite / 2), RFI_MIN_MAD_FRACTION * median);
+
+  if (mad <= 0)
+  {
+    return;
+  }
+
+  float limit = threshold * RFI_MAD_TO_SIGMA * mad;
+
+  for (int f = 0; f < fine_channels; f++)
+  {
+    if (isfinite(amplitudes[f]) && fabsf(amplitudes[f] - median) > limit)
+    {
+      flags[f / 8] |= (unsigned char)(1 << (f % 8));
+    }
+  }
+}
+
+/**
+ *
+ *  @brief Flags all of the baselines in one integration.
+ *  @param[in] buffer The visibilities: [baseline][finechan][pol][r,i].
+ *  @param[out] flags The bit packed flags: [baseline][(finechan + 7) / 8].
+ *  @param[in] baselines Number of baselines.
+ *  @param[in] fine_channels Number of fine channels.
+ *  @param[in] polarisations Number of pols per antenna (normally 2).
+ *  @param[in] threshold Number of sigma from the median to flag at.
+ *  @param[in] threads Number of threads to use.
+ *  @param[in] scratch Scratch space of threads * 2 * fine_channels floats.
+ *  @param[in,out] worker_counts PERF_COUNTER_COUNT counts to add the perf counts of the worker threads (not the calling
+ *                 thread) to, or NULL to not count them.
+ *  @returns The number of baseline/fine channels flagged.
+ */
+uint64_t rfi_flag_baselines(const float *buffer, unsigned char *flags, uint64_t baselines, int fine_channels, int polarisations,
+                            float threshold, int threads, float *scratch, uint64_t *worker_counts)
+{
+  const int values_per_fine_channel = polarisations * polarisations * 2;
+  const int yy_pol_index = (polarisations * polarisations) - 1;
+  const uint64_t flag_bytes_per_baseline = (fine_channels + 7) / 8;
+  uint64_t flagged = 0;
+
+  memset(flags, 0, baselines * flag_bytes_per_baseline);
+
+#pragma omp parallel num_threads(threads) reduction(+ : flagged)
+  {
+    float *amplitudes = scratch + ((uint64_t)omp_get_thread_num() * 2 * fine_channels);
+    float *work = amplitudes + fine_channels;
+
+    // The calling thread is thread 0, and its counts are in the stage's counts already
+    int count_worker = (worker_counts != NULL && omp_get_thread_num() != 0);
+    uint64_t worker_start[PERF_COUNTER_COUNT];
+
+    if (count_worker)
+    {
+      perf_counters_worker_read(worker_start);
+    }
+
+    // nowait, so a thread which finishes early doesn't count its wait at the barrier
+#pragma omp for schedule(static) nowait
+    for (uint64_t b = 0; b < baselines; b++)
+    {
+      const float *baseline_data = buffer + (b * fine_channels * values_per_fine_channel);
+      unsigned char *baseline_flags = flags + (b * flag_bytes_per_baseline);
+
+      rfi_flag_pol(baseline_data, 0, values_per_fine_channel, fine_channels, threshold, baseline_flags, amplitudes, work);
+
+      if (yy_pol_index != 0)
+      {
+        rfi_flag_pol(baseline_data, yy_pol_index, values_per_fine_channel, fine_channels, threshold, baseline_flags, amplitudes, work);
+      }
+
+      for (uint64_t byte = 0; byte < flag_bytes_per_baseline; byte++)
+      {
+        flagged += __builtin_popcount(baseline_flags[byte]);
+      }
+    }
+
+    if (count_worker)
+    {
+      uint64_t worker_end[PERF_COUNTER_COUNT];
+      perf_counters_worker_read(worker_end);
+
+      for (int counter = 0; counter < PERF_COUNTER_COUNT; counter++)
+      {
+#pragma omp atomic
+        worker_counts[counter] += worker_end[counter] - worker_start[counter];
+      }
+    }
+  }
+
+  return flagged;
+}
+
+/**
+ *
+ *  @brief Sets up the flags and scratch buffers for a new observation. Call after the header has been read and validated.
+ *  @param[in] client A pointer to the dada_client_t object.
+ *  @returns EXIT_SUCCESS on success, or -1 if there was an error.
+ */
+int rfi_init_observation(dada_client_t *client)
+{
+  assert(client != 0);
+  dada_db_s *ctx = (dada_db_s *)client->context;
+  multilog_t *log = (multilog_t *)ctx->log;
+
+  if (ctx->rfi_threshold <= 0)
+  {
+    return EXIT_SUCCESS;
+  }
+
+  ctx->expected_transfer_size_of_flags = ctx->nbaselines * ((ctx->nfine_chan + 7) / 8);
+
+  if (ctx->expected_transfer_size_of_flags > ctx->rfi_flags_capacity)
+  {
+    unsigned char *new_flags = realloc(ctx->rfi_flags, ctx->expected_transfer_size_of_flags);
+
+    if (new_flags == NULL)
+    {
+      multilog(log, LOG_ERR, "rfi_init_observation(): Error allocating %lu bytes for the flags buffer.\n", ctx->expected_transfer_size_of_flags);
+      return -1;
+    }
+
+    ctx->rfi_flags = new_flags;
+    ctx->rfi_flags_capacity = ctx->expected_transfer_size_of_flags;
+  }
+
+  uint64_t scratch_bytes = (uint64_t)ctx->rfi_threads * 2 * ctx->nfine_chan * sizeof(float);
+
+  if (scratch_bytes > ctx->rfi_scratch_capacity)
+  {
+    float *new_scratch = realloc(ctx->rfi_scratch, scratch_bytes);
+
+    if (new_scratch == NULL)
+    {
+      multilog(log, LOG_ERR, "rfi_init_observation(): Error allocating %lu bytes for the flagging scratch buffer.\n", scratch_bytes);
+      return -1;
+    }
+
+    ctx->rfi_scratch = new_scratch;
+    ctx->rfi_scratch_capacity = scratch_bytes;
+  }
+
+  return EXIT_SUCCESS;
+}
+
+/**
+ *
+ *  @brief Flags one integration into ctx->rfi_flags and reports how long it took.
+ *  @param[in] client A pointer to the dada_client_t object.
+ *  @param[in] buffer The visibilities for this integration: [baseline][finechan][pol][r,i].
+ *  @returns EXIT_SUCCESS on success, or -1 if there was an error.
+ */
+int rfi_flag_integration(dada_client_t *client, const float *buffer)
+{
+  assert(client != 0);
+  dada_db_s *ctx = (dada_db_s *)client->context;
+  multilog_t *log = (multilog_t *)ctx->log;
+
+  struct timespec start, end;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+
+  uint64_t worker_counts[PERF_COUNTER_COUNT] = {0};
+
+  ctx->rfi_flagged = rfi_flag_baselines(buffer, ctx->rfi_flags, ctx->nbaselines, ctx->nfine_chan, ctx->npol, ctx->rfi_threshold, ctx->rfi_threads, ctx->rfi_scratch,
+                                        (ctx->perf.enabled ? worker_counts : NULL));
+
+  if (ctx->perf.enabled)
+  {
+    perf_counters_add_workers(&ctx->perf, PERF_STAGE_RFI_FLAG, worker_counts);
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  double elapsed_ms = ((end.tv_sec - start.tv_sec) * 1000.0) + ((end.tv_nsec - start.tv_nsec) / 1000000.0);
+
+  multilog(log, LOG_INFO, "rfi_flag_integration(): Flagged %lu of %lu baseline/fine channels (%0.2f%%) in %0.3f ms (%0.1f%% of integration time) using %d threads; Marker = %d.\n",
+           ctx->rfi_flagged, ctx->nbaselines * ctx->nfine_chan, (100.0 * ctx->rfi_flagged) / (ctx->nbaselines * ctx->nfine_chan),
+           elapsed_ms, (100.0 * elapsed_ms) / ctx->int_time_msec, ctx->rfi_threads, ctx->obs_marker_number);
+
+  return EXIT_SUCCESS;
+}
+
+/**
+ *
+ *  @brief Frees the memory used for flagging.
+ *  @param[in] client A pointer to the dada_client_t object.
+ */
+void rfi_destroy(dada_client_t *client)
+{
+  assert(client != 0);
+  dada_db_s *ctx = (dada_db_s *)client->context;
+
+  free(ctx->rfi_flags);
+  ctx->rfi_flags = NULL;
+  ctx->rfi_flags_capacity = 0;
+
+  free(ctx->rfi_scratch);
+  ctx->rfi_scratch = NULL;
+  ctx->rfi_scratch_capacity = 0;
+}
+
+/**
+ *
+ *  @brief Starts the OpenMP threads used for flagging (they are then kept for later parallel regions), and opens
+ *         their perf counters, so the first integration flagged does not pay for either.
+ *  @param[in] threads The number of threads (--rfi-threads).
+ *  @param[in] perf_counters 1 if the worker threads should open their perf counters (--perf-counters).
+ */
+void rfi_start_threads(int threads, int perf_counters)
+{
+#pragma omp parallel num_threads(threads)
+  {
+    if (perf_counters && omp_get_thread_num() != 0)
+    {
+      uint64_t values[PERF_COUNTER_COUNT];
+      perf_counters_worker_read(values);
+    }
+  }
+}
\ No newline at end of file
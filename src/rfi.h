@@ -0,0 +1,23 @@
+/**
+ * @file rfi.h
+ * @author Greg Sleap
+ * @date 18 Oct 2026
+ * @brief This is the header for the code that flags RFI in each integration before it is written
+ *
+ */
+#pragma once
+
+#include <stdint.h>
+#include "dada_client.h"
+
+#define RFI_MAD_TO_SIGMA 1.4826f // Scale factor to turn a median absolute deviation into a gaussian standard deviation
+#define RFI_MIN_MAD_FRACTION 0.01f // The MAD used is at least this fraction of the median, so a MAD of 0 doesn't flag every channel that differs from it
+#define RFI_DEFAULT_THREADS 4    // Default number of threads used for flagging
+
+int rfi_init_observation(dada_client_t *client);
+int rfi_flag_integration(dada_client_t *client, const float *buffer);
+void rfi_destroy(dada_client_t *client);
+void rfi_start_threads(int threads, int perf_counters);
+
+uint64_t rfi_flag_baselines(const float *buffer, unsigned char *flags, uint64_t baselines, int fine_channels, int polarisations,
+                            float threshold, int threads, float *scratch, uint64_t *worker_counts);
\ No newline at end of file
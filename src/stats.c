@@ -0,0 +1,198 @@
+/**
+ * @file stats.c
+ * @author Greg Sleap
+ * @date 18 Oct 2026
+ * @brief This is the code that computes data quality statistics of each integration
+ *
+ * These routines only depend on the C library so that they can be benchmarked on their own.
+ */
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "stats.h"
+
+/**
+ *
+ *  @brief Allocates (or reallocates) the arrays of a channel_stats_s for a given number of fine channels and pols.
+ *  @param[in,out] stats The stats structure. Must be zeroed before the first call.
+ *  @param[in] fine_channels Number of fine channels.
+ *  @param[in] pols Number of pols per baseline (e.g. 4 == xx,xy,yx,yy).
+ *  @returns EXIT_SUCCESS on success, or EXIT_FAILURE if memory could not be allocated.
+ */
+int channel_stats_alloc(channel_stats_s *stats, int fine_channels, int pols)
+{
+  int nvalues = fine_channels * pols;
+
+  if (nvalues == stats->nvalues && stats->mean_power != NULL)
+  {
+    return EXIT_SUCCESS;
+  }
+
+  channel_stats_free(stats);
+
+  stats->mean_power = malloc(nvalues * sizeof(float));
+  stats->rms_power = malloc(nvalues * sizeof(float));
+  stats->max_power = malloc(nvalues * sizeof(float));
+  stats->nnan = malloc(nvalues * sizeof(int32_t));
+  stats->sum = malloc(nvalues * sizeof(double));
+  stats->sum_sq = malloc(nvalues * sizeof(double));
+  stats->max_bits = malloc(nvalues * sizeof(uint32_t));
+
+  if (stats->mean_power == NULL || stats->rms_power == NULL || stats->max_power == NULL || stats->nnan == NULL || stats->sum == NULL || stats->sum_sq == NULL || stats->max_bits == NULL)
+  {
+    channel_stats_free(stats);
+    return EXIT_FAILURE;
+  }
+
+  stats->nvalues = nvalues;
+
+  return EXIT_SUCCESS;
+}
+
+/**
+ *
+ *  @brief Frees the arrays of a channel_stats_s.
+ *  @param[in,out] stats The stats structure.
+ */
+void channel_stats_free(channel_stats_s *stats)
+{
+  free(stats->mean_power);
+  free(stats->rms_power);
+  free(stats->max_power);
+  free(stats->nnan);
+  free(stats->sum);
+  free(stats->sum_sq);
+  free(stats->max_bits);
+
+  memset(stats, 0, sizeof(channel_stats_s));
+}
+
+/**
+ *
+ *  @brief Computes the per fine channel/pol statistics of one integration in a single pass over the visibilities.
+ *         The inner loop runs along the contiguous [finechan][pol] values of each baseline with no branches, so the
+ *         compiler can vectorise it. A value is non-finite if the exponent bits of its real or imaginary part are all
+ *         set (NaN or Inf). Non-finite values are masked to 0 before the power is computed, in double precision so
+ *         that a large but finite value can't overflow it. The max is tracked on the bit pattern of the power as a
+ *         float (which orders the same as the value for floats >= 0), because float selects and compares are not
+ *         vectorised by gcc without relaxing the floating point trapping rules.
+ *  @param[in] buffer The visibilities: [baseline][finechan][pol][r,i].
+ *  @param[in] baselines The number of baselines.
+ *  @param[in,out] stats The stats structure, allocated with channel_stats_alloc().
+ */
+void compute_channel_stats(const float *buffer, uint64_t baselines, channel_stats_s *stats)
+{
+  const int nvalues = stats->nvalues;
+  double *restrict sum = stats->sum;
+  double *restrict sum_sq = stats->sum_sq;
+  uint32_t *restrict max_bits = stats->max_bits;
+  int32_t *restrict nnan = stats->nnan;
+
+  for (int i = 0; i < nvalues; i++)
+  {
+    sum[i] = 0;
+    sum_sq[i] = 0;
+    max_bits[i] = 0;
+    nnan[i] = 0;
+  }
+
+  for (uint64_t b = 0; b < baselines; b++)
+  {
+    const float *restrict values = buffer + (b * nvalues * 2);
+
+    for (int i = 0; i < nvalues; i++)
+    {
+      uint32_t re_bits;
+      uint32_t im_bits;
+      memcpy(&re_bits, &values[i * 2], sizeof(re_bits));
+      memcpy(&im_bits, &values[(i * 2) + 1], sizeof(im_bits));
+      int32_t finite = ((re_bits & 0x7f800000) != 0x7f800000) & ((im_bits & 0x7f800000) != 0x7f800000);
+      uint32_t mask = 0u - (uint32_t)finite;
+      re_bits &= mask;
+      im_bits &= mask;
+      float re;
+      float im;
+      memcpy(&re, &re_bits, sizeof(re));
+      memcpy(&im, &im_bits, sizeof(im));
+
+      double power = ((double)re * re) + ((double)im * im);
+      float power_float = (float)power;
+      uint32_t power_bits;
+      memcpy(&power_bits, &power_float, sizeof(power_bits));
+
+      sum[i] += power;
+      sum_sq[i] += power * power;
+      max_bits[i] = (power_bits > max_bits[i]) ? power_bits : max_bits[i];
+      nnan[i] += !finite;
+    }
+  }
+
+  for (int i = 0; i < nvalues; i++)
+  {
+    double count = (double)baselines - nnan[i];
+
+    if (count > 0)
+    {
+      double mean = sum[i] / count;
+      double variance = (sum_sq[i] / count) - (mean * mean);
+
+      stats->mean_power[i] = (float)mean;
+      stats->rms_power[i] = (float)sqrt(variance > 0 ? variance : 0);
+      memcpy(&stats->max_power[i], &max_bits[i], sizeof(float));
+    }
+    else
+    {
+      stats->mean_power[i] = NAN;
+      stats->rms_power[i] = NAN;
+      stats->max_power[i] = NAN;
+    }
+  }
+}
+
+/**
+ *
+ *  @brief Scans the visibilities of one integration for corrupt data: non-finite (NaN or Inf) values and baselines
+ *         where every value is zero. Only integer operations on the bit patterns of the values are used so that the
+ *         compiler can vectorise the loop and the scan runs at memory bandwidth.
+ *  @param[in] buffer The visibilities: [baseline][values_per_baseline].
+ *  @param[in] baselines The number of baselines.
+ *  @param[in] values_per_baseline The number of floats per baseline (fine channels * pols * 2).
+ *  @param[out] bad_baselines If not NULL, set to 1 for each baseline with a non-finite value or zero power, else 0.
+ *  @param[out] zero_baselines The number of baselines where every value is zero.
+ *  @returns The number of non-finite values.
+ */
+uint64_t scan_bad_data(const float *buffer, uint64_t baselines, int values_per_baseline, unsigned char *bad_baselines,
+                       uint64_t *zero_baselines)
+{
+  uint64_t nonfinite = 0;
+  uint64_t zeros = 0;
+
+  for (uint64_t b = 0; b < baselines; b++)
+  {
+    const float *restrict values = buffer + (b * values_per_baseline);
+    uint32_t baseline_nonfinite = 0;
+    uint32_t any_bits = 0;
+
+    for (int i = 0; i < values_per_baseline; i++)
+    {
+      uint32_t bits;
+      memcpy(&bits, &values[i], sizeof(bits));
+
+      baseline_nonfinite += ((bits & 0x7f800000) == 0x7f800000);
+      any_bits |= (bits & 0x7fffffff); // ignore the sign bit, so -0.0 is zero too
+    }
+
+    nonfinite += baseline_nonfinite;
+    zeros += (any_bits == 0);
+
+    if (bad_baselines != NULL)
+    {
+      bad_baselines[b] = (baseline_nonfinite > 0 || any_bits == 0);
+    }
+  }
+
+  *zero_baselines = zeros;
+
+  return nonfinite;
+}
\ No newline at end of file
@@ -0,0 +1,31 @@
+/**
+ * @file stats.h
+ * @author Greg Sleap
+ * @date 18 Oct 2026
+ * @brief This is the header for the code that computes data quality statistics of each integration
+ *
+ */
+#pragma once
+
+#include <stdint.h>
+
+// Per fine channel and pol statistics of one integration, over all baselines. Each array is [finechan][pol]
+typedef struct
+{
+  int nvalues;       // fine channels * pols (number of elements in each array)
+  float *mean_power; // Mean of (r^2 + i^2) over the baselines with finite values
+  float *rms_power;  // RMS scatter of (r^2 + i^2) about the mean over the baselines with finite values
+  float *max_power;  // Max of (r^2 + i^2) over the baselines with finite values
+  int32_t *nnan;     // Number of baselines with a non-finite (NaN or Inf) real or imaginary value
+
+  // Accumulators
+  double *sum;
+  double *sum_sq;
+  uint32_t *max_bits;
+} channel_stats_s;
+
+int channel_stats_alloc(channel_stats_s *stats, int fine_channels, int pols);
+void channel_stats_free(channel_stats_s *stats);
+void compute_channel_stats(const float *buffer, uint64_t baselines, channel_stats_s *stats);
+uint64_t scan_bad_data(const float *buffer, uint64_t baselines, int values_per_baseline, unsigned char *bad_baselines,
+                       uint64_t *zero_baselines);
\ No newline at end of file
@@ -0,0 +1,320 @@
+/**
+ * @file trace.c
+ * @author Greg Sleap
+ * @date 18 Oct 2026
+ * @brief This is the code that records a timeline of events in Chrome trace (Perfetto) format
+ *
+ * Each thread which records an event gets its own ring buffer, so recording an event is a timestamp, a store and
+ * a release of the ring's head, with no locks. Dumping copies each ring then checks the head again, discarding any
+ * events the thread overwrote while it was being copied. Each dump contains the events since the previous dump
+ * (or as many of them as are still in the ring buffers) and can be opened with https://ui.perfetto.dev or
+ * chrome://tracing.
+ */
+#include <linux/limits.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "metrics.h"
+#include "trace.h"
+
+typedef struct
+{
+  uint64_t ts_ns;
+  const char *name;
+  char phase;
+} trace_event_s;
+
+typedef struct trace_ring_s
+{
+  pid_t tid;
+  const char *thread_name;
+  atomic_uint_least64_t head; // Number of events ever recorded by this thread
+  uint64_t dumped;            // Number of events already dumped (only used while holding trace_mutex)
+  trace_event_s events[TRACE_RING_EVENTS];
+  struct trace_ring_s *next;
+} trace_ring_s;
+
+int g_trace_enabled = 0;
+
+static char *trace_dir = NULL;
+static uint64_t trace_start_ns = 0;
+static volatile sig_atomic_t trace_dump_flag = 0;
+
+// Protects the list of ring buffers and dumping
+static pthread_mutex_t trace_mutex = PTHREAD_MUTEX_INITIALIZER;
+static trace_ring_s *trace_rings = NULL;
+
+// This thread's ring buffer (allocated on its first event)
+static __thread trace_ring_s *trace_thread_ring = NULL;
+
+/**
+ *
+ *  @brief Enables tracing. Must be called before any threads are launched.
+ *  @param[in] dir Directory to write trace files to.
+ *  @returns EXIT_SUCCESS on success, or EXIT_FAILURE if there was an error.
+ */
+int trace_init(const char *dir)
+{
+  trace_dir = strdup(dir);
+
+  if (trace_dir == NULL)
+  {
+    return EXIT_FAILURE;
+  }
+
+  trace_start_ns = metrics_now_ns();
+  g_trace_enabled = 1;
+
+  return EXIT_SUCCESS;
+}
+
+/**
+ *
+ *  @brief Returns the calling thread's ring buffer, allocating it the first time.
+ *  @returns Pointer to the ring buffer, or NULL if it could not be allocated.
+ */
+static trace_ring_s *trace_get_thread_ring()
+{
+  if (trace_thread_ring == NULL)
+  {
+    trace_ring_s *ring = calloc(1, sizeof(trace_ring_s));
+
+    if (ring == NULL)
+    {
+      return NULL;
+    }
+
+    ring->tid = (pid_t)syscall(SYS_gettid);
+    ring->thread_name = "thread";
+    atomic_init(&ring->head, 0);
+
+    pthread_mutex_lock(&trace_mutex);
+    ring->next = trace_rings;
+    trace_rings = ring;
+    pthread_mutex_unlock(&trace_mutex);
+
+    trace_thread_ring = ring;
+  }
+
+  return trace_thread_ring;
+}
+
+/**
+ *
+ *  @brief Names the calling thread in the trace. Does nothing if tracing is disabled.
+ *  @param[in] thread_name Name of the thread (must be a string literal).
+ */
+void trace_set_thread_name(const char *thread_name)
+{
+  if (!g_trace_enabled)
+  {
+    return;
+  }
+
+  trace_ring_s *ring = trace_get_thread_ring();
+
+  if (ring != NULL)
+  {
+    pthread_mutex_lock(&trace_mutex);
+    ring->thread_name = thread_name;
+    pthread_mutex_unlock(&trace_mutex);
+  }
+}
+
+/**
+ *
+ *  @brief Records an event in the calling thread's ring buffer. Use TRACE_BEGIN() / TRACE_END() rather than calling this.
+ *  @param[in] name Name of the span (must be a string literal).
+ *  @param[in] phase TRACE_PHASE_BEGIN or TRACE_PHASE_END.
+ */
+void trace_record(const char *name, char phase)
+{
+  trace_ring_s *ring = trace_get_thread_ring();
+
+  if (ring == NULL)
+  {
+    return;
+  }
+
+  // Only this thread writes to its ring, so the head can be read relaxed
+  uint64_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+  trace_event_s *event = &ring->events[head % TRACE_RING_EVENTS];
+
+  event->ts_ns = metrics_now_ns();
+  event->name = name;
+  event->phase = phase;
+
+  atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+}
+
+/**
+ *
+ *  @brief Asks for the trace to be dumped. This is safe to call from a signal handler.
+ */
+void trace_request_dump()
+{
+  trace_dump_flag = 1;
+}
+
+/**
+ *
+ *  @brief Checks (and clears) whether a dump has been asked for with trace_request_dump().
+ *  @returns 1 if a dump was asked for, 0 otherwise.
+ */
+int trace_dump_requested()
+{
+  if (trace_dump_flag)
+  {
+    trace_dump_flag = 0;
+    return 1;
+  }
+
+  return 0;
+}
+
+/**
+ *
+ *  @brief Writes the events recorded since the previous dump to LABEL_UNIXTIME.trace.json in the trace directory.
+ *  @param[in] log A pointer to the multilog_t logger.
+ *  @param[in] label Start of the file name, e.g. the obs_id.
+ *  @returns EXIT_SUCCESS on success, or EXIT_FAILURE if there was an error.
+ */
+int trace_dump(multilog_t *log, const char *label)
+{
+  if (!g_trace_enabled)
+  {
+    return EXIT_SUCCESS;
+  }
+
+  char filename[PATH_MAX];
+  char temp_filename[PATH_MAX + 4]; // + ".tmp"
+  snprintf(filename, PATH_MAX, "%s/%s_%ld.trace.json", trace_dir, label, (long)time(NULL));
+  snprintf(temp_filename, sizeof(temp_filename), "%s.tmp", filename);
+
+  trace_event_s *events = malloc(sizeof(trace_event_s) * TRACE_RING_EVENTS);
+
+  if (events == NULL)
+  {
+    multilog(log, LOG_ERR, "trace_dump(): Error allocating memory for trace events.\n");
+    return EXIT_FAILURE;
+  }
+
+  FILE *file = fopen(temp_filename, "w");
+
+  if (file == NULL)
+  {
+    multilog(log, LOG_ERR, "trace_dump(): Error creating trace file %s.\n", temp_filename);
+    free(events);
+    return EXIT_FAILURE;
+  }
+
+  pid_t pid = getpid();
+  uint64_t total_events = 0;
+  uint64_t lost_events = 0;
+  const char *separator = "";
+
+  fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+
+  pthread_mutex_lock(&trace_mutex);
+
+  for (trace_ring_s *ring = trace_rings; ring != NULL; ring = ring->next)
+  {
+    fprintf(file, "%s\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,\"args\":{\"name\":\"%s\"}}", separator, pid, ring->tid, ring->thread_name);
+    separator = ",";
+
+    // Copy the events we have not dumped yet (or as many of them as the ring still has)
+    uint64_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    uint64_t first = ring->dumped;
+
+    if (head - first > TRACE_RING_EVENTS)
+    {
+      first = head - TRACE_RING_EVENTS;
+    }
+
+    for (uint64_t i = first; i < head; i++)
+    {
+      events[i - first] = ring->events[i % TRACE_RING_EVENTS];
+    }
+
+    // The thread may have overwritten the oldest of them while we were copying
+    atomic_thread_fence(memory_order_acquire);
+    uint64_t head_after = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    uint64_t first_intact = first;
+
+    if (head_after - first_intact > TRACE_RING_EVENTS)
+    {
+      first_intact = head_after - TRACE_RING_EVENTS;
+    }
+
+    if (first_intact > head)
+    {
+      first_intact = head;
+    }
+
+    lost_events += first_intact - ring->dumped;
+
+    for (uint64_t i = first_intact; i < head; i++)
+    {
+      trace_event_s *event = &events[i - first];
+
+      fprintf(file, ",\n{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%.3f,\"pid\":%d,\"tid\":%d}", event->name, event->phase, (double)(event->ts_ns - trace_start_ns) / 1000.0, pid, ring->tid);
+    }
+
+    total_events += head - first_intact;
+    ring->dumped = head;
+  }
+
+  pthread_mutex_unlock(&trace_mutex);
+
+  fprintf(file, "\n]}\n");
+
+  int write_error = ferror(file);
+
+  if (fclose(file) != 0 || write_error)
+  {
+    multilog(log, LOG_ERR, "trace_dump(): Error writing trace file %s.\n", temp_filename);
+    remove(temp_filename);
+    free(events);
+    return EXIT_FAILURE;
+  }
+
+  free(events);
+
+  if (rename(temp_filename, filename) != 0)
+  {
+    multilog(log, LOG_ERR, "trace_dump(): ERROR renaming %s to %s.\n", temp_filename, filename);
+    return EXIT_FAILURE;
+  }
+
+  multilog(log, LOG_INFO, "trace_dump(): Wrote %lu events to %s (%lu older events were overwritten before they could be dumped).\n", total_events, filename, lost_events);
+
+  return EXIT_SUCCESS;
+}
+
+/**
+ *
+ *  @brief Frees the ring buffers. Must only be called once all threads recording events have finished.
+ */
+void trace_destroy()
+{
+  trace_ring_s *ring = trace_rings;
+
+  while (ring != NULL)
+  {
+    trace_ring_s *next = ring->next;
+    free(ring);
+    ring = next;
+  }
+
+  trace_rings = NULL;
+  free(trace_dir);
+  trace_dir = NULL;
+  g_trace_enabled = 0;
+}
\ No newline at end of file
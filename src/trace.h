@@ -0,0 +1,46 @@
+/**
+ * @file trace.h
+ * @author Greg Sleap
+ * @date 18 Oct 2026
+ * @brief This is the header for the code that records a timeline of events in Chrome trace (Perfetto) format
+ *
+ */
+#pragma once
+
+#include <stdint.h>
+#include "multilog.h"
+
+#define TRACE_RING_EVENTS 65536 // Events kept per thread. Once full, the oldest events are overwritten
+#define TRACE_PHASE_BEGIN 'B'
+#define TRACE_PHASE_END 'E'
+
+// Set once at startup (before any threads are launched) if tracing is enabled
+extern int g_trace_enabled;
+
+// Record the beginning / end of a span. name must be a string literal (only the pointer is kept).
+// When tracing is disabled, this is just the test of g_trace_enabled.
+#define TRACE_BEGIN(name)                                 \
+  do                                                      \
+  {                                                       \
+    if (__builtin_expect(g_trace_enabled, 0))             \
+    {                                                     \
+      trace_record((name), TRACE_PHASE_BEGIN);            \
+    }                                                     \
+  } while (0)
+
+#define TRACE_END(name)                                   \
+  do                                                      \
+  {                                                       \
+    if (__builtin_expect(g_trace_enabled, 0))             \
+    {                                                     \
+      trace_record((name), TRACE_PHASE_END);              \
+    }                                                     \
+  } while (0)
+
+int trace_init(const char *trace_dir);
+void trace_set_thread_name(const char *thread_name);
+void trace_record(const char *name, char phase);
+void trace_request_dump();
+int trace_dump_requested();
+int trace_dump(multilog_t *log, const char *label);
+void trace_destroy();
\ No newline at end of file
@@ -0,0 +1,49 @@
+/**
+ * @file transpose.c
+ * @author Greg Sleap
+ * @date 18 Oct 2026
+ * @brief This is the code that reorders visibilities into frequency-major order
+ *
+ */
+#include <string.h>
+#include "transpose.h"
+
+/**
+ *
+ *  @brief Transposes one integration of visibilities from [baseline][finechan][pol][r,i] to [finechan][baseline][pol][r,i].
+ *         The pol/r,i values of each baseline/fine channel are contiguous in both layouts so we move them as one element
+ *         and walk the baseline x fine channel matrix in square tiles, so both the reads (along fine channels) and the
+ *         writes (along baselines) stay in cache rather than striding across the whole integration.
+ *  @param[in] in The visibilities in baseline-major order.
+ *  @param[out] out The buffer to write the frequency-major visibilities to (must not overlap in).
+ *  @param[in] baselines The number of baselines.
+ *  @param[in] fine_channels The number of fine channels.
+ *  @param[in] values_per_fine_channel The number of floats for each baseline/fine channel (pol * pol * 2).
+ */
+void transpose_visibilities(const float *in, float *out, uint64_t baselines, uint64_t fine_channels, uint64_t values_per_fine_channel)
+{
+  const uint64_t element_bytes = values_per_fine_channel * sizeof(float);
+
+  for (uint64_t b0 = 0; b0 < baselines; b0 += TRANSPOSE_TILE_BASELINES)
+  {
+    uint64_t b1 = (b0 + TRANSPOSE_TILE_BASELINES < baselines) ? b0 + TRANSPOSE_TILE_BASELINES : baselines;
+
+    for (uint64_t f0 = 0; f0 < fine_channels; f0 += TRANSPOSE_TILE_FINECHANS)
+    {
+      uint64_t f1 = (f0 + TRANSPOSE_TILE_FINECHANS < fine_channels) ? f0 + TRANSPOSE_TILE_FINECHANS : fine_channels;
+
+      for (uint64_t f = f0; f < f1; f++)
+      {
+        float *dest = out + ((f * baselines) + b0) * values_per_fine_channel;
+        const float *src = in + ((b0 * fine_channels) + f) * values_per_fine_channel;
+
+        for (uint64_t b = b0; b < b1; b++)
+        {
+          memcpy(dest, src, element_bytes);
+          dest += values_per_fine_channel;
+          src += fine_channels * values_per_fine_channel;
+        }
+      }
+    }
+  }
+}
\ No newline at end of file
@@ -0,0 +1,15 @@
+/**
+ * @file transpose.h
+ * @author Greg Sleap
+ * @date 18 Oct 2026
+ * @brief This is the header for the code that reorders visibilities into frequency-major order
+ *
+ */
+#pragma once
+
+#include <stdint.h>
+
+#define TRANSPOSE_TILE_BASELINES 32 // Baselines per tile. A tile of 32x32 (8 float) elements is 32 KB, which keeps source and destination in L2
+#define TRANSPOSE_TILE_FINECHANS 32 // Fine channels per tile
+
+void transpose_visibilities(const float *in, float *out, uint64_t baselines, uint64_t fine_channels, uint64_t values_per_fine_channel);
\ No newline at end of file
@@ -120,4 +120,108 @@ int get_ip_address_for_interface(const char *interface, char *out_ip_address)
     {
         return EXIT_FAILURE;
     }
+}
+
+/**
+ *
+ *  @brief Returns the baseline index of the autocorrelation for a tile. Baselines are ordered for each tile i, every
+ *         tile j <= i, so the auto for tile i sits after the i*(i+1)/2 baselines of the preceding tiles plus the i
+ *         cross correlations of tile i.
+ *  @param[in] tile The tile index (0 based).
+ *  @returns The 0 based baseline index of the tile's autocorrelation.
+ */
+uint64_t get_auto_baseline_index(int tile)
+{
+    return ((uint64_t)tile * (tile + 1)) / 2 + tile;
+}
+
+/**
+ *
+ *  @brief Adds the XX and YY weights of each tile's autocorrelation to running totals. Only the autocorrelations are
+ *         visited (by computing their index), so this is O(ntiles) rather than O(baselines).
+ *  @param[in] buffer Pointer to the baseline weights: [baseline][pol] with pols ordered xx, xy, yx, yy.
+ *  @param[in] ntiles Number of tiles in the observation.
+ *  @param[in,out] weights_per_tile_x Running total of the XX weight of each tile.
+ *  @param[in,out] weights_per_tile_y Running total of the YY weight of each tile.
+ */
+void accumulate_auto_weights(const float *buffer, int ntiles, double *weights_per_tile_x, double *weights_per_tile_y)
+{
+    for (int tile = 0; tile < ntiles; tile++)
+    {
+        uint64_t xx_index = get_auto_baseline_index(tile) * 4; // There are 4 pols per baseline in the weights provided to us.
+        uint64_t yy_index = xx_index + 3;                      // Pols are ordered xx, xy, yx, yy, so add 3 to the xx index to get yy.
+
+        weights_per_tile_x[tile] += buffer[xx_index];
+        weights_per_tile_y[tile] += buffer[yy_index];
+    }
+}
+
+/**
+ *
+ *  @brief Adds the mean XX and YY power of each tile's autocorrelation to running totals, and optionally the mean
+ *         power in each of bandpass_bins contiguous ranges of fine channels. Only the autocorrelations are visited.
+ *         The inner loop gathers the XX and YY real values (every 8th float) of a range of fine channels and is
+ *         vectorised with an OpenMP simd reduction. NaN/Inf values are counted as 0, so one bad integration does
+ *         not poison the running totals.
+ *  @param[in] buffer Pointer to the visibilities: [baseline][finechan][pol][r,i] with pols ordered xx, xy, yx, yy.
+ *  @param[in] ntiles Number of tiles in the observation.
+ *  @param[in] nfine_chan Number of fine channels.
+ *  @param[in] bandpass_bins Number of bandpass bins, or 0 for none.
+ *  @param[in,out] power_per_tile_x Running total of the mean XX power of each tile.
+ *  @param[in,out] power_per_tile_y Running total of the mean YY power of each tile.
+ *  @param[in,out] bandpass_per_tile Running total of the mean power in each bin: [tile][pol x,y][bin]. May be NULL if bandpass_bins is 0.
+ */
+void accumulate_auto_power(const float *buffer, int ntiles, int nfine_chan, int bandpass_bins, double *power_per_tile_x, double *power_per_tile_y, double *bandpass_per_tile)
+{
+    const uint64_t values_per_baseline = (uint64_t)nfine_chan * 8; // 4 pols of r,i per fine channel
+    const int nbins = (bandpass_bins > 0 ? bandpass_bins : 1);
+
+    for (int tile = 0; tile < ntiles; tile++)
+    {
+        const float *restrict values = buffer + (get_auto_baseline_index(tile) * values_per_baseline);
+        double tile_x = 0;
+        double tile_y = 0;
+
+        for (int bin = 0; bin < nbins; bin++)
+        {
+            int first_chan = (bin * nfine_chan) / nbins;
+            int last_chan = ((bin + 1) * nfine_chan) / nbins;
+            float bin_x = 0;
+            float bin_y = 0;
+
+#pragma omp simd reduction(+ : bin_x, bin_y)
+            for (int chan = first_chan; chan < last_chan; chan++)
+            {
+                uint32_t x_bits;
+                uint32_t y_bits;
+                memcpy(&x_bits, &values[chan * 8], sizeof(x_bits));     // xx real
+                memcpy(&y_bits, &values[chan * 8 + 6], sizeof(y_bits)); // yy real
+
+                // Mask non-finite values (exponent bits all set) to 0
+                x_bits &= 0u - (uint32_t)((x_bits & 0x7f800000) != 0x7f800000);
+                y_bits &= 0u - (uint32_t)((y_bits & 0x7f800000) != 0x7f800000);
+
+                float x;
+                float y;
+                memcpy(&x, &x_bits, sizeof(x));
+                memcpy(&y, &y_bits, sizeof(y));
+
+                bin_x += x;
+                bin_y += y;
+            }
+
+            tile_x += bin_x;
+            tile_y += bin_y;
+
+            // More bins than fine channels leaves some bins empty
+            if (bandpass_bins > 0 && last_chan > first_chan)
+            {
+                bandpass_per_tile[((uint64_t)tile * 2 * nbins) + bin] += bin_x / (last_chan - first_chan);
+                bandpass_per_tile[((uint64_t)tile * 2 * nbins) + nbins + bin] += bin_y / (last_chan - first_chan);
+            }
+        }
+
+        power_per_tile_x[tile] += tile_x / nfine_chan;
+        power_per_tile_y[tile] += tile_y / nfine_chan;
+    }
 }
\ No newline at end of file
@@ -7,9 +7,13 @@
  */
 #pragma once
 
+#include <stdint.h>
 #include <time.h>
 
 int get_time_struct(struct tm **out_timeinfo);
 int get_time_string_for_fits(char *timestring);
 int get_time_string_for_log(char *timestring);
-int get_ip_address_for_interface(const char *interface, char *out_ip_address);
\ No newline at end of file
+int get_ip_address_for_interface(const char *interface, char *out_ip_address);
+uint64_t get_auto_baseline_index(int tile);
+void accumulate_auto_weights(const float *buffer, int ntiles, double *weights_per_tile_x, double *weights_per_tile_y);
+void accumulate_auto_power(const float *buffer, int ntiles, int nfine_chan, int bandpass_bins, double *power_per_tile_x, double *power_per_tile_y, double *bandpass_per_tile);
\ No newline at end of file
@@ -8,5 +8,5 @@
 #pragma once
 
 #define MWAX_DB2FITS_VERSION_MAJOR 1
-#define MWAX_DB2FITS_VERSION_MINOR 0
+#define MWAX_DB2FITS_VERSION_MINOR 1
 #define MWAX_DB2FITS_VERSION_PATCH 0
\ No newline at end of file
@@ -0,0 +1,246 @@
+/**
+ * @file warmup.c
+ * @author Greg Sleap
+ * @date 18 Oct 2026
+ * @brief This is the code that gets everything ready before the first observation arrives, and (optionally)
+ *        reserves the disk space of each fits file as it is created
+ *
+ * Without a warm-up, the first observation after a start pays for things which are only done once: finding out the
+ * destination path is missing or read only when its first fits file can't be created, cfitsio allocating its buffers,
+ * the page faults of the staging buffers and starting the RFI flagging threads. warmup_run() does these while
+ * mwax_db2fits is starting, so the first integration is processed as fast as every other one.
+ *
+ * With --preallocate, the disk space each fits file is expected to need is reserved (fallocate, without changing its
+ * size) as soon as it is created, so the filesystem allocates it in one go rather than as each integration is
+ * appended. The unused part of the reservation is released before the file is closed.
+ */
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "global.h"
+#include "rfi.h"
+#include "warmup.h"
+
+/**
+ *
+ *  @brief Checks a directory exists and we can create files in it.
+ *  @param[in] path The directory.
+ *  @param[in] description What it is for (for the log).
+ *  @param[in] log The logger to use.
+ *  @returns EXIT_SUCCESS on success, or EXIT_FAILURE if there was an error.
+ */
+static int warmup_check_directory(const char *path, const char *description, multilog_t *log)
+{
+  struct stat path_stat;
+
+  if (stat(path, &path_stat) != 0)
+  {
+    multilog(log, LOG_ERR, "warmup_run(): %s %s does not exist: %s\n", description, path, strerror(errno));
+    return EXIT_FAILURE;
+  }
+
+  if (!S_ISDIR(path_stat.st_mode))
+  {
+    multilog(log, LOG_ERR, "warmup_run(): %s %s is not a directory.\n", description, path);
+    return EXIT_FAILURE;
+  }
+
+  if (access(path, W_OK | X_OK) != 0)
+  {
+    multilog(log, LOG_ERR, "warmup_run(): %s %s is not writable: %s\n", description, path, strerror(errno));
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
+
+/**
+ *
+ *  @brief Creates (and deletes) a small fits file in the destination path, which checks we really can write fits
+ *         files there and has cfitsio set up its buffers before the first observation.
+ *  @param[in] path The destination path.
+ *  @param[in] log The logger to use.
+ *  @returns EXIT_SUCCESS on success, or EXIT_FAILURE if there was an error.
+ */
+static int warmup_probe_fits(const char *path, multilog_t *log)
+{
+  char cfitsio_filename[PATH_MAX + 1];
+  snprintf(cfitsio_filename, sizeof(cfitsio_filename), "!%s/%s", path, WARMUP_PROBE_FILENAME);
+
+  fitsfile *fptr = NULL;
+  int status = 0;
+
+  if (fits_create_file(&fptr, cfitsio_filename, &status) || fits_create_img(fptr, BYTE_IMG, 0, NULL, &status) || fits_delete_file(fptr, &status))
+  {
+    char error_text[30] = "";
+    fits_get_errstatus(status, error_text);
+    multilog(log, LOG_ERR, "warmup_run(): Error creating %s. Error: %d -- %s\n", cfitsio_filename + 1, status, error_text);
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
+
+/**
+ *
+ *  @brief Gets everything ready before the first observation: checks the destination (and trace and alternate)
+ *         paths, has cfitsio write a fits file, allocates and pre-faults the staging buffers which can be sized from the
+ *         ringbuffer block size (the rest depend on the observation) and starts the RFI flagging threads.
+ *  @param[in] client A pointer to the dada_client_t object (ctx->block_size is 0 if not known yet).
+ *  @param[in] trace_dir The trace directory, or NULL if tracing is disabled.
+ *  @returns EXIT_SUCCESS on success, or EXIT_FAILURE if there was an error.
+ */
+int warmup_run(dada_client_t *client, const char *trace_dir)
+{
+  assert(client != 0);
+  dada_db_s *ctx = (dada_db_s *)client->context;
+  multilog_t *log = (multilog_t *)ctx->log;
+
+  uint64_t start_ns = metrics_now_ns();
+
+  if (warmup_check_directory(ctx->destination_dir, "Destination path", log) != EXIT_SUCCESS ||
+      warmup_probe_fits(ctx->destination_dir, log) != EXIT_SUCCESS)
+  {
+    return EXIT_FAILURE;
+  }
+
+  if (trace_dir != NULL && warmup_check_directory(trace_dir, "Trace directory", log) != EXIT_SUCCESS)
+  {
+    return EXIT_FAILURE;
+  }
+
+  if (ctx->alternate_destination_dir != NULL && warmup_check_directory(ctx->alternate_destination_dir, "Alternate path", log) != EXIT_SUCCESS)
+  {
+    return EXIT_FAILURE;
+  }
+
+  // An integration (without its weights) is never bigger than a ringbuffer block, so the transpose buffer can be
+  // allocated now. Writing to it faults its pages in.
+  if (ctx->vis_layout == VIS_LAYOUT_FINECHAN_MAJOR && ctx->block_size > ctx->transpose_buffer_capacity)
+  {
+    float *new_buffer = realloc(ctx->transpose_buffer, ctx->block_size);
+
+    if (new_buffer == NULL)
+    {
+      multilog(log, LOG_ERR, "warmup_run(): Error allocating %lu bytes for the transpose buffer.\n", ctx->block_size);
+      return EXIT_FAILURE;
+    }
+
+    memset(new_buffer, 0, ctx->block_size);
+    ctx->transpose_buffer = new_buffer;
+    ctx->transpose_buffer_capacity = ctx->block_size;
+  }
+
+  if (ctx->rfi_threshold > 0)
+  {
+    rfi_start_threads(ctx->rfi_threads, ctx->perf.enabled);
+  }
+
+  multilog(log, LOG_INFO, "warmup_run(): Ready in %.3f ms.\n", (double)(metrics_now_ns() - start_ns) / 1000000.0);
+
+  return EXIT_SUCCESS;
+}
+
+/**
+ *
+ *  @brief Reserves the disk space the fits file which has just been created is expected to need: the rest of the
+ *         observation, or the file size limit if that is smaller. Its size is not changed, so cfitsio sees it as
+ *         usual. A filesystem which can't reserve space is logged once and otherwise ignored.
+ *  @param[in] client A pointer to the dada_client_t object.
+ *  @returns EXIT_SUCCESS on success, or EXIT_FAILURE if there was an error.
+ */
+int warmup_preallocate_fits(dada_client_t *client)
+{
+  assert(client != 0);
+  dada_db_s *ctx = (dada_db_s *)client->context;
+  multilog_t *log = (multilog_t *)ctx->log;
+
+  static int unsupported_logged = 0;
+
+  ctx->preallocated_bytes = 0;
+
+  int remaining_subobs = (ctx->exposure_sec - ctx->obs_offset + ctx->secs_per_subobs - 1) / ctx->secs_per_subobs;
+  uint64_t bytes = (uint64_t)(remaining_subobs > 1 ? remaining_subobs : 1) * ctx->expected_transfer_size_of_subobs_plus_weights;
+
+  if (ctx->fits_file_size_limit > 0 && bytes > (uint64_t)ctx->fits_file_size_limit)
+  {
+    bytes = ctx->fits_file_size_limit;
+  }
+
+  if (bytes == 0)
+  {
+    return EXIT_SUCCESS;
+  }
+
+  int fd = open(ctx->temp_fits_filename, O_WRONLY);
+
+  if (fd < 0)
+  {
+    multilog(log, LOG_ERR, "warmup_preallocate_fits(): Error opening %s: %s\n", ctx->temp_fits_filename, strerror(errno));
+    return EXIT_FAILURE;
+  }
+
+  if (fallocate(fd, FALLOC_FL_KEEP_SIZE, 0, (off_t)bytes) != 0)
+  {
+    if ((errno == EOPNOTSUPP || errno == ENOSYS) && !unsupported_logged)
+    {
+      multilog(log, LOG_WARNING, "warmup_preallocate_fits(): The filesystem of %s can't reserve space. Continuing without.\n", ctx->temp_fits_filename);
+      unsupported_logged = 1;
+    }
+    else if (errno != EOPNOTSUPP && errno != ENOSYS)
+    {
+      multilog(log, LOG_WARNING, "warmup_preallocate_fits(): Error reserving %lu bytes for %s: %s\n", bytes, ctx->temp_fits_filename, strerror(errno));
+    }
+  }
+  else
+  {
+    ctx->preallocated_bytes = bytes;
+  }
+
+  close(fd);
+
+  return EXIT_SUCCESS;
+}
+
+/**
+ *
+ *  @brief Releases the part of a fits file's reservation (see warmup_preallocate_fits()) it did not use: flushes it, so
+ *         everything to the end of its last HDU is in the file, and truncates it there.
+ *  @param[in] client A pointer to the dada_client_t object.
+ *  @param[in] fptr The fits file, which is about to be closed.
+ *  @returns EXIT_SUCCESS on success, or EXIT_FAILURE if there was an error.
+ */
+int warmup_release_fits(dada_client_t *client, fitsfile *fptr)
+{
+  assert(client != 0);
+  dada_db_s *ctx = (dada_db_s *)client->context;
+  multilog_t *log = (multilog_t *)ctx->log;
+
+  LONGLONG head_start = 0;
+  LONGLONG data_start = 0;
+  LONGLONG data_end = 0;
+  int status = 0;
+
+  if (fits_flush_file(fptr, &status) || fits_get_hduaddrll(fptr, &head_start, &data_start, &data_end, &status))
+  {
+    char error_text[30] = "";
+    fits_get_errstatus(status, error_text);
+    multilog(log, LOG_ERR, "warmup_release_fits(): Error flushing %s. Error: %d -- %s\n", ctx->temp_fits_filename, status, error_text);
+    return EXIT_FAILURE;
+  }
+
+  if (truncate(ctx->temp_fits_filename, (off_t)data_end) != 0)
+  {
+    multilog(log, LOG_ERR, "warmup_release_fits(): Error truncating %s to %lld bytes: %s\n", ctx->temp_fits_filename, data_end, strerror(errno));
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
\ No newline at end of file
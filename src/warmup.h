@@ -0,0 +1,19 @@
+/**
+ * @file warmup.h
+ * @author Greg Sleap
+ * @date 18 Oct 2026
+ * @brief This is the header for the code that gets everything ready before the first observation arrives
+ *
+ */
+#pragma once
+
+#include <stdint.h>
+#include "dada_client.h"
+#include "fitsio.h"
+#include "multilog.h"
+
+#define WARMUP_PROBE_FILENAME ".mwax_db2fits_warmup.fits.tmp" // Created and deleted in the destination path to check we can write fits files there (.tmp so it is never picked up as an output file)
+
+int warmup_run(dada_client_t *client, const char *trace_dir);
+int warmup_preallocate_fits(dada_client_t *client);
+int warmup_release_fits(dada_client_t *client, fitsfile *fptr);
\ No newline at end of file
@@ -0,0 +1,67 @@
+#
+# Test05: Analyse output files and/or logs from this test of mwax_db2fits
+#
+from astropy.io import fits
+import numpy as np
+import os
+from tests_common import read_fits_hdu, count_fits_hdus
+
+TEST05_FITS_FILENAME = "test05/1324440018_20211225040000_ch148_000.fits"
+TEST05_AUTOS_FITS_FILENAME = "test05/1324440018_20211225040000_ch148_000_autos.fits"
+
+
+def test05_fits_file_produced():
+    # Check a FITS file was produced
+    assert os.path.exists(TEST05_FITS_FILENAME)
+
+
+def test05_autos_fits_file_produced():
+    # Check the autos FITS file was produced (and renamed from .tmp)
+    assert os.path.exists(TEST05_AUTOS_FITS_FILENAME)
+    assert not os.path.exists(TEST05_AUTOS_FITS_FILENAME + ".tmp")
+
+
+def test05_fits_file_has_correct_hdus():
+    # Check the output fits file has 1 primary + 8 HDUs
+    # 1 V + 1 W per timestep == 4 x 2 = 8 + primary == 9
+    assert 9 == count_fits_hdus(TEST05_FITS_FILENAME)
+
+
+def test05_autos_fits_file_has_correct_hdus():
+    # Check the autos fits file has 1 primary + 2 HDUs
+    # 4 timesteps averaged 2 at a time == 2 + primary == 3
+    assert 3 == count_fits_hdus(TEST05_AUTOS_FITS_FILENAME)
+
+
+def test05_autos_fits_file_has_correct_hdu_dimensions():
+    with fits.open(TEST05_AUTOS_FITS_FILENAME) as fits_file:
+        assert fits_file[0].header["NAVERAGE"] == 2
+
+        for h in range(1, 3):
+            d = fits_file[h].data
+
+            # 2 tiles x (2 fine chans * 4 pols * r,i)
+            assert d.shape[0] == 2
+            assert d.shape[1] == 16
+            assert fits_file[h].header["NAVERAGE"] == 2
+
+
+def test05_check_autos_hdu_values():
+    # Tile 0 auto is baseline 0, tile 1 auto is baseline 2.
+    # Each value is n + (timestep * 100) so averaging 2 timesteps adds the
+    # mean of their offsets to every one of the 32 auto values.
+    autos1 = read_fits_hdu(TEST05_AUTOS_FITS_FILENAME, 1)
+    assert 5552 == np.sum(autos1)
+    assert 150 == autos1[0][0]
+    assert 182 == autos1[1][0]
+
+    autos2 = read_fits_hdu(TEST05_AUTOS_FITS_FILENAME, 2)
+    assert 11952 == np.sum(autos2)
+    assert 350 == autos2[0][0]
+    assert 382 == autos2[1][0]
+
+
+def test05_check_autos_hdu_markers():
+    with fits.open(TEST05_AUTOS_FITS_FILENAME) as fits_file:
+        assert fits_file[1].header["MARKER"] == 0
+        assert fits_file[2].header["MARKER"] == 2
@@ -0,0 +1,64 @@
+#
+# Test06: Analyse output files and/or logs from this test of mwax_db2fits
+#
+from astropy.io import fits
+from math import isclose
+import numpy as np
+import os
+from tests_common import read_fits_hdu, count_fits_hdus
+
+TEST06_FITS_FILENAME = "test06/1324440018_20211225040000_ch148_000.fits"
+
+
+def test06_fits_file_produced():
+    # Check a FITS file was produced
+    assert os.path.exists(TEST06_FITS_FILENAME)
+
+
+def test06_fits_file_has_correct_hdus():
+    # Check the output fits file has 1 primary + 8 HDUs
+    # 1 V + 1 W per timestep == 4 x 2 = 8 + primary == 9
+    assert 9 == count_fits_hdus(TEST06_FITS_FILENAME)
+
+
+def test06_fits_file_declares_layout():
+    with fits.open(TEST06_FITS_FILENAME) as fits_file:
+        assert fits_file[0].header["VISORDER"] == "FINECHAN_BASELINE_POL"
+
+
+def test06_fits_file_has_correct_hdu_dimensions():
+    with fits.open(TEST06_FITS_FILENAME) as fits_file:
+        # Visibilities: 2 fine chans x (3 baselines * 4 pols * r,i)
+        for h in range(1, 9, 2):
+            d = fits_file[h].data
+
+            assert d.shape[0] == 2
+            assert d.shape[1] == 24
+
+        # Weights
+        for h in range(2, 9, 2):
+            d = fits_file[h].data
+
+            assert d.shape[0] == 3
+            assert d.shape[1] == 4
+
+
+def test06_check_hdu_values():
+    # Same values as test04, just reordered
+    data1 = read_fits_hdu(TEST06_FITS_FILENAME, 1)
+    assert 5928 == np.sum(data1)
+    weights1 = read_fits_hdu(TEST06_FITS_FILENAME, 2)
+    assert isclose(3.3, np.sum(weights1), rel_tol=1e-6)
+
+    data4 = read_fits_hdu(TEST06_FITS_FILENAME, 7)
+    assert 20328 == np.sum(data4)
+
+
+def test06_check_hdu_transposed():
+    # Input value for baseline b, fine chan f, pol/ri k is b*16 + f*8 + k + 100
+    data1 = read_fits_hdu(TEST06_FITS_FILENAME, 1)
+
+    for f in range(0, 2):
+        for b in range(0, 3):
+            for k in range(0, 8):
+                assert data1[f][(b * 8) + k] == (b * 16) + (f * 8) + k + 100
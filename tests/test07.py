@@ -0,0 +1,53 @@
+#
+# Test07: Analyse output files and/or logs from this test of mwax_db2fits
+#
+from astropy.io import fits
+import numpy as np
+import os
+from tests_common import count_fits_hdus
+
+TEST07_FITS_FILENAME = "test07/1324440018_20211225040000_ch148_000.fits"
+
+NBASELINES = 3
+NFINECHAN = 2
+NPOLS = 4
+
+
+def expected_channel_stats(timestep):
+    # Each value is n + (timestep * 100) where n is the index into
+    # [baseline][finechan][pol][r,i]
+    n = np.arange(NBASELINES * NFINECHAN * NPOLS * 2, dtype=np.float64)
+    vis = (n + (timestep * 100)).reshape(NBASELINES, NFINECHAN, NPOLS, 2)
+    power = vis[:, :, :, 0] ** 2 + vis[:, :, :, 1] ** 2
+    return (power.mean(axis=0), power.std(axis=0), power.max(axis=0))
+
+
+def test07_fits_file_produced():
+    # Check a FITS file was produced
+    assert os.path.exists(TEST07_FITS_FILENAME)
+
+
+def test07_fits_file_has_correct_hdus():
+    # Check the output fits file has 1 primary + 12 HDUs
+    # 1 V + 1 W + 1 CHANSTATS per timestep == 4 x 3 = 12 + primary == 13
+    assert 13 == count_fits_hdus(TEST07_FITS_FILENAME)
+
+
+def test07_check_chanstats_hdus():
+    with fits.open(TEST07_FITS_FILENAME) as fits_file:
+        for timestep in range(1, 5):
+            hdu = fits_file[timestep * 3]
+
+            assert hdu.header["EXTNAME"] == "CHANSTATS"
+            assert hdu.header["MARKER"] == timestep - 1
+            assert hdu.header["NBASELN"] == NBASELINES
+            assert hdu.header["TIME"] == fits_file[(timestep * 3) - 2].header["TIME"]
+
+            # One row per fine channel, each a vector of 4 pols
+            assert hdu.data["MEAN_PWR"].shape == (NFINECHAN, NPOLS)
+
+            mean, rms, max_power = expected_channel_stats(timestep)
+            assert np.allclose(hdu.data["MEAN_PWR"], mean, rtol=1e-6)
+            assert np.allclose(hdu.data["RMS_PWR"], rms, rtol=1e-4)
+            assert np.allclose(hdu.data["MAX_PWR"], max_power, rtol=1e-6)
+            assert np.all(hdu.data["NNAN"] == 0)
@@ -0,0 +1,64 @@
+#
+# Test08: Analyse output files and/or logs from this test of mwax_db2fits
+#
+from astropy.io import fits
+import numpy as np
+import os
+from tests_common import count_fits_hdus, read_fits_hdu
+
+TEST08_FITS_FILENAME = "test08/1324440018_20211225040000_ch148_000.fits"
+TEST08_LOG_FILENAME = "test08/mwax_db2fits.log"
+
+
+def test08_fits_file_produced():
+    # Check a FITS file was produced
+    assert os.path.exists(TEST08_FITS_FILENAME)
+
+
+def test08_fits_file_has_correct_hdus():
+    # Nothing is dropped with zero-weight, so 1 V + 1 W per timestep == 4 x 2 = 8 + primary == 9
+    assert 9 == count_fits_hdus(TEST08_FITS_FILENAME)
+
+
+def test08_check_bad_data_keys():
+    # Timesteps 2 and 4 (markers 1 and 3) have a NaN in baseline 1 and baseline 2 is all zeros
+    with fits.open(TEST08_FITS_FILENAME) as fits_file:
+        for timestep in range(1, 5):
+            header = fits_file[(timestep * 2) - 1].header
+
+            if timestep % 2 == 0:
+                assert header["NNONFIN"] == 1
+                assert header["NZEROBL"] == 1
+            else:
+                assert header["NNONFIN"] == 0
+                assert header["NZEROBL"] == 0
+
+
+def test08_check_bad_baselines_have_zero_weight():
+    for timestep in range(1, 5):
+        weights = read_fits_hdu(TEST08_FITS_FILENAME, timestep * 2)
+
+        # Baseline 0 is always good and keeps its weights
+        # (which start at (timestep - 1) * 0.05 and go up by 0.05)
+        expected = ((timestep - 1) * 0.05) + (np.arange(4) * 0.05)
+        assert np.allclose(weights[0], expected)
+
+        if timestep % 2 == 0:
+            assert np.all(weights[1] == 0)
+            assert np.all(weights[2] == 0)
+        else:
+            assert np.all(weights[1] != 0)
+            assert np.all(weights[2] != 0)
+
+
+def test08_check_log_warns_of_bad_data():
+    with open(TEST08_LOG_FILENAME) as log_file:
+        log = log_file.read()
+
+    for marker in [1, 3]:
+        assert (
+            f"Integration has 1 NaN/Inf values and 1 zero-power baselines; Marker = {marker}; Policy = zero-weight."
+            in log
+        )
+
+    assert 2 == log.count("zero-power baselines; Marker =")
@@ -0,0 +1,112 @@
+#include <getopt.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "../common.h"
+
+#define NTIMESTEPS 2
+#define NTILES 2
+#define NBASELINES ((NTILES * (NTILES + 1)) / 2)
+#define NFINECHAN 2
+#define NPOLS 4   // xx,xy,yx,yy
+#define NVALUES 2 // r,i
+
+// Same as write_visibilities_hdu() in common.c, but baseline 1 gets a NaN and baseline 2 is all zeros
+int write_bad_visibilities_hdu(int output_file, int nbaselines, int nfinechan, int npols, int nvalues, int timestep, int start_number)
+{
+    int values_per_baseline = nfinechan * npols * nvalues;
+    int buffer_len = nbaselines * values_per_baseline;
+    int buffer_bytes = buffer_len * sizeof(float);
+    float *buffer = calloc(buffer_len, sizeof(float));
+
+    // Fill buffer with values
+    for (int n = 0; n < values_per_baseline * 2; n++)
+    {
+        buffer[n] = (float)n + (float)start_number;
+    }
+
+    buffer[values_per_baseline] = NAN;
+
+    // Write to disk
+    int bytes_written = write(output_file, buffer, buffer_bytes);
+
+    // Check
+    if (bytes_written != buffer_bytes)
+    {
+        printf("Error writing bad visibilities (timestep: %d). Wrote %d bytes- should have been %d.\n", timestep, bytes_written, buffer_bytes);
+        return EXIT_FAILURE;
+    }
+    printf("%d bytes written to bad visibilities (timestep: %d).\n", bytes_written, timestep);
+    return EXIT_SUCCESS;
+}
+
+void usage()
+{
+    printf("make_test08_data subobs_number header output_file\n"
+           "subobs_number subobs number (1-based) e.g. 1,2...\n"
+           "header        DADA header file contain obs metadata\n"
+           "output_file   Output data filename\n");
+}
+
+int main(int argc, char **argv)
+{
+    // Process args
+    int arg = 0;
+
+    while ((arg = getopt(argc, argv, "h:")) != -1)
+    {
+        switch (arg)
+        {
+        default:
+            usage();
+            return 0;
+        }
+    }
+
+    // check the header file was supplied
+    if ((argc - optind) != 3)
+    {
+        printf("ERROR: subobs_number, header and output file must be specified\n");
+        usage();
+        exit(EXIT_FAILURE);
+    }
+
+    int subobs_number = atoi(argv[optind]);
+    char *header_filename = strdup(argv[optind + 1]);
+    char *output_filename = strdup(argv[optind + 2]);
+
+    int output_file = 0;
+
+    write_header(header_filename, output_filename, &output_file);
+
+    // Create the visibilities data
+    for (int timestep = 1; timestep <= NTIMESTEPS; timestep++)
+    {
+        // Write visibilities (the 2nd timestep of each subobs is bad)
+        if (timestep == 2)
+        {
+            if (write_bad_visibilities_hdu(output_file, NBASELINES, NFINECHAN, NPOLS, NVALUES, timestep, (((subobs_number - 1) * NTIMESTEPS) + timestep) * 100) != EXIT_SUCCESS)
+            {
+                exit(EXIT_FAILURE);
+            }
+        }
+        else if (write_visibilities_hdu(output_file, NBASELINES, NFINECHAN, NPOLS, NVALUES, timestep, (((subobs_number - 1) * NTIMESTEPS) + timestep) * 100) != EXIT_SUCCESS)
+        {
+            exit(EXIT_FAILURE);
+        }
+
+        // Write weights
+        if (write_weights_hdu(output_file, NBASELINES, NFINECHAN, NPOLS, NVALUES, timestep, (((subobs_number - 1) * NTIMESTEPS) + (timestep - 1)) * 0.05, 0.05) != EXIT_SUCCESS)
+        {
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    close(output_file);
+
+    return EXIT_SUCCESS;
+}
\ No newline at end of file
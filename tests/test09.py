@@ -0,0 +1,120 @@
+#
+# Test09: Analyse output files and/or logs from this test of mwax_db2fits
+#
+from astropy.io import fits
+import os
+import struct
+from tests_common import count_fits_hdus
+
+TEST09_FITS_FILENAME = "test09/1324440018_20211225040000_ch148_000.fits"
+TEST09_INDEX_FILENAME = "test09/1324440018_20211225040000_ch148_000.idx"
+
+# See hdu_index.h
+INDEX_HEADER_FORMAT = "<8sIIQqii24x"
+INDEX_RECORD_FORMAT = "<iiqQQQQQQ"
+
+
+def read_index(filename):
+    with open(filename, "rb") as f:
+        data = f.read()
+
+    header_size = struct.calcsize(INDEX_HEADER_FORMAT)
+    record_size = struct.calcsize(INDEX_RECORD_FORMAT)
+    header = struct.unpack_from(INDEX_HEADER_FORMAT, data, 0)
+    records = [
+        struct.unpack_from(INDEX_RECORD_FORMAT, data, header_size + (r * record_size))
+        for r in range(header[3])
+    ]
+
+    return data, header, records
+
+
+def test09_fits_file_produced():
+    # Check a FITS file was produced
+    assert os.path.exists(TEST09_FITS_FILENAME)
+
+
+def test09_index_file_produced():
+    # Check the index file was produced (and renamed from .tmp)
+    assert os.path.exists(TEST09_INDEX_FILENAME)
+    assert not os.path.exists(TEST09_INDEX_FILENAME + ".tmp")
+
+
+def test09_fits_file_has_correct_hdus():
+    # Check the output fits file has 1 primary + 8 HDUs
+    # 1 V + 1 W per timestep == 4 x 2 = 8 + primary == 9
+    assert 9 == count_fits_hdus(TEST09_FITS_FILENAME)
+
+
+def test09_index_header():
+    data, header, records = read_index(TEST09_INDEX_FILENAME)
+
+    magic, version, record_size, record_count, obs_id, coarse_channel, fits_file_number = header
+
+    assert magic == b"MWAXIDX1"
+    assert version == 1
+    assert record_size == 64
+    assert record_count == 4
+    assert obs_id == 1324440018
+    assert coarse_channel == 148
+    assert fits_file_number == 0
+
+    # Header + 4 records and nothing else
+    assert len(data) == 64 + (4 * 64)
+
+
+def test09_index_records_match_fits_file():
+    data, header, records = read_index(TEST09_INDEX_FILENAME)
+
+    with fits.open(TEST09_FITS_FILENAME) as fits_file:
+        for timestep, record in enumerate(records):
+            (
+                marker,
+                millitim,
+                time,
+                vis_header_offset,
+                vis_data_offset,
+                vis_data_bytes,
+                weights_header_offset,
+                weights_data_offset,
+                weights_data_bytes,
+            ) = record
+
+            vis_hdu = (timestep * 2) + 1
+            weights_hdu = vis_hdu + 1
+            vis_info = fits_file.fileinfo(vis_hdu)
+            weights_info = fits_file.fileinfo(weights_hdu)
+
+            assert marker == fits_file[vis_hdu].header["MARKER"]
+            assert time == fits_file[vis_hdu].header["TIME"]
+            assert millitim == fits_file[vis_hdu].header["MILLITIM"]
+
+            assert vis_header_offset == vis_info["hdrLoc"]
+            assert vis_data_offset == vis_info["datLoc"]
+            assert vis_data_bytes == fits_file[vis_hdu].data.nbytes
+
+            assert weights_header_offset == weights_info["hdrLoc"]
+            assert weights_data_offset == weights_info["datLoc"]
+            assert weights_data_bytes == fits_file[weights_hdu].data.nbytes
+
+
+def test09_index_offsets_point_at_data():
+    # Reading the bytes at each data offset gives the same values as astropy
+    data, header, records = read_index(TEST09_INDEX_FILENAME)
+
+    with open(TEST09_FITS_FILENAME, "rb") as f:
+        raw = f.read()
+
+    with fits.open(TEST09_FITS_FILENAME) as fits_file:
+        for timestep, record in enumerate(records):
+            vis_data_offset, vis_data_bytes = record[4], record[5]
+            weights_data_offset, weights_data_bytes = record[7], record[8]
+
+            assert (
+                raw[vis_data_offset : vis_data_offset + vis_data_bytes]
+                == fits_file[(timestep * 2) + 1].data.astype(">f4").tobytes()
+            )
+            assert (
+                raw[weights_data_offset : weights_data_offset + weights_data_bytes]
+                == fits_file[(timestep * 2) + 2].data.astype(">f4").tobytes()
+            )
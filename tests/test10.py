@@ -0,0 +1,76 @@
+#
+# Test10: Analyse output files and/or logs from this test of mwax_db2fits
+#
+from astropy.io import fits
+from math import isclose
+import numpy as np
+import os
+from tests_common import read_fits_hdu, count_fits_hdus
+
+TEST10_FITS_FILENAME = "test10/1324440018_20211225040000_ch148_000.fits"
+
+
+def test10_fits_file_produced():
+    # Check a FITS file was produced
+    assert os.path.exists(TEST10_FITS_FILENAME)
+
+
+def test10_fits_file_has_correct_hdus():
+    # Check the output fits file has 1 primary + 4 HDUs
+    # 1 V cube + 1 W cube per subobs == 2 x 2 = 4 + primary == 5
+    assert 5 == count_fits_hdus(TEST10_FITS_FILENAME)
+
+
+def test10_primary_hdu_has_cube_key():
+    with fits.open(TEST10_FITS_FILENAME) as fits_file:
+        assert fits_file[0].header["CUBE"]
+
+
+def test10_fits_file_has_correct_hdu_dimensions():
+    with fits.open(TEST10_FITS_FILENAME) as fits_file:
+        # Visibilities
+        for h in range(1, 5, 2):
+            d = fits_file[h].data
+
+            assert d.shape == (2, 3, 16)
+
+        # Weights
+        for h in range(2, 5, 2):
+            d = fits_file[h].data
+
+            assert d.shape == (2, 3, 4)
+
+
+def test10_check_hdu_keys():
+    with fits.open(TEST10_FITS_FILENAME) as fits_file:
+        # Each cube has the time and marker of its first timestep
+        assert fits_file[1].header["MARKER"] == 0
+        assert fits_file[2].header["MARKER"] == 0
+        assert fits_file[3].header["MARKER"] == 2
+        assert fits_file[4].header["MARKER"] == 2
+
+        assert fits_file[1].header["TIME"] == fits_file[2].header["TIME"]
+        assert fits_file[3].header["TIME"] == fits_file[1].header["TIME"] + 8
+        assert fits_file[3].header["TIME"] == fits_file[4].header["TIME"]
+        assert fits_file[1].header["MILLITIM"] == 0
+        assert fits_file[3].header["MILLITIM"] == 0
+
+        assert fits_file[1].header["NNONFIN"] == 0
+        assert fits_file[3].header["NNONFIN"] == 0
+
+
+def test10_check_hdu_values():
+    # The same values as each of Test 01's per integration HDUs
+    data1 = read_fits_hdu(TEST10_FITS_FILENAME, 1)
+    assert 5928 == np.sum(data1[0])
+    assert 10728 == np.sum(data1[1])
+    weights1 = read_fits_hdu(TEST10_FITS_FILENAME, 2)
+    assert isclose(3.3, np.sum(weights1[0]), rel_tol=1e-6)
+    assert isclose(3.9, np.sum(weights1[1]), rel_tol=1e-6)
+
+    data2 = read_fits_hdu(TEST10_FITS_FILENAME, 3)
+    assert 15528 == np.sum(data2[0])
+    assert 20328 == np.sum(data2[1])
+    weights2 = read_fits_hdu(TEST10_FITS_FILENAME, 4)
+    assert isclose(4.5, np.sum(weights2[0]), rel_tol=1e-6)
+    assert isclose(5.1, np.sum(weights2[1]), rel_tol=1e-6)
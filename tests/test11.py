@@ -0,0 +1,52 @@
+#
+# Test11: Analyse output files and/or logs from this test of mwax_db2fits
+#
+from astropy.io import fits
+from math import isclose
+import numpy as np
+import os
+from tests_common import read_fits_hdu, count_fits_hdus
+
+TEST11_FITS_FILENAME = "test11/1324440018_20211225040000_ch148_000.fits"
+
+
+def test11_fits_file_produced():
+    # Check a FITS file was produced, named after the start of the observation
+    assert os.path.exists(TEST11_FITS_FILENAME)
+
+
+def test11_journal_removed():
+    # The fits file is complete, so neither its journal nor its .tmp should be left
+    assert not os.path.exists(TEST11_FITS_FILENAME + ".jnl")
+    assert not os.path.exists(TEST11_FITS_FILENAME + ".tmp")
+
+
+def test11_fits_file_has_correct_hdus():
+    # Check the output fits file has 1 primary + 4 HDUs
+    # 1 V + 1 W per timestep == 2 x 2 = 4 + primary == 5
+    assert 5 == count_fits_hdus(TEST11_FITS_FILENAME)
+
+
+def test11_check_hdu_keys():
+    with fits.open(TEST11_FITS_FILENAME) as fits_file:
+        # We joined 8 seconds (2 x 4 sec integrations) into the observation
+        assert fits_file[1].header["MARKER"] == 2
+        assert fits_file[2].header["MARKER"] == 2
+        assert fits_file[3].header["MARKER"] == 3
+        assert fits_file[4].header["MARKER"] == 3
+
+        assert fits_file[1].header["TIME"] == 1640404808
+        assert fits_file[3].header["TIME"] == 1640404812
+
+
+def test11_check_hdu_values():
+    # The same values as timesteps 3 and 4 of Test 01
+    data3 = read_fits_hdu(TEST11_FITS_FILENAME, 1)
+    assert 15528 == np.sum(data3)
+    weights3 = read_fits_hdu(TEST11_FITS_FILENAME, 2)
+    assert isclose(4.5, np.sum(weights3), rel_tol=1e-6)
+
+    data4 = read_fits_hdu(TEST11_FITS_FILENAME, 3)
+    assert 20328 == np.sum(data4)
+    weights4 = read_fits_hdu(TEST11_FITS_FILENAME, 4)
+    assert isclose(5.1, np.sum(weights4), rel_tol=1e-6)
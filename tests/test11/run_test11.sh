@@ -0,0 +1,28 @@
+#!/usr/bin/env bash
+
+echo "Test11- see README.md for more information"
+
+echo "Removing old tmp, fits, journal and data files"
+rm -v *.tmp
+rm -v *.fits
+rm -v *.jnl
+rm -v *.dat
+rm -v mwax_db2fits.log
+
+echo "Clearing ring buffers"
+dada_db -k 2345 -d
+
+echo "Creating ring buffers (4 buffers of 240 bytes)"
+dada_db -k 2345 -n 4 -b 240
+
+echo "Create subobservation 2 (we start part way through the observation)"
+./make_test11_data 2 test11_header_2.txt test11_data2.dat
+
+echo "Load into ring buffers"
+dada_diskdb -s -k 2345 -f test11_data2.dat
+
+echo "Load our quit command into ring buffer"
+dada_diskdb -s -k 2345 -f ../quit_header.txt
+
+echo "Launching mwax_db2fits"
+../../bin/mwax_db2fits -k 2345 --destination-path=. -l 0 -n eth0 -i 224.0.2.2 -p 50001 -J -j |& tee mwax_db2fits.log
@@ -0,0 +1,57 @@
+#
+# Test12: Analyse output files and/or logs from this test of mwax_db2fits
+#
+from astropy.io import fits
+from math import isclose
+import numpy as np
+import os
+from tests_common import read_fits_hdu, count_fits_hdus
+
+TEST12_REFUSED_FITS_FILENAME = "test12/1324440018_20211225040000_ch148_000.fits"
+TEST12_FITS_FILENAME = "test12/1324440034_20211225040016_ch148_000.fits"
+
+
+def test12_refused_observation_not_written():
+    # The first observation won't fit, so nothing should have been written for it
+    assert not os.path.exists(TEST12_REFUSED_FITS_FILENAME)
+    assert not os.path.exists(TEST12_REFUSED_FITS_FILENAME + ".tmp")
+
+
+def test12_refused_observation_logged():
+    with open("test12/mwax_db2fits.log") as log_file:
+        assert "Refusing observation 1324440018" in log_file.read()
+
+
+def test12_fits_file_produced():
+    # Check a FITS file was produced for the second observation
+    assert os.path.exists(TEST12_FITS_FILENAME)
+
+
+def test12_fits_file_has_correct_hdus():
+    # Check the output fits file has 1 primary + 4 HDUs
+    # 1 V + 1 W per timestep == 2 x 2 = 4 + primary == 5
+    assert 5 == count_fits_hdus(TEST12_FITS_FILENAME)
+
+
+def test12_check_hdu_keys():
+    with fits.open(TEST12_FITS_FILENAME) as fits_file:
+        assert fits_file[1].header["MARKER"] == 0
+        assert fits_file[2].header["MARKER"] == 0
+        assert fits_file[3].header["MARKER"] == 1
+        assert fits_file[4].header["MARKER"] == 1
+
+        assert fits_file[1].header["TIME"] == 1640404816
+        assert fits_file[3].header["TIME"] == 1640404820
+
+
+def test12_check_hdu_values():
+    # The same values as timesteps 1 and 2 of Test 01
+    data1 = read_fits_hdu(TEST12_FITS_FILENAME, 1)
+    assert 5928 == np.sum(data1)
+    weights1 = read_fits_hdu(TEST12_FITS_FILENAME, 2)
+    assert isclose(3.3, np.sum(weights1), rel_tol=1e-6)
+
+    data2 = read_fits_hdu(TEST12_FITS_FILENAME, 3)
+    assert 10728 == np.sum(data2)
+    weights2 = read_fits_hdu(TEST12_FITS_FILENAME, 4)
+    assert isclose(3.9, np.sum(weights2), rel_tol=1e-6)
@@ -0,0 +1,31 @@
+#!/usr/bin/env bash
+
+echo "Test12- see README.md for more information"
+
+echo "Removing old tmp, fits and data files"
+rm -v *.tmp
+rm -v *.fits
+rm -v *.dat
+rm -v mwax_db2fits.log
+
+echo "Clearing ring buffers"
+dada_db -k 2345 -d
+
+echo "Creating ring buffers (4 buffers of 240 bytes)"
+dada_db -k 2345 -n 4 -b 240
+
+echo "Create the first observation (far too long to fit on any disk)"
+./make_test12_data 1 test12_header_1.txt test12_data1.dat
+
+echo "Create the second observation (1 subobservation)"
+./make_test12_data 1 test12_header_2.txt test12_data2.dat
+
+echo "Load into ring buffers"
+dada_diskdb -s -k 2345 -f test12_data1.dat
+dada_diskdb -s -k 2345 -f test12_data2.dat
+
+echo "Load our quit command into ring buffer"
+dada_diskdb -s -k 2345 -f ../quit_header.txt
+
+echo "Launching mwax_db2fits"
+../../bin/mwax_db2fits -k 2345 --destination-path=. -l 0 -n eth0 -i 224.0.2.2 -p 50001 --space-policy=refuse |& tee mwax_db2fits.log
@@ -0,0 +1,52 @@
+#
+# Test13: Analyse output files and/or logs from this test of mwax_db2fits
+#
+from astropy.io import fits
+import numpy as np
+import os
+from tests_common import read_fits_hdu, count_fits_hdus
+
+TEST13_FITS_FILENAME = "test13/1324440018_20211225040000_ch148_000.fits"
+
+# The flags of each baseline are 2 bytes: fine channel f is bit (f % 8) of byte (f / 8)
+# Timestep 1: baseline 1 fine channel 5 (RFI) and baseline 2 fine channel 9 (NaN)
+TEST13_FLAGS_TIMESTEP_1 = [[0x20, 0x00], [0x00, 0x02], [0x00, 0x00]]
+# Timestep 2: baseline 3 fine channel 14 (RFI)
+TEST13_FLAGS_TIMESTEP_2 = [[0x00, 0x00], [0x00, 0x00], [0x00, 0x40]]
+
+
+def test13_fits_file_produced():
+    # Check a FITS file was produced
+    assert os.path.exists(TEST13_FITS_FILENAME)
+
+
+def test13_fits_file_has_correct_hdus():
+    # Check the output fits file has 1 primary + 12 HDUs
+    # 1 V + 1 W + 1 F per timestep == 4 x 3 = 12 + primary == 13
+    assert 13 == count_fits_hdus(TEST13_FITS_FILENAME)
+
+
+def test13_check_flags_hdu_keys():
+    with fits.open(TEST13_FITS_FILENAME) as fits_file:
+        for timestep in range(4):
+            flags_hdu = fits_file[3 + (timestep * 3)]
+            assert flags_hdu.header["MARKER"] == timestep
+            assert flags_hdu.header["TIME"] == 1640404800 + (timestep * 4)
+            assert flags_hdu.header["NAXIS1"] == 2
+            assert flags_hdu.header["NAXIS2"] == 3
+
+
+def test13_check_nflagged():
+    # Fine channel 3 differs from the rest (which are all the same) by 1%, which is within the minimum MAD so is not flagged
+    with fits.open(TEST13_FITS_FILENAME) as fits_file:
+        assert fits_file[3].header["NFLAGGED"] == 2
+        assert fits_file[6].header["NFLAGGED"] == 1
+        assert fits_file[9].header["NFLAGGED"] == 2
+        assert fits_file[12].header["NFLAGGED"] == 1
+
+
+def test13_check_flags_hdu_values():
+    for timestep in range(4):
+        flags = read_fits_hdu(TEST13_FITS_FILENAME, 3 + (timestep * 3))
+        expected = TEST13_FLAGS_TIMESTEP_1 if timestep % 2 == 0 else TEST13_FLAGS_TIMESTEP_2
+        assert np.array_equal(flags, np.array(expected, dtype=np.uint8))
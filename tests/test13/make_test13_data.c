@@ -0,0 +1,126 @@
+#include <getopt.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "../common.h"
+
+#define NTIMESTEPS 2
+#define NTILES 2
+#define NBASELINES ((NTILES * (NTILES + 1)) / 2)
+#define NFINECHAN 16
+#define NPOLS 4   // xx,xy,yx,yy
+#define NVALUES 2 // r,i
+
+// Sets the real part of one baseline/fine channel/pol of the visibilities
+void set_visibility(float *buffer, int baseline, int finechan, int pol, float value)
+{
+    buffer[(((baseline * NFINECHAN) + finechan) * NPOLS + pol) * NVALUES] = value;
+}
+
+// Every visibility is 100 + 0i, except fine channel 3 which is 101 + 0i (so more than half of the fine channels have
+// exactly the same amplitude), and in timestep 1: baseline 1 xx fine channel 5 is RFI and baseline 2 yy fine channel 9
+// is NaN, and in timestep 2: baseline 3 yy fine channel 14 is RFI
+int write_rfi_visibilities_hdu(int output_file, int timestep)
+{
+    int buffer_len = NBASELINES * NFINECHAN * NPOLS * NVALUES;
+    int buffer_bytes = buffer_len * sizeof(float);
+    float *buffer = calloc(buffer_len, sizeof(float));
+
+    for (int baseline = 0; baseline < NBASELINES; baseline++)
+    {
+        for (int finechan = 0; finechan < NFINECHAN; finechan++)
+        {
+            for (int pol = 0; pol < NPOLS; pol++)
+            {
+                set_visibility(buffer, baseline, finechan, pol, (finechan == 3 ? 101 : 100));
+            }
+        }
+    }
+
+    if (timestep == 1)
+    {
+        set_visibility(buffer, 0, 5, 0, 1000);
+        set_visibility(buffer, 1, 9, 3, NAN);
+    }
+    else
+    {
+        set_visibility(buffer, 2, 14, 3, 1000);
+    }
+
+    // Write to disk
+    int bytes_written = write(output_file, buffer, buffer_bytes);
+    free(buffer);
+
+    // Check
+    if (bytes_written != buffer_bytes)
+    {
+        printf("Error writing visibilities (timestep: %d). Wrote %d bytes- should have been %d.\n", timestep, bytes_written, buffer_bytes);
+        return EXIT_FAILURE;
+    }
+    printf("%d bytes written to visibilities (timestep: %d).\n", bytes_written, timestep);
+    return EXIT_SUCCESS;
+}
+
+void usage()
+{
+    printf("make_test13_data subobs_number header output_file\n"
+           "subobs_number subobs number (1-based) e.g. 1,2...\n"
+           "header        DADA header file contain obs metadata\n"
+           "output_file   Output data filename\n");
+}
+
+int main(int argc, char **argv)
+{
+    // Process args
+    int arg = 0;
+
+    while ((arg = getopt(argc, argv, "h:")) != -1)
+    {
+        switch (arg)
+        {
+        default:
+            usage();
+            return 0;
+        }
+    }
+
+    // check the header file was supplied
+    if ((argc - optind) != 3)
+    {
+        printf("ERROR: subobs_number, header and output file must be specified\n");
+        usage();
+        exit(EXIT_FAILURE);
+    }
+
+    int subobs_number = atoi(argv[optind]);
+    char *header_filename = strdup(argv[optind + 1]);
+    char *output_filename = strdup(argv[optind + 2]);
+
+    int output_file = 0;
+
+    write_header(header_filename, output_filename, &output_file);
+
+    // Create the visibilities data
+    for (int timestep = 1; timestep <= NTIMESTEPS; timestep++)
+    {
+        // Write visibilities
+        if (write_rfi_visibilities_hdu(output_file, timestep) != EXIT_SUCCESS)
+        {
+            exit(EXIT_FAILURE);
+        }
+
+        // Write weights
+        if (write_weights_hdu(output_file, NBASELINES, NFINECHAN, NPOLS, NVALUES, timestep, (((subobs_number - 1) * NTIMESTEPS) + (timestep - 1)) * 0.05, 0.05) != EXIT_SUCCESS)
+        {
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    close(output_file);
+
+    return EXIT_SUCCESS;
+}
\ No newline at end of file
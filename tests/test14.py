@@ -0,0 +1,59 @@
+#
+# Test14: Analyse output files and/or logs from this test of mwax_db2fits
+#
+from astropy.io import fits
+import numpy as np
+import os
+from tests_common import count_fits_hdus
+
+TEST14_SINGLE_FITS_FILENAME = "test14/single/1324440018_20211225040000_ch148_000.fits"
+TEST14_DIRECTORY_FITS_FILENAME = "test14/directory/1324440018_20211225040000_ch148_000.fits"
+
+# Test 01 reads the same data from the ringbuffer
+TEST01_FITS_FILENAME = "test01/1324440018_20211225040000_ch148_000.fits"
+
+
+def assert_same_hdus(filename: str, expected_filename: str, hdus: int):
+    # Check each HDU after the primary has the same keys and data as the same HDU of the expected file
+    with fits.open(filename) as fits_file, fits.open(expected_filename) as expected_fits_file:
+        for h in range(1, hdus):
+            for key in ["NAXIS1", "NAXIS2", "TIME", "MILLITIM", "MARKER"]:
+                assert fits_file[h].header[key] == expected_fits_file[h].header[key]
+
+            assert np.array_equal(fits_file[h].data, expected_fits_file[h].data)
+
+
+def test14_fits_files_produced():
+    # Check a FITS file was produced (and renamed from .tmp) by each run
+    assert os.path.exists(TEST14_SINGLE_FITS_FILENAME)
+    assert not os.path.exists(TEST14_SINGLE_FITS_FILENAME + ".tmp")
+    assert os.path.exists(TEST14_DIRECTORY_FITS_FILENAME)
+    assert not os.path.exists(TEST14_DIRECTORY_FITS_FILENAME + ".tmp")
+
+
+def test14_single_fits_file_has_correct_hdus():
+    # Check the output fits file has 1 primary + 4 HDUs
+    # 1 V + 1 W per timestep == 2 x 2 = 4 + primary == 5
+    assert 5 == count_fits_hdus(TEST14_SINGLE_FITS_FILENAME)
+
+
+def test14_directory_fits_file_has_correct_hdus():
+    # Check the output fits file has 1 primary + 8 HDUs, like Test 01
+    # 1 V + 1 W per timestep == 4 x 2 = 8 + primary == 9
+    assert 9 == count_fits_hdus(TEST14_DIRECTORY_FITS_FILENAME)
+
+
+def test14_single_fits_file_matches_ringbuffer():
+    # The single file is the 1st subobservation, so timesteps 1 and 2 of Test 01
+    assert_same_hdus(TEST14_SINGLE_FITS_FILENAME, TEST01_FITS_FILENAME, 5)
+
+
+def test14_directory_fits_file_matches_ringbuffer():
+    assert_same_hdus(TEST14_DIRECTORY_FITS_FILENAME, TEST01_FITS_FILENAME, 9)
+
+
+def test14_check_primary_hdu_keys():
+    # The observation's keys are taken from the replayed headers, as they would be from the ringbuffer
+    with fits.open(TEST14_DIRECTORY_FITS_FILENAME) as fits_file, fits.open(TEST01_FITS_FILENAME) as expected_fits_file:
+        for key in ["OBSID", "TIME", "INTTIME", "NINPUTS", "NFINECHS", "FINECHAN", "PROJID"]:
+            assert fits_file[0].header[key] == expected_fits_file[0].header[key]
@@ -0,0 +1,22 @@
+#!/usr/bin/env bash
+
+echo "Test14- see README.md for more information"
+
+echo "Removing old output, data and log files"
+rm -rv input single directory
+rm -v *.dat
+rm -v mwax_db2fits_*.log
+mkdir input single directory
+
+echo "Create subobservation 1 and 2 (the same as Test 01) in the input directory"
+./make_test14_data 1 test14_header_1.txt input/test14_data1.dat
+./make_test14_data 2 test14_header_2.txt input/test14_data2.dat
+
+echo "Create subobservation 1 of a 1 subobservation observation as a single file"
+./make_test14_data 1 test14_header_single.txt test14_single.dat
+
+echo "Launching mwax_db2fits to replay the single file (no ringbuffer)"
+../../bin/mwax_db2fits --input-file=test14_single.dat --destination-path=single -l 0 -n eth0 -i 224.0.2.2 -p 50001 |& tee mwax_db2fits_single.log
+
+echo "Launching mwax_db2fits to replay the input directory (no ringbuffer)"
+../../bin/mwax_db2fits --input-file=input --destination-path=directory -l 0 -n eth0 -i 224.0.2.2 -p 50001 |& tee mwax_db2fits_directory.log
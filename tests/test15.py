@@ -0,0 +1,86 @@
+#
+# Test15: Analyse output files and/or logs from this test of mwax_db2fits
+#
+from astropy.io import fits
+from math import isclose
+import numpy as np
+import os
+import struct
+from tests_common import read_fits_hdu, count_fits_hdus, assert_substring_in_file
+
+TEST15_FITS_FILENAME = "test15/1324440018_20211225040000_ch148_000.fits"
+TEST15_INDEX_FILENAME = "test15/1324440018_20211225040000_ch148_000.idx"
+TEST15_EXPECTED_SIZE_FILENAME = "test15/test15_expected_size.txt"
+
+# See hdu_index.h
+INDEX_HEADER_FORMAT = "<8sIIQqii24x"
+INDEX_RECORD_FORMAT = "<iiqQQQQQQ"
+
+
+def test15_fits_file_recovered():
+    # Check the .tmp file was renamed, and its journal removed
+    assert os.path.exists(TEST15_FITS_FILENAME)
+    assert not os.path.exists(TEST15_FITS_FILENAME + ".tmp")
+    assert not os.path.exists(TEST15_FITS_FILENAME + ".jnl")
+
+
+def test15_recovery_logged():
+    assert_substring_in_file("test15/mwax_db2fits_recovered.log", "Recovered 2 integrations")
+
+
+def test15_fits_file_truncated_to_last_complete_integration():
+    # The part of the next integration (and its corrupt journal record) should have been dropped
+    with open(TEST15_EXPECTED_SIZE_FILENAME) as f:
+        expected_size = int(f.read())
+
+    assert os.path.getsize(TEST15_FITS_FILENAME) == expected_size
+    assert expected_size % 2880 == 0
+
+
+def test15_fits_file_has_correct_hdus():
+    # Check the output fits file has 1 primary + 4 HDUs
+    # 1 V + 1 W per timestep == 2 x 2 = 4 + primary == 5
+    assert 5 == count_fits_hdus(TEST15_FITS_FILENAME)
+
+
+def test15_check_hdu_values():
+    # The same values as timesteps 1 and 2 of Test 01
+    data1 = read_fits_hdu(TEST15_FITS_FILENAME, 1)
+    assert 5928 == np.sum(data1)
+    weights1 = read_fits_hdu(TEST15_FITS_FILENAME, 2)
+    assert isclose(3.3, np.sum(weights1), rel_tol=1e-6)
+
+    data2 = read_fits_hdu(TEST15_FITS_FILENAME, 3)
+    assert 10728 == np.sum(data2)
+    weights2 = read_fits_hdu(TEST15_FITS_FILENAME, 4)
+    assert isclose(3.9, np.sum(weights2), rel_tol=1e-6)
+
+    with fits.open(TEST15_FITS_FILENAME) as fits_file:
+        assert fits_file[1].header["MARKER"] == 0
+        assert fits_file[3].header["MARKER"] == 1
+
+
+def test15_index_rebuilt_from_journal():
+    # The .idx is written from the journal's records, so it should have the 2 complete integrations only
+    with open(TEST15_INDEX_FILENAME, "rb") as f:
+        data = f.read()
+
+    header = struct.unpack_from(INDEX_HEADER_FORMAT, data, 0)
+    magic, version, record_size, record_count, obs_id, coarse_channel, fits_file_number = header
+
+    assert magic == b"MWAXIDX1"
+    assert record_count == 2
+    assert obs_id == 1324440018
+    assert len(data) == 64 + (2 * 64)
+
+    with fits.open(TEST15_FITS_FILENAME) as fits_file:
+        for timestep in range(2):
+            record = struct.unpack_from(INDEX_RECORD_FORMAT, data, 64 + (timestep * 64))
+            vis_info = fits_file.fileinfo((timestep * 2) + 1)
+            weights_info = fits_file.fileinfo((timestep * 2) + 2)
+
+            assert record[0] == timestep
+            assert record[3] == vis_info["hdrLoc"]
+            assert record[4] == vis_info["datLoc"]
+            assert record[6] == weights_info["hdrLoc"]
+            assert record[7] == weights_info["datLoc"]
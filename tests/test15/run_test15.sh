@@ -0,0 +1,45 @@
+#!/usr/bin/env bash
+
+echo "Test15- see README.md for more information"
+
+echo "Removing old output, data and log files"
+rm -rv input empty
+rm -v *.tmp
+rm -v *.fits
+rm -v *.jnl
+rm -v *.idx
+rm -v *.dat
+rm -v test15_expected_size.txt
+rm -v mwax_db2fits_*.log
+mkdir input empty
+
+echo "Create subobservation 1 (of 2)"
+./make_test15_data 1 test15_header_1.txt input/test15_data1.dat
+
+echo "Launching mwax_db2fits to write subobservation 1 and stop, as if it was killed part way through the observation"
+../../bin/mwax_db2fits --input-file=input --destination-path=. -l 0 -n eth0 -i 224.0.2.2 -p 50001 --journal --hdu-index |& tee mwax_db2fits_stopped.log
+
+echo "The end of the last complete integration (the size the recovered fits file should be)"
+stat -c %s 1324440018_20211225040000_ch148_000.fits.tmp | tee test15_expected_size.txt
+
+echo "Append part of the next integration to the fits file, and a record for it (with the wrong checksum) to the journal"
+head -c 5000 /dev/urandom >> 1324440018_20211225040000_ch148_000.fits.tmp
+python3 - <<'PYTHON'
+import os
+import struct
+
+journal_filename = "1324440018_20211225040000_ch148_000.fits.jnl"
+
+# See journal.h: hdu_index_record_s (64 bytes), file_size (uint64), sequence (uint32), checksum (uint32)
+with open(journal_filename, "rb") as f:
+    last_record = f.read()[-80:]
+
+hdus, file_size, sequence, checksum = struct.unpack("<64sQII", last_record)
+file_size = os.path.getsize("1324440018_20211225040000_ch148_000.fits.tmp")
+
+with open(journal_filename, "ab") as f:
+    f.write(struct.pack("<64sQII", hdus, file_size, sequence + 1, checksum))
+PYTHON
+
+echo "Launching mwax_db2fits with nothing to replay, to recover the fits file from its journal"
+../../bin/mwax_db2fits --input-file=empty --destination-path=. -l 0 -n eth0 -i 224.0.2.2 -p 50001 --journal --hdu-index |& tee mwax_db2fits_recovered.log